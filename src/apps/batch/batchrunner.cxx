@@ -0,0 +1,355 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include "batchrunner.hxx"
+
+#include "core/core.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_batch
+ * @{
+ *     @file
+ *     @brief Implementation file for the headless batch runner
+ * @}
+ */
+
+/**
+ * Small helper task to process one scene inside the QThreadPool.
+ */
+class BatchSceneTask
+:   public QRunnable
+{
+    public:
+        BatchSceneTask(BatchRunner* runner, const QString& scene, const QString& output_dir, bool compress)
+        :   m_runner(runner),
+            m_scene(scene),
+            m_output_dir(output_dir),
+            m_compress(compress)
+        {
+        }
+
+        void run()
+        {
+            m_runner->processScene(m_scene, m_output_dir, m_compress);
+        }
+
+    private:
+        BatchRunner* m_runner;
+        QString m_scene;
+        QString m_output_dir;
+        bool m_compress;
+};
+
+BatchRunner::BatchRunner(Workspace* wsp)
+:   m_workspace(wsp),
+    m_input_id("input"),
+    m_scenes(0),
+    m_failed_scenes(0),
+    m_bytes_in(0),
+    m_elapsed_ms(0)
+{
+}
+
+bool BatchRunner::loadPipeline(const QString& filename)
+{
+    QIODevice* device = Impex::openFile(filename, QIODevice::ReadOnly);
+
+    if(device == NULL)
+    {
+        qWarning() << "BatchRunner::loadPipeline: Could not open file:" << filename;
+        return false;
+    }
+
+    m_pipeline = device->readAll();
+    device->close();
+    delete device;
+
+    m_statistics.clear();
+
+    //Check the root and collect all stages:
+    QXmlStreamReader xmlReader(m_pipeline);
+
+    if(!xmlReader.readNextStartElement() || xmlReader.name() != "Pipeline")
+    {
+        qWarning() << "BatchRunner::loadPipeline: Did not find the Pipeline root element in" << filename;
+        return false;
+    }
+
+    if(xmlReader.attributes().hasAttribute("Input"))
+    {
+        m_input_id = xmlReader.attributes().value("Input").toString();
+    }
+
+    while(xmlReader.readNextStartElement())
+    {
+        StageStatistics stage;
+        stage.type = xmlReader.name().toString();
+        stage.id = xmlReader.attributes().value("ID").toString();
+        stage.elapsed_ms = 0;
+        stage.runs = 0;
+        stage.errors = 0;
+
+        bool found = false;
+        for(const AlgorithmFactoryItem& item : m_workspace->algorithmFactory())
+        {
+            if(item.algorithm_type == stage.type)
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if(!found)
+        {
+            qWarning() << "BatchRunner::loadPipeline: Algorithm type" << stage.type << "was not found among available ones.";
+            return false;
+        }
+
+        m_statistics.push_back(stage);
+        xmlReader.skipCurrentElement();
+    }
+
+    if(xmlReader.hasError())
+    {
+        qWarning() << "BatchRunner::loadPipeline: XML error:" << xmlReader.errorString();
+        return false;
+    }
+
+    return !m_statistics.empty();
+}
+
+unsigned int BatchRunner::run(const QStringList& scenes, const QString& output_dir, unsigned int threads, bool compress)
+{
+    m_mutex.lock();
+    for(StageStatistics& stage : m_statistics)
+    {
+        stage.elapsed_ms = 0;
+        stage.runs = 0;
+        stage.errors = 0;
+    }
+    m_scenes = scenes.size();
+    m_failed_scenes = 0;
+    m_bytes_in = 0;
+    m_mutex.unlock();
+
+    QDir().mkpath(output_dir);
+
+    QThreadPool pool;
+    if(threads != 0)
+    {
+        pool.setMaxThreadCount(threads);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for(const QString& scene : scenes)
+    {
+        pool.start(new BatchSceneTask(this, scene, output_dir, compress));
+    }
+    pool.waitForDone();
+
+    m_elapsed_ms = timer.elapsed();
+
+    return m_scenes - m_failed_scenes;
+}
+
+bool BatchRunner::processScene(const QString& scene, const QString& output_dir, bool compress)
+{
+    //Every scene gets its own workspace, but shares the factories
+    Workspace* wsp = new Workspace(*m_workspace);
+    bool success = true;
+
+    Model* input = wsp->loadModel(scene);
+
+    if(input == NULL)
+    {
+        qWarning() << "BatchRunner: Could not load scene:" << scene;
+        success = false;
+    }
+    else
+    {
+        input->setID(m_input_id);
+
+        QXmlStreamReader xmlReader(m_pipeline);
+        xmlReader.readNextStartElement();
+
+        std::vector<Model*> results;
+
+        for(int s=0; s<m_statistics.size() && success; ++s)
+        {
+            QElapsedTimer timer;
+            timer.start();
+
+            Algorithm* alg = wsp->loadAlgorithm(xmlReader);
+
+            if(alg == NULL)
+            {
+                qWarning() << "BatchRunner: Could not restore stage" << s << "for scene:" << scene;
+                success = false;
+                break;
+            }
+
+            //Read until the end of this stage comes...
+            while(!(xmlReader.isEndElement() && xmlReader.name() == m_statistics[s].type) && !xmlReader.atEnd())
+            {
+                xmlReader.readNext();
+            }
+
+            bool finished = false;
+            QString error;
+
+            QObject::connect(alg, &Algorithm::finished, [&finished](){ finished = true; });
+            QObject::connect(alg, &Algorithm::errorMessage, [&error](QString message){ error = message; });
+
+            alg->execute();
+
+            qint64 elapsed = timer.elapsed();
+
+            if(finished && error.isEmpty())
+            {
+                results = alg->results();
+
+                for(unsigned int j=0; j<results.size(); ++j)
+                {
+                    results[j]->setID(QString("%1:%2").arg(m_statistics[s].id).arg(j));
+                }
+            }
+            else
+            {
+                qWarning() << "BatchRunner: Stage" << m_statistics[s].type << "failed for scene:" << scene << error;
+                success = false;
+            }
+
+            delete alg;
+
+            m_mutex.lock();
+            m_statistics[s].elapsed_ms += elapsed;
+            if(success)
+            {
+                m_statistics[s].runs++;
+            }
+            else
+            {
+                m_statistics[s].errors++;
+            }
+            m_mutex.unlock();
+        }
+
+        //Save the results of the last stage
+        if(success)
+        {
+            QString basename = QFileInfo(scene).completeBaseName();
+
+            for(unsigned int j=0; j<results.size(); ++j)
+            {
+                QString filename = QDir(output_dir).absoluteFilePath(QString("%1_%2_%3.%4")
+                                                                     .arg(basename)
+                                                                     .arg(m_statistics.back().id)
+                                                                     .arg(j)
+                                                                     .arg(compress ? "xgz" : "xml"));
+                if(!Impex::save(results[j], filename, compress))
+                {
+                    qWarning() << "BatchRunner: Could not save result:" << filename;
+                    success = false;
+                }
+            }
+        }
+    }
+
+    //Clean up all models of this scene, since there is no event loop
+    //in this thread, which would handle the deleteLater() of the Workspace.
+    wsp->models_mutex.lock();
+    while(!wsp->models.empty())
+    {
+        delete wsp->models.back();
+    }
+    wsp->models_mutex.unlock();
+    delete wsp;
+
+    m_mutex.lock();
+    m_bytes_in += QFileInfo(scene).size();
+    if(!success)
+    {
+        m_failed_scenes++;
+    }
+    m_mutex.unlock();
+
+    return success;
+}
+
+QString BatchRunner::report() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QString str = QString("Processed %1 scenes (%2 failed) in %3 s\n")
+                    .arg(m_scenes)
+                    .arg(m_failed_scenes)
+                    .arg(m_elapsed_ms/1000.0, 0, 'f', 2);
+
+    if(m_elapsed_ms > 0)
+    {
+        str += QString("Throughput: %1 scenes/s, %2 MB/s (input)\n")
+                    .arg(m_scenes*1000.0/m_elapsed_ms, 0, 'f', 3)
+                    .arg(m_bytes_in/1048.576/m_elapsed_ms, 0, 'f', 2);
+    }
+
+    str += "Stages:\n";
+
+    for(const StageStatistics& stage : m_statistics)
+    {
+        unsigned int count = stage.runs + stage.errors;
+
+        str += QString("    %1 (ID: %2): %3 runs, %4 errors, total %5 s, mean %6 ms\n")
+                    .arg(stage.type)
+                    .arg(stage.id)
+                    .arg(stage.runs)
+                    .arg(stage.errors)
+                    .arg(stage.elapsed_ms/1000.0, 0, 'f', 2)
+                    .arg(count ? stage.elapsed_ms/double(count) : 0.0, 0, 'f', 1);
+    }
+
+    return str;
+}
+
+} //namespace graipe
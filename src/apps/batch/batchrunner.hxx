@@ -0,0 +1,174 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_BATCH_BATCHRUNNER_HXX
+#define GRAIPE_BATCH_BATCHRUNNER_HXX
+
+#include "core/workspace.hxx"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_batch
+ * @{
+ *
+ * @file
+ * @brief Header file for the headless batch runner
+ */
+
+/**
+ * Timing statistics of one stage (one Algorithm) of a pipeline,
+ * accumulated over all processed scenes.
+ */
+struct StageStatistics
+{
+    /** The typeName() of the stage's Algorithm **/
+    QString type;
+    /** The ID of the stage's Algorithm inside the pipeline **/
+    QString id;
+    /** Accumulated runtime over all scenes in milliseconds **/
+    qint64 elapsed_ms;
+    /** Number of successful runs **/
+    unsigned int runs;
+    /** Number of failed runs **/
+    unsigned int errors;
+};
+
+/**
+ * The BatchRunner executes a pipeline of serialized Algorithms over a list
+ * of input scenes without any GUI involved.
+ *
+ * A pipeline is an XML file containing a sequence of Algorithms, each
+ * one in the format written by Algorithm::serialize, wrapped into a
+ * Pipeline root element:
+ * \verbatim
+   <Pipeline Input="INPUT_ID">
+       <ALGORITHM_TYPE ID="STAGE_ID">
+           <ParameterGroup> ... </ParameterGroup>
+       </ALGORITHM_TYPE>
+       ...
+   </Pipeline>
+   \endverbatim
+ *
+ * Each scene is loaded into its own Workspace copy and gets the ID
+ * INPUT_ID, so that the ModelParameters of the first stage can refer to it.
+ * The j-th result of a stage will get the ID "STAGE_ID:j" and may thus be
+ * used by all following stages. The results of the last stage are saved
+ * into the output directory.
+ *
+ * Scenes are processed in parallel, one scene per thread.
+ */
+class BatchRunner
+{
+    public:
+        /**
+         * Creates a new batch runner on a given GRAIPE workspace. The workspace
+         * is only used as a prototype for the factories. Each scene will get
+         * its own copy of it.
+         *
+         * \param wsp The (prototype) workspace of this runner.
+         */
+        BatchRunner(Workspace* wsp);
+
+        /**
+         * Loads a pipeline from an XML file (compressed or not).
+         *
+         * \param filename The filename of the pipeline.
+         * \return True, if the pipeline was read and all stages are known Algorithms.
+         */
+        bool loadPipeline(const QString& filename);
+
+        /**
+         * Runs the pipeline over all given scenes.
+         *
+         * \param scenes     The filenames of the input scenes.
+         * \param output_dir The directory, where the results will be saved.
+         * \param threads    The maximum number of scenes in parallel, 0 = number of cores.
+         * \param compress   If true, the results will be saved in compressed form.
+         * \return The number of scenes, which have been processed successfully.
+         */
+        unsigned int run(const QStringList& scenes, const QString& output_dir, unsigned int threads=0, bool compress=true);
+
+        /**
+         * Creates a human-readable report of the per-stage timings and the
+         * overall throughput of the last run.
+         *
+         * \return The report as a QString.
+         */
+        QString report() const;
+
+        /**
+         * Processes one scene through the complete pipeline. Thread-safe.
+         *
+         * \param scene      The filename of the input scene.
+         * \param output_dir The directory, where the results will be saved.
+         * \param compress   If true, the results will be saved in compressed form.
+         * \return True, if all stages ran successfully and the results were saved.
+         */
+        bool processScene(const QString& scene, const QString& output_dir, bool compress);
+
+    private:
+        /** The prototype workspace **/
+        Workspace* m_workspace;
+
+        /** The complete pipeline XML **/
+        QByteArray m_pipeline;
+
+        /** The ID, the input scene will get in each run **/
+        QString m_input_id;
+
+        /** Per-stage statistics **/
+        QVector<StageStatistics> m_statistics;
+
+        /** Overall statistics of the last run **/
+        unsigned int m_scenes, m_failed_scenes;
+        qint64 m_bytes_in, m_elapsed_ms;
+
+        /** Mutex for the statistics **/
+        mutable QMutex m_mutex;
+};
+
+/**
+ * @}
+ */
+
+} //namespace graipe
+
+#endif //GRAIPE_BATCH_BATCHRUNNER_HXX
@@ -0,0 +1,140 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QtCore>
+#include <QtDebug>
+
+#include <stdlib.h>
+
+#include "core/core.h"
+
+#include "batchrunner.hxx"
+
+/**
+ * @defgroup graipe_batch The headless batch runner for the Graipe framework
+ *
+ * @addtogroup graipe_batch
+ * @{
+ *
+ * @file
+ * @brief Main file of the graipe batch runner
+ */
+
+/**
+ * This is the main method of the GRAIPE batch runner. It runs a pipeline
+ * of Algorithms over all scenes in a directory without any GUI.
+ *
+ * \param argc The calling argument count.
+ * \param argv An array of c-strings containing the calling arguments.
+ * \return 0, if all scenes were processed successfully. Else: 1.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("GraipeBatch");
+    QCoreApplication::setApplicationVersion(graipe::full_version_name);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs a pipeline of GRAIPE algorithms over a directory of scenes.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("pipeline", "The pipeline of serialized algorithms (.xml or .xgz).");
+    parser.addPositionalArgument("input", "The directory of input scenes (*.xml, *.xgz and *.xbin).");
+    parser.addPositionalArgument("output", "The directory, where the results will be stored.");
+
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of scenes processed in parallel (default: number of cores).", "count", "0");
+    parser.addOption(threadsOption);
+    QCommandLineOption uncompressedOption(QStringList() << "u" << "uncompressed", "Save the results as uncompressed .xml files.");
+    parser.addOption(uncompressedOption);
+    QCommandLineOption logOption(QStringList() << "l" << "log", "Log into the given file instead of the console.", "file");
+    parser.addOption(logOption);
+
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if(args.size() != 3)
+    {
+        parser.showHelp(1);
+    }
+
+    if(parser.isSet(logOption))
+    {
+        graipe::Logging::logger(parser.value(logOption));
+        qInstallMessageHandler(&graipe::Logging::messageHandler);
+    }
+
+    qsrand(QTime(0,0,0).secsTo(QTime::currentTime()));
+
+    graipe::Workspace* wsp = new graipe::Workspace;
+    qInfo() << "Loaded modules:" << wsp->modules_names().join(", ");
+
+    graipe::BatchRunner runner(wsp);
+
+    if(!runner.loadPipeline(args[0]))
+    {
+        qCritical() << "Could not load pipeline:" << args[0];
+        return 1;
+    }
+
+    QDir input_dir(args[1]);
+    QStringList scenes;
+
+    for(const QString& file : input_dir.entryList(QStringList() << "*.xml" << "*.xgz" << "*.xbin", QDir::Files, QDir::Name))
+    {
+        scenes.push_back(input_dir.absoluteFilePath(file));
+    }
+
+    if(scenes.empty())
+    {
+        qCritical() << "No scenes found in:" << args[1];
+        return 1;
+    }
+
+    unsigned int processed = runner.run(scenes, args[2],
+                                        parser.value(threadsOption).toUInt(),
+                                        !parser.isSet(uncompressedOption));
+
+    QTextStream(stdout) << runner.report();
+
+    delete wsp;
+
+    return (processed == (unsigned int)scenes.size()) ? 0 : 1;
+}
+
+/**
+ * @}
+ */
@@ -51,6 +51,8 @@ Client::Client(QWidget *parent)
     m_lnePassword(new QLineEdit),
     m_btnLogin(new QPushButton(tr("Login"))),
     m_tcpSocket(new QTcpSocket(this)),
+    m_reading(false),
+    m_tmrJobs(new QTimer(this)),
     m_workspace(new Workspace)
 {
     m_workspace->loadModel("/Users/seppke/Desktop/Lenna_face.xgz");
@@ -62,6 +64,13 @@ Client::Client(QWidget *parent)
     QMenu* mnuImport = mnuFile->addMenu("Import");
     QMenu* mnuExport = mnuFile->addMenu("Export");
     
+    QAction* actCancelJobs = mnuFile->addAction("Cancel all jobs");
+    connect(actCancelJobs, &QAction::triggered, this, &Client::cancelJobs);
+    
+    //Poll the status of all submitted jobs
+    m_tmrJobs->setInterval(1000);
+    connect(m_tmrJobs, &QTimer::timeout, this, &Client::pollJobs);
+    
     QMenu* mnuAlgs = menuBar()->addMenu("Algorithms");
     
     
@@ -193,45 +202,32 @@ Client::Client(QWidget *parent)
 
 void Client::sendModel(Model* model)
 {
-    QByteArray model_data;
-    QBuffer out_buf(&model_data);
-    
-    //Always use compressed transfer
-    QIOCompressor* compressor = new QIOCompressor(&out_buf);
-    compressor->setStreamFormat(QIOCompressor::GzipFormat);
-
-    if (!compressor->open(QIODevice::WriteOnly))
-    {
-        qWarning("Did not open compressor (gz) on tcpSocket");
-        throw "Error";
-    }
-    
-    QXmlStreamWriter xmlWriter(compressor);
     model->setID(QString::number(reinterpret_cast<long long>(model)));
-    model->serialize(xmlWriter);
-    compressor->close();
+    QString hash = QString::fromLatin1(model->contentHash().toHex());
     
-    QString request1 = QString("Model:%1\n").arg(model_data.size());
+    //First ask, if the server already knows this model
+    QString request1 = QString("Cached:%1:%2\n").arg(hash).arg(model->id());
     
     qDebug() << "--> " << request1;
     m_tcpSocket->write(request1.toLatin1());
-    m_tcpSocket->flush();
-    m_tcpSocket->waitForBytesWritten();
     
-    while( m_tcpSocket->bytesToWrite() != 0)
+    QString response = readResponse("Cached");
+    qDebug() << "<-- " << response;
+    
+    if(response == "Cached:1")
     {
-        QCoreApplication::processEvents();
+        m_lblStatus->setText(QString("Model %1 restored from the server's cache").arg(model->name()));
+        return;
     }
     
-    qDebug() << "--> \"Compressed Model Data\"";
-    m_tcpSocket->write(model_data);
-    m_tcpSocket->flush();
-    m_tcpSocket->waitForBytesWritten();
+    //Upload it (with the hash for caching) otherwise
+    QString request2 = QString("Model:Stream:%1\n").arg(hash);
     
-    while( m_tcpSocket->bytesToWrite() != 0)
-    {
-        QCoreApplication::processEvents();
-    }
+    qDebug() << "--> " << request2;
+    m_tcpSocket->write(request2.toLatin1());
+    
+    qDebug() << "--> \"Compressed Model Data\"";
+    sendStream(model);
     
     m_tcpSocket->waitForReadyRead();
 }
@@ -267,106 +263,152 @@ void Client::registerAtServer()
 
 void Client::sendAlgorithm(Algorithm* alg)
 {
-    QByteArray alg_data;
-    QBuffer out_buf(&alg_data);
+    QString request1("Algorithm:Stream\r\n");
+    
+    qDebug() << "--> " << request1;
+    m_tcpSocket->write(request1.toLatin1());
+    
+    qDebug() << "--> \"Compressed Algorithm Data\"";
+    sendStream(alg);
+}
+
+void Client::sendStream(Serializable* object)
+{
+    //The frames are written directly to the socket, while the object is serialized
+    FramedStreamWriter stream(m_tcpSocket);
+    stream.open(QIODevice::WriteOnly);
     
     //Always use compressed transfer
-    QIOCompressor* compressor = new QIOCompressor(&out_buf);
-    compressor->setStreamFormat(QIOCompressor::GzipFormat);
+    QIOCompressor compressor(&stream);
+    compressor.setStreamFormat(QIOCompressor::GzipFormat);
+    compressor.setParallelBlockSize(QIOCompressor::DefaultParallelBlockSize);
 
-    if (!compressor->open(QIODevice::WriteOnly))
+    if (!compressor.open(QIODevice::WriteOnly))
     {
         qWarning("Did not open compressor (gz) on tcpSocket");
+        stream.abort();
         throw "Error";
     }
     
-    QXmlStreamWriter xmlWriter(compressor);
-    alg->serialize(xmlWriter);
-    compressor->close();
+    QXmlStreamWriter xmlWriter(&compressor);
+    object->serialize(xmlWriter);
+    compressor.close();
     
-    QString request1 = QString("Algorithm:%1\r\n").arg(alg_data.size());
-    
-    qDebug() << "--> " << request1;
-    m_tcpSocket->write(request1.toLatin1());
-    m_tcpSocket->flush();
-    m_tcpSocket->waitForBytesWritten();
-    
-    while( m_tcpSocket->bytesToWrite() != 0)
+    if(xmlWriter.hasError())
     {
-        QCoreApplication::processEvents();
-    }
-    
-    qDebug() << "--> \"Compressed Algorithm Data\"";
-    m_tcpSocket->write(alg_data);
-    m_tcpSocket->flush();
-    m_tcpSocket->waitForBytesWritten();
-    
-    while( m_tcpSocket->bytesToWrite() != 0)
-    {
-        QCoreApplication::processEvents();
+        qWarning("Could not stream over the tcpSocket");
+        stream.abort();
+        throw "Error";
     }
+    stream.close();
 }
 
-void Client::readModel(int bytesToRead)
+QString Client::readResponse(const QString& type)
 {
-    try
+    //Keep the readHandler from consuming the response
+    bool reading = m_reading;
+    m_reading = true;
+    
+    QString response;
+    
+    while(m_tcpSocket->state() == QTcpSocket::ConnectedState)
     {
-        QByteArray model_data;
-        
-        //Second: Receive all the data for the model
-        m_tcpSocket->waitForReadyRead();
-        
-        while(m_tcpSocket->bytesAvailable() && model_data.size() < bytesToRead)
+        if(!m_tcpSocket->canReadLine())
         {
-            model_data.append(m_tcpSocket->readAll());
-            if(model_data.size() == bytesToRead)
+            if(!m_tcpSocket->waitForReadyRead())
             {
+                qWarning() << "Did not receive a response:" << m_tcpSocket->errorString();
                 break;
             }
-            else
-            {
-                m_tcpSocket->waitForReadyRead();
-            }
-        }
-        
-        if(model_data.size()!= bytesToRead)
-        {
-            qWarning() << "Did not receive the full model data, but only "<< model_data.size()  <<" of " << bytesToRead << "bytes";
-            throw "Error";
+            continue;
         }
         
-        qDebug() << "<-- \"Compressed Model data\".";
-        QBuffer buf(&model_data);
+        QString line = QString::fromLatin1(m_tcpSocket->readLine()).trimmed();
         
-        //Always use compressed transfer
-        QIOCompressor* compressor = new QIOCompressor(&buf);
-        compressor->setStreamFormat(QIOCompressor::GzipFormat);
-
-        if (!compressor->open(QIODevice::ReadOnly))
+        if(line.startsWith(type + ":"))
         {
-            qWarning("Did not open compressor (gz) on tcpSocket");
-            throw "Error";
+            response = line;
+            break;
         }
         
-        QXmlStreamReader xmlReader(compressor);
-        Model* new_model = m_workspace->loadModel(xmlReader);
-        
-        if(new_model == NULL)
+        //Other messages (e.g. the status of jobs) may arrive meanwhile
+        handleMessage(line);
+    }
+    
+    m_reading = reading;
+    
+    return response;
+}
+
+void Client::readModel()
+{
+    FramedStreamReader stream;
+    stream.open(QIODevice::ReadOnly);
+    
+    Model* new_model = NULL;
+    
+    //Decompress and deserialize while the frames are still arriving
+    FramedStreamDecoder decoder(
+                    [this, &stream, &new_model]()
+                    {
+                        //Always use compressed transfer
+                        QIOCompressor compressor(&stream);
+                        compressor.setStreamFormat(QIOCompressor::GzipFormat);
+                        compressor.setParallelBlockSize(QIOCompressor::DefaultParallelBlockSize);
+                        
+                        if (!compressor.open(QIODevice::ReadOnly))
+                        {
+                            qWarning("Did not open compressor (gz) on stream");
+                        }
+                        else
+                        {
+                            QXmlStreamReader xmlReader(&compressor);
+                            new_model = m_workspace->loadModel(xmlReader);
+                            compressor.close();
+                        }
+                        
+                        //Discard everything, which has not been read
+                        stream.close();
+                    });
+    decoder.start();
+    
+    qDebug() << "<-- \"Compressed Model data\".";
+    
+    //Keep the readHandler from consuming the frames
+    bool reading = m_reading;
+    m_reading = true;
+    
+    //Feed all frames of the model, as they arrive
+    while(!stream.feed(m_tcpSocket))
+    {
+        if(!m_tcpSocket->waitForReadyRead())
         {
-            qWarning("Did not load a model over the tcpSocket");
-            throw "Error";
-            
+            qWarning() << "Did not receive the full model data:" << m_tcpSocket->errorString();
+            stream.abort();
         }
-        
-        qDebug("    Model loaded and added sucessfully!");
-        qDebug() << "Now: " << m_workspace->models.size() << " models available!";
-        
-        m_lblStatus->setText(QString("Models: %1, latest model: %2, type:%3, ID:%4, descripton:%5").arg(m_workspace->models.size()).arg(new_model->name()).arg(new_model->typeName()).arg(new_model->id()).arg(new_model->description()));
     }
-    catch(...)
+    
+    m_reading = reading;
+    
+    decoder.wait();
+    
+    if(stream.aborted())
+    {
+        delete new_model;
+        new_model = NULL;
+    }
+    
+    if(new_model == NULL)
     {
+        qWarning("Did not load a model over the tcpSocket");
         qDebug("Error occured!");
+        return;
     }
+    
+    qDebug("    Model loaded and added sucessfully!");
+    qDebug() << "Now: " << m_workspace->modelCount() << " models available!";
+    
+    m_lblStatus->setText(QString("Models: %1, latest model: %2, type:%3, ID:%4, descripton:%5").arg(m_workspace->modelCount()).arg(new_model->name()).arg(new_model->typeName()).arg(new_model->id()).arg(new_model->description()));
 }
 
 /**
@@ -374,41 +416,126 @@ void Client::readModel(int bytesToRead)
  */
 void Client::readHandler()
 {
-    QString data = QString::fromLatin1(m_tcpSocket->readLine());
+    //The socket is currently read elsewhere
+    if(m_reading)
+    {
+        return;
+    }
     
+    while(m_tcpSocket->canReadLine())
+    {
+        handleMessage(QString::fromLatin1(m_tcpSocket->readLine()).trimmed());
+    }
+}
+
+void Client::handleMessage(const QString& data)
+{
     qDebug() << "<-- " << data << ".";
     
     QStringList data_split = data.split(":");
     
-    if(data_split.size() != 2)
+    if(data_split.size() < 2)
     {
-        qWarning() << "Did not data in the right format. Expected MESSAGE_TYPE:SIZE, but got: " << data << ".";
+        qWarning() << "Did not data in the right format. Expected MESSAGE_TYPE:VALUE, but got: " << data << ".";
+        return;
     }
-    else
-    {
-        QString message_type = data_split[0];
+    
+    QString message_type = data_split[0];
 
-        if(message_type == "Model")
+    if(message_type == "Model" && data_split[1] == "Stream")
+    {
+        readModel();
+    }
+    if(message_type == "Error")
+    {
+        int bytesToRead = data_split[1].toInt();
+        m_lblStatus->setText(QString("Error number: %1 occured!").arg(bytesToRead));
+    }
+    if(message_type == "Success")
+    {
+        
+        m_lblStatus->setText("Success!" + data_split[1]);
+    }
+    if(message_type == "Login" && data_split[1] =="OK")
+    {
+        m_lblStatus->setText(QString("Successfully logged in!"));
+        m_btnLogin->setText("Logout");
+        
+        //Continue with the jobs of previous connections
+        m_tcpSocket->write(QString("Jobs:List\n").toLatin1());
+    }
+    if(message_type == "Job")
+    {
+        m_jobs.append(data_split[1].toLongLong());
+        m_tmrJobs->start();
+        m_lblStatus->setText(QString("Algorithm submitted as job %1").arg(data_split[1]));
+    }
+    if(message_type == "Jobs")
+    {
+        for(const QString& job_id : data_split[1].split(",", QString::SkipEmptyParts))
         {
-            int bytesToRead = data_split[1].toInt();
-            readModel(bytesToRead);
+            if(!m_jobs.contains(job_id.toLongLong()))
+            {
+                m_jobs.append(job_id.toLongLong());
+            }
         }
-        if(message_type == "Error")
+        if(!m_jobs.isEmpty())
+        {
+            m_tmrJobs->start();
+        }
+    }
+    if(message_type == "Status" && data_split.size() >= 5)
+    {
+        qint64 job_id = data_split[1].toLongLong();
+        QString state = data_split[2];
+        
+        m_lblStatus->setText(QString("Job %1: %2 (%3%) %4").arg(job_id).arg(state).arg(data_split[3]).arg(data_split.mid(4).join(":")));
+        
+        if(state == "Finished")
         {
-            int bytesToRead = data_split[1].toInt();
-            m_lblStatus->setText(QString("Error number: %1 occured!").arg(bytesToRead));
+            m_jobs.removeAll(job_id);
+            m_tcpSocket->write(QString("Results:%1\n").arg(job_id).toLatin1());
         }
-        if(message_type == "Sucess")
+        else if(state == "Failed" || state == "Cancelled")
         {
-            
-            m_lblStatus->setText("Success!" + data_split[1]);
+            m_jobs.removeAll(job_id);
+            m_tcpSocket->write(QString("Cancel:%1\n").arg(job_id).toLatin1());
         }
-        if(message_type == "Login" && data_split[1] =="OK")
+    }
+    if(message_type == "Cancelled")
+    {
+        //Failed jobs are removed silently
+        if(m_jobs.removeAll(data_split[1].toLongLong()))
         {
-            m_lblStatus->setText(QString("Successfully logged in!"));
-            m_btnLogin->setText("Logout");
+            m_lblStatus->setText(QString("Job %1 cancelled").arg(data_split[1]));
         }
     }
+    if(message_type == "Results" && data_split.size() == 3)
+    {
+        m_lblStatus->setText(QString("Job %1: receiving %2 results").arg(data_split[1]).arg(data_split[2]));
+    }
+}
+
+void Client::pollJobs()
+{
+    if(m_jobs.isEmpty())
+    {
+        m_tmrJobs->stop();
+        return;
+    }
+    
+    for(qint64 job_id : m_jobs)
+    {
+        m_tcpSocket->write(QString("Status:%1\n").arg(job_id).toLatin1());
+    }
+}
+
+void Client::cancelJobs()
+{
+    for(qint64 job_id : m_jobs)
+    {
+        m_tcpSocket->write(QString("Cancel:%1\n").arg(job_id).toLatin1());
+    }
 }
 
 void Client::displayError(QAbstractSocket::SocketError socketError)
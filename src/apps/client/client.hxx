@@ -39,6 +39,8 @@
 #include <QMainWindow>
 #include <QTcpSocket>
 #include <QSignalMapper>
+#include <QTimer>
+#include <QList>
 
 #include "core/core.h"
 
@@ -88,6 +90,16 @@ private slots:
      */
     void readHandler();
     
+    /**
+     * Asks the server for the status of all submitted jobs.
+     */
+    void pollJobs();
+    
+    /**
+     * Cancels all submitted jobs at the server.
+     */
+    void cancelJobs();
+    
     /**
      * Handler for displaying socket errors.
      */
@@ -109,12 +121,33 @@ private slots:
 private:
     /**
      * Inline function to read a received Model, which will be send over TCP
+     * as a framed stream. The Model is decompressed and deserialized
+     * while its frames are still arriving.
+     */
+    inline void readModel();
+    
+    /**
+     * Serializes an object directly (compressed and framed) into the socket.
+     *
+     * \param object The Model or Algorithm to be sent.
+     */
+    void sendStream(Serializable* object);
+    
+    /**
+     * Waits for the response line of the server to a synchronous request.
+     * All other messages, which arrive meanwhile, are handled as usual.
+     *
+     * \param type The message type of the response.
+     * \return The response without the line ending, or an empty string on errors.
+     */
+    QString readResponse(const QString& type);
+    
+    /**
+     * Handles one message (line) received from the server.
      *
-     * \param bytesToRead The total number of bytes for this model. This is 
-     *                    important, because Models are usually too large to fit 
-     *                    into one TCP package.
+     * \param data The message without the line ending.
      */
-    inline void readModel(int bytesToRead);
+    void handleMessage(const QString& data);
     
     /**
      * @{
@@ -136,6 +169,15 @@ private:
     /** The TCP socket of the client **/
     QTcpSocket *m_tcpSocket;
     
+    /** True, while the socket is read by readResponse() or readModel() **/
+    bool m_reading;
+    
+    /** The IDs of all jobs submitted to the server, which are not yet done **/
+    QList<qint64> m_jobs;
+    
+    /** Timer for polling the jobs' status **/
+    QTimer* m_tmrJobs;
+    
     /** The workspace of the client **/
     Workspace* m_workspace;
 };
@@ -36,6 +36,7 @@
 #include "gui/mainwindow.hxx"
 #include "gui/memorystatus.hxx"
 
+#include "core/scheduler.hxx"
 #include "core/updatechecker.hxx"
 #include "core/workspace.hxx"
 
@@ -282,7 +283,7 @@ void MainWindow::reset()
 
 void MainWindow::loadModel()
 {	
-	QFileDialog dialog(this, "Load models", m_default_dir, "GRAIPE models (*.xgz *.xml)");
+	QFileDialog dialog(this, "Load models", m_default_dir, "GRAIPE models (*.xgz *.xml *.xbin)");
 	dialog.setFileMode(QFileDialog::ExistingFiles);
 	dialog.setViewMode(QFileDialog::Detail);
 	
@@ -478,24 +479,19 @@ void MainWindow::runAlgorithm(int index)
 		//AND are available!
 		if( parameter_selection.result()!=0 )
 		{
-			QThread *thr = new QThread;
-			alg->moveToThread(thr);
-			
 			//Add alg. status item to models
 			QListWidgetAlgorithmItem * alg_list_item = new QListWidgetAlgorithmItem(alg_item.algorithm_name, alg );
 			alg_list_item->setToolTip(alg_item.algorithm_name);
+			alg_list_item->setText(QString("%1: queued").arg(alg_item.algorithm_name));
 			alg_list_item->setFlags(Qt::NoItemFlags);
 			m_ui.listModels->addItem(alg_list_item);
-						
-			connect(thr, SIGNAL(started()), alg, SLOT(run()));
 			
 			connect(alg, SIGNAL(statusMessage(float, QString)), this, SLOT(algorithmStateChanged(float, QString)));
 			connect(alg, SIGNAL(errorMessage(QString)), this, SLOT(algorithmErrorState(QString)));
 			connect(alg, SIGNAL(finished()), this, SLOT(algorithmFinished()));
 			
-			connect(alg, SIGNAL(finished()), thr, SLOT(quit()));
-			
-			thr->start();
+			//Run the algorithm inside the shared thread pool
+			Scheduler::instance()->submit(alg);
 		}
 		else 
 		{
@@ -716,7 +712,7 @@ void MainWindow::saveCurrentModel()
 		QString suggested_filename = model->name().replace(" ", "_");
 		QString filename = QFileDialog::getSaveFileName(this, tr("Save Model to file"),
                            suggested_filename,
-                            tr("Packed GRAIPE-models (*.xgz);;Unpacked GRAIPE-models (*.xml)"));
+                            tr("Packed GRAIPE-models (*.xgz);;Unpacked GRAIPE-models (*.xml);;Binary GRAIPE-models (*.xbin)"));
 		
 		if(!filename.isEmpty())
 		{	
@@ -947,10 +943,12 @@ void MainWindow::restoreWorkspace(const QString& xmlFilename)
             
             m_workspace->deserialize(xmlReader);
             
+            m_workspace->models_mutex.lock();
             for(Model* model : m_workspace->models)
             {
                 addModelItemToList(model);
             }
+            m_workspace->models_mutex.unlock();
             for(ViewController* vc : m_workspace->viewControllers)
             {
                 addViewControllerItemToSceneAndList(vc);
@@ -1032,7 +1030,7 @@ void MainWindow::updateStatusDescription(QString str)
 
 void MainWindow::updateMemoryUsage()
 {
-    m_lblMemoryUsage->setText(QString("%1 Models, %2 Views (Memory: %3 MB, max: %4 MB)").arg(m_workspace->models.size()).arg(m_workspace->viewControllers.size()).arg((float)(getCurrentRSS()>>10)/1024).arg((float)(getPeakRSS()>>10)/1024));
+    m_lblMemoryUsage->setText(QString("%1 Models, %2 Views (Memory: %3 MB, max: %4 MB)").arg(m_workspace->modelCount()).arg(m_workspace->viewControllers.size()).arg((float)(getCurrentRSS()>>10)/1024).arg((float)(getPeakRSS()>>10)/1024));
 }
 
 void MainWindow::updateRecentActionList()
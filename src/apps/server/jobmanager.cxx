@@ -0,0 +1,347 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#include "jobmanager.hxx"
+
+#include "core/scheduler.hxx"
+
+#include <QMutexLocker>
+#include <QtDebug>
+
+namespace graipe {
+
+QString JobStatus::stateName() const
+{
+    switch(state)
+    {
+        case Queued:
+            return "Queued";
+        case Running:
+            return "Running";
+        case Finished:
+            return "Finished";
+        case Failed:
+            return "Failed";
+        case Cancelled:
+        default:
+            return "Cancelled";
+    }
+}
+
+JobManager::JobManager(QObject* parent)
+:   QObject(parent),
+    m_next_id(1)
+{
+    //The Scheduler emits these signals from its worker threads
+    connect(Scheduler::instance(), &Scheduler::jobStarted,  this, &JobManager::schedulerJobStarted,  Qt::DirectConnection);
+    connect(Scheduler::instance(), &Scheduler::jobFinished, this, &JobManager::schedulerJobFinished, Qt::DirectConnection);
+}
+
+JobManager::~JobManager()
+{
+    disconnect(Scheduler::instance(), 0, this, 0);
+    
+    Scheduler* scheduler = Scheduler::instance();
+    
+    for(Job* job : m_jobs)
+    {
+        if(m_scheduler_jobs.contains(job->scheduler_job) && !scheduler->cancel(job->scheduler_job))
+        {
+            scheduler->waitForJob(job->scheduler_job);
+        }
+        delete job->algorithm;
+        delete job;
+    }
+    m_jobs.clear();
+    m_scheduler_jobs.clear();
+}
+
+qint64 JobManager::submit(const QString& user, QSharedPointer<Workspace> workspace, Algorithm* alg)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    removeExpiredJobs();
+    
+    qint64 job_id = m_next_id++;
+    
+    Job* job = new Job;
+    job->user = user;
+    job->workspace = workspace;
+    job->algorithm = alg;
+    job->status.state = JobStatus::Queued;
+    job->status.progress = 0;
+    job->status.message = "queued";
+    job->finished = false;
+    job->remove = false;
+    
+    //The algorithm emits these signals from the Scheduler's worker threads
+    connect(alg, &Algorithm::statusMessage, this,
+            [this, job_id](float p, QString message)
+            {
+                m_mutex.lock();
+                if(m_jobs.contains(job_id))
+                {
+                    m_jobs[job_id]->status.progress = p;
+                    m_jobs[job_id]->status.message = message;
+                }
+                m_mutex.unlock();
+                emit jobChanged(job_id);
+            },
+            Qt::DirectConnection);
+    
+    connect(alg, &Algorithm::errorMessage, this,
+            [this, job_id](QString message)
+            {
+                m_mutex.lock();
+                if(m_jobs.contains(job_id))
+                {
+                    m_jobs[job_id]->status.state = JobStatus::Failed;
+                    m_jobs[job_id]->status.message = message;
+                }
+                m_mutex.unlock();
+                emit jobChanged(job_id);
+            },
+            Qt::DirectConnection);
+    
+    connect(alg, &Algorithm::finished, this,
+            [this, job_id]()
+            {
+                QMutexLocker locker(&m_mutex);
+                if(m_jobs.contains(job_id))
+                {
+                    m_jobs[job_id]->finished = true;
+                }
+            },
+            Qt::DirectConnection);
+    
+    m_jobs[job_id] = job;
+    
+    //Still locked: The Scheduler's signals need the mapping
+    job->scheduler_job = Scheduler::instance()->submit(alg);
+    m_scheduler_jobs[job->scheduler_job] = job_id;
+    
+    qDebug() << "JobManager: Job" << job_id << "of user" << user << "submitted:" << alg->typeName();
+    
+    return job_id;
+}
+
+bool JobManager::status(const QString& user, qint64 job_id, JobStatus& status) const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    Job* job = m_jobs.value(job_id, NULL);
+    
+    if(job == NULL || job->user != user)
+    {
+        return false;
+    }
+    
+    status = job->status;
+    return true;
+}
+
+bool JobManager::cancel(const QString& user, qint64 job_id)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    Job* job = m_jobs.value(job_id, NULL);
+    
+    if(job == NULL || job->user != user)
+    {
+        return false;
+    }
+    
+    if(!m_scheduler_jobs.contains(job->scheduler_job))
+    {
+        //Already done
+        removeJob(job_id);
+    }
+    else if(Scheduler::instance()->cancel(job->scheduler_job))
+    {
+        //Not yet started
+        m_scheduler_jobs.remove(job->scheduler_job);
+        removeJob(job_id);
+    }
+    else
+    {
+        //Running: Stop it and remove it, as soon as it is done
+        job->algorithm->cancel();
+        job->remove = true;
+    }
+    
+    locker.unlock();
+    
+    qDebug() << "JobManager: Job" << job_id << "of user" << user << "cancelled";
+    emit jobChanged(job_id);
+    
+    return true;
+}
+
+bool JobManager::takeResults(const QString& user, qint64 job_id, std::vector<Model*>& results, QSharedPointer<Workspace>& workspace)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    Job* job = m_jobs.value(job_id, NULL);
+    
+    if(job == NULL || job->user != user || job->status.state != JobStatus::Finished)
+    {
+        return false;
+    }
+    
+    results = job->algorithm->results();
+    workspace = job->workspace;
+    removeJob(job_id);
+    
+    return true;
+}
+
+QList<qint64> JobManager::jobs(const QString& user)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    removeExpiredJobs();
+    
+    QList<qint64> job_ids;
+    
+    for(QMap<qint64, Job*>::const_iterator iter = m_jobs.constBegin(); iter != m_jobs.constEnd(); ++iter)
+    {
+        if(iter.value()->user == user && !iter.value()->remove)
+        {
+            job_ids.append(iter.key());
+        }
+    }
+    return job_ids;
+}
+
+int JobManager::activeJobs() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return m_scheduler_jobs.size();
+}
+
+void JobManager::schedulerJobStarted(qint64 scheduler_job)
+{
+    m_mutex.lock();
+    
+    qint64 job_id = m_scheduler_jobs.value(scheduler_job, 0);
+    Job* job = m_jobs.value(job_id, NULL);
+    
+    if(job != NULL && job->status.state == JobStatus::Queued)
+    {
+        job->status.state = JobStatus::Running;
+        job->status.message = "started";
+    }
+    m_mutex.unlock();
+    
+    if(job != NULL)
+    {
+        emit jobChanged(job_id);
+    }
+}
+
+void JobManager::schedulerJobFinished(qint64 scheduler_job)
+{
+    m_mutex.lock();
+    
+    if(!m_scheduler_jobs.contains(scheduler_job))
+    {
+        //Not one of our jobs
+        m_mutex.unlock();
+        return;
+    }
+    
+    qint64 job_id = m_scheduler_jobs.take(scheduler_job);
+    Job* job = m_jobs.value(job_id, NULL);
+    
+    job->done = QDateTime::currentDateTimeUtc();
+    
+    if(job->remove)
+    {
+        removeJob(job_id);
+    }
+    else if(job->status.state != JobStatus::Failed)
+    {
+        if(job->finished)
+        {
+            job->status.state = JobStatus::Finished;
+            job->status.progress = 100;
+            job->status.message = "finished";
+        }
+        else
+        {
+            job->status.state = JobStatus::Failed;
+            job->status.message = "The algorithm did not finish";
+        }
+    }
+    m_mutex.unlock();
+    
+    qDebug() << "JobManager: Job" << job_id << "done";
+    emit jobChanged(job_id);
+}
+
+int JobManager::jobExpiry()
+{
+    //One day
+    return 24*60*60;
+}
+
+void JobManager::removeExpiredJobs()
+{
+    QDateTime expired = QDateTime::currentDateTimeUtc().addSecs(-jobExpiry());
+    
+    for(qint64 job_id : m_jobs.keys())
+    {
+        const Job* job = m_jobs[job_id];
+        
+        if(job->done.isValid() && job->done < expired)
+        {
+            qDebug() << "JobManager: Job" << job_id << "of user" << job->user << "expired";
+            removeJob(job_id);
+        }
+    }
+}
+
+void JobManager::removeJob(qint64 job_id)
+{
+    Job* job = m_jobs.take(job_id);
+    
+    if(job != NULL)
+    {
+        delete job->algorithm;
+        delete job;
+    }
+}
+
+} //namespace graipe
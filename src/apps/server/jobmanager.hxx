@@ -0,0 +1,251 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef GRAIPE_SERVER_JOBMANAGER_HXX
+#define GRAIPE_SERVER_JOBMANAGER_HXX
+
+#include "core/algorithm.hxx"
+#include "core/workspace.hxx"
+
+#include <QDateTime>
+#include <QObject>
+#include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QList>
+
+namespace graipe {
+
+/**
+ * The current state of an algorithm run (job) at the server.
+ */
+struct JobStatus
+{
+    /** The different states of a job **/
+    enum State
+    {
+        Queued = 0,
+        Running = 1,
+        Finished = 2,
+        Failed = 3,
+        Cancelled = 4
+    };
+    
+    /** The state of the job **/
+    State state;
+    /** The last progress reported by the algorithm (0..100) **/
+    float progress;
+    /** The last status or error message of the algorithm **/
+    QString message;
+    
+    /**
+     * Returns the state as a human-readable string.
+     *
+     * \return The name of the state.
+     */
+    QString stateName() const;
+};
+
+/**
+ * The JobManager of the server runs the algorithms of all connections
+ * asynchronously inside the shared Scheduler. Each job gets an ID, which
+ * can be used by the submitting user to poll its status, to cancel it, and
+ * to retrieve its results - even on a later connection.
+ *
+ * A job keeps the workspace of the submitting connection alive, since the
+ * algorithm's inputs and results belong to it. The job (and its reference
+ * to the workspace) is removed, when the results have been taken, the
+ * job was cancelled, or the job has been done for longer than jobExpiry()
+ * seconds without anyone taking it. All methods are thread-safe.
+ */
+class JobManager
+:   public QObject
+{
+    Q_OBJECT
+    
+    public:
+        /**
+         * Creates a new job manager.
+         *
+         * \param parent The parent object, NULL by default.
+         */
+        JobManager(QObject* parent = NULL);
+    
+        /**
+         * Destructor. Cancels all queued jobs and waits for the running ones.
+         */
+        ~JobManager();
+    
+        /**
+         * Submits an algorithm to run asynchronously. The job manager takes
+         * the ownership of the algorithm.
+         *
+         * \param user      The user, who submits the job.
+         * \param workspace The workspace of the algorithm's models.
+         * \param alg       The algorithm to be run.
+         * \return The ID of the new job.
+         */
+        qint64 submit(const QString& user, QSharedPointer<Workspace> workspace, Algorithm* alg);
+    
+        /**
+         * Returns the status of a job.
+         *
+         * \param user   The user, who asks for the status.
+         * \param job_id The ID of the job.
+         * \param status The status of the job, if found.
+         * \return True, if the job was found and belongs to the user.
+         */
+        bool status(const QString& user, qint64 job_id, JobStatus& status) const;
+    
+        /**
+         * Cancels a job. Queued jobs will be removed, running jobs are asked
+         * to stop. The job itself will be removed afterwards.
+         *
+         * \param user   The user, who cancels the job.
+         * \param job_id The ID of the job.
+         * \return True, if the job was found and belongs to the user.
+         */
+        bool cancel(const QString& user, qint64 job_id);
+    
+        /**
+         * Returns the results of a finished job. As long as the returned
+         * workspace is referenced, the results stay valid. The job itself
+         * will be removed.
+         *
+         * \param user      The user, who wants the results.
+         * \param job_id    The ID of the job.
+         * \param results   The results of the algorithm.
+         * \param workspace The workspace, the results belong to.
+         * \return True, if the job was found, belongs to the user and has finished.
+         */
+        bool takeResults(const QString& user, qint64 job_id, std::vector<Model*>& results, QSharedPointer<Workspace>& workspace);
+    
+        /**
+         * Returns the IDs of all (queued, running and completed) jobs of a user.
+         *
+         * \param user The user.
+         * \return The IDs of the user's jobs.
+         */
+        QList<qint64> jobs(const QString& user);
+    
+        /**
+         * Returns the number of queued and running jobs of all users.
+         *
+         * \return The number of active jobs.
+         */
+        int activeJobs() const;
+    
+        /**
+         * Returns the time, after which done jobs, which have not been taken,
+         * are removed together with their results.
+         *
+         * \return The expiry time in seconds.
+         */
+        static int jobExpiry();
+    
+    signals:
+        /**
+         * This signal is emitted, whenever the status of a job changed.
+         *
+         * \param job_id The ID of the job.
+         */
+        void jobChanged(qint64 job_id);
+    
+    protected slots:
+        /**
+         * Called by the Scheduler, when a job is started.
+         *
+         * \param scheduler_job The Scheduler's ID of the job.
+         */
+        void schedulerJobStarted(qint64 scheduler_job);
+    
+        /**
+         * Called by the Scheduler, when a job is done.
+         *
+         * \param scheduler_job The Scheduler's ID of the job.
+         */
+        void schedulerJobFinished(qint64 scheduler_job);
+    
+    protected:
+        /**
+         * Internal representation of a job.
+         */
+        struct Job
+        {
+            /** The user, who submitted the job **/
+            QString user;
+            /** The workspace of the algorithm's models **/
+            QSharedPointer<Workspace> workspace;
+            /** The algorithm **/
+            Algorithm* algorithm;
+            /** The Scheduler's ID of the job **/
+            qint64 scheduler_job;
+            /** The current status **/
+            JobStatus status;
+            /** If true, the algorithm reported the end of its run **/
+            bool finished;
+            /** If true, the job will be removed, once it is done **/
+            bool remove;
+            /** The time, when the job was done (invalid before) **/
+            QDateTime done;
+        };
+    
+        /**
+         * Removes a job. The mutex needs to be locked.
+         *
+         * \param job_id The ID of the job.
+         */
+        void removeJob(qint64 job_id);
+    
+        /**
+         * Removes all jobs, which have been done for longer than jobExpiry()
+         * seconds. The mutex needs to be locked.
+         */
+        void removeExpiredJobs();
+    
+    private:
+        /** All jobs by their IDs **/
+        QMap<qint64, Job*> m_jobs;
+        /** The job IDs by the Scheduler's IDs **/
+        QMap<qint64, qint64> m_scheduler_jobs;
+        /** The next job ID **/
+        qint64 m_next_id;
+        /** Mutex for the jobs **/
+        mutable QMutex m_mutex;
+};
+
+} //namespace graipe
+
+#endif //GRAIPE_SERVER_JOBMANAGER_HXX
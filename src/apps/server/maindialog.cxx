@@ -128,6 +128,7 @@ MainDialog::MainDialog(QWidget *parent)
     
     QTimer* timer = new QTimer;
     connect(timer, SIGNAL(timeout()), this, SLOT(updateLog()));
+    connect(timer, SIGNAL(timeout()), this, SLOT(updateClientStatus()));
     timer->start(2000);
     
     setLayout(mainLayout);
@@ -157,6 +158,12 @@ void MainDialog::updateClientStatus()
         str = "No connections yet!";
     }
     
+    ModelCache& cache = m_server->modelCache();
+    str += QString("\nModel cache: %1 models, %2 of %3 MB used").arg(cache.count())
+                                                                 .arg(cache.size()/1048576.0, 0, 'f', 1)
+                                                                 .arg(cache.capacity()/1048576);
+    str += QString("\nJobs: %1 queued or running").arg(m_server->jobManager().activeJobs());
+    
     m_lblClientStatus->setText(str);
 }
 
@@ -0,0 +1,112 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#include "modelcache.hxx"
+
+#include <QMutexLocker>
+#include <QtDebug>
+
+namespace graipe {
+
+/**
+ * Computes the cost (in KB) of a stream for the QCache.
+ *
+ * \param size The size of the stream in bytes.
+ * \return The cost of the stream in KB, at least one.
+ */
+static int modelCacheCost(qint64 size)
+{
+    return (int)qMax(qint64(1), (size + 1023)/1024);
+}
+
+ModelCache::ModelCache(qint64 capacity)
+{
+    setCapacity(capacity);
+}
+
+qint64 ModelCache::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return qint64(m_cache.maxCost())*1024;
+}
+
+void ModelCache::setCapacity(qint64 capacity)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    m_cache.setMaxCost(modelCacheCost(capacity));
+}
+
+qint64 ModelCache::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return qint64(m_cache.totalCost())*1024;
+}
+
+int ModelCache::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return m_cache.count();
+}
+
+QByteArray ModelCache::find(const QByteArray& hash)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    //QCache::object() marks the stream as recently used
+    QByteArray* data = m_cache.object(hash);
+    
+    if(data == NULL)
+    {
+        return QByteArray();
+    }
+    return *data;
+}
+
+bool ModelCache::insert(const QByteArray& hash, const QByteArray& data)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    if(!m_cache.insert(hash, new QByteArray(data), modelCacheCost(data.size())))
+    {
+        qWarning() << "ModelCache::insert: Stream of" << data.size() << "bytes does not fit into the cache.";
+        return false;
+    }
+    return true;
+}
+
+} //namespace graipe
@@ -0,0 +1,121 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef GRAIPE_SERVER_MODELCACHE_HXX
+#define GRAIPE_SERVER_MODELCACHE_HXX
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+
+namespace graipe {
+
+/**
+ * The ModelCache of the server is shared by all WorkerThreads. It holds the
+ * compressed streams of uploaded Models, addressed by the hex-encoded
+ * Model::contentHash(). If a client asks for a Model, which is already
+ * known, it does not need to be uploaded again, but is restored from the
+ * cache into the workspace of the requesting WorkerThread.
+ *
+ * The cache is bounded by the total size of the streams. If it is full,
+ * the least recently used streams are removed first. All methods are
+ * thread-safe.
+ */
+class ModelCache
+{
+    public:
+        /**
+         * Creates a new and empty model cache.
+         *
+         * \param capacity The maximum total size of all cached streams in bytes.
+         */
+        ModelCache(qint64 capacity = 1073741824);
+    
+        /**
+         * Returns the maximum total size of all cached streams.
+         *
+         * \return The capacity in bytes.
+         */
+        qint64 capacity() const;
+    
+        /**
+         * Sets the maximum total size of all cached streams. May remove
+         * streams, if the cache is larger than the new capacity.
+         *
+         * \param capacity The new capacity in bytes.
+         */
+        void setCapacity(qint64 capacity);
+    
+        /**
+         * Returns the total size of all cached streams.
+         *
+         * \return The size in bytes.
+         */
+        qint64 size() const;
+    
+        /**
+         * Returns the number of cached streams.
+         *
+         * \return The number of cached Models.
+         */
+        int count() const;
+    
+        /**
+         * Looks for the stream of a model and marks it as recently used.
+         *
+         * \param hash The hex-encoded content hash of the Model.
+         * \return The (compressed) stream of the Model, or an empty QByteArray if not found.
+         */
+        QByteArray find(const QByteArray& hash);
+    
+        /**
+         * Adds the stream of a Model to the cache. Streams larger than the
+         * capacity will not be cached.
+         *
+         * \param hash The hex-encoded content hash of the Model.
+         * \param data The (compressed) stream of the Model.
+         * \return True, if the stream was added.
+         */
+        bool insert(const QByteArray& hash, const QByteArray& data);
+    
+    private:
+        /** The streams, with costs in KB to allow capacities beyond 2 GB **/
+        QCache<QByteArray, QByteArray> m_cache;
+        /** Mutex for the cache **/
+        mutable QMutex m_mutex;
+};
+
+} //namespace graipe
+
+#endif //GRAIPE_SERVER_MODELCACHE_HXX
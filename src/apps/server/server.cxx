@@ -67,6 +67,16 @@ QVector<ConnectionInfo> Server::connectionInfo() const
     return m_connections;
 }
 
+ModelCache& Server::modelCache()
+{
+    return m_model_cache;
+}
+
+JobManager& Server::jobManager()
+{
+    return m_job_manager;
+}
+
 void Server::connectionUserAuth(qintptr socketDescriptor, QString user)
 {
     for(unsigned int i=0; i!=m_connections.size(); ++i)
@@ -98,7 +108,7 @@ void Server::incomingConnection(qintptr socketDescriptor)
 {
     qDebug() << "New incoming connection for socket:" << socketDescriptor;
     
-    WorkerThread *thread = new WorkerThread(socketDescriptor, m_registered_users, m_workspace, this);
+    WorkerThread *thread = new WorkerThread(socketDescriptor, m_registered_users, m_workspace, &m_model_cache, &m_job_manager, this);
     connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
     connect(thread, SIGNAL(connectionUserAuth(qintptr, QString)), this, SLOT(connectionUserAuth(qintptr, QString)));
     connect(thread, SIGNAL(connectionTerminated(qintptr)), this, SLOT(connectionTerminated(qintptr)));
@@ -39,6 +39,8 @@
 #include <QStringList>
 #include <QTcpServer>
 #include "core/workspace.hxx"
+#include "modelcache.hxx"
+#include "jobmanager.hxx"
 
 namespace graipe {
 
@@ -77,6 +79,20 @@ public:
      * \return all current connections by means of their socket ids and usernames
      */
     QVector<ConnectionInfo> connectionInfo() const;
+    
+    /**
+     * Get the model cache, which is shared by all connections.
+     *
+     * \return the model cache of the server
+     */
+    ModelCache& modelCache();
+    
+    /**
+     * Get the job manager, which runs the algorithms of all connections.
+     *
+     * \return the job manager of the server
+     */
+    JobManager& jobManager();
 
 public slots:
     /**
@@ -121,6 +137,12 @@ private:
     
     /** All active connections **/
     QVector<ConnectionInfo> m_connections;
+    
+    /** The models uploaded by any connection **/
+    ModelCache m_model_cache;
+    
+    /** The algorithm runs of all connections **/
+    JobManager m_job_manager;
 };
 
 } //namespace graipe
@@ -43,14 +43,38 @@
 
 namespace graipe {
 
-WorkerThread::WorkerThread(qintptr socketDescriptor, QVector<QString> registered_users, Workspace* wsp, QObject *parent)
+/**
+ * Deletes a workspace of the server together with all its models. The models
+ * are deleted directly, since the last owner of the workspace may be a
+ * thread without an event loop, which would handle their deleteLater().
+ *
+ * \param wsp The workspace to be deleted.
+ */
+static void deleteWorkspace(Workspace* wsp)
+{
+    wsp->models_mutex.lock();
+    while(!wsp->models.empty())
+    {
+        delete wsp->models.back();
+    }
+    wsp->models_mutex.unlock();
+    
+    delete wsp;
+}
+
+WorkerThread::WorkerThread(qintptr socketDescriptor, QVector<QString> registered_users, Workspace* wsp, ModelCache* cache, JobManager* jobs, QObject *parent)
 :   QThread(parent),
     m_socketDescriptor(socketDescriptor),
     m_tcpSocket(NULL),
     m_registered_users(registered_users),
     m_state(-1),
-    m_expected_bytes(0),
-    m_workspace(new Workspace(*wsp))
+    m_stream(NULL),
+    m_stream_decoder(NULL),
+    m_received_model(NULL),
+    m_received_algorithm(NULL),
+    m_workspace(new Workspace(*wsp), &deleteWorkspace),
+    m_cache(cache),
+    m_jobs(jobs)
 {
     qDebug()    << "Server knows factories: models " << m_workspace->modelFactory().size()
                 << ", ViewControllers: " << m_workspace->viewControllerFactory().size()
@@ -94,89 +118,104 @@ void WorkerThread::readyRead()
             if(m_registered_users.contains(account))
             {
                 m_state = 0;
+                m_user = split_data[1];
                 qDebug() << m_socketDescriptor <<  "--- logged in unsing:" << account;
                 
                 //Tell the server
                 emit connectionUserAuth(m_socketDescriptor, split_data[1]);
                 
                 //Tell the client:
-                m_tcpSocket->write(QString("Login:OK").toLatin1());
+                m_tcpSocket->write(QString("Login:OK\n").toLatin1());
                 m_tcpSocket->flush();
                 m_tcpSocket->waitForBytesWritten();
             }
         }
+        return;
     }
-    else if(m_state == 0)
+    
+    if(m_state == 0)
     {
+        //Wait until the complete request line arrived
+        if(!m_tcpSocket->canReadLine())
+        {
+            return;
+        }
+        
         QByteArray data = m_tcpSocket->readLine();
         qDebug() << m_socketDescriptor <<  "-->" << QString::fromLatin1(data);
 
         //Waiting for model or algorithm call
         QStringList split_data = QString::fromLatin1(data).trimmed().split(":");
         
-        if(split_data.size() == 2)
+        if(split_data.size() == 3 && split_data[0] == "Cached")
         {
+            readCachedModel(split_data[1].toLatin1(), split_data[2]);
+        }
+        else if(split_data.size() == 2 && split_data[0] == "Status")
+        {
+            sendJobStatus(split_data[1].toLongLong());
+        }
+        else if(split_data.size() == 2 && split_data[0] == "Cancel")
+        {
+            qint64 job_id = split_data[1].toLongLong();
+            respond(QString(m_jobs->cancel(m_user, job_id) ? "Cancelled:%1\n" : "Error:%1\n").arg(job_id));
+        }
+        else if(split_data.size() == 2 && split_data[0] == "Results")
+        {
+            sendJobResults(split_data[1].toLongLong());
+        }
+        else if(split_data.size() == 2 && split_data[0] == "Jobs")
+        {
+            QStringList job_ids;
+            for(qint64 job_id : m_jobs->jobs(m_user))
+            {
+                job_ids.append(QString::number(job_id));
+            }
+            respond("Jobs:" + job_ids.join(",") + "\n");
+        }
+        else if(split_data.size() >= 2 && split_data[1] == "Stream")
+        {
+            //An optional content hash allows to cache the uploaded model
+            m_stream_hash = (split_data.size() == 3) ? split_data[2].toLatin1() : QByteArray();
+            
             if(split_data[0] == "Model")
             {
-                m_state = 1;
-                m_expected_bytes = split_data[1].toInt();
-                m_buffer.clear();
-                //Maybe some bytes already arrived?
-                if(m_tcpSocket->bytesAvailable())
-                {
-                    readyRead();
-                }
+                startStream(1);
             }
             else if(split_data[0] == "Algorithm")
             {
-                m_state = 2;
-                m_expected_bytes = split_data[1].toInt();
-                m_buffer.clear();
-                //Maybe some bytes already arrived?
-                if(m_tcpSocket->bytesAvailable())
-                {
-                    readyRead();
-                }
+                startStream(2);
             }
         }
     }
-    else if(m_state == 1)
+    
+    if(m_state > 0)
     {
-        if(m_buffer.size() < m_expected_bytes)
-        {
-            m_buffer.append(m_tcpSocket->readAll());
-        }
-        
-        if(m_buffer.size() == m_expected_bytes)
+        //Hand all arrived frames to the deserialization, which is already running
+        if(m_stream->feed(m_tcpSocket))
         {
-            readModel();
-            m_state = 0;
-            m_expected_bytes = 0;
-            m_buffer.clear();
+            int state = m_state;
+            finishStream();
+            
+            if(state == 1)
+            {
+                readModel();
+            }
+            else
+            {
+                readAndSubmitAlgorithm();
+            }
         }
         else
         {
-            qDebug()  << m_socketDescriptor << "--- Still waiting for more Model bytes";
+            qDebug()  << m_socketDescriptor << "--- Still waiting for more frames";
         }
     }
-    else if(m_state == 2)
+    
+    //Maybe some bytes of the next request already arrived?
+    if(m_state == 0 && m_tcpSocket->canReadLine())
     {
-        if(m_buffer.size() < m_expected_bytes)
-        {
-            m_buffer.append(m_tcpSocket->readAll());
-        }
-        
-        if(m_buffer.size() == m_expected_bytes)
-        {
-            readAndRunAlgorithm();
-            m_state = 0;
-            m_expected_bytes = 0;
-            m_buffer.clear();
-        }
-        else
-        {
-            qDebug()  << m_socketDescriptor << "--- Still waiting for more Algorithm bytes";
-        }
+        readyRead();
     }
 }
 
@@ -184,139 +223,299 @@ void WorkerThread::disconnected()
 {
     qDebug() << m_socketDescriptor << "--- disconnected";
     
+    //Stop a running transfer, the deserialization will fail
+    if(m_stream != NULL)
+    {
+        m_stream->abort();
+        finishStream();
+    }
+    
     //Tell the server
     emit connectionTerminated(m_socketDescriptor);
 
-    delete m_workspace;
+    //Submitted jobs may still need the workspace
+    m_workspace.clear();
     m_tcpSocket->deleteLater();
     exit(0);
 }
 
-void WorkerThread::readModel()
+void WorkerThread::startStream(int state)
 {
-    try
-    {
-        QByteArray in_model_data = m_buffer;
-        
-        QBuffer in_buf(&in_model_data);
-        
-        //Always use compressed transfer
-        QIOCompressor* in_compressor = new QIOCompressor(&in_buf);
-        in_compressor->setStreamFormat(QIOCompressor::GzipFormat);
+    m_state = state;
+    m_received_model = NULL;
+    m_received_algorithm = NULL;
+    
+    m_stream = new FramedStreamReader;
+    m_stream->setRecording(state == 1 && !m_stream_hash.isEmpty());
+    m_stream->open(QIODevice::ReadOnly);
+    
+    FramedStreamReader* stream = m_stream;
+    
+    //Decompress and deserialize while the frames are still arriving
+    m_stream_decoder = new FramedStreamDecoder(
+                    [this, stream, state]()
+                    {
+                        //Always use compressed transfer
+                        QIOCompressor in_compressor(stream);
+                        in_compressor.setStreamFormat(QIOCompressor::GzipFormat);
+                        in_compressor.setParallelBlockSize(QIOCompressor::DefaultParallelBlockSize);
+                        
+                        if (!in_compressor.open(QIODevice::ReadOnly))
+                        {
+                            qWarning()  << m_socketDescriptor << "--- Did not open compressor (gz) on stream";
+                        }
+                        else
+                        {
+                            QXmlStreamReader xmlReader(&in_compressor);
+                            
+                            m_workspace->global_algorithm_mutex.lock();
+                            if(state == 1)
+                            {
+                                m_received_model = m_workspace->loadModel(xmlReader);
+                            }
+                            else
+                            {
+                                m_received_algorithm = m_workspace->loadAlgorithm(xmlReader);
+                            }
+                            m_workspace->global_algorithm_mutex.unlock();
+                            
+                            in_compressor.close();
+                        }
+                        
+                        //Discard everything, which has not been read
+                        stream->close();
+                    });
+    m_stream_decoder->start();
+}
 
-        if (!in_compressor->open(QIODevice::ReadOnly))
-        {
-            qWarning()  << m_socketDescriptor << "--- Did not open compressor (gz) on tcpSocket";
-            throw "Error";
-        }
-        
-        QXmlStreamReader xmlReader(in_compressor);
-        
+void WorkerThread::finishStream()
+{
+    m_stream_decoder->wait();
+    delete m_stream_decoder;
+    m_stream_decoder = NULL;
+    
+    //A broken stream must not produce any results
+    if(m_stream->aborted())
+    {
         m_workspace->global_algorithm_mutex.lock();
-        Model* new_model = m_workspace->loadModel(xmlReader);
+        delete m_received_model;
+        m_received_model = NULL;
         m_workspace->global_algorithm_mutex.unlock();
         
-        if(new_model == NULL)
-        {
-            qWarning() << m_socketDescriptor << "--- Did not load a model over the tcpSocket";
-            throw "Error";
-            
-        }
-        
-        qDebug() << m_socketDescriptor << "--- Model loaded and added sucessfully!";
-        qDebug() << m_socketDescriptor << "--- Now: " << m_workspace->models.size() << " models available!";
-        
-        m_tcpSocket->write(QString("Success:0").toLatin1());
-        m_tcpSocket->flush();
-        m_tcpSocket->waitForBytesWritten();
+        delete m_received_algorithm;
+        m_received_algorithm = NULL;
     }
-    catch(...)
+    
+    m_received_data = m_stream->recording();
+    
+    delete m_stream;
+    m_stream = NULL;
+    m_state = 0;
+}
+
+void WorkerThread::readModel()
+{
+    Model* new_model = m_received_model;
+    QByteArray hash = m_stream_hash;
+    QByteArray data = m_received_data;
+    
+    m_received_model = NULL;
+    m_stream_hash.clear();
+    m_received_data.clear();
+    
+    if(new_model == NULL)
     {
-        if(m_tcpSocket && m_tcpSocket->state() == QTcpSocket::ConnectedState)
+        qWarning() << m_socketDescriptor << "--- Did not load a model over the tcpSocket";
+        
+        if(m_tcpSocket->state() == QTcpSocket::ConnectedState)
         {
-            m_tcpSocket->write(QString("Error:0").toLatin1());
+            m_tcpSocket->write(QString("Error:0\n").toLatin1());
             m_tcpSocket->flush();
             m_tcpSocket->waitForBytesWritten();
         }
+        return;
     }
-}
-
-void WorkerThread::readAndRunAlgorithm()
-{
-    try
+    
+    qDebug() << m_socketDescriptor << "--- Model loaded and added sucessfully!";
+    
+    //Only cache models, which really match the hash given by the client
+    if(!hash.isEmpty())
     {
-        QByteArray in_alg_data = m_buffer;
-        
-        qDebug()  << m_socketDescriptor << "--> \"Algorithm data\".";
-        QBuffer in_buf(&in_alg_data);
-        
-        //Always use compressed transfer
-        QIOCompressor* in_compressor = new QIOCompressor(&in_buf);
-        in_compressor->setStreamFormat(QIOCompressor::GzipFormat);
-
-        if (!in_compressor->open(QIODevice::ReadOnly))
+        if(new_model->contentHash().toHex() == hash)
         {
-            qWarning() << m_socketDescriptor << "--- Did not open compressor (gz) on tcpSocket";
-            throw "Error";
+            m_cache->insert(hash, data);
+            qDebug() << m_socketDescriptor << "--- Model cached, now: " << m_cache->count() << " models in cache!";
         }
-        
-        QXmlStreamReader xmlReader(in_compressor);
-        Algorithm* new_alg = m_workspace->loadAlgorithm(xmlReader);
-        
-        if(new_alg == NULL)
+        else
         {
-            qWarning() << m_socketDescriptor << "--- Did not load a algorithm over the tcpSocket";
-            throw "Error";
-            
+            qWarning() << m_socketDescriptor << "--- Content hash does not match, model will not be cached";
         }
+    }
+    
+    qDebug() << m_socketDescriptor << "--- Now: " << m_workspace->modelCount() << " models available!";
+    
+    m_tcpSocket->write(QString("Success:0\n").toLatin1());
+    m_tcpSocket->flush();
+    m_tcpSocket->waitForBytesWritten();
+}
+
+void WorkerThread::readCachedModel(const QByteArray& hash, const QString& id)
+{
+    QByteArray data = m_cache->find(hash);
+    Model* new_model = NULL;
+    
+    if(!data.isEmpty())
+    {
+        QBuffer in_buf;
+        in_buf.setData(data);
         
-        qDebug() << m_socketDescriptor << "--- Algorithm loaded sucessfully!";
-        new_alg->run();
-        qDebug() << m_socketDescriptor << "--- Algorithm ran sucessfully!";
+        //Always use compressed transfer
+        QIOCompressor in_compressor(&in_buf);
+        in_compressor.setStreamFormat(QIOCompressor::GzipFormat);
+        in_compressor.setParallelBlockSize(QIOCompressor::DefaultParallelBlockSize);
         
-        for(Model* model : new_alg->results())
+        if (in_compressor.open(QIODevice::ReadOnly))
         {
-            QByteArray out_model_data;
-            QBuffer out_buf(&out_model_data);
+            QXmlStreamReader xmlReader(&in_compressor);
             
-            //Always use compressed transfer
-            QIOCompressor* out_compressor = new QIOCompressor(&out_buf);
-            out_compressor->setStreamFormat(QIOCompressor::GzipFormat);
-
-            if (!out_compressor->open(QIODevice::WriteOnly))
+            m_workspace->global_algorithm_mutex.lock();
+            new_model = m_workspace->loadModel(xmlReader);
+            if(new_model != NULL)
             {
-                qWarning()  << m_socketDescriptor << "--- Did not open compressor (gz) on tcpSocket";
-                throw "Error";
+                new_model->setID(id);
             }
+            m_workspace->global_algorithm_mutex.unlock();
             
-            QXmlStreamWriter xmlWriter(out_compressor);
-            model->serialize(xmlWriter);
-            out_compressor->close();
-            
-            QString request = QString("Model:%1\n").arg(out_model_data.size());
-
-            qDebug()  << m_socketDescriptor << "<-- " << request;
-            //First: Write the type (Image) and the number of bytes (of the image) to the socket"
-            m_tcpSocket->write(request.toLatin1());
-            m_tcpSocket->flush();
-            m_tcpSocket->waitForBytesWritten();
-            
-            qDebug()  << m_socketDescriptor << "<-- \"Model data\".";
-            //Then submit the data of the model:
-            m_tcpSocket->write(out_model_data);
-            m_tcpSocket->flush();
-            m_tcpSocket->waitForBytesWritten();
+            in_compressor.close();
         }
     }
-    catch(...)
+    
+    if(new_model != NULL)
     {
-        if(m_tcpSocket && m_tcpSocket->state() == QTcpSocket::ConnectedState)
+        qDebug() << m_socketDescriptor << "--- Model restored from cache!";
+        qDebug() << m_socketDescriptor << "--- Now: " << m_workspace->modelCount() << " models available!";
+    }
+    
+    //Tell the client, if the model needs to be uploaded
+    QString response = QString("Cached:%1\n").arg(new_model != NULL);
+    
+    qDebug()  << m_socketDescriptor << "<-- " << response;
+    m_tcpSocket->write(response.toLatin1());
+    m_tcpSocket->flush();
+    m_tcpSocket->waitForBytesWritten();
+}
+
+void WorkerThread::readAndSubmitAlgorithm()
+{
+    Algorithm* new_alg = m_received_algorithm;
+    m_received_algorithm = NULL;
+    
+    if(new_alg == NULL)
+    {
+        qWarning() << m_socketDescriptor << "--- Did not load a algorithm over the tcpSocket";
+        respond("Error:0\n");
+        return;
+    }
+    
+    qDebug() << m_socketDescriptor << "--- Algorithm loaded sucessfully!";
+    
+    //Run the algorithm asynchronously, the client may ask for its status and results
+    qint64 job_id = m_jobs->submit(m_user, m_workspace, new_alg);
+    
+    respond(QString("Job:%1\n").arg(job_id));
+}
+
+void WorkerThread::sendJobStatus(qint64 job_id)
+{
+    JobStatus status;
+    
+    if(m_jobs->status(m_user, job_id, status))
+    {
+        respond(QString("Status:%1:%2:%3:%4\n").arg(job_id)
+                                               .arg(status.stateName())
+                                               .arg(status.progress, 0, 'f', 1)
+                                               .arg(status.message.simplified()));
+    }
+    else
+    {
+        respond(QString("Error:%1\n").arg(job_id));
+    }
+}
+
+void WorkerThread::sendJobResults(qint64 job_id)
+{
+    std::vector<Model*> results;
+    QSharedPointer<Workspace> workspace;
+    
+    if(!m_jobs->takeResults(m_user, job_id, results, workspace))
+    {
+        respond(QString("Error:%1\n").arg(job_id));
+        return;
+    }
+    
+    try
+    {
+        respond(QString("Results:%1:%2\n").arg(job_id).arg(results.size()));
+        
+        //Stream back each result on its own
+        for(Model* model : results)
         {
-            m_tcpSocket->write(QString("Error:0").toLatin1());
-            m_tcpSocket->flush();
-            m_tcpSocket->waitForBytesWritten();
+            sendModel(model);
         }
     }
+    catch(...)
+    {
+        qWarning() << m_socketDescriptor << "--- Could not send the results of job" << job_id;
+    }
+}
+
+void WorkerThread::respond(const QString& response)
+{
+    qDebug()  << m_socketDescriptor << "<-- " << response;
+    
+    if(m_tcpSocket->state() == QTcpSocket::ConnectedState)
+    {
+        m_tcpSocket->write(response.toLatin1());
+        m_tcpSocket->flush();
+        m_tcpSocket->waitForBytesWritten();
+    }
+}
+
+void WorkerThread::sendModel(Model* model)
+{
+    QString request("Model:Stream\n");
+    
+    qDebug()  << m_socketDescriptor << "<-- " << request;
+    m_tcpSocket->write(request.toLatin1());
+    
+    //The frames are written directly to the socket, while the model is serialized
+    FramedStreamWriter out_stream(m_tcpSocket);
+    out_stream.open(QIODevice::WriteOnly);
+    
+    //Always use compressed transfer
+    QIOCompressor out_compressor(&out_stream);
+    out_compressor.setStreamFormat(QIOCompressor::GzipFormat);
+    out_compressor.setParallelBlockSize(QIOCompressor::DefaultParallelBlockSize);
+    
+    if (!out_compressor.open(QIODevice::WriteOnly))
+    {
+        qWarning()  << m_socketDescriptor << "--- Did not open compressor (gz) on tcpSocket";
+        out_stream.abort();
+        throw "Error";
+    }
+    
+    qDebug()  << m_socketDescriptor << "<-- \"Model data\".";
+    QXmlStreamWriter xmlWriter(&out_compressor);
+    model->serialize(xmlWriter);
+    out_compressor.close();
+    
+    if(xmlWriter.hasError())
+    {
+        qWarning()  << m_socketDescriptor << "--- Could not stream model over the tcpSocket";
+        out_stream.abort();
+        throw "Error";
+    }
+    out_stream.close();
 }
 
 } //namespace graipe
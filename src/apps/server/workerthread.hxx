@@ -37,11 +37,17 @@
 #define GRAIPE_SERVER_WORKERTHREAD_HXX
 
 #include "core/model.hxx"
+#include "core/algorithm.hxx"
+#include "core/framedstream.hxx"
+
+#include "modelcache.hxx"
+#include "jobmanager.hxx"
 
 #include <QThread>
 #include <QTcpSocket>
 #include <QByteArray>
 #include <QVector>
+#include <QSharedPointer>
 
 namespace graipe {
 
@@ -61,9 +67,11 @@ class WorkerThread
          * \param socketDescriptor The unique socketDescriptor of the client
          * \param registered_users A list of all registered users
          * \param wsp              The workspace of this client
+         * \param cache            The model cache shared by all clients
+         * \param jobs             The job manager shared by all clients
          * \param parent           A pointer to the parent. Here: the server.
          */
-        WorkerThread(qintptr socketDescriptor, QVector<QString> registered_users, Workspace* wsp, QObject *parent);
+        WorkerThread(qintptr socketDescriptor, QVector<QString> registered_users, Workspace* wsp, ModelCache* cache, JobManager* jobs, QObject *parent);
     
         /**
          * Running phase of the thread
@@ -82,14 +90,60 @@ class WorkerThread
         void disconnected();
    
     protected:
+        /**
+         * Starts to receive a framed stream. The decompression and
+         * deserialization run in a decoder thread of this connection
+         * while the frames arrive.
+         *
+         * \param state The new state: 1 for a Model, 2 for an Algorithm.
+         */
+        void startStream(int state);
+        /**
+         * Waits for the deserialization of the current stream and returns to state 0.
+         */
+        void finishStream();
         /** 
-         * Function to read a model.
+         * Function to finish the reading of a model.
          */
         void readModel();
         /**
-         * Funciton to read and run an algorithm.
+         * Function to restore a model from the server's cache instead of
+         * receiving it. Tells the client, if the model was found.
+         *
+         * \param hash The hex-encoded content hash of the model.
+         * \param id   The ID, the restored model will get.
+         */
+        void readCachedModel(const QByteArray& hash, const QString& id);
+        /**
+         * Funciton to finish the reading of an algorithm and to submit it
+         * as a job. Tells the client the ID of the job.
          */
-        void readAndRunAlgorithm();
+        void readAndSubmitAlgorithm();
+        /**
+         * Tells the client the status of one of its jobs.
+         *
+         * \param job_id The ID of the job.
+         */
+        void sendJobStatus(qint64 job_id);
+        /**
+         * Streams the results of a finished job back to the client and
+         * removes the job.
+         *
+         * \param job_id The ID of the job.
+         */
+        void sendJobResults(qint64 job_id);
+        /**
+         * Writes a response line to the client.
+         *
+         * \param response The response, including the line ending.
+         */
+        void respond(const QString& response);
+        /**
+         * Streams a model back to the client, while it is being serialized.
+         *
+         * \param model The model to be sent.
+         */
+        void sendModel(Model* model);
 
     signals:
         /**
@@ -120,19 +174,39 @@ class WorkerThread
          * \verbatim
            -1 : no logged in, \n
             0 : logged in,\n
-            1 : busy (waiting for data to be received)
+            1 : busy (receiving the frames of a model)\n
+            2 : busy (receiving the frames of an algorithm)
            \endverbatim
          */
         int m_state;
     
-        /** If state==1 - how many bytes do we want to receive **/
-        int m_expected_bytes;
+        /** If state>0 - the stream of the frames received **/
+        FramedStreamReader* m_stream;
+    
+        /** If state>0 - the thread deserializing the stream **/
+        FramedStreamDecoder* m_stream_decoder;
+    
+        /** If state==1 - the content hash given by the client for caching **/
+        QByteArray m_stream_hash;
+    
+        /** The results of the deserialization **/
+        Model* m_received_model;
+        Algorithm* m_received_algorithm;
+    
+        /** The (compressed) stream of the received model, if it will be cached **/
+        QByteArray m_received_data;
+    
+        /** The workspace of this thread, shared with its submitted jobs **/
+        QSharedPointer<Workspace> m_workspace;
+    
+        /** The model cache shared by all threads **/
+        ModelCache* m_cache;
     
-        /** Buffer for data exchange **/
-        QByteArray m_buffer;
+        /** The job manager shared by all threads **/
+        JobManager* m_jobs;
     
-        /** The workspace of this thread **/
-        Workspace * m_workspace;
+        /** The user, who logged in on this connection **/
+        QString m_user;
 };
 
 } //namespace graipe
@@ -35,6 +35,8 @@
 
 #include "core/algorithm.hxx"
 
+#include <algorithm>
+
 namespace graipe {
 
 /**
@@ -45,6 +47,9 @@ namespace graipe {
  * @}
  */
 
+/** The algorithm, which is currently executed by each thread **/
+static thread_local Algorithm* running_algorithm = NULL;
+
 Algorithm::Algorithm(Workspace* wsp)
 :   m_parameters(new ParameterGroup),
     m_workspace(wsp)
@@ -139,6 +144,62 @@ void Algorithm::run()
 	}
 }
 
+void Algorithm::execute()
+{
+    Algorithm* last_algorithm = running_algorithm;
+    CancellationToken* last_token = CancellationToken::current();
+    
+    //Start each run uncancelled, but keep the deadline set by the caller
+    QDateTime deadline = m_token.deadline();
+    m_token.reset();
+    m_token.setDeadline(deadline);
+    
+    running_algorithm = this;
+    CancellationToken::setCurrent(&m_token);
+    m_created_models.clear();
+    
+    //Did the run report an error by itself?
+    bool error_reported = false;
+    QMetaObject::Connection connection = connect(this, &Algorithm::errorMessage, [&error_reported](){ error_reported = true; });
+    
+    try
+    {
+        run();
+    }
+    catch(std::exception& e)
+    {
+        emit errorMessage(QString("Explainable error occured: ") + QString::fromStdString(e.what()));
+    }
+    catch(...)
+    {
+        emit errorMessage(QString("Non-explainable error occured"));
+    }
+    
+    disconnect(connection);
+    
+    running_algorithm = last_algorithm;
+    CancellationToken::setCurrent(last_token);
+    
+    if(m_token.wasInterrupted())
+    {
+        //Free the partial results of the interrupted run
+        std::vector<Model*> created_models = m_created_models;
+        m_created_models.clear();
+        
+        for(Model* model : created_models)
+        {
+            m_results.erase(std::remove(m_results.begin(), m_results.end(), model), m_results.end());
+            delete model;
+        }
+        
+        if(!error_reported)
+        {
+            emit errorMessage(QString::fromStdString(OperationCancelled(m_token.deadlineExceeded()).what()));
+        }
+    }
+    m_created_models.clear();
+}
+
 void Algorithm::lockModels()
 {
     for(auto item : *m_parameters)
@@ -157,6 +218,9 @@ void Algorithm::unlockModels()
 
 void Algorithm::status_update(float percent)
 {
+    //Stop here, if the algorithm has been cancelled
+    m_token.checkNow();
+    
 	//restrict to 99.9% because otherwise the processing of the algorithm 
 	//could be interuppted unwanted
 	float p_overall = 100.0*m_phase/std::max(m_phase_count,(unsigned int)1);
@@ -170,4 +234,53 @@ std::vector<Model *>  Algorithm::results()
 	return m_results;
 }
 
+void Algorithm::cancel()
+{
+    m_token.cancel();
+}
+
+bool Algorithm::isCancelled() const
+{
+    return m_token.isCancelled();
+}
+
+void Algorithm::setDeadline(const QDateTime& deadline)
+{
+    m_token.setDeadline(deadline);
+}
+
+QDateTime Algorithm::deadline() const
+{
+    return m_token.deadline();
+}
+
+void Algorithm::trackModel(Model* model)
+{
+    if(running_algorithm != NULL)
+    {
+        QMutexLocker locker(&running_algorithm->m_created_models_mutex);
+        running_algorithm->m_created_models.push_back(model);
+    }
+}
+
+void Algorithm::untrackModel(Model* model)
+{
+    if(running_algorithm != NULL)
+    {
+        QMutexLocker locker(&running_algorithm->m_created_models_mutex);
+        std::vector<Model*>& models = running_algorithm->m_created_models;
+        models.erase(std::remove(models.begin(), models.end(), model), models.end());
+    }
+}
+
+Algorithm* Algorithm::current()
+{
+    return running_algorithm;
+}
+
+void Algorithm::setCurrent(Algorithm* algorithm)
+{
+    running_algorithm = algorithm;
+}
+
 }//end of namespace graipe
@@ -37,9 +37,12 @@
 #define GRAIPE_CORE_ALGORITHM_HXX
 
 #include "core/config.hxx"
+#include "core/cancellation.hxx"
 #include "core/model.hxx"
 #include "core/parameters.hxx"
 
+#include <QMutex>
+
 #include <vector>
 
 namespace graipe {
@@ -73,6 +76,11 @@ namespace graipe {
  *
  * During each run, the algorithm uses signals to report about the
  * current progress, errors and finshed state.
+ *
+ * Long running algorithms may be cancelled or get a deadline. Both are
+ * checked cooperatively at each status_update() and inside the iteration
+ * loops of the kernels via CancellationToken::checkCurrent(). To make this
+ * work, algorithms should be started by means of execute() instead of run().
  */
 class GRAIPE_CORE_EXPORT Algorithm
 :   public QObject,
@@ -183,6 +191,65 @@ class GRAIPE_CORE_EXPORT Algorithm
          * \return The results of the algorithm (if finished).
          */
 		virtual std::vector<Model*> results();
+    
+        /**
+         * Cancels the algorithm. Thread-safe. The run will stop at the next
+         * cancellation check, release the model locks and emit an errorMessage.
+         */
+        void cancel();
+    
+        /**
+         * Returns, if the algorithm has been cancelled or its deadline has been exceeded.
+         *
+         * \return True, if the algorithm shall stop.
+         */
+        bool isCancelled() const;
+    
+        /**
+         * Sets the deadline of the algorithm's run. Thread-safe.
+         *
+         * \param deadline The deadline. An invalid QDateTime removes the deadline.
+         */
+        void setDeadline(const QDateTime& deadline);
+    
+        /**
+         * Returns the deadline of the algorithm's run.
+         *
+         * \return The deadline or an invalid QDateTime, if there is none.
+         */
+        QDateTime deadline() const;
+    
+        /**
+         * Registers a newly created Model at the algorithm, which is currently
+         * running in the calling thread (if any). Called by the Model constructors.
+         *
+         * \param model The new model.
+         */
+        static void trackModel(Model* model);
+    
+        /**
+         * Unregisters a Model from the algorithm, which is currently running in
+         * the calling thread (if any). Called by the Model destructor.
+         *
+         * \param model The model, which will be deleted.
+         */
+        static void untrackModel(Model* model);
+    
+        /**
+         * Returns the algorithm, which is currently running in the calling thread.
+         *
+         * \return The running algorithm or NULL, if there is none.
+         */
+        static Algorithm* current();
+    
+        /**
+         * Sets the algorithm, which is currently running in the calling thread.
+         * Used to pass the algorithm on to parallel tasks (see parallelFor), such
+         * that models created by these tasks are tracked, too.
+         *
+         * \param algorithm The running algorithm, may be NULL.
+         */
+        static void setCurrent(Algorithm* algorithm);
 	
     
     public slots:
@@ -200,6 +267,16 @@ class GRAIPE_CORE_EXPORT Algorithm
          * changed the ownership from algorithm to the caller.
          */
         virtual void run();
+    
+        /**
+         * Runs the algorithm under the control of its cancellation token: The token
+         * is reset (keeping its deadline) and becomes the current token of the calling
+         * thread (and thus of all tasks, which are submitted to the Scheduler during
+         * the run). If the run was interrupted,
+         * all models, which have been created during the run are deleted again, and an
+         * errorMessage is emitted, if the run() did not do so itself.
+         */
+        void execute();
 
 	signals:
         /** Neutral status message **/
@@ -221,6 +298,14 @@ class GRAIPE_CORE_EXPORT Algorithm
         std::vector<Model*> m_results;
         /** The Workspace **/
         Workspace* m_workspace;
+    
+    private:
+        /** The cancellation token of this algorithm **/
+        CancellationToken m_token;
+        /** The models, which have been created during the current execute() **/
+        std::vector<Model*> m_created_models;
+        /** Mutex for the created models, since parallel tasks may create models **/
+        QMutex m_created_models_mutex;
 };
 
 /**
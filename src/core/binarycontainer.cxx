@@ -0,0 +1,553 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include "core/binarycontainer.hxx"
+#include "core/parallel.hxx"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QtDebug>
+
+#include <zlib.h>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *     @file
+ *     @brief Implementation file for the binary (chunked) container format
+ * @}
+ */
+
+/** The magic bytes at the beginning of each container **/
+static const char binary_container_magic[8] = {'G','R','A','I','P','E','B','C'};
+
+/** The current version of the container format **/
+static const quint32 binary_container_version = 1;
+
+/** The alignment of the chunks inside the container **/
+static const quint64 binary_container_alignment = 64;
+
+/** Chunks larger than this will not be compressed (zlib uses 32 bit sizes on some platforms) **/
+static const quint64 binary_container_max_compress = quint64(1) << 30;
+
+/**
+ * Rounds a position up to the next multiple of the alignment.
+ *
+ * \param pos The position.
+ * \return The next aligned position.
+ */
+static quint64 alignedPosition(quint64 pos)
+{
+    return ((pos + binary_container_alignment - 1) / binary_container_alignment) * binary_container_alignment;
+}
+
+BinaryContainer::BinaryContainer(QIODevice* device, bool compress, QObject* parent)
+:   QIODevice(parent),
+    m_device(device),
+    m_compress(compress)
+{
+}
+
+BinaryContainer::~BinaryContainer()
+{
+    if(isOpen())
+    {
+        close();
+    }
+}
+
+bool BinaryContainer::isContainerFile(const QString& filename)
+{
+    return filename.endsWith(".xbin", Qt::CaseInsensitive);
+}
+
+QString BinaryContainer::encoding(const QXmlStreamWriter& xmlWriter)
+{
+    return qobject_cast<BinaryContainer*>(xmlWriter.device()) ? "Binary" : "Base64";
+}
+
+void BinaryContainer::writeBlock(QXmlStreamWriter& xmlWriter, const char* data, qint64 size)
+{
+    BinaryContainer* container = qobject_cast<BinaryContainer*>(xmlWriter.device());
+    
+    if(container != NULL)
+    {
+        xmlWriter.writeAttribute("Chunk", QString::number(container->addChunk(data, size)));
+    }
+    else
+    {
+        xmlWriter.writeCharacters(QByteArray::fromRawData(data, size).toBase64());
+    }
+}
+
+bool BinaryContainer::readBlock(QXmlStreamReader& xmlReader, char* data, qint64 size)
+{
+    if(xmlReader.attributes().hasAttribute("Chunk"))
+    {
+        BinaryContainer* container = qobject_cast<BinaryContainer*>(xmlReader.device());
+        int index = xmlReader.attributes().value("Chunk").toInt();
+        
+        xmlReader.skipCurrentElement();
+        
+        return (container != NULL) && container->readChunk(index, data, size);
+    }
+    
+    QByteArray block = QByteArray::fromBase64(xmlReader.readElementText().toLatin1());
+    
+    if(block.size() != size)
+    {
+        return false;
+    }
+    
+    memcpy(data, block.constData(), size);
+    return true;
+}
+
+bool BinaryContainer::open(OpenMode mode)
+{
+    if(isOpen() || m_device == NULL)
+    {
+        qWarning() << "BinaryContainer::open: Container is already opened or has no device.";
+        return false;
+    }
+    
+    if((mode & ReadWrite) == ReadWrite || (mode & Append))
+    {
+        qWarning() << "BinaryContainer::open: Only ReadOnly or WriteOnly are supported.";
+        return false;
+    }
+    
+    m_header.clear();
+    m_chunks.clear();
+    
+    if(!m_device->isOpen() && !m_device->open(mode & ReadWrite))
+    {
+        return false;
+    }
+    
+    if((mode & ReadOnly) && !readContainer())
+    {
+        m_device->close();
+        return false;
+    }
+    
+    //The header lives in memory, so there is no need for QIODevice's buffering
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void BinaryContainer::close()
+{
+    if(!isOpen())
+    {
+        return;
+    }
+    
+    bool written = true;
+    
+    if(openMode() & WriteOnly)
+    {
+        written = writeContainer();
+        
+        if(!written)
+        {
+            qCritical() << "BinaryContainer::close: Could not write the container.";
+        }
+    }
+    
+    QIODevice::close();
+    
+    //QSaveFiles replace the target file atomically. This keeps the mappings
+    //of images, which have been loaded from the same file, intact.
+    QSaveFile* save_file = qobject_cast<QSaveFile*>(m_device);
+    
+    if(save_file != NULL)
+    {
+        if(!written)
+        {
+            save_file->cancelWriting();
+        }
+        save_file->commit();
+    }
+    else
+    {
+        m_device->close();
+    }
+    
+    m_header.clear();
+    m_chunks.clear();
+}
+
+bool BinaryContainer::isSequential() const
+{
+    return false;
+}
+
+qint64 BinaryContainer::size() const
+{
+    return m_header.size();
+}
+
+bool BinaryContainer::compression() const
+{
+    return m_compress;
+}
+
+void BinaryContainer::setCompression(bool compress)
+{
+    m_compress = compress;
+}
+
+int BinaryContainer::addChunk(const char* data, qint64 size)
+{
+    if(!isWritable() || size < 0)
+    {
+        return -1;
+    }
+    
+    Chunk chunk;
+    chunk.data = data;
+    chunk.offset = 0;
+    chunk.stored_size = size;
+    chunk.size = size;
+    chunk.compression = NoCompression;
+    
+    m_chunks.push_back(chunk);
+    
+    return (int)m_chunks.size()-1;
+}
+
+int BinaryContainer::addChunk(const QByteArray& data)
+{
+    int index = addChunk(data.constData(), data.size());
+    
+    if(index != -1)
+    {
+        m_chunks[index].buffer = data;
+    }
+    return index;
+}
+
+unsigned int BinaryContainer::chunkCount() const
+{
+    return (unsigned int)m_chunks.size();
+}
+
+qint64 BinaryContainer::chunkSize(int index) const
+{
+    if(index < 0 || index >= (int)m_chunks.size())
+    {
+        return -1;
+    }
+    return m_chunks[index].size;
+}
+
+uchar* BinaryContainer::mapChunk(int index, QFile*& mapping)
+{
+    QFile* file = qobject_cast<QFile*>(m_device);
+    
+    if(     !isReadable() || file == NULL
+        ||  index < 0 || index >= (int)m_chunks.size()
+        ||  m_chunks[index].compression != NoCompression)
+    {
+        return NULL;
+    }
+    
+    if(mapping == NULL)
+    {
+        mapping = new QFile(file->fileName());
+        
+        if(!mapping->open(QIODevice::ReadOnly))
+        {
+            delete mapping;
+            mapping = NULL;
+            return NULL;
+        }
+    }
+    
+    const Chunk& chunk = m_chunks[index];
+    
+    return mapping->map(chunk.offset, chunk.size, QFileDevice::MapPrivateOption);
+}
+
+uchar* BinaryContainer::mapBlock(QXmlStreamReader& xmlReader, qint64 size, QFile*& mapping)
+{
+    BinaryContainer* container = qobject_cast<BinaryContainer*>(xmlReader.device());
+    
+    if(container == NULL || !xmlReader.attributes().hasAttribute("Chunk"))
+    {
+        return NULL;
+    }
+    
+    int index = xmlReader.attributes().value("Chunk").toInt();
+    
+    if(container->chunkSize(index) != size)
+    {
+        return NULL;
+    }
+    
+    uchar* data = container->mapChunk(index, mapping);
+    
+    if(data != NULL)
+    {
+        xmlReader.skipCurrentElement();
+    }
+    return data;
+}
+
+bool BinaryContainer::readChunk(int index, char* data, qint64 size)
+{
+    if(!isReadable() || index < 0 || index >= (int)m_chunks.size())
+    {
+        qWarning() << "BinaryContainer::readChunk: Chunk" << index << "does not exist.";
+        return false;
+    }
+    
+    const Chunk& chunk = m_chunks[index];
+    
+    if((quint64)size != chunk.size)
+    {
+        qWarning() << "BinaryContainer::readChunk: Size mismatch for chunk" << index << ":" << size << "!=" << chunk.size;
+        return false;
+    }
+    
+    if(!m_device->seek(chunk.offset))
+    {
+        return false;
+    }
+    
+    if(chunk.compression == NoCompression)
+    {
+        //Read directly into the destination
+        qint64 read = 0;
+        
+        while(read < size)
+        {
+            qint64 res = m_device->read(data + read, size - read);
+            
+            if(res <= 0)
+            {
+                return false;
+            }
+            read += res;
+        }
+        return true;
+    }
+    else if(chunk.compression == ZlibCompression)
+    {
+        QByteArray buffer = m_device->read(chunk.stored_size);
+        
+        if((quint64)buffer.size() != chunk.stored_size)
+        {
+            return false;
+        }
+        
+        uLongf dest_size = (uLongf)size;
+        
+        if(     uncompress((Bytef*)data, &dest_size, (const Bytef*)buffer.constData(), (uLong)buffer.size()) != Z_OK
+            ||  dest_size != (uLongf)size)
+        {
+            qWarning() << "BinaryContainer::readChunk: Decompression of chunk" << index << "failed.";
+            return false;
+        }
+        return true;
+    }
+    
+    qWarning() << "BinaryContainer::readChunk: Unknown compression" << chunk.compression << "of chunk" << index;
+    return false;
+}
+
+qint64 BinaryContainer::readData(char* data, qint64 maxSize)
+{
+    qint64 available = qMax(qint64(0), qint64(m_header.size()) - pos());
+    qint64 count = qMin(maxSize, available);
+    
+    memcpy(data, m_header.constData() + pos(), count);
+    
+    return count;
+}
+
+qint64 BinaryContainer::writeData(const char* data, qint64 maxSize)
+{
+    m_header.append(data, maxSize);
+    
+    return maxSize;
+}
+
+bool BinaryContainer::writeContainer()
+{
+    //1. Compress the chunks in parallel (if wanted)
+    if(m_compress)
+    {
+        parallelFor(m_chunks.size(),
+                    [&](unsigned int i)
+                    {
+                        Chunk& chunk = m_chunks[i];
+                        
+                        if(chunk.size == 0 || chunk.size > binary_container_max_compress)
+                        {
+                            return;
+                        }
+                        
+                        QByteArray buffer;
+                        buffer.resize(compressBound((uLong)chunk.size));
+                        uLongf stored_size = buffer.size();
+                        
+                        if(     compress2((Bytef*)buffer.data(), &stored_size, (const Bytef*)chunk.data, (uLong)chunk.size, Z_DEFAULT_COMPRESSION) == Z_OK
+                            &&  stored_size < chunk.size)
+                        {
+                            buffer.resize(stored_size);
+                            chunk.buffer = buffer;
+                            chunk.data = chunk.buffer.constData();
+                            chunk.stored_size = stored_size;
+                            chunk.compression = ZlibCompression;
+                        }
+                    });
+    }
+    
+    //2. Compute the layout
+    quint64 position = sizeof(binary_container_magic) + 2*sizeof(quint32) + sizeof(quint64)
+                    + m_chunks.size()*(3*sizeof(quint64) + 2*sizeof(quint32))
+                    + m_header.size();
+    
+    for(Chunk& chunk : m_chunks)
+    {
+        chunk.offset = alignedPosition(position);
+        position = chunk.offset + chunk.stored_size;
+    }
+    
+    //3. Write preamble, chunk table and XML header
+    QDataStream out(m_device);
+    out.setByteOrder(QDataStream::LittleEndian);
+    
+    out.writeRawData(binary_container_magic, sizeof(binary_container_magic));
+    out << binary_container_version << (quint32)m_chunks.size() << (quint64)m_header.size();
+    
+    for(const Chunk& chunk : m_chunks)
+    {
+        out << chunk.offset << chunk.stored_size << chunk.size << chunk.compression << quint32(0);
+    }
+    
+    if(     out.status() != QDataStream::Ok
+        ||  m_device->write(m_header) != m_header.size())
+    {
+        return false;
+    }
+    
+    //4. Write the aligned chunks
+    quint64 written = m_device->pos();
+    
+    for(const Chunk& chunk : m_chunks)
+    {
+        QByteArray padding(chunk.offset - written, '\0');
+        
+        if(m_device->write(padding) != padding.size())
+        {
+            return false;
+        }
+        
+        quint64 chunk_written = 0;
+        
+        while(chunk_written < chunk.stored_size)
+        {
+            qint64 res = m_device->write(chunk.data + chunk_written, chunk.stored_size - chunk_written);
+            
+            if(res <= 0)
+            {
+                return false;
+            }
+            chunk_written += res;
+        }
+        written = chunk.offset + chunk.stored_size;
+    }
+    
+    return true;
+}
+
+bool BinaryContainer::readContainer()
+{
+    QDataStream in(m_device);
+    in.setByteOrder(QDataStream::LittleEndian);
+    
+    char magic[sizeof(binary_container_magic)];
+    
+    if(     in.readRawData(magic, sizeof(magic)) != sizeof(magic)
+        ||  memcmp(magic, binary_container_magic, sizeof(magic)) != 0)
+    {
+        qWarning() << "BinaryContainer::readContainer: Device does not contain a GRAIPE binary container.";
+        return false;
+    }
+    
+    quint32 version, chunk_count;
+    quint64 header_size;
+    
+    in >> version >> chunk_count >> header_size;
+    
+    if(version > binary_container_version)
+    {
+        qWarning() << "BinaryContainer::readContainer: Unsupported container version" << version;
+        return false;
+    }
+    
+    for(quint32 i=0; i<chunk_count && in.status() == QDataStream::Ok; ++i)
+    {
+        Chunk chunk;
+        quint32 reserved;
+        
+        chunk.data = NULL;
+        in >> chunk.offset >> chunk.stored_size >> chunk.size >> chunk.compression >> reserved;
+        
+        if(!m_device->isSequential() && chunk.offset + chunk.stored_size > (quint64)m_device->size())
+        {
+            qWarning() << "BinaryContainer::readContainer: Chunk" << i << "exceeds the container's size.";
+            return false;
+        }
+        m_chunks.push_back(chunk);
+    }
+    
+    if(in.status() != QDataStream::Ok)
+    {
+        qWarning() << "BinaryContainer::readContainer: Chunk table is incomplete.";
+        return false;
+    }
+    
+    m_header = m_device->read(header_size);
+    
+    return (quint64)m_header.size() == header_size;
+}
+
+} //end of namespace graipe
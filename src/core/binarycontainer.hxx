@@ -0,0 +1,348 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_CORE_BINARYCONTAINER_HXX
+#define GRAIPE_CORE_BINARYCONTAINER_HXX
+
+#include "core/config.hxx"
+
+#include <QIODevice>
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+#include <vector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *
+ * @file
+ * @brief Header file for the binary (chunked) container format
+ */
+
+/**
+ * The BinaryContainer is a file format for GRAIPE objects with bulk data.
+ * It consists of the usual XML serialization of the objects (the header)
+ * and a number of raw binary chunks, which hold the bulk data (e.g. image
+ * bands) instead of Base64 encoded text inside the XML.
+ *
+ * The layout of a container file is (all numbers little endian):
+ * \verbatim
+   "GRAIPEBC"                                        8 bytes magic
+   version, chunk count                              2 x quint32
+   XML header size                                   quint64
+   for each chunk:                                   32 bytes each
+       offset, stored size, size                     3 x quint64
+       compression, reserved                         2 x quint32
+   XML header                                        UTF-8
+   chunks, each aligned to 64 bytes
+   \endverbatim
+ *
+ * The container is a QIODevice itself: The QXmlStreamWriter/Reader work on
+ * the XML header only. Serializables may find out if they are written
+ * into a container by a qobject_cast of the xml stream's device and then
+ * add their bulk data as chunks using addChunk(). The returned index is
+ * stored inside the XML instead of the data. On reading, the data is
+ * read (and decompressed, if necessary) directly into the destination.
+ *
+ * Container files use the extension ".xbin".
+ */
+class GRAIPE_CORE_EXPORT BinaryContainer
+:   public QIODevice
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * The compression types of the single chunks.
+         */
+        enum Compression
+        {
+            NoCompression = 0,
+            ZlibCompression = 1
+        };
+
+        /**
+         * Creates a new container on top of a random access device, e.g. a QFile.
+         * The device is not owned by the container.
+         *
+         * \param device   The underlying device.
+         * \param compress If true, the chunks will be compressed when written.
+         * \param parent   The parent QObject, NULL by default.
+         */
+        BinaryContainer(QIODevice* device, bool compress=false, QObject* parent=NULL);
+
+        /**
+         * Destructor of the container. Closes it, if it is still opened.
+         */
+        ~BinaryContainer();
+
+        /**
+         * Checks, if a filename refers to a container by means of its extension.
+         *
+         * \param filename The filename to be checked.
+         * \return True, if the file ends with ".xbin".
+         */
+        static bool isContainerFile(const QString& filename);
+
+        /**
+         * Returns the encoding of bulk data, which will be used for the
+         * given writer: "Binary" for containers, else "Base64".
+         *
+         * \param xmlWriter The QXmlStreamWriter, which will be used.
+         * \return The encoding name as a QString.
+         */
+        static QString encoding(const QXmlStreamWriter& xmlWriter);
+
+        /**
+         * Writes a block of bulk data into the current (opened) XML element.
+         * If the writer works on a container, the data is added as a chunk
+         * and only its index is written as attribute "Chunk". Else, the data
+         * is written Base64 encoded as the element's text.
+         * The data has to stay valid until the device has been closed.
+         *
+         * \param xmlWriter The QXmlStreamWriter, where we write to.
+         * \param data      Pointer to the data.
+         * \param size      The size of the data in bytes.
+         */
+        static void writeBlock(QXmlStreamWriter& xmlWriter, const char* data, qint64 size);
+
+        /**
+         * Reads a block of bulk data from the current XML element, which
+         * has been written by writeBlock(). Reads until the end of the element.
+         *
+         * \param xmlReader The QXmlStreamReader, where we read from.
+         * \param data      Pointer to the destination memory.
+         * \param size      The expected size of the data in bytes.
+         * \return True, if the block had the expected size and was read completely.
+         */
+        static bool readBlock(QXmlStreamReader& xmlReader, char* data, qint64 size);
+
+        /**
+         * Maps a block of bulk data from the current XML element into memory
+         * instead of reading it. This is only possible, if the reader works on a
+         * container file and the block is stored as an uncompressed chunk.
+         * The element is only consumed, if the mapping succeeded. Otherwise
+         * use readBlock() to read the data.
+         *
+         * \param xmlReader The QXmlStreamReader, where we read from.
+         * \param size      The expected size of the data in bytes.
+         * \param mapping   The file, which holds the mapping (see mapChunk()).
+         * \return Pointer to the (copy-on-write) mapped data or NULL.
+         */
+        static uchar* mapBlock(QXmlStreamReader& xmlReader, qint64 size, QFile*& mapping);
+
+        /**
+         * Opens the container and the underlying device. If opened for reading,
+         * the complete XML header and the chunk table will be read.
+         *
+         * \param mode Either QIODevice::ReadOnly or QIODevice::WriteOnly.
+         * \return True, if the container was opened successfully.
+         */
+        bool open(OpenMode mode);
+
+        /**
+         * Closes the container. If opened for writing, the header, the chunk
+         * table and all chunks will be written to the underlying device now.
+         */
+        void close();
+
+        /**
+         * The XML header may be accessed randomly.
+         *
+         * \return Always false.
+         */
+        bool isSequential() const;
+
+        /**
+         * Const accessor to the size of the XML header.
+         *
+         * \return The size of the XML header in bytes.
+         */
+        qint64 size() const;
+
+        /**
+         * Const accessor to the compression of written chunks.
+         *
+         * \return True, if the chunks will be compressed when written.
+         */
+        bool compression() const;
+
+        /**
+         * Sets the compression of written chunks.
+         *
+         * \param compress If true, the chunks will be compressed when written.
+         */
+        void setCompression(bool compress);
+
+        /**
+         * Adds a chunk of data to the container, which is opened for writing.
+         * The data is not copied, it has to stay valid until close() has been called.
+         *
+         * \param data Pointer to the data.
+         * \param size The size of the data in bytes.
+         * \return The index of the new chunk, or -1 if the container is not writable.
+         */
+        int addChunk(const char* data, qint64 size);
+
+        /**
+         * Adds a chunk of data to the container, which is opened for writing.
+         * The (implicitly shared) byte array is kept until close() has been called.
+         *
+         * \param data The data.
+         * \return The index of the new chunk, or -1 if the container is not writable.
+         */
+        int addChunk(const QByteArray& data);
+
+        /**
+         * Const accessor to the number of chunks of this container.
+         *
+         * \return The number of chunks.
+         */
+        unsigned int chunkCount() const;
+
+        /**
+         * Const accessor to the (uncompressed) size of a chunk.
+         *
+         * \param index The index of the chunk.
+         * \return The size of the chunk in bytes or -1, if the index is invalid.
+         */
+        qint64 chunkSize(int index) const;
+
+        /**
+         * Maps an uncompressed chunk of a container file into memory. The
+         * mapping is copy-on-write: Changes to the memory will never be written
+         * back to the file. Untouched pages may be paged out by the OS.
+         *
+         * The mapping belongs to a separate QFile, since a QFile removes all of
+         * its mappings when it is closed. If mapping is NULL, a new QFile will
+         * be created, which is then owned by the caller. Delete it to unmap
+         * all chunks, which have been mapped using it.
+         *
+         * \param index   The index of the chunk.
+         * \param mapping The file, which holds the mapping.
+         * \return Pointer to the mapped data or NULL, if the chunk cannot be mapped.
+         */
+        uchar* mapChunk(int index, QFile*& mapping);
+
+        /**
+         * Reads a chunk directly into the given memory. The size has to match
+         * the uncompressed size of the chunk.
+         *
+         * \param index The index of the chunk.
+         * \param data  Pointer to the destination memory.
+         * \param size  The size of the destination memory in bytes.
+         * \return True, if the chunk was read completely.
+         */
+        bool readChunk(int index, char* data, qint64 size);
+
+    protected:
+        /**
+         * Reads from the XML header.
+         *
+         * \param data    Pointer to the destination memory.
+         * \param maxSize The maximum number of bytes to read.
+         * \return The number of bytes read.
+         */
+        qint64 readData(char* data, qint64 maxSize);
+
+        /**
+         * Writes into the XML header.
+         *
+         * \param data    Pointer to the source memory.
+         * \param maxSize The number of bytes to write.
+         * \return The number of bytes written.
+         */
+        qint64 writeData(const char* data, qint64 maxSize);
+
+    private:
+        /**
+         * Writes the complete container to the underlying device.
+         *
+         * \return True, if everything was written.
+         */
+        bool writeContainer();
+
+        /**
+         * Reads the XML header and the chunk table from the underlying device.
+         *
+         * \return True, if the device contained a valid container.
+         */
+        bool readContainer();
+
+        /**
+         * The description of one chunk.
+         */
+        struct Chunk
+        {
+            /** Pointer to the (unowned) data of a chunk to be written **/
+            const char* data;
+            /** Owned or compressed data of a chunk to be written **/
+            QByteArray buffer;
+            /** Position inside the container **/
+            quint64 offset;
+            /** Size inside the container **/
+            quint64 stored_size;
+            /** Size of the uncompressed data **/
+            quint64 size;
+            /** Compression of the chunk's data **/
+            quint32 compression;
+        };
+
+        /** The underlying device **/
+        QIODevice* m_device;
+
+        /** Shall the written chunks be compressed? **/
+        bool m_compress;
+
+        /** The XML header **/
+        QByteArray m_header;
+
+        /** All chunks of the container **/
+        std::vector<Chunk> m_chunks;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_CORE_BINARYCONTAINER_HXX
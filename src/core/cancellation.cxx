@@ -0,0 +1,160 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#include "core/cancellation.hxx"
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *     @file
+ *     @brief Implementation file for the cooperative cancellation of long running computations
+ * @}
+ */
+
+/** The current token of each thread **/
+static thread_local CancellationToken* current_cancellation_token = NULL;
+
+/** The number of check() calls of each thread, to rate-limit the deadline tests **/
+static thread_local unsigned int cancellation_check_count = 0;
+
+OperationCancelled::OperationCancelled(bool deadline_exceeded)
+:   m_deadline_exceeded(deadline_exceeded)
+{
+}
+
+const char* OperationCancelled::what() const noexcept
+{
+    return m_deadline_exceeded ? "The deadline has been exceeded" : "The operation has been cancelled";
+}
+
+CancellationToken::CancellationToken()
+:   m_cancelled(0),
+    m_deadline(-1),
+    m_interrupted(0)
+{
+}
+
+void CancellationToken::cancel()
+{
+    m_cancelled.storeRelease(1);
+}
+
+void CancellationToken::reset()
+{
+    m_cancelled.storeRelease(0);
+    m_deadline.storeRelease(-1);
+    m_interrupted.storeRelease(0);
+}
+
+void CancellationToken::setDeadline(const QDateTime& deadline)
+{
+    m_deadline.storeRelease(deadline.isValid() ? deadline.toMSecsSinceEpoch() : -1);
+}
+
+QDateTime CancellationToken::deadline() const
+{
+    qint64 deadline = m_deadline.loadAcquire();
+    
+    return (deadline < 0) ? QDateTime() : QDateTime::fromMSecsSinceEpoch(deadline);
+}
+
+bool CancellationToken::isCancelled() const
+{
+    return m_cancelled.loadAcquire() || deadlineExceeded();
+}
+
+bool CancellationToken::deadlineExceeded() const
+{
+    qint64 deadline = m_deadline.loadAcquire();
+    
+    return deadline >= 0 && QDateTime::currentMSecsSinceEpoch() > deadline;
+}
+
+bool CancellationToken::wasInterrupted() const
+{
+    return m_interrupted.loadAcquire();
+}
+
+void CancellationToken::check() const
+{
+    if(m_cancelled.loadAcquire())
+    {
+        m_interrupted.storeRelease(1);
+        throw OperationCancelled(false);
+    }
+    
+    if(     m_deadline.loadAcquire() >= 0
+        &&  cancellation_check_count++ % deadlineCheckInterval() == 0
+        &&  deadlineExceeded())
+    {
+        m_interrupted.storeRelease(1);
+        throw OperationCancelled(true);
+    }
+}
+
+void CancellationToken::checkNow() const
+{
+    if(isCancelled())
+    {
+        m_interrupted.storeRelease(1);
+        throw OperationCancelled(!m_cancelled.loadAcquire() && deadlineExceeded());
+    }
+}
+
+unsigned int CancellationToken::deadlineCheckInterval()
+{
+    return 64;
+}
+
+CancellationToken* CancellationToken::current()
+{
+    return current_cancellation_token;
+}
+
+void CancellationToken::setCurrent(CancellationToken* token)
+{
+    current_cancellation_token = token;
+}
+
+void CancellationToken::checkCurrent()
+{
+    if(current_cancellation_token != NULL)
+    {
+        current_cancellation_token->check();
+    }
+}
+
+} //end of namespace graipe
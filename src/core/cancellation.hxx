@@ -0,0 +1,210 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef GRAIPE_CORE_CANCELLATION_HXX
+#define GRAIPE_CORE_CANCELLATION_HXX
+
+#include "core/config.hxx"
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QDateTime>
+
+#include <exception>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *
+ * @file
+ * @brief Header file for the cooperative cancellation of long running computations
+ */
+
+/**
+ * This exception is thrown by CancellationToken::check(), if the computation
+ * has been cancelled or its deadline has been exceeded. Since it inherits
+ * from std::exception, the usual error handling of the Algorithms' run()
+ * methods will catch it, release the models' locks and report the reason
+ * by means of an error message.
+ */
+class GRAIPE_CORE_EXPORT OperationCancelled
+:   public std::exception
+{
+    public:
+        /**
+         * Creates a new exception.
+         *
+         * \param deadline_exceeded True, if the deadline caused the cancellation.
+         */
+        OperationCancelled(bool deadline_exceeded=false);
+    
+        /**
+         * Returns the reason of the cancellation.
+         *
+         * \return A human-readable reason.
+         */
+        const char* what() const noexcept override;
+    
+    private:
+        /** True, if the deadline caused the cancellation **/
+        bool m_deadline_exceeded;
+};
+
+/**
+ * A CancellationToken allows to stop long running computations cooperatively.
+ * It may be cancelled (from any thread) or get a deadline. The computation
+ * itself regularly calls check() or the static checkCurrent(), which throw
+ * an OperationCancelled exception, if the computation shall stop.
+ *
+ * Each thread has a current token. Algorithm::execute() sets the algorithm's
+ * token as current token of the running thread, and the Scheduler passes
+ * the current token on to all tasks submitted from that thread. Thus, kernels
+ * (e.g. iteration loops or parallel tiles) may use checkCurrent() without
+ * knowing about the Algorithm at all.
+ */
+class GRAIPE_CORE_EXPORT CancellationToken
+{
+    public:
+        /**
+         * Creates a new token, which is neither cancelled nor has a deadline.
+         */
+        CancellationToken();
+    
+        /**
+         * Cancels the computation. Thread-safe.
+         */
+        void cancel();
+    
+        /**
+         * Resets the token to a non-cancelled state without deadline.
+         */
+        void reset();
+    
+        /**
+         * Sets the deadline of the computation. Thread-safe.
+         *
+         * \param deadline The deadline. An invalid QDateTime removes the deadline.
+         */
+        void setDeadline(const QDateTime& deadline);
+    
+        /**
+         * Returns the deadline of the computation.
+         *
+         * \return The deadline or an invalid QDateTime, if there is none.
+         */
+        QDateTime deadline() const;
+    
+        /**
+         * Returns, if the computation shall stop: Either it was cancelled
+         * or the deadline was exceeded.
+         *
+         * \return True, if the computation shall stop.
+         */
+        bool isCancelled() const;
+    
+        /**
+         * Returns, if the deadline has been exceeded.
+         *
+         * \return True, if there is a deadline and it has been exceeded.
+         */
+        bool deadlineExceeded() const;
+    
+        /**
+         * Returns, if check() has ever thrown for this token, i.e. if the
+         * computation was really interrupted.
+         *
+         * \return True, if the computation was interrupted.
+         */
+        bool wasInterrupted() const;
+    
+        /**
+         * Throws an OperationCancelled exception, if the computation shall stop.
+         * Meant for inner loops: The cancellation flag is tested on each call,
+         * but the deadline only on every deadlineCheckInterval()-th call of each
+         * thread, since reading the clock is comparably expensive.
+         */
+        void check() const;
+    
+        /**
+         * Throws an OperationCancelled exception, if the computation shall stop.
+         * Unlike check(), this always compares the deadline to the clock.
+         */
+        void checkNow() const;
+    
+        /**
+         * Returns, how many calls of check() of one thread share one test of
+         * the deadline.
+         *
+         * \return The number of calls.
+         */
+        static unsigned int deadlineCheckInterval();
+    
+        /**
+         * Returns the current token of the calling thread.
+         *
+         * \return The current token or NULL, if there is none.
+         */
+        static CancellationToken* current();
+    
+        /**
+         * Sets the current token of the calling thread.
+         *
+         * \param token The new current token, may be NULL.
+         */
+        static void setCurrent(CancellationToken* token);
+    
+        /**
+         * Calls check() for the current token of the calling thread, if there is one.
+         * Meant to be called inside the inner loops of long running kernels.
+         */
+        static void checkCurrent();
+    
+    private:
+        /** Cancellation flag **/
+        QAtomicInt m_cancelled;
+        /** Deadline in msecs since epoch, or -1 **/
+        QAtomicInteger<qint64> m_deadline;
+        /** Set, once check() has thrown **/
+        mutable QAtomicInt m_interrupted;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_CORE_CANCELLATION_HXX
@@ -48,14 +48,19 @@
 
 #include "core/algorithm.hxx"
 #include "core/basicstatistics.hxx"
+#include "core/binarycontainer.hxx"
+#include "core/cancellation.hxx"
 #include "core/colortables.hxx"
 #include "core/factories.hxx"
+#include "core/framedstream.hxx"
 #include "core/impex.hxx"
 #include "core/logging.hxx"
 #include "core/model.hxx"
 #include "core/module.hxx"
+#include "core/parallel.hxx"
 #include "core/parameters.hxx"
 #include "core/parameterselection.hxx"
+#include "core/scheduler.hxx"
 #include "core/qt_ext.hxx"
 #include "core/serializable.hxx"
 #include "core/updatechecker.hxx"
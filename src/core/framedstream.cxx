@@ -0,0 +1,379 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#include "core/framedstream.hxx"
+
+#include <QMutexLocker>
+#include <QtDebug>
+
+#include <cstring>
+#include <exception>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *     @file
+ *     @brief Implementation file for framed (chunked) streaming over sequential devices
+ * @}
+ */
+
+/** The maximum payload size of one frame **/
+static const qint64 framed_stream_max_frame = 16777216;
+
+/** Time (in ms) to wait for a target to accept pending bytes, before the write fails **/
+static const int framed_stream_timeout = 30000;
+
+/** Maximum number of bytes read at once from a source, if the payload is discarded **/
+static const qint64 framed_stream_discard_size = 1048576;
+
+FramedStreamWriter::FramedStreamWriter(QIODevice* target, qint64 max_pending, QObject* parent)
+:   QIODevice(parent),
+    m_target(target),
+    m_max_pending(max_pending)
+{
+}
+
+FramedStreamWriter::~FramedStreamWriter()
+{
+    close();
+}
+
+bool FramedStreamWriter::isSequential() const
+{
+    return true;
+}
+
+void FramedStreamWriter::close()
+{
+    if(!isOpen())
+    {
+        return;
+    }
+    
+    if(!writeHeader(0) || !waitForTarget(0))
+    {
+        qWarning() << "FramedStreamWriter::close: Could not write the end of the stream:" << m_target->errorString();
+    }
+    QIODevice::close();
+}
+
+void FramedStreamWriter::abort()
+{
+    if(!isOpen())
+    {
+        return;
+    }
+    
+    if(!writeHeader(FramedStreamAbort) || !waitForTarget(0))
+    {
+        qWarning() << "FramedStreamWriter::abort: Could not write the abort marker:" << m_target->errorString();
+    }
+    QIODevice::close();
+}
+
+qint64 FramedStreamWriter::readData(char* /*data*/, qint64 /*maxSize*/)
+{
+    return -1;
+}
+
+qint64 FramedStreamWriter::writeData(const char* data, qint64 maxSize)
+{
+    qint64 written = 0;
+    
+    while(written < maxSize)
+    {
+        const qint64 size = qMin(maxSize - written, framed_stream_max_frame);
+        
+        if(!writeHeader(size) || m_target->write(data + written, size) != size || !waitForTarget(m_max_pending))
+        {
+            setErrorString("Could not write frame to target: " + m_target->errorString());
+            return -1;
+        }
+        written += size;
+    }
+    return maxSize;
+}
+
+bool FramedStreamWriter::writeHeader(quint32 size)
+{
+    const char header[4] = { char(size & 0xFF), char((size >> 8) & 0xFF), char((size >> 16) & 0xFF), char((size >> 24) & 0xFF) };
+    
+    return m_target->write(header, 4) == 4;
+}
+
+bool FramedStreamWriter::waitForTarget(qint64 limit)
+{
+    while(m_target->bytesToWrite() > limit)
+    {
+        if(!m_target->waitForBytesWritten(framed_stream_timeout))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+FramedStreamReader::FramedStreamReader(qint64 capacity, QObject* parent)
+:   QIODevice(parent),
+    m_capacity(capacity),
+    m_chunk_pos(0),
+    m_buffered(0),
+    m_frame_remaining(0),
+    m_finished(false),
+    m_aborted(false),
+    m_closed(false),
+    m_recording(false)
+{
+}
+
+bool FramedStreamReader::isSequential() const
+{
+    return true;
+}
+
+bool FramedStreamReader::atEnd() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    while(m_buffered == 0 && !m_finished && !m_closed)
+    {
+        m_changed.wait(&m_mutex);
+    }
+    return m_buffered == 0 && QIODevice::bytesAvailable() == 0;
+}
+
+qint64 FramedStreamReader::bytesAvailable() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    qint64 available = m_buffered;
+    
+    if(available == 0 && !m_finished && !m_closed)
+    {
+        available = 1;
+    }
+    return available + QIODevice::bytesAvailable();
+}
+
+void FramedStreamReader::close()
+{
+    m_mutex.lock();
+    m_closed = true;
+    m_chunks.clear();
+    m_chunk_pos = 0;
+    m_buffered = 0;
+    m_changed.wakeAll();
+    m_mutex.unlock();
+    
+    QIODevice::close();
+}
+
+bool FramedStreamReader::feed(QIODevice* source)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    while(!m_finished)
+    {
+        //Read the (next) frame header
+        if(m_frame_remaining == 0)
+        {
+            QByteArray header = source->read(4 - m_header.size());
+            
+            if(header.isEmpty())
+            {
+                break;
+            }
+            
+            m_header.append(header);
+            
+            if(m_header.size() < 4)
+            {
+                break;
+            }
+            
+            const uchar* h = reinterpret_cast<const uchar*>(m_header.constData());
+            const quint32 size = h[0] | (h[1] << 8) | (h[2] << 16) | (quint32(h[3]) << 24);
+            m_header.clear();
+            
+            if(size == 0)
+            {
+                m_finished = true;
+            }
+            else if(size == FramedStreamAbort)
+            {
+                qWarning() << "FramedStreamReader::feed: The stream was aborted by the sender.";
+                m_finished = m_aborted = true;
+            }
+            else
+            {
+                m_frame_remaining = size;
+            }
+            m_changed.wakeAll();
+            continue;
+        }
+        
+        //Wait until the reading side caught up
+        while(m_buffered >= m_capacity && !m_closed)
+        {
+            m_changed.wait(&m_mutex);
+        }
+        
+        const qint64 count = qMin(m_frame_remaining, m_closed ? framed_stream_discard_size : m_capacity - m_buffered);
+        QByteArray payload = source->read(count);
+        
+        if(payload.isEmpty())
+        {
+            break;
+        }
+        
+        m_frame_remaining -= payload.size();
+        
+        if(m_recording)
+        {
+            m_recorded.append(payload);
+        }
+        
+        if(!m_closed)
+        {
+            m_buffered += payload.size();
+            m_chunks.append(payload);
+            m_changed.wakeAll();
+        }
+    }
+    
+    return m_finished;
+}
+
+void FramedStreamReader::abort()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    m_finished = m_aborted = true;
+    m_changed.wakeAll();
+}
+
+bool FramedStreamReader::aborted() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return m_aborted;
+}
+
+void FramedStreamReader::setRecording(bool enable)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    m_recording = enable;
+}
+
+QByteArray FramedStreamReader::recording() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return m_recorded;
+}
+
+qint64 FramedStreamReader::readData(char* data, qint64 maxSize)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    qint64 bytesRead = 0;
+    
+    while(bytesRead < maxSize)
+    {
+        while(m_buffered == 0 && !m_finished && !m_closed)
+        {
+            m_changed.wait(&m_mutex);
+        }
+        
+        if(m_buffered == 0)
+        {
+            break;
+        }
+        
+        //Copy from the chunks as received - no need to move the remaining bytes
+        const QByteArray& chunk = m_chunks.front();
+        const qint64 count = qMin(maxSize - bytesRead, qint64(chunk.size() - m_chunk_pos));
+        
+        memcpy(data + bytesRead, chunk.constData() + m_chunk_pos, count);
+        bytesRead += count;
+        m_chunk_pos += count;
+        m_buffered -= count;
+        
+        if(m_chunk_pos == chunk.size())
+        {
+            m_chunks.removeFirst();
+            m_chunk_pos = 0;
+        }
+        m_changed.wakeAll();
+    }
+    
+    if(bytesRead == 0 && m_aborted)
+    {
+        setErrorString("The stream was aborted.");
+        return -1;
+    }
+    return bytesRead;
+}
+
+qint64 FramedStreamReader::writeData(const char* /*data*/, qint64 /*maxSize*/)
+{
+    return -1;
+}
+
+FramedStreamDecoder::FramedStreamDecoder(const std::function<void()>& decode, QObject* parent)
+:   QThread(parent),
+    m_decode(decode)
+{
+}
+
+void FramedStreamDecoder::run()
+{
+    try
+    {
+        m_decode();
+    }
+    catch(std::exception& e)
+    {
+        qWarning() << "FramedStreamDecoder: Decoding failed:" << e.what();
+    }
+    catch(...)
+    {
+        qWarning() << "FramedStreamDecoder: Decoding failed";
+    }
+}
+
+} //end of namespace graipe
@@ -0,0 +1,330 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef GRAIPE_CORE_FRAMEDSTREAM_HXX
+#define GRAIPE_CORE_FRAMEDSTREAM_HXX
+
+#include "core/config.hxx"
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <functional>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *
+ * @file
+ * @brief Header file for framed (chunked) streaming over sequential devices
+ */
+
+/**
+ * Framed streams are used to transfer (compressed) models and algorithms
+ * between the GraipeClient and the GraipeServer without knowing or
+ * buffering the complete payload in advance. A stream is a sequence of
+ * frames, each one prefixed by its size:
+ * \verbatim
+   payload size                                      quint32, little endian
+   payload                                           payload size bytes
+   \endverbatim
+ * A frame of size 0 marks the end of the stream, a frame of size
+ * FramedStreamAbort means, that the sender failed and the stream is invalid.
+ */
+static const quint32 FramedStreamAbort = 0xFFFFFFFF;
+
+/**
+ * The FramedStreamWriter is a write-only QIODevice, which writes everything
+ * as frames to a target device (e.g. a QTcpSocket). If the target buffers
+ * more than a given number of bytes, each write waits until the target has
+ * written them out. This keeps the memory footprint of a transfer constant.
+ *
+ * The end frame is written on close().
+ */
+class GRAIPE_CORE_EXPORT FramedStreamWriter
+:   public QIODevice
+{
+    Q_OBJECT
+    
+    public:
+        /**
+         * Creates a new framed writer on a given target.
+         *
+         * \param target      The device, the frames will be written to. Needs to be open.
+         * \param max_pending Maximum number of bytes pending at the target before writes wait.
+         * \param parent      The parent QObject.
+         */
+        FramedStreamWriter(QIODevice* target, qint64 max_pending = 8388608, QObject* parent = NULL);
+    
+        /**
+         * Destructor, closes the stream if still open.
+         */
+        ~FramedStreamWriter();
+    
+        /**
+         * The stream is sequential.
+         *
+         * \return Always true.
+         */
+        bool isSequential() const override;
+    
+        /**
+         * Writes the end frame and closes the stream. The target will
+         * stay open.
+         */
+        void close() override;
+    
+        /**
+         * Marks the stream as invalid at the receiver and closes it.
+         */
+        void abort();
+    
+    protected:
+        /**
+         * Not supported.
+         *
+         * \return Always -1.
+         */
+        qint64 readData(char* data, qint64 maxSize) override;
+    
+        /**
+         * Writes the given data as one or more frames to the target.
+         *
+         * \param data    The data to be written.
+         * \param maxSize The size of the data in bytes.
+         * \return maxSize, if the data was written, else -1.
+         */
+        qint64 writeData(const char* data, qint64 maxSize) override;
+    
+        /**
+         * Writes a frame header and waits, if the target has too much data pending.
+         *
+         * \param size The size of the following payload (or a control value).
+         * \return True, if the header was written.
+         */
+        bool writeHeader(quint32 size);
+    
+        /**
+         * Waits until the target has no more than a given number of bytes pending.
+         *
+         * \param limit The number of bytes, which may stay pending.
+         * \return False, if the target failed.
+         */
+        bool waitForTarget(qint64 limit);
+    
+    private:
+        /** The target device **/
+        QIODevice* m_target;
+        /** Maximum number of pending bytes **/
+        qint64 m_max_pending;
+};
+
+/**
+ * The FramedStreamReader is a read-only, sequential QIODevice, which is fed
+ * with frames from one thread (e.g. the thread owning a QTcpSocket) and
+ * read by another one (e.g. a FramedStreamDecoder, which decompresses and
+ * deserializes the payload while it is still arriving).
+ *
+ * In contrast to sockets, reads block until the requested number of bytes
+ * arrived or the stream ended. Thus, the reader behaves like a file for
+ * QIOCompressor and QXmlStreamReader. Feeding blocks, if the reader
+ * holds more than a given number of unread bytes. Once the reading side
+ * closes the device, all further payload is discarded.
+ */
+class GRAIPE_CORE_EXPORT FramedStreamReader
+:   public QIODevice
+{
+    Q_OBJECT
+    
+    public:
+        /**
+         * Creates a new framed reader.
+         *
+         * \param capacity Maximum number of unread bytes, before feeding blocks.
+         * \param parent   The parent QObject.
+         */
+        FramedStreamReader(qint64 capacity = 8388608, QObject* parent = NULL);
+    
+        /**
+         * The stream is sequential.
+         *
+         * \return Always true.
+         */
+        bool isSequential() const override;
+    
+        /**
+         * Waits until either data is available or the stream ended.
+         *
+         * \return True, if the stream ended and all data has been read.
+         */
+        bool atEnd() const override;
+    
+        /**
+         * Returns the number of bytes, which may be read. As long as the stream
+         * has not ended, at least one byte is reported, since reads will block.
+         *
+         * \return The number of bytes available.
+         */
+        qint64 bytesAvailable() const override;
+    
+        /**
+         * Closes the reading side. Wakes up the feeding side and discards all
+         * following payload.
+         */
+        void close() override;
+    
+        /**
+         * Feeds all frame data, which is currently available at a source device,
+         * into the stream. Never reads beyond the end frame, so that following
+         * messages stay at the source. To be called by the feeding thread only.
+         *
+         * \param source The source device, e.g. a QTcpSocket.
+         * \return True, if the stream is complete (ended or aborted).
+         */
+        bool feed(QIODevice* source);
+    
+        /**
+         * Ends the stream prematurely, e.g. after a disconnection. Pending
+         * reads will fail.
+         */
+        void abort();
+    
+        /**
+         * Returns, if the stream ended regularly or was aborted.
+         *
+         * \return True, if the stream was aborted by any side.
+         */
+        bool aborted() const;
+    
+        /**
+         * Enables or disables the recording of the complete payload, e.g. to
+         * keep the stream for later use. To be set before feeding starts.
+         *
+         * \param enable If true, all payload fed will be recorded.
+         */
+        void setRecording(bool enable);
+    
+        /**
+         * Returns the recorded payload, even if already read or discarded.
+         *
+         * \return The recorded payload of the stream.
+         */
+        QByteArray recording() const;
+    
+    protected:
+        /**
+         * Reads data from the stream. Blocks until maxSize bytes have arrived
+         * or the stream ended.
+         *
+         * \param data    The target of the read.
+         * \param maxSize The maximum number of bytes to be read.
+         * \return The number of bytes read or -1 at the end of the stream.
+         */
+        qint64 readData(char* data, qint64 maxSize) override;
+    
+        /**
+         * Not supported.
+         *
+         * \return Always -1.
+         */
+        qint64 writeData(const char* data, qint64 maxSize) override;
+    
+    private:
+        /** Maximum number of unread bytes **/
+        qint64 m_capacity;
+        /** Unread payload, as received, and the read position in the first chunk **/
+        QList<QByteArray> m_chunks;
+        int m_chunk_pos;
+        /** Number of unread bytes **/
+        qint64 m_buffered;
+        /** Partially received frame header **/
+        QByteArray m_header;
+        /** Remaining payload of the current frame **/
+        qint64 m_frame_remaining;
+        /** State of the stream **/
+        bool m_finished, m_aborted, m_closed;
+        /** Recording of the complete payload, if enabled **/
+        bool m_recording;
+        QByteArray m_recorded;
+    
+        /** Synchronization of both sides **/
+        mutable QMutex m_mutex;
+        mutable QWaitCondition m_changed;
+};
+
+/**
+ * The FramedStreamDecoder is a thread, which is owned by a connection and
+ * reads (decompresses and deserializes) a FramedStreamReader while the
+ * connection feeds it. Since reading blocks until the frames arrive, it must
+ * not run in the Scheduler: A slow client would block a worker of the shared
+ * pool and the feeding side might wait for a decoding job queued behind long
+ * running Algorithms. Only the CPU-bound decompression of gzip blocks may
+ * still be handed to the Scheduler by the decoding function.
+ */
+class GRAIPE_CORE_EXPORT FramedStreamDecoder
+:   public QThread
+{
+    public:
+        /**
+         * Creates a new decoder thread. It has to be started by start().
+         *
+         * \param decode The decoding function, which reads the stream.
+         * \param parent The parent QObject.
+         */
+        FramedStreamDecoder(const std::function<void()>& decode, QObject* parent = NULL);
+    
+    protected:
+        /**
+         * Calls the decoding function. Exceptions are logged and dropped.
+         */
+        void run() override;
+    
+    private:
+        /** The decoding function **/
+        std::function<void()> m_decode;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_CORE_FRAMEDSTREAM_HXX
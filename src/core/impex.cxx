@@ -37,7 +37,9 @@
 #include "core/workspace.hxx"
 
 #include <QFile>
+#include <QSaveFile>
 #include "core/qt_ext/qiocompressor.hxx"
+#include "core/binarycontainer.hxx"
 #include "core/factories.hxx"
 
 #include "core/parameters/longstringparameter.hxx"
@@ -59,12 +61,35 @@ QIODevice* Impex::openFile(const QString & filename, QIODevice::OpenModeFlag ope
     
     if(!filename.isEmpty())
     {
-        QFile* file = new QFile(filename);
-        
-        if(compress)
+        if(BinaryContainer::isContainerFile(filename))
+        {
+            //Images may have mapped the file we are overwriting, thus write
+            //into a temporary file, which replaces the target on success.
+            QFileDevice* file = NULL;
+            
+            if(openMode & QIODevice::WriteOnly)
+            {
+                file = new QSaveFile(filename);
+            }
+            else
+            {
+                file = new QFile(filename);
+            }
+            
+            BinaryContainer* container = new BinaryContainer(file);
+            file->setParent(container);
+            
+            if (container->open(openMode))
+            {
+                device = container;
+            }
+        }
+        else if(compress)
         {
+            QFile* file = new QFile(filename);
             QIOCompressor* compressor = new QIOCompressor(file);
             compressor->setStreamFormat(QIOCompressor::GzipFormat);
+            compressor->setParallelBlockSize(QIOCompressor::DefaultParallelBlockSize);
 
             if (compressor->open(openMode))
             {
@@ -73,6 +98,8 @@ QIODevice* Impex::openFile(const QString & filename, QIODevice::OpenModeFlag ope
         }
         else
         {
+            QFile* file = new QFile(filename);
+            
             if(file->open(openMode))
             {
                 device = file;
@@ -88,6 +115,13 @@ bool Impex::save(Serializable * object, const QString & filename, bool compress)
     
 	if (device != NULL)
     {
+        //Binary containers compress their chunks instead of the whole file
+        BinaryContainer* container = qobject_cast<BinaryContainer*>(device);
+        if(container != NULL)
+        {
+            container->setCompression(compress);
+        }
+        
         QXmlStreamWriter xmlWriter(device);
         object->serialize(xmlWriter);
 		device->close();
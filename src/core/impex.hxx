@@ -83,6 +83,9 @@ class GRAIPE_CORE_EXPORT Impex
 	public:
         /**
          * Basic open procedure for compressed and uncompressed files.
+         * The type is selected by means of the file extension: Files ending
+         * with "gz" are GZip compressed, files ending with ".xbin" are
+         * BinaryContainers, all others are read/written as they are.
          *
          * \param filename The filename of the stored object.
          * \param openMode An openind mode, read/write-only etc.
@@ -95,7 +98,8 @@ class GRAIPE_CORE_EXPORT Impex
          *
          * \param object   The object, which shall be serialized.
          * \param filename The filename, where the object shall be stored.
-         * \param compress If true, the file will be read using the GZip decompressor.
+         * \param compress If true, the chunks of a BinaryContainer will be compressed.
+         *                 Other files are compressed by means of their extension.
          * \return True, if the storage of the object was successful.
          */
 		static bool save(Serializable * object, const QString & filename, bool compress=true);
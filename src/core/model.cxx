@@ -34,6 +34,7 @@
 /************************************************************************/
 
 #include "core/model.hxx"
+#include "core/algorithm.hxx"
 #include "core/impex.hxx"
 #include "core/parameters.hxx"
 #include "core/workspace.hxx"
@@ -43,6 +44,8 @@
 
 #include <QtDebug>
 #include <QXmlStreamWriter>
+#include <QCryptographicHash>
+#include <QIODevice>
 
 namespace graipe {
 
@@ -81,7 +84,12 @@ Model::Model(Workspace* wsp)
     connect(m_parameters, SIGNAL(valueChanged()), this, SLOT(updateModel()));
     
     //Add to global Models list
+    workspace()->models_mutex.lock();
     workspace()->models.push_back(this);
+    workspace()->models_mutex.unlock();
+    
+    //Let a running algorithm know about its (partial) results
+    Algorithm::trackModel(this);
 }
 
 Model::Model(const Model& model)
@@ -107,7 +115,12 @@ Model::Model(const Model& model)
     connect(m_parameters, SIGNAL(valueChanged()), this, SLOT(updateModel()));
     
     //Add to global Models list
+    workspace()->models_mutex.lock();
     workspace()->models.push_back(this);
+    workspace()->models_mutex.unlock();
+    
+    //Let a running algorithm know about its (partial) results
+    Algorithm::trackModel(this);
 }
 
 Model::~Model()
@@ -116,7 +129,11 @@ Model::~Model()
     delete m_parameters;
     
     //Remove from global models list
+    workspace()->models_mutex.lock();
     workspace()->models.erase(std::remove(workspace()->models.begin(), workspace()->models.end(), this), workspace()->models.end());
+    workspace()->models_mutex.unlock();
+    
+    Algorithm::untrackModel(this);
 }
 
 QString Model::name() const
@@ -342,6 +359,64 @@ void Model::copyData(Model& other) const
 	}
 }
 
+/**
+ * Small helper device, which hashes everything written to it
+ * instead of storing it.
+ */
+class ModelHashDevice
+:   public QIODevice
+{
+    public:
+        ModelHashDevice()
+        :   m_hash(QCryptographicHash::Sha256)
+        {
+        }
+    
+        QByteArray result() const
+        {
+            return m_hash.result();
+        }
+    
+    protected:
+        qint64 readData(char* /*data*/, qint64 /*maxSize*/)
+        {
+            return -1;
+        }
+    
+        qint64 writeData(const char* data, qint64 maxSize)
+        {
+            //QCryptographicHash only adds int-sized blocks
+            for(qint64 pos=0; pos<maxSize; pos+=1073741824)
+            {
+                m_hash.addData(data + pos, (int)qMin(maxSize - pos, qint64(1073741824)));
+            }
+            return maxSize;
+        }
+    
+    private:
+        QCryptographicHash m_hash;
+};
+
+QByteArray Model::contentHash() const
+{
+    ModelHashDevice device;
+    device.open(QIODevice::WriteOnly);
+    
+    //Same as serialize(), but without the ID
+    QXmlStreamWriter xmlWriter(&device);
+    xmlWriter.writeStartElement(typeName());
+        xmlWriter.writeStartElement("Header");
+            serialize_header(xmlWriter);
+        xmlWriter.writeEndElement();
+        xmlWriter.writeStartElement("Content");
+            serialize_content(xmlWriter);
+        xmlWriter.writeEndElement();
+    xmlWriter.writeEndElement();
+    
+    device.close();
+    return device.result();
+}
+
 void Model::serialize(QXmlStreamWriter& xmlWriter) const
 {
     xmlWriter.setAutoFormatting(true);
@@ -39,6 +39,7 @@
 #include "core/config.hxx"
 #include "core/serializable.hxx"
 
+#include <QByteArray>
 #include <QString>
 #include <QVector>
 #include <QTransform>
@@ -369,6 +370,16 @@ class GRAIPE_CORE_EXPORT Model
          */
         void serialize(QXmlStreamWriter& xmlWriter) const;
     
+        /**
+         * Computes a hash of the Model's data, which is independent of the
+         * Model's ID. Two Models with the same type, header and content
+         * will thus have the same hash, which may be used to identify
+         * Models without transferring them (e.g. in the GraipeServer).
+         *
+         * \return The SHA-256 hash of the type, the header and the content.
+         */
+        QByteArray contentHash() const;
+    
         /**
          * This function deserializes the model by means of its header and content
          *
@@ -0,0 +1,208 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include "core/parallel.hxx"
+#include "core/scheduler.hxx"
+#include "core/cancellation.hxx"
+#include "core/algorithm.hxx"
+
+#include <QAtomicInt>
+
+#include <algorithm>
+#include <exception>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *     @file
+ *     @brief Implementation file for the parallel band/tile execution helpers
+ * @}
+ */
+
+std::vector<BandTile> splitIntoTiles(unsigned int bands,
+                                     unsigned int width, unsigned int height,
+                                     int halo, unsigned int tasks)
+{
+    std::vector<BandTile> tiles;
+    
+    //How many stripes per band?
+    unsigned int stripes = 1;
+    
+    if(halo >= 0 && bands != 0 && bands < tasks)
+    {
+        unsigned int min_rows = std::max(64, halo);
+        
+        stripes = (tasks + bands - 1)/bands;
+        stripes = std::min(stripes, std::max(height/min_rows, 1u));
+    }
+    
+    for(unsigned int b=0; b!=bands; ++b)
+    {
+        for(unsigned int s=0; s!=stripes; ++s)
+        {
+            int top    = (int)(s*height/stripes);
+            int bottom = (int)((s+1)*height/stripes);
+            
+            BandTile tile;
+            tile.band  = b;
+            tile.inner = QRect(0, top, width, bottom-top);
+            
+            if(stripes == 1)
+            {
+                tile.outer = tile.inner;
+            }
+            else
+            {
+                int outer_top    = std::max(top - halo, 0);
+                int outer_bottom = std::min(bottom + halo, (int)height);
+                
+                tile.outer = QRect(0, outer_top, width, outer_bottom-outer_top);
+            }
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
+
+std::vector<BandTile> splitIntoBlocks(unsigned int width, unsigned int height,
+                                      unsigned int block_size, unsigned int halo,
+                                      unsigned int alignment)
+{
+    std::vector<BandTile> tiles;
+    
+    alignment  = std::max(alignment, 1u);
+    block_size = std::max((block_size + alignment - 1)/alignment, 1u)*alignment;
+    
+    //Round the halo up, too, so that the outer regions stay aligned
+    halo = (halo + alignment - 1)/alignment*alignment;
+    
+    for(unsigned int top=0; top < height; top += block_size)
+    {
+        for(unsigned int left=0; left < width; left += block_size)
+        {
+            unsigned int right  = std::min(left + block_size, width),
+                         bottom = std::min(top + block_size, height);
+            
+            int outer_left   = std::max(int(left) - int(halo), 0),
+                outer_top    = std::max(int(top)  - int(halo), 0),
+                outer_right  = (int)std::min(right  + halo, width),
+                outer_bottom = (int)std::min(bottom + halo, height);
+            
+            BandTile tile;
+            tile.band  = 0;
+            tile.inner = QRect(left, top, right-left, bottom-top);
+            tile.outer = QRect(outer_left, outer_top, outer_right-outer_left, outer_bottom-outer_top);
+            
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
+
+void parallelFor(unsigned int count,
+                 const std::function<void(unsigned int)>& f,
+                 const std::function<void(float)>& progress)
+{
+    Scheduler* scheduler = Scheduler::instance();
+    
+    std::vector<qint64> jobs;
+    jobs.reserve(count);
+    
+    QAtomicInt done(0);
+    QAtomicInt failed(0);
+    QMutex error_mutex;
+    std::exception_ptr error;
+    
+    //Run all calls in the context of the calling thread, such that models
+    //created by them are tracked and cancellation checks work there, too
+    Algorithm* algorithm = Algorithm::current();
+    CancellationToken* token = CancellationToken::current();
+    
+    for(unsigned int i=0; i!=count; ++i)
+    {
+        jobs.push_back(scheduler->submit([&, i]()
+                                         {
+                                             Algorithm* last_algorithm = Algorithm::current();
+                                             CancellationToken* last_token = CancellationToken::current();
+                                             
+                                             Algorithm::setCurrent(algorithm);
+                                             CancellationToken::setCurrent(token);
+                                             
+                                             try
+                                             {
+                                                 //Skip the remaining items after the first error
+                                                 if(!failed.loadAcquire())
+                                                 {
+                                                     CancellationToken::checkCurrent();
+                                                     
+                                                     f(i);
+                                                     
+                                                     int finished = done.fetchAndAddOrdered(1) + 1;
+                                                     
+                                                     if(progress)
+                                                     {
+                                                         progress(finished*100.0f/count);
+                                                     }
+                                                 }
+                                             }
+                                             catch(...)
+                                             {
+                                                 QMutexLocker locker(&error_mutex);
+                                                 if(!error)
+                                                 {
+                                                     error = std::current_exception();
+                                                 }
+                                                 failed.storeRelease(1);
+                                             }
+                                             
+                                             Algorithm::setCurrent(last_algorithm);
+                                             CancellationToken::setCurrent(last_token);
+                                         }));
+    }
+    
+    for(qint64 job_id : jobs)
+    {
+        scheduler->waitForJob(job_id);
+    }
+    
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+}//end of namespace graipe
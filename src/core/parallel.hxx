@@ -0,0 +1,136 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_CORE_PARALLEL_HXX
+#define GRAIPE_CORE_PARALLEL_HXX
+
+#include "core/config.hxx"
+
+#include <QRect>
+
+#include <vector>
+#include <functional>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *
+ * @file
+ * @brief Header file for the parallel band/tile execution helpers
+ */
+
+/**
+ * A tile of one band of a rastered model. Each tile consists of an inner
+ * region, which is written into the result, and an outer region, which
+ * additionally contains a halo of neighbouring pixels needed to compute
+ * the inner region exactly (e.g. half of a filter's window size).
+ *
+ * If a band is not split, inner and outer region are both the full band.
+ */
+struct GRAIPE_CORE_EXPORT BandTile
+{
+    /** The band index of this tile **/
+    unsigned int band;
+    /** The region including the halo (in band coordinates) **/
+    QRect outer;
+    /** The region, which is written into the result (in band coordinates) **/
+    QRect inner;
+};
+
+/**
+ * Splits all bands of a rastered model into tiles for the parallel processing.
+ * If there are less bands than tasks wanted, each band will be split into
+ * horizontal stripes, which overlap by the given halo. Stripes will never
+ * be thinner than 64 rows or the halo itself.
+ *
+ * \param bands  The number of bands.
+ * \param width  The width of each band.
+ * \param height The height of each band.
+ * \param halo   The number of pixels needed around each pixel to compute it exactly.
+ *               Use a negative value, if the bands must not be split at all (e.g. 
+ *               for recursive or iterative filters).
+ * \param tasks  The number of tasks wanted, usually the number of threads.
+ * \return A vector of tiles covering all bands.
+ */
+GRAIPE_CORE_EXPORT std::vector<BandTile> splitIntoTiles(unsigned int bands,
+                                                        unsigned int width, unsigned int height,
+                                                        int halo, unsigned int tasks);
+
+/**
+ * Splits one band into square blocks of (at most) the given size for an
+ * out-of-core or tiled processing. Each block's outer region extends the
+ * inner region by the halo, clipped at the band's borders.
+ *
+ * If an alignment is given, the inner and outer regions will start at
+ * multiples of it (where not clipped), e.g. to keep the sampling grid of
+ * image pyramids identical to the one of the whole band.
+ *
+ * \param width      The width of the band.
+ * \param height     The height of the band.
+ * \param block_size The size (width and height) of each block's inner region.
+ * \param halo       The number of pixels needed around each pixel to compute it exactly.
+ * \param alignment  The alignment of the regions' upper left corners. Defaults to 1.
+ * \return A vector of tiles of band 0 covering the band row by row.
+ */
+GRAIPE_CORE_EXPORT std::vector<BandTile> splitIntoBlocks(unsigned int width, unsigned int height,
+                                                         unsigned int block_size, unsigned int halo,
+                                                         unsigned int alignment = 1);
+
+/**
+ * Runs a function for each index 0...count-1 in parallel on the shared
+ * Scheduler and waits until all calls have finished. The first exception
+ * thrown by any call will be rethrown in the calling thread, the calls, which
+ * have not yet been started, are skipped then. Each call runs with the current
+ * Algorithm and CancellationToken of the calling thread, and the token is
+ * checked before each call.
+ *
+ * \param count    The number of calls.
+ * \param f        The function to be called with each index.
+ * \param progress Optional callback, which is informed about the overall progress
+ *                 (0...100%) after each finished call. Called from the worker threads.
+ */
+GRAIPE_CORE_EXPORT void parallelFor(unsigned int count,
+                                    const std::function<void(unsigned int)>& f,
+                                    const std::function<void(float)>& progress = std::function<void(float)>());
+
+/**
+ * @}
+ */
+
+}//end of namespace graipe
+
+#endif //GRAIPE_CORE_PARALLEL_HXX
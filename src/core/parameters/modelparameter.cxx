@@ -54,10 +54,10 @@ ModelParameter::ModelParameter(const QString &name, QString type_filter, Paramet
     m_delegate(NULL),
     m_type_filter(type_filter)
 {
-    if(wsp!= NULL && wsp->models.size())
+    if(wsp != NULL)
 	{
-		m_allowed_values.clear();
-		
+        QMutexLocker locker(&wsp->models_mutex);
+        
 		for(Model * model: wsp->models)
 		{
 			if(m_type_filter.isEmpty() || m_type_filter.contains(model->typeName()))
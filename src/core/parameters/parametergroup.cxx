@@ -212,25 +212,25 @@ bool ParameterGroup::deserialize(QXmlStreamReader& xmlReader)
                     {
                         int parameter_count = xmlReader.readElementText().toInt();
                         
-                        if(parameter_count != m_parameters.size())
-                        {
-                            throw std::runtime_error("Parameter count mismatch");
-                        }
-                        
+                        //Match the parameters by their IDs: Parameters, which are not
+                        //stored (e.g. added after saving), keep their default values and
+                        //stored parameters, which are unknown (e.g. removed), are skipped.
                         for (int i=0; i!= parameter_count; ++i)
                         {
                             xmlReader.readNextStartElement();
                             
-                            if(xmlReader.attributes().hasAttribute("ID"))
+                            QString id = xmlReader.attributes().value("ID").toString();
+                            storage_type::iterator iter = m_parameters.find(id);
+                            
+                            if(iter == m_parameters.end())
                             {
-                                QString id = xmlReader.attributes().value("ID").toString();
-                               
-                                if(!m_parameters[id]->deserialize(xmlReader))
-                                {
-                                    throw std::runtime_error("Could not deserialize ID: " + id.toStdString());
-                                }
+                                qWarning() << "ParameterGroup::deserialize: Skipping unknown parameter ID:" << id;
+                                xmlReader.skipCurrentElement();
+                            }
+                            else if(!iter->second->deserialize(xmlReader))
+                            {
+                                throw std::runtime_error("Could not deserialize ID: " + id.toStdString());
                             }
-
                         }                            
                         //Read until </ParameterGroup> comes...
                         while(true)
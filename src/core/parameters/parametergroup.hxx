@@ -228,6 +228,9 @@ class GRAIPE_CORE_EXPORT ParameterGroup
     
         /**
          * Deserialization of a parameter's state from an xml file.
+         * The stored parameters are matched by their IDs. Thus, parameters,
+         * which are missing in the xml file, keep their current (default) values
+         * and unknown ones are skipped. This keeps older files loadable.
          *
          * \param xmlReader The QXmlStreamReader, where we read from.
          * \return True, if the deserialization was successful, else false.
@@ -80,9 +80,13 @@
 ****************************************************************************/
 
 #include "qiocompressor.hxx"
+#include "core/scheduler.hxx"
 #include "zlib.h"
 #include <QtCore/QDebug>
 
+#include <cstring>
+#include <deque>
+
 namespace graipe {
 
 /**
@@ -98,6 +102,9 @@ typedef Bytef ZlibByte;
 /** internal type for sizes: uInt **/
 typedef uInt ZlibSize;
 
+/** Size of the gzip header of indexed members: 10 bytes + XLEN + 8 bytes extra field **/
+static const int IndexedHeaderSize = 20;
+
 
 /**
  * Pirvate/Hidden implementation of the QIOCompressor's internal magic
@@ -159,6 +166,102 @@ public:
      * \param zlibErrorCode The zlib Error Code
      */
     void setZlibError(const QString &errorMessage, int zlibErrorCode);
+    
+    /**
+     * One block of the block-parallel gzip mode. Each block will become
+     * an independent gzip member of the stream.
+     */
+    struct ParallelBlock
+    {
+        /** The id of the Scheduler job, which (de-)compresses this block **/
+        qint64 job;
+        /** Uncompressed data (writing) or compressed member (reading) **/
+        QByteArray input;
+        /** Compressed member (writing) or uncompressed data (reading) **/
+        QByteArray output;
+        /** Current read position inside the output **/
+        int pos;
+        /** True, if the (de-)compression was successful **/
+        bool ok;
+    };
+    
+    /**
+     * Is the block-parallel gzip mode enabled?
+     *
+     * \return True, if the stream is gzip and a block size has been set.
+     */
+    bool isParallel() const;
+    
+    /**
+     * Submits a block of uncompressed data to be compressed in parallel.
+     *
+     * \param data The uncompressed data of the block.
+     */
+    void submitBlock(const QByteArray& data);
+    
+    /**
+     * Writes the compressed blocks in order to the underlying device
+     * until at most keep blocks are left in flight.
+     *
+     * \param keep The number of blocks, which may remain in flight.
+     * \return True, if successful, else false.
+     */
+    bool writeBlocks(unsigned int keep);
+    
+    /**
+     * Reads indexed members ahead from the underlying device and submits
+     * them to be decompressed in parallel.
+     *
+     * \return True, if successful, else false.
+     */
+    bool readAheadBlocks();
+    
+    /**
+     * Reads the decompressed data of the indexed members in order.
+     *
+     * \param data    Byte pointer to the data.
+     * \param maxSize The max length to be read.
+     * \return The length of the read data, 0 if there are no more indexed members, -1 on error.
+     */
+    qint64 readBlocks(char* data, qint64 maxSize);
+    
+    /**
+     * Cancels or waits for all blocks in flight and removes them.
+     */
+    void clearBlocks();
+    
+    /**
+     * Checks, if the next member on the underlying device carries an index.
+     *
+     * \return True, if the next member has been written in block-parallel mode.
+     */
+    bool nextMemberIndexed();
+    
+    /**
+     * Checks, if another gzip member follows in the input.
+     *
+     * \return True, if the next bytes are a gzip magic.
+     */
+    bool nextMemberFollows();
+    
+    /**
+     * Compresses a block into a complete gzip member with an index.
+     *
+     * \param input  The uncompressed data.
+     * \param output The gzip member.
+     * \param level  The compression level.
+     * \return True, if successful, else false.
+     */
+    static bool compressMember(const QByteArray& input, QByteArray& output, int level);
+    
+    /**
+     * Decompresses a complete gzip member.
+     *
+     * \param input  The gzip member.
+     * \param output The uncompressed data.
+     * \return True, if successful, else false.
+     */
+    static bool decompressMember(const QByteArray& input, QByteArray& output);
 
     /**
      * @{ 
@@ -172,6 +275,10 @@ public:
     ZlibByte *buffer;
     State state;
     QIOCompressor::StreamFormat streamFormat;
+    int parallelBlockSize;
+    bool indexed;
+    QByteArray pendingBlock;
+    std::deque<ParallelBlock*> blocks;
     /**
      * @}
      */
@@ -185,6 +292,8 @@ QIOCompressorPrivate::QIOCompressorPrivate(QIOCompressor *q_ptr, QIODevice *devi
 ,buffer(new ZlibByte[bufferSize])
 ,state(Closed)
 ,streamFormat(QIOCompressor::ZlibFormat)
+,parallelBlockSize(0)
+,indexed(false)
 {
     // Use default zlib memory management.
     zlibStream.zalloc = Z_NULL;
@@ -271,6 +380,229 @@ void QIOCompressorPrivate::setZlibError(const QString &errorMessage, int zlibErr
 
 
 
+bool QIOCompressorPrivate::isParallel() const
+{
+    return parallelBlockSize > 0 && streamFormat == QIOCompressor::GzipFormat;
+}
+
+void QIOCompressorPrivate::submitBlock(const QByteArray& data)
+{
+    ParallelBlock* block = new ParallelBlock;
+    block->input = data;
+    block->pos = 0;
+    block->ok = false;
+    
+    const int level = compressionLevel;
+    
+    block->job = Scheduler::instance()->submit([block, level](){ block->ok = compressMember(block->input, block->output, level); });
+    blocks.push_back(block);
+}
+
+bool QIOCompressorPrivate::writeBlocks(unsigned int keep)
+{
+    Q_Q(QIOCompressor);
+    
+    while (blocks.size() > keep) {
+        ParallelBlock* block = blocks.front();
+        blocks.pop_front();
+        
+        Scheduler::instance()->waitForJob(block->job);
+        
+        bool ok = block->ok;
+        
+        if (!ok)
+            q->setErrorString(QT_TRANSLATE_NOOP("QIOCompressor", "Internal zlib error when compressing a block."));
+        else
+            ok = writeBytes(reinterpret_cast<ZlibByte *>(block->output.data()), block->output.size());
+        
+        delete block;
+        
+        if (!ok) {
+            state = QIOCompressorPrivate::Error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool QIOCompressorPrivate::readAheadBlocks()
+{
+    const unsigned int maxBlocks = 2*Scheduler::instance()->threadCount();
+    
+    while (blocks.size() < maxBlocks && nextMemberIndexed()) {
+        const QByteArray header = device->peek(IndexedHeaderSize);
+        const uchar* h = reinterpret_cast<const uchar *>(header.constData());
+        const quint32 memberSize = h[16] | (h[17] << 8) | (h[18] << 16) | (quint32(h[19]) << 24);
+        
+        ParallelBlock* block = new ParallelBlock;
+        block->input = device->read(memberSize);
+        block->pos = 0;
+        block->ok = false;
+        
+        if ((quint32)block->input.size() != memberSize) {
+            delete block;
+            return false;
+        }
+        
+        block->job = Scheduler::instance()->submit([block](){ block->ok = decompressMember(block->input, block->output); });
+        blocks.push_back(block);
+    }
+    return true;
+}
+
+qint64 QIOCompressorPrivate::readBlocks(char* data, qint64 maxSize)
+{
+    Q_Q(QIOCompressor);
+    
+    qint64 bytesRead = 0;
+    
+    while (bytesRead < maxSize) {
+        if (!readAheadBlocks()) {
+            state = QIOCompressorPrivate::Error;
+            q->setErrorString(QT_TRANSLATE_NOOP("QIOCompressor", "Error reading a block from underlying device: ") + device->errorString());
+            return -1;
+        }
+        
+        if (blocks.empty())
+            break;
+        
+        ParallelBlock* block = blocks.front();
+        Scheduler::instance()->waitForJob(block->job);
+        
+        if (!block->ok) {
+            state = QIOCompressorPrivate::Error;
+            q->setErrorString(QT_TRANSLATE_NOOP("QIOCompressor", "Internal zlib error when decompressing a block."));
+            return -1;
+        }
+        
+        const qint64 count = qMin(maxSize - bytesRead, qint64(block->output.size() - block->pos));
+        memcpy(data + bytesRead, block->output.constData() + block->pos, count);
+        block->pos += count;
+        bytesRead += count;
+        
+        if (block->pos == block->output.size()) {
+            blocks.pop_front();
+            delete block;
+        }
+    }
+    return bytesRead;
+}
+
+void QIOCompressorPrivate::clearBlocks()
+{
+    for (ParallelBlock* block : blocks) {
+        if (!Scheduler::instance()->cancel(block->job))
+            Scheduler::instance()->waitForJob(block->job);
+        delete block;
+    }
+    blocks.clear();
+    pendingBlock.clear();
+    indexed = false;
+}
+
+bool QIOCompressorPrivate::nextMemberIndexed()
+{
+    const QByteArray header = device->peek(IndexedHeaderSize);
+    const uchar* h = reinterpret_cast<const uchar *>(header.constData());
+    
+    // gzip magic, deflate, FEXTRA flag, XLEN=8 and our "GR" subfield of length 4.
+    return header.size() == IndexedHeaderSize
+        && h[0] == 0x1f && h[1] == 0x8b && h[2] == 8 && (h[3] & 4)
+        && h[10] == 8 && h[11] == 0
+        && h[12] == 'G' && h[13] == 'R' && h[14] == 4 && h[15] == 0;
+}
+
+bool QIOCompressorPrivate::nextMemberFollows()
+{
+    char magic[2];
+    
+    if (zlibStream.avail_in >= 2) {
+        magic[0] = zlibStream.next_in[0];
+        magic[1] = zlibStream.next_in[1];
+    } else if (zlibStream.avail_in == 1) {
+        magic[0] = zlibStream.next_in[0];
+        if (device->peek(magic + 1, 1) != 1)
+            return false;
+    } else if (device->peek(magic, 2) != 2) {
+        return false;
+    }
+    return uchar(magic[0]) == 0x1f && uchar(magic[1]) == 0x8b;
+}
+
+bool QIOCompressorPrivate::compressMember(const QByteArray& input, QByteArray& output, int level)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    
+    if (deflateInit2(&stream, level, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    
+    // The extra field "GR" will hold the size of the complete member,
+    // which allows the reader to split the stream without inflating it.
+    Bytef extra[8] = {'G', 'R', 4, 0, 0, 0, 0, 0};
+    
+    gz_header header;
+    memset(&header, 0, sizeof(header));
+    header.os = 255;
+    header.extra = extra;
+    header.extra_len = sizeof(extra);
+    
+    deflateSetHeader(&stream, &header);
+    
+    output.resize(deflateBound(&stream, input.size()) + IndexedHeaderSize);
+    
+    stream.next_in = reinterpret_cast<ZlibByte *>(const_cast<char *>(input.constData()));
+    stream.avail_in = input.size();
+    stream.next_out = reinterpret_cast<ZlibByte *>(output.data());
+    stream.avail_out = output.size();
+    
+    const int status = deflate(&stream, Z_FINISH);
+    const uLong memberSize = stream.total_out;
+    deflateEnd(&stream);
+    
+    if (status != Z_STREAM_END)
+        return false;
+    
+    output.resize(memberSize);
+    
+    uchar* size = reinterpret_cast<uchar *>(output.data()) + 16;
+    size[0] = memberSize & 0xff;
+    size[1] = (memberSize >> 8) & 0xff;
+    size[2] = (memberSize >> 16) & 0xff;
+    size[3] = (memberSize >> 24) & 0xff;
+    
+    return true;
+}
+
+bool QIOCompressorPrivate::decompressMember(const QByteArray& input, QByteArray& output)
+{
+    if (input.size() < IndexedHeaderSize + 8)
+        return false;
+    
+    // The last four bytes of a member hold the uncompressed size.
+    const uchar* t = reinterpret_cast<const uchar *>(input.constData()) + input.size() - 4;
+    const quint32 dataSize = t[0] | (t[1] << 8) | (t[2] << 16) | (quint32(t[3]) << 24);
+    
+    output.resize(dataSize);
+    
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    
+    if (inflateInit2(&stream, 31) != Z_OK)
+        return false;
+    
+    stream.next_in = reinterpret_cast<ZlibByte *>(const_cast<char *>(input.constData()));
+    stream.avail_in = input.size();
+    stream.next_out = reinterpret_cast<ZlibByte *>(output.data());
+    stream.avail_out = dataSize;
+    
+    const int status = inflate(&stream, Z_FINISH);
+    const bool ok = (status == Z_STREAM_END && stream.total_out == dataSize);
+    inflateEnd(&stream);
+    
+    return ok;
+}
+
 QIOCompressor::QIOCompressor(QIODevice* device, int compressionLevel, int bufferSize)
 :d_ptr(new QIOCompressorPrivate(this, device, compressionLevel, bufferSize))
 {}
@@ -302,6 +634,22 @@ QIOCompressor::StreamFormat QIOCompressor::streamFormat() const
     return d->streamFormat;
 }
 
+void QIOCompressor::setParallelBlockSize(int blockSize)
+{
+    Q_D(QIOCompressor);
+    if (isOpen()) {
+        qWarning("QIOCompressor::setParallelBlockSize: must be called before open()");
+        return;
+    }
+    d->parallelBlockSize = qMax(0, blockSize);
+}
+
+int QIOCompressor::parallelBlockSize() const
+{
+    Q_D(const QIOCompressor);
+    return d->parallelBlockSize;
+}
+
 bool QIOCompressor::isGzipSupported()
 {
     return checkGzipSupport(zlibVersion());
@@ -413,6 +761,16 @@ void QIOCompressor::close()
     if (openMode() & ReadOnly) {
         d->state = QIOCompressorPrivate::NotReadFirstByte;
         inflateEnd(&d->zlibStream);
+    } else if (d->isParallel()) {
+        // Compress the last (incomplete) block and write all blocks in order.
+        if (d->state == QIOCompressorPrivate::BytesWritten) {
+            if (!d->pendingBlock.isEmpty())
+                d->submitBlock(d->pendingBlock);
+            d->pendingBlock.clear();
+            d->writeBlocks(0);
+            d->state = QIOCompressorPrivate::NoBytesWritten;
+        }
+        deflateEnd(&d->zlibStream);
     } else {
         if (d->state == QIOCompressorPrivate::BytesWritten) { // Only flush if we have written anything.
             d->state = QIOCompressorPrivate::NoBytesWritten;
@@ -420,6 +778,7 @@ void QIOCompressor::close()
         }
         deflateEnd(&d->zlibStream);
     }
+    d->clearBlocks();
 
     // Close the underlying device if we are managing it.
     if (d->manageDevice)
@@ -435,6 +794,14 @@ void QIOCompressor::flush()
     if (isOpen() == false || openMode() & ReadOnly)
         return;
 
+    if (d->isParallel()) {
+        if (!d->pendingBlock.isEmpty())
+            d->submitBlock(d->pendingBlock);
+        d->pendingBlock.clear();
+        d->writeBlocks(0);
+        return;
+    }
+
     d->flushZlib(Z_SYNC_FLUSH);
 }
 
@@ -478,6 +845,26 @@ qint64 QIOCompressor::readData(char *data, qint64 maxSize)
     if (d->state == QIOCompressorPrivate::Error)
         return -1;
 
+    // Members written in block-parallel mode are decompressed in parallel.
+    if (d->state == QIOCompressorPrivate::NotReadFirstByte && d->isParallel()) {
+        d->indexed = d->nextMemberIndexed();
+        if (d->indexed)
+            d->state = QIOCompressorPrivate::InStream;
+    }
+
+    if (d->indexed) {
+        const qint64 bytesRead = d->readBlocks(data, maxSize);
+        if (bytesRead != 0)
+            return bytesRead;
+
+        // No more indexed members: Continue with the sequential decompression.
+        d->indexed = false;
+        if (!d->nextMemberFollows()) {
+            d->state = QIOCompressorPrivate::EndOfStream;
+            return 0;
+        }
+    }
+
     // We are ging to try to fill the data buffer
     d->zlibStream.next_out = reinterpret_cast<ZlibByte *>(data);
     d->zlibStream.avail_out = maxSize;
@@ -519,6 +906,12 @@ qint64 QIOCompressor::readData(char *data, qint64 maxSize)
                 return 0;
             break;
         }
+
+        // Concatenated gzip members (e.g. written in block-parallel mode) form one stream.
+        if (status == Z_STREAM_END && d->streamFormat == QIOCompressor::GzipFormat && d->nextMemberFollows()) {
+            inflateReset(&d->zlibStream);
+            status = Z_OK;
+        }
     // Loop util data buffer is full or we reach the end of the input stream.
     } while (d->zlibStream.avail_out != 0 && status != Z_STREAM_END);
 
@@ -539,6 +932,48 @@ qint64 QIOCompressor::writeData(const char *data, qint64 maxSize)
     if (maxSize < 1)
         return 0;
     Q_D(QIOCompressor);
+
+    // Collect full blocks and compress them in parallel.
+    if (d->isParallel()) {
+        if (d->state == QIOCompressorPrivate::Error)
+            return -1;
+
+        d->state = QIOCompressorPrivate::BytesWritten;
+
+        const qint64 blockSize = d->parallelBlockSize;
+        const unsigned int inFlight = 2*Scheduler::instance()->threadCount();
+        qint64 offset = 0;
+
+        // Complete the unaligned head from the previous writes
+        if (!d->pendingBlock.isEmpty()) {
+            offset = qMin(maxSize, blockSize - d->pendingBlock.size());
+            d->pendingBlock.append(data, offset);
+
+            if (d->pendingBlock.size() < blockSize)
+                return maxSize;
+
+            d->submitBlock(d->pendingBlock);
+            d->pendingBlock.clear();
+
+            if (!d->writeBlocks(inFlight))
+                return -1;
+        }
+
+        // Submit full blocks directly from the data
+        while (maxSize - offset >= blockSize) {
+            d->submitBlock(QByteArray(data + offset, blockSize));
+            offset += blockSize;
+
+            // Limit the number of blocks in flight
+            if (!d->writeBlocks(inFlight))
+                return -1;
+        }
+
+        // Keep the unaligned tail for the next writes
+        d->pendingBlock.append(data + offset, maxSize - offset);
+        return maxSize;
+    }
+
     d->zlibStream.next_in = reinterpret_cast<ZlibByte *>(const_cast<char *>(data));
     d->zlibStream.avail_in = maxSize;
 
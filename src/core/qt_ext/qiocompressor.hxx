@@ -195,6 +195,35 @@ public:
     */
     StreamFormat streamFormat() const;
     
+    /*!
+        Enables the block-parallel mode for the GzipFormat if \a blockSize is larger than 0.
+
+        When writing, the data is split into blocks of \a blockSize bytes, which are
+        compressed independently on all cores (using the shared Scheduler). Each block
+        becomes a member of a standard multi-member gzip stream, which can be read by any
+        gzip decoder. Each member carries its compressed size in an extra header field.
+
+        When reading, members with such a size field are read ahead and decompressed in
+        parallel. Other gzip streams are decompressed sequentially as before.
+
+        Has to be called before open(). The default value is 0 (disabled).
+
+        \sa parallelBlockSize()
+    */
+    void setParallelBlockSize(int blockSize);
+    
+    /*!
+        Returns the block size of the block-parallel gzip mode, 0 if it is disabled.
+
+        \sa setParallelBlockSize()
+    */
+    int parallelBlockSize() const;
+    
+    /*!
+        The default block size for the block-parallel gzip mode (1 MB).
+    */
+    static const int DefaultParallelBlockSize = 1048576;
+    
     /*!
         Returns true if the zlib library in use supports the gzip format, false otherwise.
     */
@@ -0,0 +1,561 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include "core/scheduler.hxx"
+#include "core/algorithm.hxx"
+#include "core/cancellation.hxx"
+
+#include <QThread>
+#include <QMutexLocker>
+#include <QtDebug>
+
+#include <algorithm>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *     @file
+ *     @brief Implementation file for the Scheduler class
+ * @}
+ */
+
+/**
+ * A job of the scheduler: Either an Algorithm or a generic task.
+ */
+struct SchedulerJob
+{
+    /** The id of the job **/
+    qint64 id;
+    /** The priority of the job **/
+    Scheduler::Priority priority;
+    /** The Algorithm to be run (or NULL for tasks) **/
+    Algorithm* algorithm;
+    /** The task to be run (if algorithm is NULL) **/
+    std::function<void()> task;
+    /** The cancellation token of the submitting thread (may be NULL) **/
+    CancellationToken* token;
+};
+
+/**
+ * The queue of one worker: one deque per priority for the tasks and another
+ * one for the Algorithms, secured by a mutex. Keeping both apart allows
+ * waiting workers to find all queued tasks, even if Algorithms have been
+ * queued before them.
+ */
+struct SchedulerQueue
+{
+    /** The mutex for this queue **/
+    QMutex mutex;
+    /** The tasks for each priority **/
+    std::deque<SchedulerJob*> tasks[Scheduler::HighPriority+1];
+    /** The Algorithms for each priority **/
+    std::deque<SchedulerJob*> algorithms[Scheduler::HighPriority+1];
+    
+    /**
+     * Returns the deque for a job's kind and priority.
+     *
+     * \param job The job.
+     * \return The deque, where the job belongs to.
+     */
+    std::deque<SchedulerJob*>& jobs(const SchedulerJob* job)
+    {
+        return (job->algorithm != NULL) ? algorithms[job->priority] : tasks[job->priority];
+    }
+};
+
+/**
+ * A worker thread of the scheduler.
+ */
+class SchedulerWorker
+:   public QThread
+{
+    public:
+        /**
+         * Creates a new worker.
+         *
+         * \param scheduler The scheduler of this worker.
+         * \param index     The index of this worker (and its queue).
+         */
+        SchedulerWorker(Scheduler* scheduler, int index)
+        :   m_scheduler(scheduler),
+            m_index(index)
+        {
+        }
+
+        /**
+         * Running phase of the worker: Take jobs or sleep until there are new ones.
+         */
+        void run()
+        {
+            while(true)
+            {
+                SchedulerJob* job = m_scheduler->takeJob(m_index, false);
+
+                if(job != NULL)
+                {
+                    m_scheduler->execute(job);
+                }
+                else
+                {
+                    QMutexLocker locker(&m_scheduler->m_mutex);
+
+                    if(m_scheduler->m_stop)
+                    {
+                        break;
+                    }
+                    if(!m_scheduler->jobTakeable())
+                    {
+                        m_scheduler->m_job_available.wait(&m_scheduler->m_mutex);
+                    }
+                }
+            }
+        }
+
+    private:
+        Scheduler* m_scheduler;
+        int m_index;
+};
+
+
+/**
+ * The shared instance's space (static)
+ */
+Scheduler* Scheduler::m_instance = NULL;
+
+Scheduler* Scheduler::instance()
+{
+    static QMutex instance_mutex;
+    QMutexLocker locker(&instance_mutex);
+    
+    if (m_instance == NULL)
+    {
+        m_instance = new Scheduler;
+    }
+    return m_instance;
+}
+
+Scheduler::Scheduler(unsigned int threads, QObject* parent)
+:   QObject(parent),
+    m_queued(0),
+    m_queued_algorithms(0),
+    m_running_algorithms(0),
+    m_next_queue(0),
+    m_last_id(0),
+    m_stop(false)
+{
+    if(threads == 0)
+    {
+        threads = std::max(QThread::idealThreadCount(), 1);
+    }
+    
+    //Keep one worker free for tasks, if there is more than one
+    m_max_algorithms = std::max(threads, 2u) - 1;
+    
+    for(unsigned int i=0; i!=threads; ++i)
+    {
+        m_queues.push_back(new SchedulerQueue);
+    }
+    for(unsigned int i=0; i!=threads; ++i)
+    {
+        m_workers.push_back(new SchedulerWorker(this, i));
+        m_workers.back()->start();
+    }
+}
+
+Scheduler::~Scheduler()
+{
+    //Remove all queued jobs
+    for(SchedulerQueue* queue : m_queues)
+    {
+        QMutexLocker locker(&queue->mutex);
+        
+        for(int priority=LowPriority; priority<=HighPriority; ++priority)
+        {
+            for(std::deque<SchedulerJob*>* jobs : {&queue->tasks[priority], &queue->algorithms[priority]})
+            {
+                for(SchedulerJob* job : *jobs)
+                {
+                    delete job;
+                }
+                jobs->clear();
+            }
+        }
+    }
+    
+    m_mutex.lock();
+    m_queued.store(0);
+    m_queued_algorithms.store(0);
+    m_pending.clear();
+    m_stop = true;
+    m_job_available.wakeAll();
+    m_job_done.wakeAll();
+    m_mutex.unlock();
+    
+    for(SchedulerWorker* worker : m_workers)
+    {
+        worker->wait();
+        delete worker;
+    }
+    for(SchedulerQueue* queue : m_queues)
+    {
+        delete queue;
+    }
+}
+
+unsigned int Scheduler::threadCount() const
+{
+    return m_workers.size();
+}
+
+unsigned int Scheduler::queuedJobs() const
+{
+    return m_queued.load();
+}
+
+unsigned int Scheduler::pendingJobs() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pending.size();
+}
+
+qint64 Scheduler::submit(Algorithm* alg, Priority priority)
+{
+    SchedulerJob* job = new SchedulerJob;
+    job->priority = priority;
+    job->algorithm = alg;
+    job->token = NULL;
+    
+    return enqueue(job);
+}
+
+qint64 Scheduler::submit(std::function<void()> task, Priority priority)
+{
+    SchedulerJob* job = new SchedulerJob;
+    job->priority = priority;
+    job->algorithm = NULL;
+    job->task = task;
+    job->token = CancellationToken::current();
+    
+    return enqueue(job);
+}
+
+bool Scheduler::cancel(qint64 job_id)
+{
+    for(SchedulerQueue* queue : m_queues)
+    {
+        QMutexLocker locker(&queue->mutex);
+        
+        for(int priority=LowPriority; priority<=HighPriority; ++priority)
+        {
+            for(std::deque<SchedulerJob*>* jobs : {&queue->tasks[priority], &queue->algorithms[priority]})
+            {
+                for(std::deque<SchedulerJob*>::iterator iter = jobs->begin(); iter != jobs->end(); ++iter)
+                {
+                    if((*iter)->id == job_id)
+                    {
+                        bool is_algorithm = ((*iter)->algorithm != NULL);
+                        delete *iter;
+                        jobs->erase(iter);
+                        locker.unlock();
+                        
+                        m_mutex.lock();
+                        m_queued.deref();
+                        if(is_algorithm)
+                        {
+                            m_queued_algorithms.deref();
+                        }
+                        m_pending.remove(job_id);
+                        m_job_done.wakeAll();
+                        m_mutex.unlock();
+                        
+                        emit jobCancelled(job_id);
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool Scheduler::isPending(qint64 job_id) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pending.contains(job_id);
+}
+
+void Scheduler::waitForJob(qint64 job_id)
+{
+    int worker = currentWorker();
+    
+    while(true)
+    {
+        if(worker >= 0)
+        {
+            //Help the others instead of blocking this worker
+            SchedulerJob* job = takeJob(worker, true);
+            
+            if(job != NULL)
+            {
+                execute(job);
+                continue;
+            }
+        }
+        
+        QMutexLocker locker(&m_mutex);
+        
+        if(!m_pending.contains(job_id))
+        {
+            return;
+        }
+        
+        if(worker >= 0)
+        {
+            //Nothing to help with, the awaited job runs on another worker
+            m_job_done.wait(&m_mutex, 10);
+        }
+        else
+        {
+            m_job_done.wait(&m_mutex);
+        }
+    }
+}
+
+void Scheduler::waitForDone()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    while(!m_pending.empty())
+    {
+        m_job_done.wait(&m_mutex);
+    }
+}
+
+qint64 Scheduler::enqueue(SchedulerJob* job)
+{
+    m_mutex.lock();
+    job->id = ++m_last_id;
+    m_pending.insert(job->id);
+    m_mutex.unlock();
+    
+    int worker = currentWorker();
+    
+    if(worker < 0)
+    {
+        worker = (m_next_queue.fetchAndAddRelaxed(1) & 0x7fffffff) % m_queues.size();
+    }
+    
+    qint64 job_id = job->id;
+    
+    SchedulerQueue* queue = m_queues[worker];
+    queue->mutex.lock();
+    queue->jobs(job).push_back(job);
+    queue->mutex.unlock();
+    
+    if(job->algorithm != NULL)
+    {
+        m_queued_algorithms.ref();
+    }
+    m_queued.ref();
+    
+    //Wake up one worker
+    m_mutex.lock();
+    m_job_available.wakeOne();
+    m_mutex.unlock();
+    
+    return job_id;
+}
+
+SchedulerJob* Scheduler::takeJob(int worker, bool tasks_only)
+{
+    int queue_count = m_queues.size();
+    
+    for(int priority=HighPriority; priority>=LowPriority; --priority)
+    {
+        //Tasks first, since running Algorithms may wait for them
+        for(int kind=0; kind!=2; ++kind)
+        {
+            bool algorithms = (kind == 1);
+            
+            if(algorithms && (tasks_only || m_queued_algorithms.load() == 0))
+            {
+                continue;
+            }
+            
+            //First: own queue (oldest first), then: steal from the others (newest first)
+            for(int i=0; i!=queue_count; ++i)
+            {
+                int q = (std::max(worker,0) + i) % queue_count;
+                bool own = (worker >= 0 && i == 0);
+                
+                SchedulerQueue* queue = m_queues[q];
+                QMutexLocker locker(&queue->mutex);
+                
+                std::deque<SchedulerJob*>& jobs = algorithms ? queue->algorithms[priority] : queue->tasks[priority];
+                
+                if(jobs.empty())
+                {
+                    continue;
+                }
+                
+                //Do not let Algorithms occupy the workers reserved for tasks
+                if(algorithms && !reserveAlgorithmSlot())
+                {
+                    break;
+                }
+                
+                SchedulerJob* job = own ? jobs.front() : jobs.back();
+                
+                if(own)
+                {
+                    jobs.pop_front();
+                }
+                else
+                {
+                    jobs.pop_back();
+                }
+                
+                m_queued.deref();
+                if(algorithms)
+                {
+                    m_queued_algorithms.deref();
+                }
+                
+                return job;
+            }
+        }
+    }
+    return NULL;
+}
+
+void Scheduler::execute(SchedulerJob* job)
+{
+    qint64 job_id = job->id;
+    bool is_algorithm = (job->algorithm != NULL);
+    
+    //Tasks (tiles, parallelFor chunks, gzip blocks) are not reported to keep
+    //the listeners off these hot paths
+    if(is_algorithm)
+    {
+        emit jobStarted(job_id);
+    }
+    
+    CancellationToken* last_token = CancellationToken::current();
+    CancellationToken::setCurrent(job->token);
+    
+    try
+    {
+        if(job->algorithm != NULL)
+        {
+            job->algorithm->execute();
+        }
+        else
+        {
+            job->task();
+        }
+    }
+    catch(std::exception& e)
+    {
+        qCritical() << "Scheduler: Job" << job->id << "threw an exception:" << e.what();
+    }
+    catch(...)
+    {
+        qCritical() << "Scheduler: Job" << job->id << "threw an exception.";
+    }
+    
+    CancellationToken::setCurrent(last_token);
+    
+    delete job;
+    
+    m_mutex.lock();
+    if(is_algorithm)
+    {
+        //Another queued Algorithm may run now
+        m_running_algorithms.deref();
+        m_job_available.wakeOne();
+    }
+    m_pending.remove(job_id);
+    m_job_done.wakeAll();
+    m_mutex.unlock();
+    
+    if(is_algorithm)
+    {
+        emit jobFinished(job_id);
+    }
+}
+
+bool Scheduler::reserveAlgorithmSlot()
+{
+    while(true)
+    {
+        int running = m_running_algorithms.load();
+        
+        if(running >= (int)m_max_algorithms)
+        {
+            return false;
+        }
+        if(m_running_algorithms.testAndSetOrdered(running, running+1))
+        {
+            return true;
+        }
+    }
+}
+
+bool Scheduler::jobTakeable() const
+{
+    int queued = m_queued.load(),
+        queued_algorithms = m_queued_algorithms.load();
+    
+    return     queued > queued_algorithms
+           || (queued_algorithms > 0 && m_running_algorithms.load() < (int)m_max_algorithms);
+}
+
+int Scheduler::currentWorker() const
+{
+    QThread* current = QThread::currentThread();
+    
+    for(unsigned int i=0; i!=m_workers.size(); ++i)
+    {
+        if(m_workers[i] == current)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+}//end of namespace graipe
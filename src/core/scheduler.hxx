@@ -0,0 +1,308 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_CORE_SCHEDULER_HXX
+#define GRAIPE_CORE_SCHEDULER_HXX
+
+#include "core/config.hxx"
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSet>
+#include <QAtomicInt>
+
+#include <deque>
+#include <vector>
+#include <functional>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_core
+ * @{
+ *
+ * @file
+ * @brief Header file for the Scheduler class
+ */
+
+//Forward declarations
+class Algorithm;
+class SchedulerWorker;
+struct SchedulerJob;
+struct SchedulerQueue;
+
+/**
+ * The Scheduler is a bounded, work-stealing thread pool shared by the whole
+ * framework. Instead of starting one thread per Algorithm run, all runs
+ * (and smaller tasks) are submitted to this pool, which has exactly as many
+ * worker threads as cores are available by default.
+ *
+ * Each worker thread owns a queue of jobs. Jobs submitted from a worker are
+ * put into its own queue, jobs submitted from any other thread are distributed
+ * round-robin. An idle worker first takes the oldest job of its own queue and
+ * then steals the newest job of the other workers' queues. Higher priority
+ * jobs are always preferred over lower priority ones. For the same priority,
+ * tasks are preferred over Algorithms.
+ *
+ * Algorithms are usually long running. To keep short tasks (e.g. the blocks
+ * of a parallelFor or a gzip compression) from waiting behind them, at most
+ * threadCount()-1 workers run Algorithms at the same time. Thus, if there is
+ * more than one worker, at least one is always available for tasks. As a
+ * consequence, an Algorithm must not wait for another Algorithm's job.
+ *
+ * Jobs, which have not yet been started, may be cancelled. Waiting for a job
+ * from inside a worker thread does not block that worker: It helps processing
+ * queued tasks (not Algorithms) until the awaited job has finished. This
+ * allows nested parallelism without dead-locks.
+ *
+ * The Scheduler does not take the ownership of submitted Algorithms. Their
+ * signals are emitted from the worker thread, which runs them.
+ */
+class GRAIPE_CORE_EXPORT Scheduler
+:   public QObject
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * The priorities of jobs.
+         */
+        enum Priority
+        {
+            LowPriority = 0,
+            NormalPriority = 1,
+            HighPriority = 2
+        };
+
+        /**
+         * Replaces the constructor by means of the Singleton design pattern (static).
+         * The shared scheduler is sized to the number of available cores.
+         *
+         * \return The shared scheduler, it will be created on the first call.
+         */
+        static Scheduler* instance();
+
+        /**
+         * Creates a new (private) scheduler with a given number of worker threads.
+         * Usually you will want to use the shared instance() instead.
+         *
+         * \param threads The number of worker threads, 0 means: number of cores.
+         * \param parent  The parent QObject, NULL by default.
+         */
+        Scheduler(unsigned int threads=0, QObject* parent=NULL);
+
+        /**
+         * Destructor of the Scheduler. Removes all queued jobs and waits for
+         * all running jobs to finish.
+         */
+        ~Scheduler();
+
+        /**
+         * Const accessor to the number of worker threads.
+         *
+         * \return The number of worker threads.
+         */
+        unsigned int threadCount() const;
+
+        /**
+         * Const accessor to the number of jobs, which are currently queued,
+         * but not running.
+         *
+         * \return The number of queued jobs.
+         */
+        unsigned int queuedJobs() const;
+
+        /**
+         * Const accessor to the number of jobs, which are either queued
+         * or currently running.
+         *
+         * \return The number of pending jobs.
+         */
+        unsigned int pendingJobs() const;
+
+        /**
+         * Submit an Algorithm to be run by the pool. The Algorithm::execute()
+         * method will be called in one of the worker threads.
+         *
+         * \param alg      The algorithm to be run.
+         * \param priority The priority of this job.
+         * \return The job id, which can be used for waiting and cancellation.
+         */
+        qint64 submit(Algorithm* alg, Priority priority=NormalPriority);
+
+        /**
+         * Submit an arbitrary task to be run by the pool. The task inherits the
+         * current CancellationToken of the calling thread, thus it must not
+         * outlive the computation, which submitted it.
+         *
+         * \param task     The task to be run.
+         * \param priority The priority of this job.
+         * \return The job id, which can be used for waiting and cancellation.
+         */
+        qint64 submit(std::function<void()> task, Priority priority=NormalPriority);
+
+        /**
+         * Cancels a job, if it has not been started yet.
+         *
+         * \param job_id The id of the job.
+         * \return True, if the job was removed from the queues.
+         */
+        bool cancel(qint64 job_id);
+
+        /**
+         * Returns if a job is still pending (queued or running).
+         *
+         * \param job_id The id of the job.
+         * \return True, if the job has not yet been finished or cancelled.
+         */
+        bool isPending(qint64 job_id) const;
+
+        /**
+         * Waits until a job is finished or cancelled. If called from a worker
+         * thread, the worker will help processing queued tasks meanwhile.
+         *
+         * \param job_id The id of the job.
+         */
+        void waitForJob(qint64 job_id);
+
+        /**
+         * Waits until all pending jobs are finished. Must not be called from
+         * inside a worker thread.
+         */
+        void waitForDone();
+
+    signals:
+        /** Emitted by the worker thread, when an Algorithm job is started **/
+        void jobStarted(qint64 job_id);
+        /** Emitted by the worker thread, when an Algorithm job is finished **/
+        void jobFinished(qint64 job_id);
+        /** Emitted, when a queued job has been cancelled **/
+        void jobCancelled(qint64 job_id);
+
+    protected:
+        /**
+         * Adds a new job to the queues and wakes up a worker.
+         *
+         * \param job The job.
+         * \return The id of the job.
+         */
+        qint64 enqueue(SchedulerJob* job);
+
+        /**
+         * Takes the next job for a given worker, either from its own queue or
+         * by stealing it from another worker's queue.
+         *
+         * \param worker     The index of the worker, or -1 if called from another thread.
+         * \param tasks_only If true, only task jobs will be taken, no Algorithms.
+         * \return The job or NULL, if none was found.
+         */
+        SchedulerJob* takeJob(int worker, bool tasks_only);
+
+        /**
+         * Executes a job and marks it as done afterwards.
+         *
+         * \param job The job. Will be deleted after execution.
+         */
+        void execute(SchedulerJob* job);
+
+        /**
+         * Reserves one of the limited slots for running an Algorithm.
+         * The slot is released after the Algorithm has been executed.
+         *
+         * \return True, if a slot was free and has been reserved.
+         */
+        bool reserveAlgorithmSlot();
+    
+        /**
+         * Returns if any queued job may be taken by an idle worker. To be called
+         * while the scheduler's mutex is locked.
+         *
+         * \return True, if any task or any Algorithm (with a free slot) is queued.
+         */
+        bool jobTakeable() const;
+
+        /**
+         * Returns the worker index of the current thread.
+         *
+         * \return The worker index or -1 if the current thread is no worker of this scheduler.
+         */
+        int currentWorker() const;
+
+    private:
+        /** Static pointer to the shared instance **/
+        static Scheduler* m_instance;
+
+        /** The worker threads **/
+        std::vector<SchedulerWorker*> m_workers;
+
+        /** One queue per worker **/
+        std::vector<SchedulerQueue*> m_queues;
+
+        /** Mutex for the waiting and the pending set **/
+        mutable QMutex m_mutex;
+        /** Condition for idle workers **/
+        QWaitCondition m_job_available;
+        /** Condition for waiting threads **/
+        QWaitCondition m_job_done;
+
+        /** The ids of all queued or running jobs **/
+        QSet<qint64> m_pending;
+
+        /** Number of currently queued jobs **/
+        QAtomicInt m_queued;
+        /** Number of currently queued Algorithms **/
+        QAtomicInt m_queued_algorithms;
+        /** Number of currently running Algorithms **/
+        QAtomicInt m_running_algorithms;
+        /** Maximum number of Algorithms running at the same time **/
+        unsigned int m_max_algorithms;
+        /** The next queue for submissions from non-workers **/
+        QAtomicInt m_next_queue;
+        /** The last used job id **/
+        qint64 m_last_id;
+        /** Shall the workers stop? **/
+        bool m_stop;
+
+        friend class SchedulerWorker;
+};
+
+/**
+ * @}
+ */
+
+}//end of namespace graipe
+
+#endif //GRAIPE_CORE_SCHEDULER_HXX
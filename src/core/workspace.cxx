@@ -52,14 +52,16 @@ namespace graipe {
  */
 
 Workspace::Workspace()
-: m_currentModel(NULL),
+: models_mutex(QMutex::Recursive),
+  m_currentModel(NULL),
   m_currentViewController(NULL)
 {
     findAndLoadModules();
 }
 
 Workspace::Workspace(const Workspace& wsp, bool reload_factories)
-: m_modules_names(wsp.modules_names()),
+: models_mutex(QMutex::Recursive),
+  m_modules_names(wsp.modules_names()),
   m_modules_status(wsp.modules_status()),m_modelFactory(wsp.modelFactory()),
   m_viewControllerFactory(wsp.viewControllerFactory()),
   m_algorithmFactory(wsp.algorithmFactory()),
@@ -235,6 +237,8 @@ bool Workspace::deserialize(QXmlStreamReader& xmlReader)
 
 void Workspace::serialize(QXmlStreamWriter& xmlWriter) const
 {
+    QMutexLocker locker(&models_mutex);
+    
     try
     {
         //Transform memory address to ID for models and viewControllers:
@@ -311,6 +315,8 @@ void Workspace::clear()
     }
     viewControllers.clear();
     
+    QMutexLocker locker(&models_mutex);
+    
     for(Model* m : models)
     {
         m->deleteLater();
@@ -410,6 +416,8 @@ ViewController* Workspace::loadViewController(QXmlStreamReader & xmlReader)
 
         //2. Find the associated model at the model_list (if it was already loaded)
         Model* vc_model = NULL;
+        
+        models_mutex.lock();
         for(Model* mod : models)
         {
             if(     mod
@@ -419,6 +427,8 @@ ViewController* Workspace::loadViewController(QXmlStreamReader & xmlReader)
                 break;
             }
         }
+        models_mutex.unlock();
+        
         //  If it was not found: Indicate error
         if(vc_model == NULL)
         {
@@ -525,8 +535,17 @@ Algorithm* Workspace::loadAlgorithm(QXmlStreamReader & xmlReader)
     return NULL;
 }
 
+unsigned int Workspace::modelCount() const
+{
+    QMutexLocker locker(&models_mutex);
+    
+    return models.size();
+}
+
 Model* Workspace::currentModel()
 {
+    QMutexLocker locker(&models_mutex);
+    
     for(Model* m: models)
     {
         if(m_currentModel == m)
@@ -544,6 +563,8 @@ Model* Workspace::currentModel()
 
 void Workspace::setCurrentModel(Model * model)
 {
+    QMutexLocker locker(&models_mutex);
+    
     for(Model* m : models)
     {
         if(model == m)
@@ -255,10 +255,24 @@ class GRAIPE_CORE_EXPORT Workspace
         QMutex global_algorithm_mutex;
     
         /**
-         * A public container holding all loaded Models.
+         * Public (recursive) mutex for the models container. Algorithms create
+         * and delete Models in the Scheduler's worker threads, thus it has to be
+         * held whenever the models are iterated or changed.
+         */
+        mutable QMutex models_mutex;
+    
+        /**
+         * A public container holding all loaded Models. Guarded by models_mutex.
          */
         std::vector<Model*> models;
     
+        /**
+         * Returns the number of loaded Models. Thread-safe.
+         *
+         * \return The size of the models container.
+         */
+        unsigned int modelCount() const;
+    
         /**
          * A public container holding all loaded ViewControllers.
          */
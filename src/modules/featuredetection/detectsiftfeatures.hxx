@@ -88,14 +88,16 @@ SIFTFeatureList2D* detectFeaturesUsingSIFT(const vigra::MultiArrayView<2,T>& src
 	SIFTFeatureList2D * result = new SIFTFeatureList2D(wsp);
     
     std::vector<SIFTFeature> std_result = computeSIFTDescriptors(src, sigma, octaves, levels, contrast_threshold, curvature_threshold, double_image_size, normalize_image);
-        
+    
+    result->reserve(std_result.size());
+    
     for(const SIFTFeature& sift : std_result)
     {
         result->addFeature(SIFTFeatureList2D::PointType(sift.position[0], sift.position[1]),
                            sift.contrast,
                            sift.orientation,
                            sift.scale,
-                           QVector<float>(sift.descriptor.begin(), sift.descriptor.end()));
+                           sift.descriptor.data(), sift.descriptor.size());
     }
     
     return result;
@@ -0,0 +1,675 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_FEATUREMATCHING_DESCRIPTORINDEX_HXX
+#define GRAIPE_FEATUREMATCHING_DESCRIPTORINDEX_HXX
+
+//GRAIPE components needed
+#include "features2d/features2d.h"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_featurematching
+ * @{
+ *
+ * @file
+ * @brief Header file for the (approximate) nearest neighbour search of feature descriptors
+ */
+
+/**
+ * Computes the squared euclidean distance of two descriptors.
+ * Both descriptors have to be 32-byte aligned and padded with zeros to
+ * a multiple of eight entries, like the rows of a DescriptorMatrix.
+ *
+ * \param a      The first descriptor.
+ * \param b      The second descriptor.
+ * \param stride The padded length of both descriptors.
+ * \return The squared distance of both descriptors.
+ */
+inline float squaredDescriptorDistance(const float* a, const float* b, unsigned int stride)
+{
+#if defined(__AVX__)
+    __m256 sum = _mm256_setzero_ps();
+    
+    for(unsigned int k=0; k<stride; k+=8)
+    {
+        __m256 d = _mm256_sub_ps(_mm256_load_ps(a+k), _mm256_load_ps(b+k));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(d, d));
+    }
+    
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128 sum1 = _mm_setzero_ps(),
+           sum2 = _mm_setzero_ps();
+    
+    for(unsigned int k=0; k<stride; k+=8)
+    {
+        __m128 d1 = _mm_sub_ps(_mm_load_ps(a+k),   _mm_load_ps(b+k)),
+               d2 = _mm_sub_ps(_mm_load_ps(a+k+4), _mm_load_ps(b+k+4));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(d1, d1));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(d2, d2));
+    }
+    
+    __m128 s = _mm_add_ps(sum1, sum2);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+#else
+    //Four independent sums, which may be vectorized by the compiler
+    float sum[4] = {0, 0, 0, 0};
+    
+    for(unsigned int k=0; k<stride; k+=4)
+    {
+        for(unsigned int l=0; l<4; ++l)
+        {
+            float d = a[k+l] - b[k+l];
+            sum[l] += d*d;
+        }
+    }
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+#endif
+}
+
+/**
+ * A contiguous matrix of feature descriptors. Each row holds one descriptor.
+ * The rows start at 32-byte aligned addresses and are padded with zeros to
+ * a multiple of eight floats, such that squaredDescriptorDistance() may be
+ * applied to any two rows (of matrices with the same stride).
+ *
+ * If the layout of a SIFTFeatureList2D's descriptor block fits, the matrix
+ * refers to that block instead of copying it. It is then only valid as long
+ * as the features are not changed.
+ */
+class DescriptorMatrix
+{
+    public:
+        /**
+         * Creates the descriptor matrix of a SIFT feature list.
+         *
+         * \param features The SIFT features.
+         * \param dim      The descriptor length. If zero, the features' descriptorSize()
+         *                 is used. Longer descriptors are cut, shorter ones are
+         *                 padded with zeros.
+         * \param copy     If true, the descriptors are always copied.
+         */
+        DescriptorMatrix(const SIFTFeatureList2D & features, unsigned int dim=0, bool copy=false)
+        {
+            m_rows   = features.size();
+            m_dim    = (dim == 0) ? features.descriptorSize() : dim;
+            m_stride = (m_dim + 7) / 8 * 8;
+            
+            if(    !copy
+                && features.descriptorSize() <= m_dim
+                && features.descriptorStride() == m_stride)
+            {
+                m_data = features.descriptors();
+            }
+            else
+            {
+                m_buffer.assign(size_t(m_rows)*m_stride, 0.0f);
+                
+                for(unsigned int i=0; i<m_rows; ++i)
+                {
+                    DescriptorSpan d = features.descriptor(i);
+                    std::copy(d.begin(), d.begin() + std::min(m_dim, d.size()), m_buffer.begin() + size_t(i)*m_stride);
+                }
+                m_data = m_buffer.data();
+            }
+        }
+        
+        /**
+         * The number of descriptors.
+         *
+         * \return The row count of the matrix.
+         */
+        unsigned int rows() const
+        {
+            return m_rows;
+        }
+        
+        /**
+         * The length of each descriptor (without padding).
+         *
+         * \return The descriptor length.
+         */
+        unsigned int dim() const
+        {
+            return m_dim;
+        }
+        
+        /**
+         * The padded length of each descriptor.
+         *
+         * \return The distance of two rows in floats.
+         */
+        unsigned int stride() const
+        {
+            return m_stride;
+        }
+        
+        /**
+         * Read-only access to a descriptor.
+         *
+         * \param i The index of the descriptor.
+         * \return Pointer to the (aligned) start of the descriptor.
+         */
+        const float* row(unsigned int i) const
+        {
+            return m_data + size_t(i)*m_stride;
+        }
+        
+    private:
+        /** Copying would invalidate the data pointer **/
+        DescriptorMatrix(const DescriptorMatrix&);
+        DescriptorMatrix& operator=(const DescriptorMatrix&);
+        
+        /** The matrix size **/
+        unsigned int m_rows, m_dim, m_stride;
+        
+        /** The own storage, if the descriptors have been copied **/
+        std::vector<float, AlignedAllocator<float> > m_buffer;
+        
+        /** The first descriptor **/
+        const float* m_data;
+};
+
+/**
+ * An approximate nearest neighbour index for SIFT descriptors. It is a forest
+ * of randomized k-d trees (Silpa-Anan and Hartley): Each tree splits at the mean
+ * of one of the five dimensions with the highest variance, chosen at random.
+ * A query descends all trees at once using a common priority queue of the
+ * unexplored branches and stops after a given number of descriptor comparisons.
+ *
+ * The index is built once for the descriptors of one feature list and may then
+ * be queried from several threads at the same time, each one using its own
+ * SearchState. Use cached() to reuse indices over several matching runs.
+ */
+class SIFTDescriptorIndex
+{
+    public:
+        /**
+         * The per-query (or per-thread) scratch memory of a search.
+         */
+        class SearchState
+        {
+            public:
+                SearchState()
+                :   m_stamp(0)
+                {
+                }
+            
+            private:
+                friend class SIFTDescriptorIndex;
+            
+                /** Marks the descriptors, which have been compared in the current query **/
+                std::vector<unsigned int> m_checked;
+                unsigned int m_stamp;
+            
+                /** The priority queue of unexplored branches: (lower bound, tree, node) **/
+                std::vector<std::pair<float, std::pair<unsigned int, unsigned int> > > m_branches;
+        };
+    
+        /**
+         * Builds the index for the descriptors of a feature list.
+         *
+         * \param features  The SIFT features.
+         * \param trees     The number of randomized k-d trees.
+         * \param leaf_size The maximal number of descriptors in each leaf.
+         */
+        SIFTDescriptorIndex(const SIFTFeatureList2D & features, unsigned int trees=4, unsigned int leaf_size=8)
+        :   m_descriptors(features, 0, true),
+            m_leaf_size(std::max(1u, leaf_size)),
+            m_trees(trees)
+        {
+            std::mt19937 random(42);
+            
+            for(Tree& tree : m_trees)
+            {
+                tree.indices.resize(m_descriptors.rows());
+                
+                for(unsigned int i=0; i<m_descriptors.rows(); ++i)
+                {
+                    tree.indices[i] = i;
+                }
+                std::shuffle(tree.indices.begin(), tree.indices.end(), random);
+                
+                tree.nodes.push_back(Node());
+                buildNode(tree, 0, 0, m_descriptors.rows(), random);
+            }
+        }
+        
+        /**
+         * The number of indexed descriptors.
+         *
+         * \return The size of the index.
+         */
+        unsigned int size() const
+        {
+            return m_descriptors.rows();
+        }
+        
+        /**
+         * The indexed descriptors.
+         *
+         * \return The contiguous descriptor matrix of the index.
+         */
+        const DescriptorMatrix& descriptors() const
+        {
+            return m_descriptors;
+        }
+        
+        /**
+         * Searches for the (approximately) k nearest descriptors of a query.
+         *
+         * \param query      The query descriptor. Has to be aligned and padded like
+         *                   the rows of descriptors(), e.g. a row of a DescriptorMatrix
+         *                   with the same stride.
+         * \param k          The number of neighbours to search for.
+         * \param max_checks The maximal number of descriptor comparisons. If it
+         *                   is at least size(), the search is exact.
+         * \param state      The scratch memory of the calling thread.
+         * \param indices    The indices of the found neighbours, nearest first.
+         * \param distances  The squared distances of the found neighbours.
+         */
+        void knnSearch(const float* query, unsigned int k, unsigned int max_checks,
+                       SearchState & state,
+                       std::vector<unsigned int> & indices, std::vector<float> & distances) const
+        {
+            indices.clear();
+            distances.clear();
+            
+            if(k == 0 || size() == 0)
+            {
+                return;
+            }
+            
+            if(state.m_checked.size() != size() || state.m_stamp == ~0u)
+            {
+                state.m_checked.assign(size(), 0);
+                state.m_stamp = 0;
+            }
+            state.m_stamp++;
+            state.m_branches.clear();
+            
+            std::vector<std::pair<float, unsigned int> > result;
+            unsigned int checks = 0;
+            
+            for(unsigned int t=0; t<m_trees.size(); ++t)
+            {
+                searchNode(t, 0, 0.0f, query, k, state, result, checks);
+            }
+            
+            std::greater<std::pair<float, std::pair<unsigned int, unsigned int> > > cmp;
+            
+            while(!state.m_branches.empty() && checks < max_checks)
+            {
+                std::pop_heap(state.m_branches.begin(), state.m_branches.end(), cmp);
+                std::pair<float, std::pair<unsigned int, unsigned int> > branch = state.m_branches.back();
+                state.m_branches.pop_back();
+                
+                if(result.size() == k && branch.first >= result.back().first)
+                {
+                    break;
+                }
+                searchNode(branch.second.first, branch.second.second, branch.first, query, k, state, result, checks);
+            }
+            
+            for(const std::pair<float, unsigned int>& r : result)
+            {
+                indices.push_back(r.second);
+                distances.push_back(r.first);
+            }
+        }
+        
+        /**
+         * Returns an index for the descriptors of a feature list, which is shared
+         * by all matching runs against these features. The index is built on first
+         * request and dropped as soon as the features are changed or deleted.
+         * Thread-safe. The index is built outside of the cache's lock, such that
+         * lookups of other features are not blocked by a build. If the features
+         * change during the build, the index is returned, but not cached.
+         *
+         * \param features The SIFT features.
+         * \return The (shared) index of the features' descriptors.
+         */
+        static std::shared_ptr<const SIFTDescriptorIndex> cached(const SIFTFeatureList2D & features)
+        {
+            static QMutex mutex;
+            static std::list<CacheEntry> cache;
+            
+            const SIFTFeatureList2D* key = &features;
+            
+            auto lookup = [key]() -> std::shared_ptr<const SIFTDescriptorIndex>
+                          {
+                              for(const CacheEntry& entry : cache)
+                              {
+                                  if(entry.features == key)
+                                  {
+                                      return entry.index;
+                                  }
+                              }
+                              return std::shared_ptr<const SIFTDescriptorIndex>();
+                          };
+            
+            mutex.lock();
+            std::shared_ptr<const SIFTDescriptorIndex> index = lookup();
+            mutex.unlock();
+            
+            if(index)
+            {
+                return index;
+            }
+            
+            //Watch the features before building, such that changes during the
+            //build are noticed. The same connections invalidate the cache entry.
+            std::shared_ptr<QAtomicInt> changed = std::make_shared<QAtomicInt>(0);
+            auto drop = [key, changed]()
+                        {
+                            changed->storeRelease(1);
+                            
+                            QMutexLocker locker(&mutex);
+                            
+                            for(auto it=cache.begin(); it!=cache.end(); ++it)
+                            {
+                                if(it->features == key)
+                                {
+                                    QObject::disconnect(it->changed);
+                                    QObject::disconnect(it->destroyed);
+                                    cache.erase(it);
+                                    break;
+                                }
+                            }
+                        };
+            
+            CacheEntry entry;
+            entry.features  = key;
+            entry.changed   = QObject::connect(&features, &Model::modelChanged, drop);
+            entry.destroyed = QObject::connect(&features, &QObject::destroyed, drop);
+            
+            //Build the index without holding the lock
+            entry.index = std::make_shared<const SIFTDescriptorIndex>(features);
+            
+            QMutexLocker locker(&mutex);
+            
+            //Another thread may have built an index for the same features meanwhile
+            std::shared_ptr<const SIFTDescriptorIndex> other = lookup();
+            
+            if(other || changed->loadAcquire())
+            {
+                QObject::disconnect(entry.changed);
+                QObject::disconnect(entry.destroyed);
+                
+                //A changed index is still returned to the caller, but not cached
+                return other ? other : entry.index;
+            }
+            
+            //Keep only a few indices alive
+            while(cache.size() >= 4)
+            {
+                QObject::disconnect(cache.front().changed);
+                QObject::disconnect(cache.front().destroyed);
+                cache.pop_front();
+            }
+            
+            cache.push_back(entry);
+            
+            return entry.index;
+        }
+        
+    private:
+        /**
+         * A node of a k-d tree. Inner nodes have a split dimension and value and
+         * two children, leaves refer to a range of the tree's indices.
+         */
+        struct Node
+        {
+            Node()
+            :   dim(-1), value(0), child(0), begin(0), end(0)
+            {
+            }
+            
+            /** The split dimension, or -1 for a leaf **/
+            int dim;
+            /** The split value **/
+            float value;
+            /** The first child (left), the second one is child+1 (right) **/
+            unsigned int child;
+            /** The range of a leaf's descriptors **/
+            unsigned int begin, end;
+        };
+        
+        /** One randomized k-d tree **/
+        struct Tree
+        {
+            /** The nodes, the root node is the first one **/
+            std::vector<Node> nodes;
+            /** The descriptor indices ordered by leaves **/
+            std::vector<unsigned int> indices;
+        };
+        
+        /** An entry of the index cache **/
+        struct CacheEntry
+        {
+            const SIFTFeatureList2D* features;
+            std::shared_ptr<const SIFTDescriptorIndex> index;
+            QMetaObject::Connection changed, destroyed;
+        };
+        
+        /**
+         * Recursively builds a node of a tree over a range of its indices.
+         *
+         * \param tree   The tree.
+         * \param node   The node's index inside the tree.
+         * \param begin  The start of the range.
+         * \param end    The end of the range.
+         * \param random The random number generator.
+         */
+        void buildNode(Tree & tree, unsigned int node, unsigned int begin, unsigned int end, std::mt19937 & random)
+        {
+            tree.nodes[node].begin = begin;
+            tree.nodes[node].end   = end;
+            
+            if(end - begin <= m_leaf_size || m_descriptors.dim() == 0)
+            {
+                return;
+            }
+            
+            //Estimate mean and variance of each dimension by a sample of the range
+            unsigned int dim = m_descriptors.dim(),
+                         samples = std::min(end - begin, 100u);
+            std::vector<double> mean(dim, 0.0), var(dim, 0.0);
+            
+            for(unsigned int s=0; s<samples; ++s)
+            {
+                const float* d = m_descriptors.row(tree.indices[begin + s]);
+                
+                for(unsigned int k=0; k<dim; ++k)
+                {
+                    mean[k] += d[k];
+                    var[k]  += double(d[k])*d[k];
+                }
+            }
+            
+            std::vector<std::pair<double, unsigned int> > variances(dim);
+            
+            for(unsigned int k=0; k<dim; ++k)
+            {
+                mean[k] /= samples;
+                variances[k] = std::make_pair(var[k]/samples - mean[k]*mean[k], k);
+            }
+            
+            //Split at a random one of the five dimensions with highest variance
+            unsigned int top = std::min(5u, dim);
+            std::partial_sort(variances.begin(), variances.begin()+top, variances.end(),
+                              std::greater<std::pair<double, unsigned int> >());
+            
+            unsigned int split_dim = variances[random() % top].second;
+            float split_value = mean[split_dim];
+            
+            auto less = [&](unsigned int i){ return m_descriptors.row(i)[split_dim] < split_value; };
+            unsigned int middle = std::partition(tree.indices.begin()+begin, tree.indices.begin()+end, less) - tree.indices.begin();
+            
+            if(middle == begin || middle == end)
+            {
+                //Degenerated split: Use the median instead
+                middle = begin + (end - begin)/2;
+                std::nth_element(tree.indices.begin()+begin, tree.indices.begin()+middle, tree.indices.begin()+end,
+                                 [&](unsigned int i, unsigned int j){ return m_descriptors.row(i)[split_dim] < m_descriptors.row(j)[split_dim]; });
+                split_value = m_descriptors.row(tree.indices[middle])[split_dim];
+                
+                middle = std::partition(tree.indices.begin()+begin, tree.indices.begin()+end, less) - tree.indices.begin();
+                
+                if(middle == begin || middle == end)
+                {
+                    //All values are equal in this dimension: keep this node as a (large) leaf
+                    return;
+                }
+            }
+            
+            unsigned int child = (unsigned int)tree.nodes.size();
+            tree.nodes[node].dim   = split_dim;
+            tree.nodes[node].value = split_value;
+            tree.nodes[node].child = child;
+            tree.nodes.resize(child + 2);
+            
+            buildNode(tree, child,   begin,  middle, random);
+            buildNode(tree, child+1, middle, end,    random);
+        }
+        
+        /**
+         * Descends from a node to the closest leaf, queues all branches, which were
+         * not taken, and compares the query against the leaf's descriptors.
+         *
+         * \param t        The tree index.
+         * \param node     The node to start at.
+         * \param min_dist The lower bound of the squared distance for this node.
+         * \param query    The query descriptor.
+         * \param k        The number of neighbours to search for.
+         * \param state    The scratch memory of the search.
+         * \param result   The sorted (distance, index) pairs found so far.
+         * \param checks   The number of comparisons so far.
+         */
+        void searchNode(unsigned int t, unsigned int node, float min_dist, const float* query, unsigned int k,
+                        SearchState & state, std::vector<std::pair<float, unsigned int> > & result, unsigned int & checks) const
+        {
+            const Tree& tree = m_trees[t];
+            std::greater<std::pair<float, std::pair<unsigned int, unsigned int> > > cmp;
+            
+            while(tree.nodes[node].dim >= 0)
+            {
+                const Node& n = tree.nodes[node];
+                float diff = query[n.dim] - n.value;
+                
+                unsigned int best  = (diff < 0) ? n.child : n.child+1,
+                             other = (diff < 0) ? n.child+1 : n.child;
+                
+                float other_dist = min_dist + diff*diff;
+                
+                if(result.size() < k || other_dist < result.back().first)
+                {
+                    state.m_branches.push_back(std::make_pair(other_dist, std::make_pair(t, other)));
+                    std::push_heap(state.m_branches.begin(), state.m_branches.end(), cmp);
+                }
+                node = best;
+            }
+            
+            const Node& leaf = tree.nodes[node];
+            
+            for(unsigned int l=leaf.begin; l<leaf.end; ++l)
+            {
+                unsigned int i = tree.indices[l];
+                
+                if(state.m_checked[i] == state.m_stamp)
+                {
+                    continue;
+                }
+                state.m_checked[i] = state.m_stamp;
+                checks++;
+                
+                float dist = squaredDescriptorDistance(query, m_descriptors.row(i), m_descriptors.stride());
+                
+                if(result.size() < k || dist < result.back().first)
+                {
+                    std::pair<float, unsigned int> r(dist, i);
+                    result.insert(std::upper_bound(result.begin(), result.end(), r), r);
+                    
+                    if(result.size() > k)
+                    {
+                        result.pop_back();
+                    }
+                }
+            }
+        }
+        
+        /** The indexed descriptors **/
+        DescriptorMatrix m_descriptors;
+        
+        /** The maximal leaf size **/
+        unsigned int m_leaf_size;
+        
+        /** The randomized k-d trees **/
+        std::vector<Tree> m_trees;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_FEATUREMATCHING_DESCRIPTORINDEX_HXX
@@ -0,0 +1,265 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_FEATUREMATCHING_FEATUREINDEX_HXX
+#define GRAIPE_FEATUREMATCHING_FEATUREINDEX_HXX
+
+//vigra components needed
+#include <vigra/linear_algebra.hxx>
+#include <vigra/tinyvector.hxx>
+
+//GRAIPE components needed
+#include "features2d/features2d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_featurematching
+ * @{
+ *
+ * @file
+ * @brief Header file for a spatial index over the positions of point features
+ */
+
+/**
+ * A uniform grid over the (rounded and transformed) positions of a point feature
+ * list. It is built once, e.g. after the global motion estimation, and then
+ * answers radius queries by looking only at the grid cells, which overlap the
+ * query's bounding box instead of testing all features.
+ *
+ * The positions are stored as the matchers use them: The feature positions are
+ * rounded to integers first and afterwards transformed by the given matrix.
+ * The cells are stored in a compact form (counting sort), such that each cell's
+ * feature indices are contiguous in memory.
+ */
+class PointFeatureIndex2D
+{
+    public:
+        typedef vigra::TinyVector<float,2> PointType;
+        
+        /**
+         * Builds the index for a feature list.
+         *
+         * \param features  The point features, which shall be indexed.
+         * \param cell_size The preferred size of a grid cell. Should be the
+         *                  typical query radius. It is enlarged automatically,
+         *                  if the grid would get much more cells than features.
+         * \param mat       The 3x3 affine matrix, which is applied to the rounded
+         *                  feature positions before indexing them.
+         */
+        PointFeatureIndex2D(const PointFeatureList2D & features, float cell_size,
+                            const vigra::Matrix<double> & mat = vigra::identityMatrix<double>(3))
+        {
+            m_positions.reserve(features.size());
+            
+            for(unsigned int j=0; j<features.size(); ++j)
+            {
+                int x = vigra::round(features.position(j).x()),
+                    y = vigra::round(features.position(j).y());
+                
+                float t_x = x*mat(0,0) + y*mat(0,1) + mat(0,2),
+                      t_y = x*mat(1,0) + y*mat(1,1) + mat(1,2);
+                
+                m_positions.push_back(PointType(t_x, t_y));
+            }
+            
+            build(cell_size);
+        }
+        
+        /**
+         * The number of indexed features.
+         *
+         * \return The number of features of the index.
+         */
+        unsigned int size() const
+        {
+            return (unsigned int)m_positions.size();
+        }
+        
+        /**
+         * The indexed (rounded and transformed) position of a feature.
+         *
+         * \param index The index of the feature in the original feature list.
+         * \return The position of the feature inside the index.
+         */
+        const PointType& position(unsigned int index) const
+        {
+            return m_positions[index];
+        }
+        
+        /**
+         * Collects all features, which may be within a radius around a point.
+         * The result is a superset of the features inside the radius: Only
+         * the cells are tested, so the exact distance test is up to the caller.
+         * The indices are returned in ascending order, thus iterating over them
+         * visits the features in the same order as a loop over all features does.
+         *
+         * \param x      The x-coordinate of the query point.
+         * \param y      The y-coordinate of the query point.
+         * \param radius The search radius.
+         * \param result The feature indices in range. Will be overwritten.
+         */
+        void candidates(double x, double y, double radius, std::vector<unsigned int> & result) const
+        {
+            result.clear();
+            
+            int c0 = std::max(0,          cell((x - radius - m_left) / m_cell_size, m_cols)),
+                c1 = std::min(m_cols - 1, cell((x + radius - m_left) / m_cell_size, m_cols)),
+                r0 = std::max(0,          cell((y - radius - m_top)  / m_cell_size, m_rows)),
+                r1 = std::min(m_rows - 1, cell((y + radius - m_top)  / m_cell_size, m_rows));
+            
+            for(int r=r0; r<=r1; ++r)
+            {
+                for(int c=c0; c<=c1; ++c)
+                {
+                    unsigned int idx = r*m_cols + c;
+                    
+                    result.insert(result.end(),
+                                  m_indices.begin() + m_cell_start[idx],
+                                  m_indices.begin() + m_cell_start[idx+1]);
+                }
+            }
+            
+            if(r0 != r1 || c0 != c1)
+            {
+                std::sort(result.begin(), result.end());
+            }
+        }
+        
+    private:
+        /**
+         * Converts a grid coordinate into a cell index, clamped to [-1, count].
+         *
+         * \param v     The coordinate in cell units.
+         * \param count The number of cells in that direction.
+         * \return The (clamped) cell index.
+         */
+        static int cell(double v, int count)
+        {
+            return (int)std::floor(std::min(double(count), std::max(-1.0, v)));
+        }
+        
+        /**
+         * Sorts all positions into the grid cells.
+         *
+         * \param cell_size The preferred size of a grid cell.
+         */
+        void build(float cell_size)
+        {
+            m_left = m_top = 0;
+            m_cell_size = std::max(1.0f, cell_size);
+            m_cols = m_rows = 1;
+            
+            if(!m_positions.empty())
+            {
+                PointType lower = m_positions.front(),
+                          upper = m_positions.front();
+                
+                for(const PointType& p : m_positions)
+                {
+                    lower = min(lower, p);
+                    upper = max(upper, p);
+                }
+                
+                m_left = lower[0];
+                m_top  = lower[1];
+                
+                //Do not create (many) more cells than features:
+                double max_cells = 4.0*m_positions.size() + 16;
+                
+                while(   (std::floor((upper[0] - m_left)/m_cell_size) + 1)
+                       * (std::floor((upper[1] - m_top) /m_cell_size) + 1) > max_cells)
+                {
+                    m_cell_size *= 2;
+                }
+                
+                m_cols = (int)std::floor((upper[0] - m_left)/m_cell_size) + 1;
+                m_rows = (int)std::floor((upper[1] - m_top) /m_cell_size) + 1;
+            }
+            
+            //Counting sort of the feature indices by their cells
+            std::vector<unsigned int> cells(m_positions.size());
+            m_cell_start.assign(m_cols*m_rows + 1, 0);
+            
+            for(unsigned int j=0; j<m_positions.size(); ++j)
+            {
+                int c = std::min(m_cols - 1, (int)std::floor((m_positions[j][0] - m_left)/m_cell_size)),
+                    r = std::min(m_rows - 1, (int)std::floor((m_positions[j][1] - m_top) /m_cell_size));
+                
+                cells[j] = r*m_cols + c;
+                m_cell_start[cells[j]+1]++;
+            }
+            
+            for(unsigned int idx=0; idx<(unsigned int)(m_cols*m_rows); ++idx)
+            {
+                m_cell_start[idx+1] += m_cell_start[idx];
+            }
+            
+            std::vector<unsigned int> fill(m_cell_start.begin(), m_cell_start.end()-1);
+            m_indices.resize(m_positions.size());
+            
+            for(unsigned int j=0; j<m_positions.size(); ++j)
+            {
+                m_indices[fill[cells[j]]++] = j;
+            }
+        }
+        
+        /** The (rounded and transformed) positions of the features **/
+        std::vector<PointType> m_positions;
+        
+        /** The upper left corner of the grid and the size of each cell **/
+        double m_left, m_top, m_cell_size;
+        
+        /** The grid's size **/
+        int m_cols, m_rows;
+        
+        /** Start of each cell inside m_indices (and end of the last one) **/
+        std::vector<unsigned int> m_cell_start;
+        
+        /** The feature indices, ordered by cells **/
+        std::vector<unsigned int> m_indices;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_FEATUREMATCHING_FEATUREINDEX_HXX
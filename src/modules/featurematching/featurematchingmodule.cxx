@@ -76,6 +76,7 @@ class BlockWiseImageMatcher
             m_parameters->addParameter("max_d",     new IntParameter("Max Distance", 1, 999));
             m_parameters->addParameter("best_n",    new IntParameter("Find N best candidates", 1, 50));
             m_parameters->addParameter("gme?",      new BoolParameter("use global motion estimation"));
+            m_parameters->addParameter("verbose?",  new BoolParameter("print correlation diagnostics"));
         }
     
         /**
@@ -116,6 +117,7 @@ class BlockWiseImageMatcher
                                         * param_searchDistance = static_cast<IntParameter*> ((*m_parameters)["max_d"]),
                                         * param_nCandidates    = static_cast<IntParameter*> ((*m_parameters)["best_n"]);
                     BoolParameter		* param_useGME         = static_cast<BoolParameter*> ((*m_parameters)["gme?"]);
+                    BoolParameter		* param_verbose        = static_cast<BoolParameter*> ((*m_parameters)["verbose?"]);
                     
                 
                     vigra::MultiArrayView<2,float> imageband1 = param_imageBand1->value();
@@ -126,6 +128,8 @@ class BlockWiseImageMatcher
                     unsigned int y_step = param_imageBand1->image()->height()/param_ySamples->value();
                     unsigned int x_step = param_imageBand1->image()->width()/param_xSamples->value();
                         
+                    features_of_image1.reserve(param_xSamples->value()*param_ySamples->value());
+                    
                     for(unsigned int y=y_step/2; y < param_imageBand1->image()->height(); y+=y_step)
                     {
                         for(unsigned int x=x_step/2; x < param_imageBand1->image()->width(); x+=x_step)
@@ -156,7 +160,8 @@ class BlockWiseImageMatcher
                                                param_useGME->value(),
                                                mat,
                                                rotation_correlation, translation_correlation,
-                                               used_distance);
+                                               used_distance,
+                                               param_verbose->value());
                     
                     qint64 processing_time = timer.elapsed();
                     
@@ -479,6 +484,7 @@ class FeatureToImageMatcher
             m_parameters->addParameter("max_d",     new IntParameter("Max Distance", 1, 999));
             m_parameters->addParameter("best_n",    new IntParameter("Find N best candidates", 1, 50));
             m_parameters->addParameter("gme?",      new BoolParameter("use global motion estimation"));
+            m_parameters->addParameter("verbose?",  new BoolParameter("print correlation diagnostics"));
         }
     
         /**
@@ -519,6 +525,7 @@ class FeatureToImageMatcher
                                         * param_searchDistance = static_cast<IntParameter*> ((*m_parameters)["max_d"]),
                                         * param_nCandidates    = static_cast<IntParameter*> ((*m_parameters)["best_n"]);
                     BoolParameter		* param_useGME         = static_cast<BoolParameter*> ((*m_parameters)["gme?"]);
+                    BoolParameter		* param_verbose        = static_cast<BoolParameter*> ((*m_parameters)["verbose?"]);
                     
                     
                     vigra::MultiArrayView<2,float> imageband1 = param_imageBand1->value();
@@ -550,7 +557,8 @@ class FeatureToImageMatcher
                                                param_nCandidates->value(), param_useGME->value(),
                                                mat,
                                                rotation_correlation, translation_correlation,
-                                               used_distance);
+                                               used_distance,
+                                               param_verbose->value());
                     
                     qint64 processing_time = timer.elapsed();
                     
@@ -831,6 +839,8 @@ class SIFTMatcher
             m_parameters->addParameter("max_sift_d", new FloatParameter("Max. distance of point descriptors", 1, 1000000,1000));
             m_parameters->addParameter("max_d", new FloatParameter("Max. geometrical distance of points", 1, 100000,100));
             m_parameters->addParameter("best_n", new IntParameter("Find N best candidates", 1, 50,10));
+            m_parameters->addParameter("ratio", new FloatParameter("Ratio test threshold (1 = off)", 0.1, 1, 1));
+            m_parameters->addParameter("ann?", new BoolParameter("use approximate descriptor search"));
             m_parameters->addParameter("gme?", new BoolParameter("use global motion estimation"));
         }
 		
@@ -871,10 +881,12 @@ class SIFTMatcher
                     ModelParameter	* param_features2		= static_cast<ModelParameter*> ( (*m_parameters)["sift2"]);
                 
                     FloatParameter	*	param_maxDistance = static_cast<FloatParameter*> ( (*m_parameters)["max_sift_d"]),
-                                    *	param_maxGeoDistance = static_cast<FloatParameter*> ( (*m_parameters)["max_geo_d"]);
+                                    *	param_maxGeoDistance = static_cast<FloatParameter*> ( (*m_parameters)["max_d"]),
+                                    *	param_ratio = static_cast<FloatParameter*> ( (*m_parameters)["ratio"]);
                     IntParameter	*	param_nCandidates = static_cast<IntParameter*> ( (*m_parameters)["best_n"]);
                 
-                    BoolParameter	*	param_useGME = static_cast<BoolParameter*> ( (*m_parameters)["gme?"]);
+                    BoolParameter	*	param_useANN = static_cast<BoolParameter*> ( (*m_parameters)["ann?"]),
+                                    *	param_useGME = static_cast<BoolParameter*> ( (*m_parameters)["gme?"]);
                     
                     
                     vigra::MultiArrayView<2,float> imageband1 = param_imageBand1->value();
@@ -907,7 +919,9 @@ class SIFTMatcher
                                                          param_useGME->value(),
                                                          mat,
                                                          rotation_correlation, translation_correlation,
-                                                         used_distance);
+                                                         used_distance,
+                                                         param_ratio->value(),
+                                                         param_useANN->value());
                     
                     qint64 processing_time = timer.elapsed();
                     
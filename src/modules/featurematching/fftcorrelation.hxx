@@ -0,0 +1,573 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_FEATUREMATCHING_FFTCORRELATION_HXX
+#define GRAIPE_FEATUREMATCHING_FFTCORRELATION_HXX
+
+//vigra components needed
+#include <vigra/multi_array.hxx>
+#include <vigra/multi_fft.hxx>
+
+#include <fftw3.h>
+
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_featurematching
+ * @{
+ *
+ * @file
+ * @brief Header file for the batched FFT-based (normalized) cross correlation
+ */
+
+/**
+ * A pair of FFTW plans (real to complex and back) for a batch of two-dimensional
+ * transforms of the same size. The plans are created only once per size and batch
+ * count and kept for the lifetime of the process. The FFTW wisdom is read from and
+ * written to the user's graipe directory, such that the (measured) plans are
+ * cheap to create in later runs, too.
+ *
+ * The FFTW planner and the wisdom functions are not reentrant. Thus, creating a
+ * plan and the wisdom I/O hold the lock, which vigra uses for its own (fftwf)
+ * plans, too. Executing a plan (forward/backward) is thread-safe, as long as
+ * each thread uses its own arrays.
+ */
+class FFTCorrelationPlan
+{
+    public:
+        /**
+         * Returns the plan for a given transform size and batch count. Thread-safe.
+         *
+         * \param width  The width of each transform.
+         * \param height The height of each transform.
+         * \param batch  The number of transforms, which are computed at once.
+         * \return The (shared) plan.
+         */
+        static const FFTCorrelationPlan& get(unsigned int width, unsigned int height, unsigned int batch)
+        {
+            static QMutex mutex;
+            static std::map<std::pair<std::pair<unsigned int, unsigned int>, unsigned int>, FFTCorrelationPlan*> plans;
+            static bool wisdom_loaded = false;
+            
+            QMutexLocker locker(&mutex);
+            
+            std::pair<std::pair<unsigned int, unsigned int>, unsigned int> key(std::make_pair(width, height), batch);
+            
+            auto it = plans.find(key);
+            
+            if(it == plans.end())
+            {
+                QDir().mkpath(QDir::homePath() + "/.graipe/");
+                
+                //Shared with all FFTW planning of vigra
+                vigra::detail::FFTWLock<> fftw_lock;
+                
+                if(!wisdom_loaded)
+                {
+                    fftwf_import_wisdom_from_filename(wisdomFilename().toLocal8Bit().constData());
+                    wisdom_loaded = true;
+                }
+                
+                it = plans.insert(std::make_pair(key, new FFTCorrelationPlan(width, height, batch))).first;
+                
+                fftwf_export_wisdom_to_filename(wisdomFilename().toLocal8Bit().constData());
+            }
+            
+            return *it->second;
+        }
+        
+        /**
+         * The smallest transform size, which is not smaller than n and has only
+         * the prime factors 2, 3, 5 and 7, for which FFTW is fastest.
+         *
+         * \param n The minimal size.
+         * \return The transform size.
+         */
+        static unsigned int fftSize(unsigned int n)
+        {
+            for(unsigned int m=std::max(n,1u); ; ++m)
+            {
+                unsigned int r = m;
+                
+                for(unsigned int p : {2u, 3u, 5u, 7u})
+                {
+                    while(r % p == 0)
+                        r /= p;
+                }
+                
+                if(r == 1)
+                    return m;
+            }
+        }
+        
+        /**
+         * The width of each transform.
+         *
+         * \return The width of each (real) transform.
+         */
+        unsigned int width() const
+        {
+            return m_width;
+        }
+        
+        /**
+         * The height of each transform.
+         *
+         * \return The height of each transform.
+         */
+        unsigned int height() const
+        {
+            return m_height;
+        }
+        
+        /**
+         * The width of each transform's spectrum. Due to the symmetry of the
+         * spectra of real signals, this is width()/2+1.
+         *
+         * \return The width of each (complex) spectrum.
+         */
+        unsigned int spectrumWidth() const
+        {
+            return m_width/2+1;
+        }
+        
+        /**
+         * The number of transforms, which are computed at once.
+         *
+         * \return The batch count.
+         */
+        unsigned int batch() const
+        {
+            return m_batch;
+        }
+        
+        /**
+         * Computes the spectra of the whole batch. Both arrays have to be allocated
+         * by fftwf_malloc. The input will be kept.
+         *
+         * \param in  batch() real arrays of width()*height() floats each.
+         * \param out batch() complex arrays of spectrumWidth()*height() values each.
+         */
+        void forward(float* in, fftwf_complex* out) const
+        {
+            fftwf_execute_dft_r2c(m_forward, in, out);
+        }
+        
+        /**
+         * Computes the (unnormalized) inverse transforms of the whole batch. Both arrays
+         * have to be allocated by fftwf_malloc. The input will be overwritten.
+         *
+         * \param in  batch() complex arrays of spectrumWidth()*height() values each.
+         * \param out batch() real arrays of width()*height() floats each.
+         */
+        void backward(fftwf_complex* in, float* out) const
+        {
+            fftwf_execute_dft_c2r(m_backward, in, out);
+        }
+        
+    private:
+        /**
+         * Creates and measures the plans for one size and batch count.
+         * Only called by get(), while the mutex and vigra's FFTW lock are held.
+         *
+         * \param width  The width of each transform.
+         * \param height The height of each transform.
+         * \param batch  The number of transforms, which are computed at once.
+         */
+        FFTCorrelationPlan(unsigned int width, unsigned int height, unsigned int batch)
+        :   m_width(width),
+            m_height(height),
+            m_batch(batch)
+        {
+            int n[2] = {(int)height, (int)width};
+            int real_size = width*height,
+                spectrum_size = spectrumWidth()*height;
+            
+            //Measuring overwrites the arrays, thus we use temporary ones
+            float* real = (float*) fftwf_malloc(sizeof(float)*real_size*batch);
+            fftwf_complex* spectrum = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*spectrum_size*batch);
+            
+            m_forward  = fftwf_plan_many_dft_r2c(2, n, batch,
+                                                 real, NULL, 1, real_size,
+                                                 spectrum, NULL, 1, spectrum_size,
+                                                 FFTW_MEASURE);
+            m_backward = fftwf_plan_many_dft_c2r(2, n, batch,
+                                                 spectrum, NULL, 1, spectrum_size,
+                                                 real, NULL, 1, real_size,
+                                                 FFTW_MEASURE);
+            fftwf_free(real);
+            fftwf_free(spectrum);
+        }
+        
+        /**
+         * The file, where the FFTW wisdom is kept between the runs.
+         *
+         * \return The filename of the wisdom file.
+         */
+        static QString wisdomFilename()
+        {
+            return QDir::homePath() + "/.graipe/fftwf_wisdom";
+        }
+        
+        //The size and count of the transforms
+        unsigned int m_width, m_height, m_batch;
+        
+        //The plans
+        fftwf_plan m_forward, m_backward;
+};
+
+/**
+ * The geometry of a single correlation: A (possibly border-clipped) search
+ * window in the search image and the upper left corner of the template in
+ * the template image.
+ */
+struct CorrelationWindow
+{
+    /** The upper left corner of the search window in the search image **/
+    vigra::Shape2 search_begin;
+    /** The lower right corner (exclusive) of the search window in the search image **/
+    vigra::Shape2 search_end;
+    /** The upper left corner of the template in the template image **/
+    vigra::Shape2 mask_begin;
+};
+
+/**
+ * Batched (normalized) cross correlation of many templates against their search
+ * windows in a common search image. It replaces the per-feature calls of
+ * vigra::fastNormalizedCrossCorrelation and vigra::fastCrossCorrelation.
+ *
+ * All windows are zero-padded to one FFT-friendly size, such that a single FFTW plan
+ * transforms batchSize() windows and templates at once. For the normalization, the
+ * sums and squared sums of the search image are computed once as integral images
+ * and then shared by all (overlapping) windows.
+ *
+ * The results follow the vigra conventions: Each result has the shape of its search
+ * window, holds the correlation of the template centered at each position and is
+ * zero where the template does not fit completely into the window.
+ */
+class BatchedCorrelation
+{
+    public:
+        /**
+         * Per-thread scratch memory for the correlation of one batch.
+         */
+        class Scratch
+        {
+            public:
+                /**
+                 * Allocates the scratch memory for a correlation engine.
+                 *
+                 * \param corr The correlation engine, which will use this memory.
+                 */
+                Scratch(const BatchedCorrelation& corr)
+                {
+                    const FFTCorrelationPlan& plan = corr.plan();
+                    
+                    m_real_size = plan.width()*plan.height();
+                    m_spectrum_size = plan.spectrumWidth()*plan.height();
+                    
+                    m_windows   = (float*) fftwf_malloc(sizeof(float)*m_real_size*plan.batch());
+                    m_masks     = (float*) fftwf_malloc(sizeof(float)*m_real_size*plan.batch());
+                    m_window_spectra = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*m_spectrum_size*plan.batch());
+                    m_mask_spectra   = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*m_spectrum_size*plan.batch());
+                }
+                
+                /**
+                 * Frees the scratch memory.
+                 */
+                ~Scratch()
+                {
+                    fftwf_free(m_windows);
+                    fftwf_free(m_masks);
+                    fftwf_free(m_window_spectra);
+                    fftwf_free(m_mask_spectra);
+                }
+                
+            private:
+                Scratch(const Scratch&);
+                Scratch& operator=(const Scratch&);
+                
+                friend class BatchedCorrelation;
+                
+                //The sizes of each transform
+                unsigned int m_real_size, m_spectrum_size;
+                
+                //The windows, templates and their spectra of a batch
+                float* m_windows;
+                float* m_masks;
+                fftwf_complex* m_window_spectra;
+                fftwf_complex* m_mask_spectra;
+        };
+        
+        /**
+         * Prepares the correlation of templates against a search image. This creates
+         * (or reuses) the FFTW plan and, if normalized, the integral images.
+         *
+         * \param search_image The image, where we search in.
+         * \param mask_width  The (odd) width of each template.
+         * \param mask_height The (odd) height of each template.
+         * \param max_width   The maximal width of the search windows.
+         * \param max_height  The maximal height of the search windows.
+         * \param normalized  If true, the normalized cross correlation is computed.
+         * \param batch_size  The number of correlations, which are computed at once.
+         */
+        BatchedCorrelation(const vigra::MultiArrayView<2,float>& search_image,
+                           unsigned int mask_width, unsigned int mask_height,
+                           unsigned int max_width, unsigned int max_height,
+                           bool normalized,
+                           unsigned int batch_size = 16)
+        :   m_search_image(search_image),
+            m_mask_width(mask_width),
+            m_mask_height(mask_height),
+            m_normalized(normalized),
+            m_plan(&FFTCorrelationPlan::get(FFTCorrelationPlan::fftSize(max_width),
+                                            FFTCorrelationPlan::fftSize(max_height),
+                                            batch_size))
+        {
+            vigra_precondition(mask_width % 2 == 1 && mask_height % 2 == 1, "BatchedCorrelation: mask sizes must be odd!");
+            
+            if(m_normalized)
+            {
+                //Integral images of the values and squared values (with an additional zero row and column)
+                m_sum.reshape(search_image.shape() + vigra::Shape2(1,1), 0.0);
+                m_sq_sum.reshape(search_image.shape() + vigra::Shape2(1,1), 0.0);
+                
+                for(int y=0; y<search_image.height(); ++y)
+                {
+                    double row_sum = 0, row_sq_sum = 0;
+                    
+                    for(int x=0; x<search_image.width(); ++x)
+                    {
+                        double v = search_image(x,y);
+                        row_sum    += v;
+                        row_sq_sum += v*v;
+                        
+                        m_sum(x+1,y+1)    = m_sum(x+1,y)    + row_sum;
+                        m_sq_sum(x+1,y+1) = m_sq_sum(x+1,y) + row_sq_sum;
+                    }
+                }
+            }
+        }
+        
+        /**
+         * The number of correlations, which are computed at once by correlate().
+         *
+         * \return The batch size.
+         */
+        unsigned int batchSize() const
+        {
+            return m_plan->batch();
+        }
+        
+        /**
+         * The FFTW plan used by this correlation.
+         *
+         * \return The plan.
+         */
+        const FFTCorrelationPlan& plan() const
+        {
+            return *m_plan;
+        }
+        
+        /**
+         * Correlates up to batchSize() templates against their search windows. Thread-safe,
+         * as long as each thread uses its own scratch memory.
+         *
+         * \param template_image The image, where the templates are taken from.
+         * \param windows The geometry of each correlation.
+         * \param results The results. For each window, the upper left part of the
+         *                corresponding result (of the window's size) will be written.
+         * \param scratch The scratch memory of the calling thread.
+         */
+        void correlate(const vigra::MultiArrayView<2,float>& template_image,
+                       const std::vector<CorrelationWindow>& windows,
+                       std::vector<vigra::MultiArray<2,float> >& results,
+                       Scratch& scratch) const
+        {
+            using namespace ::vigra;
+            
+            vigra_precondition(windows.size() <= batchSize(), "BatchedCorrelation: too many windows for one batch!");
+            vigra_precondition(results.size() >= windows.size(), "BatchedCorrelation: not enough results!");
+            
+            const unsigned int fft_w = m_plan->width(),
+                               fft_h = m_plan->height(),
+                               spectrum_w = m_plan->spectrumWidth(),
+                               mask_size = m_mask_width*m_mask_height;
+            
+            std::fill(scratch.m_windows, scratch.m_windows + scratch.m_real_size*batchSize(), 0.0f);
+            std::fill(scratch.m_masks,   scratch.m_masks   + scratch.m_real_size*batchSize(), 0.0f);
+            
+            //Copy the windows and (zero-mean, unit-norm if normalized) templates to the batch
+            for(unsigned int k=0; k<windows.size(); ++k)
+            {
+                const CorrelationWindow& wnd = windows[k];
+                
+                vigra_precondition(     wnd.search_end[0] - wnd.search_begin[0] <= (int)fft_w
+                                   &&   wnd.search_end[1] - wnd.search_begin[1] <= (int)fft_h,
+                                   "BatchedCorrelation: search window larger than the maximal size!");
+                
+                float* dest = scratch.m_windows + k*scratch.m_real_size;
+                
+                for(int y=wnd.search_begin[1]; y<wnd.search_end[1]; ++y)
+                {
+                    for(int x=wnd.search_begin[0]; x<wnd.search_end[0]; ++x)
+                    {
+                        dest[(y-wnd.search_begin[1])*fft_w + x-wnd.search_begin[0]] = m_search_image(x,y);
+                    }
+                }
+                
+                MultiArrayView<2,float> mask = template_image.subarray(wnd.mask_begin, wnd.mask_begin + Shape2(m_mask_width, m_mask_height));
+                double mean = 0, norm = 1;
+                
+                if(m_normalized)
+                {
+                    double sum = 0, sq_sum = 0;
+                    
+                    for(auto it=mask.begin(); it!=mask.end(); ++it)
+                    {
+                        sum    += *it;
+                        sq_sum += double(*it)*(*it);
+                    }
+                    mean = sum/mask_size;
+                    norm = std::sqrt(std::max(0.0, sq_sum - sum*mean));
+                }
+                
+                //A constant template does not correlate with anything
+                if(norm == 0)
+                    continue;
+                
+                dest = scratch.m_masks + k*scratch.m_real_size;
+                
+                for(unsigned int y=0; y<m_mask_height; ++y)
+                {
+                    for(unsigned int x=0; x<m_mask_width; ++x)
+                    {
+                        dest[y*fft_w + x] = (mask(x,y) - mean)/norm;
+                    }
+                }
+            }
+            
+            m_plan->forward(scratch.m_windows, scratch.m_window_spectra);
+            m_plan->forward(scratch.m_masks,   scratch.m_mask_spectra);
+            
+            //The cross correlation is the product of the window's spectrum with the conjugated template's spectrum
+            const float scale = 1.0f/(fft_w*fft_h);
+            
+            for(unsigned int k=0; k<windows.size(); ++k)
+            {
+                fftwf_complex* w = scratch.m_window_spectra + k*scratch.m_spectrum_size;
+                const fftwf_complex* m = scratch.m_mask_spectra + k*scratch.m_spectrum_size;
+                
+                for(unsigned int j=0; j<spectrum_w*fft_h; ++j)
+                {
+                    float re = w[j][0]*m[j][0] + w[j][1]*m[j][1],
+                          im = w[j][1]*m[j][0] - w[j][0]*m[j][1];
+                    w[j][0] = re*scale;
+                    w[j][1] = im*scale;
+                }
+            }
+            
+            m_plan->backward(scratch.m_window_spectra, scratch.m_windows);
+            
+            //Shift the correlations to the templates' centers and normalize them
+            for(unsigned int k=0; k<windows.size(); ++k)
+            {
+                const CorrelationWindow& wnd = windows[k];
+                const float* corr = scratch.m_windows + k*scratch.m_real_size;
+                
+                const int window_w = wnd.search_end[0] - wnd.search_begin[0],
+                          window_h = wnd.search_end[1] - wnd.search_begin[1];
+                
+                MultiArrayView<2,float> res = results[k].subarray(Shape2(0,0), Shape2(window_w, window_h));
+                res.init(0);
+                
+                for(int y=0; y+(int)m_mask_height<=window_h; ++y)
+                {
+                    for(int x=0; x+(int)m_mask_width<=window_w; ++x)
+                    {
+                        float value = corr[y*fft_w + x];
+                        
+                        if(m_normalized)
+                        {
+                            int x0 = wnd.search_begin[0] + x, x1 = x0 + m_mask_width,
+                                y0 = wnd.search_begin[1] + y, y1 = y0 + m_mask_height;
+                            
+                            double sum    = m_sum(x1,y1)    - m_sum(x0,y1)    - m_sum(x1,y0)    + m_sum(x0,y0),
+                                   sq_sum = m_sq_sum(x1,y1) - m_sq_sum(x0,y1) - m_sq_sum(x1,y0) + m_sq_sum(x0,y0),
+                                   var    = sq_sum - sum*sum/mask_size;
+                            
+                            //Treat (numerically) constant image regions as uncorrelated
+                            value = (var > 1.0e-10*sq_sum) ? value/std::sqrt(var) : 0.0f;
+                        }
+                        res(x + m_mask_width/2, y + m_mask_height/2) = value;
+                    }
+                }
+            }
+        }
+        
+    private:
+        //The image, where we search in
+        vigra::MultiArrayView<2,float> m_search_image;
+        
+        //The size of the templates
+        unsigned int m_mask_width, m_mask_height;
+        
+        //Normalized or plain cross correlation?
+        bool m_normalized;
+        
+        //The plan for one batch
+        const FFTCorrelationPlan* m_plan;
+        
+        //Integral images of the search image's values and squared values
+        vigra::MultiArray<2,double> m_sum, m_sq_sum;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_FEATUREMATCHING_FFTCORRELATION_HXX
@@ -47,6 +47,16 @@
 #include "features2d/features2d.h"
 #include "vectorfields/vectorfields.h"
 #include "registration/registration.h"
+#include "core/cancellation.hxx"
+#include "core/parallel.hxx"
+#include "featurematching/featureindex.hxx"
+#include "featurematching/fftcorrelation.hxx"
+
+#include <QString>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 namespace graipe {
 
@@ -114,11 +124,80 @@ public:
     }
 };
 
+/**
+ * Tells matchFeaturesToImage, if a matching functor may be replaced by the
+ * BatchedCorrelation. Other functors are called for each feature.
+ *
+ * \param func The matching functor.
+ * \param[out] normalized If batched, this tells if the correlation is normalized.
+ * \return Always false for arbitrary functors.
+ */
+template <class MatchingFunctor>
+bool batchedCorrelationMode(const MatchingFunctor& func, bool& normalized)
+{
+    return false;
+}
+
+/**
+ * The fast normalized cross correlation is computed by the BatchedCorrelation.
+ *
+ * \param func The matching functor.
+ * \param[out] normalized Always true.
+ * \return Always true.
+ */
+inline bool batchedCorrelationMode(const FastNCCFunctor& func, bool& normalized)
+{
+    normalized = true;
+    return true;
+}
+
+/**
+ * The fast cross correlation is computed by the BatchedCorrelation.
+ *
+ * \param func The matching functor.
+ * \param[out] normalized Always false.
+ * \return Always true.
+ */
+inline bool batchedCorrelationMode(const FastCCFunctor& func, bool& normalized)
+{
+    normalized = false;
+    return true;
+}
+
+/**
+ * Appends the values of a two-dimensional array row by row to a diagnostics string.
+ *
+ * \param str The string, which will be extended.
+ * \param title A title, which is written in front of the values.
+ * \param arr The array to be written.
+ */
+template <class ArrayView>
+void appendArrayToDebugString(QString& str, const QString& title, const ArrayView& arr)
+{
+    str += QString("\n%1 (%2, %3):").arg(title).arg(arr.width()).arg(arr.height());
+    
+    for(int y=0; y<arr.height(); y++)
+    {
+        str += "\n";
+        for(int x=0; x<arr.width(); x++)
+        {
+            str += QString::number(arr(x,y)) + ", ";
+        }
+    }
+}
+
 /** 
  * Feature matching using features of the first image and an area at the second image to search for
  * the N most likely positions of the second image.
  * This function returns a (probability-)weighted 2-dimensional multi vectorfield holding the results.
  *
+ * The features are matched in parallel blocks. Each block uses its own copy of the matching functor
+ * and its own correlation result buffers. The matches are collected per feature and added to the
+ * vectorfield at once, in the order of the features.
+ *
+ * For the FastNCCFunctor and the FastCCFunctor, the correlations are computed by a
+ * BatchedCorrelation instead of calling the functor for each feature.
+ *
  * \param src1 The first image.
  * \param src2 The second image.
  * \param features The features of the first image.
@@ -132,6 +211,8 @@ public:
  * \param rotation_correlation If use_global is true, this keeps rotation correlation coefficient.
  * \param translation_correlation If use_global is true, this keeps translation correlation coefficient.
  * \param used_max_distance If use_global is true, this contains the used search distance after the gme.
+ * \param verbose If true, the search window, mask, correlation result and candidates of each
+ *                feature will be written to the debug output. Very slow, for diagnostics only.
  * \return A Sparse weighted multi vectorfield containing all found matches.
  */
 template <class T1, class T2, class MatchingFunctor>
@@ -145,11 +226,15 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToImage(const vigra::MultiArrayVi
                                                        bool use_global,
                                                        vigra::Matrix<double>& mat,
                                                        double & rotation_correlation, double & translation_correlation,
-                                                       unsigned int & used_max_distance)
+                                                       unsigned int & used_max_distance,
+                                                       bool verbose = false)
 {
     vigra_precondition(src1.shape() == src2.shape(), "image shapes differ!");
     
-    qDebug() << "Mask size: (" << mask_width<< ", " << mask_height << ")";
+    if(verbose)
+    {
+        qDebug() << "Mask size: (" << mask_width<< ", " << mask_height << ")";
+    }
     
     using namespace ::std;
     using namespace ::vigra;
@@ -157,9 +242,6 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToImage(const vigra::MultiArrayVi
 	unsigned int work_w   = (unsigned int) src1.width(),
                  work_h   = (unsigned int) src1.height();
 	
-	vigra::MultiArray<2,T2> s2_temp(src2.shape());
-	s2_temp.init(0);
-	
     mat = vigra::identityMatrix<double>(3);
     
     if(use_global)
@@ -176,119 +258,164 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToImage(const vigra::MultiArrayVi
 	
     unsigned int result_w = used_max_distance*2+mask_width+1,
 			     result_h = used_max_distance*2+mask_height+1;
-    
-	///Create result image (will be used / updated for each features correlation)
-	MultiArray<2,float>	result(result_w, result_h);
 	
 	//Create resulting vectorfield
 	SparseWeightedMultiVectorfield2D* result_vf = new SparseWeightedMultiVectorfield2D(features.workspace());
 	
-	
-	for(unsigned int i=0 ; i < features.size(); ++i)
+    typedef typename Vectorfield2D::PointType PointType;
+    
+    //One slot per feature, each of them is written by exactly one block
+    vector<PointType>           origins(features.size());
+    vector<vector<PointType> >  directions(features.size());
+    vector<vector<float> >      weights(features.size());
+    
+    MultiArrayView<2,float> s1(src1), s2(src2);
+    
+    //The FFT-based functors are replaced by the batched correlation, which plans and
+    //transforms many windows at once and shares the search image's integral images
+    bool normalized = false;
+    unique_ptr<BatchedCorrelation> batched;
+    
+    if(batchedCorrelationMode(func, normalized))
     {
-        unsigned int s1_x = vigra::round(features.position(i).x()),
-                     s1_y = vigra::round(features.position(i).y());
-		
-		//Assure that source and transformed target coordinates are within mask bounds
-		if(		s1_y  > mask_height/2	&& s1_y  < work_h-mask_height/2
-			&&	s1_x  > mask_width/2	&& s1_x  < work_w-mask_width/2)
-		{
-			result.init(0);
-			
-			//Border threatment
-			unsigned int search_upper = std::max((unsigned int) 0,		(unsigned int) (s1_y-used_max_distance-mask_height/2)),
-                         search_left  = std::max((unsigned int) 0,		(unsigned int) (s1_x-used_max_distance-mask_width/2)),
-                         search_lower = std::min(work_h,	(s1_y+used_max_distance+mask_height/2+1)),
-                         search_right = std::min(work_w,	(s1_x+used_max_distance+mask_width/2+1)),
-                         search_w = search_right - search_left,
-                         search_h = search_lower - search_upper;
-			
-            MultiArrayView<2,float> s1(src1), s2(src2);
-            
-            //do the fast ncc
-			func( s2.subarray( Shape2(search_left, search_upper), Shape2(search_right, search_lower)),
-				  s1.subarray( Shape2(s1_x-mask_width/2, s1_y-mask_height/2),  Shape2(s1_x+mask_width/2+1, s1_y+mask_height/2+1)),
-                  result.subarray(Shape2(0,0), Shape2(search_w,search_h)));
-			
-			
-			unsigned int	result_w = search_right-search_left,
-							result_h = search_lower-search_upper,
-							max_x	 = result_w/2,
-							max_y	 = result_h/2;
-            
-			typedef typename Vectorfield2D::PointType PointType;
-			vector<PointType>	directions(n_candidates);
-			vector<float>		weights(n_candidates);
-			
-            
-                qDebug() << "\nSource: (" << search_w<<", " << search_h<< ")";
-				for(unsigned int r_y=0; r_y<search_h; r_y++)
-				{
-                    qDebug() << "\n";
-					for(unsigned int r_x=0; r_x<search_w; r_x++)
-					{
-                        qDebug() << s2.subarray( Shape2(search_left, search_upper), Shape2(search_right, search_lower))(r_x,r_y) << ", ";
-                    }
-                }
-            
-                qDebug() << "\nMask (" << mask_width<<", " << mask_height<< ")";
-				for(unsigned int r_y=0; r_y<mask_height; r_y++)
-				{
-                    qDebug() << "\n";
-					for(unsigned int r_x=0; r_x<mask_width; r_x++)
-					{
-                        qDebug() <<  s1.subarray( Shape2(s1_x-mask_width/2, s1_y-mask_height/2),  Shape2(s1_x+mask_width/2+1, s1_y+mask_height/2+1))(r_x,r_y) << ", ";
+        batched.reset(new BatchedCorrelation(s2, mask_width/2*2+1, mask_height/2*2+1, result_w, result_h, normalized));
+    }
+    
+    const unsigned int block_size = 64,
+                       blocks = (features.size() + block_size - 1)/block_size,
+                       batch_size = batched ? batched->batchSize() : 1;
+    
+    parallelFor(blocks,
+                [&](unsigned int b)
+                {
+                    //Result images of this block (will be used / updated for each batch of correlations)
+                    vector<MultiArray<2,float> > results(batch_size, MultiArray<2,float>(Shape2(result_w, result_h)));
+                    vector<CorrelationWindow> windows;
+                    vector<unsigned int> indices;
+                    
+                    unique_ptr<BatchedCorrelation::Scratch> scratch;
+                    if(batched)
+                    {
+                        scratch.reset(new BatchedCorrelation::Scratch(*batched));
                     }
-                }
-            
-                qDebug()<< "\nResult:";
-				for(unsigned int r_y=0; r_y<result_h; r_y++)
-				{
-                    qDebug() << "\n";
-					for(unsigned int r_x=0; r_x<result_w; r_x++)
-					{
-                        qDebug() << result(r_x,r_y) << ", ";
+                    MatchingFunctor block_func(func);
+                    
+                    const unsigned int block_end = min((b+1)*block_size, features.size());
+                    
+                    for(unsigned int batch_begin=b*block_size; batch_begin<block_end; batch_begin+=batch_size)
+                    {
+                        windows.clear();
+                        indices.clear();
+                        
+                        for(unsigned int i=batch_begin; i<min(batch_begin+batch_size, block_end); ++i)
+                        {
+                            unsigned int s1_x = vigra::round(features.position(i).x()),
+                                         s1_y = vigra::round(features.position(i).y());
+                            
+                            //Assure that source and transformed target coordinates are within mask bounds
+                            if(		s1_y  > mask_height/2	&& s1_y  < work_h-mask_height/2
+                                &&	s1_x  > mask_width/2	&& s1_x  < work_w-mask_width/2)
+                            {
+                                //Border threatment
+                                CorrelationWindow wnd;
+                                wnd.search_begin = Shape2(std::max(0, int(s1_x)-int(used_max_distance)-int(mask_width/2)),
+                                                          std::max(0, int(s1_y)-int(used_max_distance)-int(mask_height/2)));
+                                wnd.search_end   = Shape2(std::min(work_w, s1_x+used_max_distance+mask_width/2+1),
+                                                          std::min(work_h, s1_y+used_max_distance+mask_height/2+1));
+                                wnd.mask_begin   = Shape2(s1_x-mask_width/2, s1_y-mask_height/2);
+                                
+                                windows.push_back(wnd);
+                                indices.push_back(i);
+                            }
+                        }
+                        
+                        CancellationToken::checkCurrent();
+                        
+                        if(batched)
+                        {
+                            batched->correlate(s1, windows, results, *scratch);
+                        }
+                        else
+                        {
+                            for(unsigned int k=0; k<windows.size(); ++k)
+                            {
+                                const CorrelationWindow& wnd = windows[k];
+                                
+                                results[k].init(0);
+                                
+                                //do the fast ncc
+                                block_func(s2.subarray(wnd.search_begin, wnd.search_end),
+                                           s1.subarray(wnd.mask_begin, wnd.mask_begin + Shape2(mask_width/2*2+1, mask_height/2*2+1)),
+                                           results[k].subarray(Shape2(0,0), wnd.search_end - wnd.search_begin));
+                            }
+                        }
+                        
+                        for(unsigned int k=0; k<windows.size(); ++k)
+                        {
+                            const CorrelationWindow& wnd = windows[k];
+                            MultiArray<2,float>& result = results[k];
+                            
+                            unsigned int i = indices[k],
+                                         s1_x = wnd.mask_begin[0] + mask_width/2,
+                                         s1_y = wnd.mask_begin[1] + mask_height/2,
+                                         search_left  = wnd.search_begin[0],
+                                         search_upper = wnd.search_begin[1],
+                                         search_w = wnd.search_end[0] - wnd.search_begin[0],
+                                         search_h = wnd.search_end[1] - wnd.search_begin[1],
+                                         max_x = search_w/2,
+                                         max_y = search_h/2;
+                            
+                            QString debug_str;
+                            
+                            if(verbose)
+                            {
+                                debug_str = QString("Feature %1 at (%2, %3):").arg(i).arg(s1_x).arg(s1_y);
+                                appendArrayToDebugString(debug_str, "Source", s2.subarray(wnd.search_begin, wnd.search_end));
+                                appendArrayToDebugString(debug_str, "Mask",   s1.subarray(wnd.mask_begin, wnd.mask_begin + Shape2(mask_width/2*2+1, mask_height/2*2+1)));
+                                appendArrayToDebugString(debug_str, "Result", result.subarray(Shape2(0,0), Shape2(search_w, search_h)));
+                                debug_str += "\nCandidates:";
+                            }
+                            
+                            origins[i] = PointType(s1_x, s1_y);
+                            directions[i].resize(n_candidates);
+                            weights[i].resize(n_candidates);
+                            
+                            //collect N local maxima from the result image
+                            for(unsigned int c=0; c<n_candidates; c++)
+                            {
+                                for(unsigned int r_y=0; r_y<search_h; r_y++)
+                                {
+                                    for(unsigned int r_x=0; r_x<search_w; r_x++)
+                                    {
+                                        if(result(r_x,r_y) > result(max_x,max_y))
+                                        {
+                                            max_x=r_x; max_y=r_y;
+                                        }
+                                    }
+                                }
+                                unsigned int s2_x = search_left  + max_x,
+                                             s2_y = search_upper + max_y;
+                                
+                                directions[i][c] = PointType(float(s2_x) - s1_x, float(s2_y) - s1_y);
+                                weights[i][c]    = result(max_x,max_y);
+                                result(max_x,max_y)=0;
+                                
+                                if(verbose)
+                                {
+                                    debug_str += QString("\n(%1, %2): %3").arg(s2_x).arg(s2_y).arg(weights[i][c]);
+                                }
+                            }
+                            
+                            if(verbose)
+                            {
+                                qDebug().noquote() << debug_str;
+                            }
+                        }
                     }
-                }
-            
-			//collect N local maxima from the result image
-			for(unsigned int c=0; c<n_candidates; c++)
-			{
-                qDebug()<< "\n";
-				for(unsigned int r_y=0; r_y<result_h; r_y++)
-				{
-                    qDebug() << "\n";
-					for(unsigned int r_x=0; r_x<result_w; r_x++)
-					{
-                        qDebug() << result(r_x,r_y) << ", ";
-						if(	//	(r_x-result_w/2.0)*(r_x-result_w/2.0) + (r_y-result_h/2.0)*(r_y-result_h/2.0) < used_max_distance*used_max_distance
-						   result(r_x,r_y) > result(max_x,max_y)
-						   /*&&	result(r_x,r_y) > result(r_x-1,r_y-1)	&& result(r_x,r_y) > result(r_x,r_y-1)	&& result(r_x,r_y) > result(r_x+1,r_y-1)
-						   &&	result(r_x,r_y) > result(r_x-1,r_y)												&& result(r_x,r_y) > result(r_x+1,r_y) 
-						   &&	result(r_x,r_y) > result(r_x-1,r_y+1)	&& result(r_x,r_y) > result(r_x,r_y+1)	&& result(r_x,r_y) > result(r_x+1,r_y+1)
-                            */)
-	  					{
-							max_x=r_x; max_y=r_y;
-						}
-					}
-				}
-				unsigned int s2_x = search_left  + max_x,
-							 s2_y = search_upper + max_y;
-				
-				//s2 is in s1's coordinate system --> transform bach to I2's coords
-				float	s2t_x = s2_x,//*mat(0,0) + s2_y*mat(0,1) + mat(0,2),
-						s2t_y = s2_y;//s2_x*mat(1,0) + s2_y*mat(1,1) + mat(1,2);
-				
-				directions[c] = PointType(s2t_x - s1_x, s2t_y - s1_y);
-				weights[c]   =  result(max_x,max_y);
-				result(max_x,max_y)=0;
-			}
-			if(weights.size()>0)
-			{
-				result_vf->addVector(PointType(s1_x,s1_y),directions,weights);
-			}
-		}
-	}
+                });
+    
+    //Features outside the mask bounds have no directions and will be skipped
+    result_vf->addVectors(origins, directions, weights);
     
     //affineMat contains I2 -> I1 get I2->I1
     vigra::Matrix<double> imat = vigra::identityMatrix<double>(3);
@@ -492,9 +619,15 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToFeatures(const vigra::MultiArra
 	
 	//Create resulting vectorfield
 	SparseWeightedMultiVectorfield2D*  result_vf = new SparseWeightedMultiVectorfield2D(s1_features.workspace());
+    
+    //Index the transformed s2 features once, to query only those near each s1 feature
+    PointFeatureIndex2D s2_index(s2_features, used_max_distance, mat);
+    vector<unsigned int> s2_candidates;
 		
 	for(unsigned int i=0 ; i < s1_features.size(); ++i)
 	{ 
+        CancellationToken::checkCurrent();
+        
         //Source image point coordinates
         unsigned int s1_x = vigra::round(s1_features.position(i).x()),
 					 s1_y = vigra::round(s1_features.position(i).y());
@@ -505,7 +638,9 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToFeatures(const vigra::MultiArra
 		{
 			list<WeightedTarget2D>		candidates_list;
 			
-			for(unsigned int j=0 ; j < s2_features.size(); ++j)
+            s2_index.candidates(s1_x, s1_y, used_max_distance, s2_candidates);
+            
+			for(unsigned int j : s2_candidates)
 			{ 
                 //Destination image point coordinates
                 int s2_x = vigra::round(s2_features.position(j).x()),
@@ -513,8 +648,8 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToFeatures(const vigra::MultiArra
                 
                 
                 //s2 is in s1's coordinate system --> transform bach to I2's coords
-                float	s2t_x = s2_x*mat(0,0) + s2_y*mat(0,1) + mat(0,2),
-                        s2t_y = s2_x*mat(1,0) + s2_y*mat(1,1) + mat(1,2);
+                float	s2t_x = s2_index.position(j)[0],
+                        s2t_y = s2_index.position(j)[1];
 				
 				//Assure that source and transformed target coordinates are within mask bounds (and within search space)
 				if(		(s1_x-s2t_x)*(s1_x-s2t_x) + (s1_y-s2t_y)*(s1_y-s2t_y) < used_max_distance*used_max_distance
@@ -595,21 +730,28 @@ std::vector<vigra::MultiArray<2, unsigned int> > createShapeContexts(PointFeatur
 	int radius_bins = int(log(max_radius))+1;
 	
 	vector<vigra::MultiArray<2, unsigned int> > shape_contexts;
+    
+    PointFeatureIndex2D index(features, max_radius);
+    vector<unsigned int> neighbors;
 
 	for(unsigned int i=0 ; i < features.size(); ++i)
     {
+        CancellationToken::checkCurrent();
+        
 		//Source image point coordinates
 		int s1_x = vigra::round(features.position(i).x()),
             s1_y = vigra::round(features.position(i).y());
 		
 		//create new shape context image for ith feature
 		vigra::MultiArray<2, unsigned int> shape_context(angle_bins,radius_bins);
+        
+        index.candidates(s1_x, s1_y, max_radius, neighbors);
 				 
-		for(unsigned int j=0 ; j < features.size(); ++j)
+		for(unsigned int j : neighbors)
         {
             //Destination image point coordinates
-            int s2_x = vigra::round(features.position(j).x()),
-                s2_y = vigra::round(features.position(j).y());
+            int s2_x = index.position(j)[0],
+                s2_y = index.position(j)[1];
 				 
 			//Test if potential target is within radius distance
 			float dist2 = (s1_x-s2_x)*(s1_x-s2_x) + (s1_y-s2_y)*(s1_y-s2_y);
@@ -720,9 +862,15 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToFeaturesUsingShapeContext(const
 	//1. step: build shape context
 	vector<vigra::MultiArray<2, unsigned int> >  shape_contexts1 = createShapeContexts(s1_features, max_radius, angle_bins),
                                                  shape_contexts2 = createShapeContexts(s2_features, max_radius, angle_bins);
+    
+    //2. step: index the transformed s2 features for the search
+    PointFeatureIndex2D s2_index(s2_features, used_max_distance, mat);
+    vector<unsigned int> s2_candidates;
 	
 	for(unsigned int i=0 ; i < s1_features.size(); ++i)
 	{ 
+        CancellationToken::checkCurrent();
+        
         //Source image point coordinates
         int s1_x = vigra::round(s1_features.position(i).x()),
             s1_y = vigra::round(s1_features.position(i).y());
@@ -732,15 +880,17 @@ SparseWeightedMultiVectorfield2D* matchFeaturesToFeaturesUsingShapeContext(const
         {
 			list<WeightedTarget2D>		candidates_list;
 			
-			for(unsigned int j=0 ; j < s2_features.size(); ++j)
+            s2_index.candidates(s1_x, s1_y, used_max_distance, s2_candidates);
+            
+			for(unsigned int j : s2_candidates)
 			{ 
                 //Destination image point coordinates
                 int s2_x = vigra::round(s2_features.position(j).x()),
                     s2_y = vigra::round(s2_features.position(j).y());
                 
                 //s2 is in s1's coordinate system --> transform bach to I2's coords
-                float	s2t_x = s2_x*mat(0,0) + s2_y*mat(0,1) + mat(0,2),
-                        s2t_y = s2_x*mat(1,0) + s2_y*mat(1,1) + mat(1,2);
+                float	s2t_x = s2_index.position(j)[0],
+                        s2t_y = s2_index.position(j)[1];
 				
 				//Assure that source and transformed target coordinates are within search space
 				if(	shape_contexts2[j](0,0)!=-1
@@ -45,6 +45,15 @@
 #include "features2d/features2d.h"
 #include "vectorfields/vectorfields.h"
 #include "registration/registration.h"
+#include "core/cancellation.hxx"
+#include "core/parallel.hxx"
+#include "featurematching/featureindex.hxx"
+#include "featurematching/descriptorindex.hxx"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
 
 namespace graipe {
 
@@ -59,8 +68,12 @@ namespace graipe {
 /** 
  * Feature matching using sift features of the first image and sift features of the second image to search for
  * the N most likely features of the second image.
- * The algorithm is brute force: it finds the closest
- * and second-closest matches, and registers the the correspondence if the distance ratio is above a certain threshold.
+ * By default, the search is exact: All features of the second image within the geometrical search distance
+ * are compared by means of their descriptors' euclidean distance. Optionally, an approximate nearest neighbour
+ * index (see SIFTDescriptorIndex) is used instead, which is shared by all runs against the same second features.
+ * In this case, the 2*N nearest descriptors are searched first and then tested for their geometrical distance.
+ * If the ratio is below one, Lowe's ratio test is applied: A feature is only matched, if the distance to the
+ * closest candidate is below ratio times the distance to the second-closest candidate.
  * This function returns a (probability-)weighted 2-dimensional multi vectorfield holding the results.
  *
  * \param src1 The first image.
@@ -75,6 +88,9 @@ namespace graipe {
  * \param rotation_correlation If use_global is true, this keeps rotation correlation coefficient.
  * \param translation_correlation If use_global is true, this keeps translation correlation coefficient.
  * \param used_max_distance If use_global is true, this contains the used search distance after the gme.
+ * \param ratio The threshold of Lowe's ratio test. Use 1 to disable the test.
+ * \param use_ann Use the approximate nearest neighbour index for the descriptor search?
+ * \param ann_checks The maximal number of descriptor comparisons per feature of the approximate search.
  * \return A Sparse weighted multi vectorfield containing all found matches.
  */
 template <class T1, class T2>
@@ -88,7 +104,10 @@ SparseWeightedMultiVectorfield2D* matchSIFTFeaturesUsingDistance(const vigra::Mu
                                                                  bool use_global,
                                                                  vigra::Matrix<double> & mat,
                                                                  double & rotation_correlation, double & translation_correlation,
-                                                                 unsigned int & used_max_distance)
+                                                                 unsigned int & used_max_distance,
+                                                                 float ratio = 1.0,
+                                                                 bool use_ann = false,
+                                                                 unsigned int ann_checks = 512)
 {
     using namespace ::std;
     using namespace ::vigra;
@@ -111,52 +130,105 @@ SparseWeightedMultiVectorfield2D* matchSIFTFeaturesUsingDistance(const vigra::Mu
     //Create resulting vectorfield
     SparseWeightedMultiVectorfield2D* result_vf = new SparseWeightedMultiVectorfield2D(points1.workspace());
     
+    //Index the transformed points2 once, to query only those near each of points1
+    PointFeatureIndex2D index2(points2, used_max_distance, mat);
+    
+    //Contiguous descriptors of points2 (indexed for the approximate search) and of points1
+    shared_ptr<const SIFTDescriptorIndex> descr_index2;
+    unique_ptr<DescriptorMatrix> plain_descr2;
+    
+    if(use_ann)
+    {
+        descr_index2 = SIFTDescriptorIndex::cached(points2);
+    }
+    else
+    {
+        plain_descr2.reset(new DescriptorMatrix(points2));
+    }
+    
+    const DescriptorMatrix& descr2 = use_ann ? descr_index2->descriptors() : *plain_descr2;
+    DescriptorMatrix descr1(points1, descr2.dim());
+    
+    //The sorted candidates of each feature of points1
+    vector<vector<WeightedTarget2D> > matches(points1.size());
+    
+    const unsigned int block_size = 256,
+                       blocks = (points1.size() + block_size - 1)/block_size;
+    
+    parallelFor(blocks,
+                [&](unsigned int b)
+                {
+                    vector<unsigned int> candidates2;
+                    vector<float> distances2;
+                    SIFTDescriptorIndex::SearchState state;
+                    
+                    for(unsigned int i=b*block_size; i<min((b+1)*block_size, points1.size()); i++)
+                    {
+                        CancellationToken::checkCurrent();
+                        
+                        const float* di = descr1.row(i);
+                        vector<WeightedTarget2D>& candidates = matches[i];
+                        
+                        if(use_ann)
+                        {
+                            descr_index2->knnSearch(di, 2*max(2u, n_candidates), ann_checks, state, candidates2, distances2);
+                        }
+                        else
+                        {
+                            index2.candidates(points1.position(i).x(), points1.position(i).y(), used_max_distance, candidates2);
+                        }
+                        
+                        double min_distance = numeric_limits<double>::max(),
+                               min_distance2 = numeric_limits<double>::max();
+                        
+                        for(unsigned int c=0; c<candidates2.size(); c++)
+                        {
+                            unsigned int j = candidates2[c];
+                            
+                            float	s2t_x = index2.position(j)[0],
+                                    s2t_y = index2.position(j)[1];
+                            
+                            if(		(points1.position(i).x()-s2t_x)*(points1.position(i).x()-s2t_x)
+                               +	(points1.position(i).y()-s2t_y)*(points1.position(i).y()-s2t_y)
+                               >	used_max_distance*used_max_distance)
+                                continue;
+                            
+                            double distance = sqrt(use_ann ? distances2[c] : squaredDescriptorDistance(di, descr2.row(j), descr2.stride()));
+                            
+                            if(distance < min_distance)
+                            {
+                                min_distance2 = min_distance;
+                                min_distance = distance;
+                            }
+                            else if(distance < min_distance2)
+                            {
+                                min_distance2 = distance;
+                            }
+                            
+                            if(distance < max_descr_dist)     // smallest distance
+                            {
+                                WeightedTarget2D target;
+                                target.x=s2t_x;
+                                target.y=s2t_y;
+                                target.weight=distance;
+                                candidates.push_back(target);
+                            }
+                        }
+                        
+                        //Lowe's ratio test
+                        if(ratio < 1 && min_distance > ratio*min_distance2)
+                        {
+                            candidates.clear();
+                        }
+                        
+                        stable_sort(candidates.begin(), candidates.end());
+                        reverse(candidates.begin(), candidates.end());
+                    }
+                });
+    
     for(unsigned int i=0; i<points1.size(); i++)
     {
-        QVector<float> di = points1.descriptor(i);
-        list<WeightedTarget2D>		candidates_list;
-        
-        double min_distance = max_descr_dist;
-        
-        for(unsigned int j=0; j<points2.size(); j++)
-        {
-            QVector<float> dm = points2.descriptor(j);
-            
-            double distance = 0;
-            
-            int s2_x = vigra::round(points2.position(j).x()),
-                s2_y = vigra::round(points2.position(j).y());
-            
-            float	s2t_x = s2_x*mat(0,0) + s2_y*mat(0,1) + mat(0,2),
-                    s2t_y = s2_x*mat(1,0) + s2_y*mat(1,1) + mat(1,2);
-            
-            if(		(points1.position(i).x()-s2t_x)*(points1.position(i).x()-s2t_x)
-               +	(points1.position(i).y()-s2t_y)*(points1.position(i).y()-s2t_y)
-               >	used_max_distance*used_max_distance)
-                continue;
-            
-            for(unsigned int k=0; k<(unsigned int)di.size() && k<(unsigned int)dm.size(); k++)
-            {
-                distance += (di[k]-dm[k]) * (di[k]-dm[k]);
-            }
-            distance = sqrt(distance);
-            
-            if(distance < max_descr_dist)     // smallest distance
-            {
-                WeightedTarget2D target;
-                target.x=s2t_x;
-                target.y=s2t_y;
-                target.weight=distance;
-                candidates_list.push_back(target);
-                min_distance = std::min(distance,min_distance);
-            }
-            
-        }
-        //qDebug() << "min1 = " << min1 << ", min2 = " << min2
-        if(candidates_list.size()>0){
-            candidates_list.sort();
-            candidates_list.reverse();
-            
+        if(matches[i].size()>0){
             typedef Vectorfield2D::PointType PointType;
             vector<PointType>	dirs(n_candidates);
             vector<float>		weights(n_candidates);
@@ -169,8 +241,8 @@ SparseWeightedMultiVectorfield2D* matchSIFTFeaturesUsingDistance(const vigra::Mu
                 weights[c] = 0.0;
             }
             
-            list<WeightedTarget2D>::iterator iter = candidates_list.begin();
-            for(unsigned int c=0; c<n_candidates && iter!= candidates_list.end(); ++c, ++iter)
+            vector<WeightedTarget2D>::iterator iter = matches[i].begin();
+            for(unsigned int c=0; c<n_candidates && iter!= matches[i].end(); ++c, ++iter)
             {
                 dirs[c] = PointType(iter->x-points1.position(i).x(), iter->y-points1.position(i).y());
                 weights[c] = 1 - iter->weight;
@@ -34,6 +34,9 @@
 /************************************************************************/
 
 #include "features2d/featurelist.hxx"
+#include "core/binarycontainer.hxx"
+
+#include <algorithm>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -72,6 +75,11 @@ const PointFeatureList2D::PointType& PointFeatureList2D::position(unsigned int i
 	return m_points[index];		
 }
 
+const PointFeatureList2D::PointType* PointFeatureList2D::positions() const
+{
+	return m_points.constData();
+}
+
 void PointFeatureList2D::setPosition(unsigned int index, const PointType& new_p)
 { 
     if(locked())
@@ -102,6 +110,11 @@ void PointFeatureList2D::removeFeature(unsigned int index)
     }
 }
 
+void PointFeatureList2D::reserve(unsigned int count)
+{
+    m_points.reserve(count);
+}
+
 QString PointFeatureList2D::csvHeader() const
 {
 	return "pos_x, pos_y";
@@ -177,13 +190,10 @@ bool PointFeatureList2D::deserialize_item(QXmlStreamReader& xmlReader)
 
 void PointFeatureList2D::serialize_content(QXmlStreamWriter& xmlWriter) const
 {
-	for(unsigned int i=0; i < size(); ++i)
-    {
-        xmlWriter.writeStartElement("Feature");
-        xmlWriter.writeAttribute("ID", QString::number(i));
-            serialize_item(i, xmlWriter);
-        xmlWriter.writeEndElement();
-    }
+    xmlWriter.writeStartElement("Features");
+    xmlWriter.writeAttribute("Count", QString::number(size()));
+        serialize_columns(xmlWriter);
+    xmlWriter.writeEndElement();
 }
 
 bool PointFeatureList2D::deserialize_content(QXmlStreamReader& xmlReader)
@@ -193,39 +203,98 @@ bool PointFeatureList2D::deserialize_content(QXmlStreamReader& xmlReader)
 
     //Clean up
 	clear();
-    updateModel();
     
-    //Read the entries
     while(xmlReader.readNextStartElement())
     {
-        if(xmlReader.name() == "Feature")
+        if(xmlReader.name() == "Features")
         {
-            if(!deserialize_item(xmlReader))
-                return false;
-        }
-        else
-        {
-            qWarning() << "Found non 'Feature' tag in serialization of elements";
-            return false;
+            resizeColumns(xmlReader.attributes().value("Count").toUInt());
+            
+            //Read the columns
+            while(xmlReader.readNextStartElement())
+            {
+                if(     xmlReader.name() == "Column"
+                   &&   xmlReader.attributes().hasAttribute("ID")
+                   &&   (   xmlReader.attributes().value("Encoding") == "Base64"
+                         || xmlReader.attributes().value("Encoding") == "Binary"))
+                {
+                    QString id = xmlReader.attributes().value("ID").toString();
+                    
+                    if(!deserialize_column(id, xmlReader))
+                    {
+                        qWarning() << "Could not read the feature column" << id;
+                        clear();
+                        return false;
+                    }
+                }
+                else
+                {
+                    qWarning() << "Found non 'Column' tag in serialization of features:" << xmlReader.name();
+                    clear();
+                    return false;
+                }
+            }
         }
-        //Read until </Feature> comes...
-        while(true)
+        else if(xmlReader.name() == "Feature")
         {
-            if(!xmlReader.readNext())
-            {
+            //Former versions: One element for each feature
+            if(!deserialize_item(xmlReader))
                 return false;
-            }
             
-            if(xmlReader.isEndElement() && xmlReader.name() == "Feature")
+            //Read until </Feature> comes...
+            while(true)
             {
-                break;
+                if(!xmlReader.readNext())
+                {
+                    return false;
+                }
+                
+                if(xmlReader.isEndElement() && xmlReader.name() == "Feature")
+                {
+                    break;
+                }
             }
         }
+        else
+        {
+            qWarning() << "Found non 'Features' tag in serialization of elements";
+            return false;
+        }
+    }
+    return true;
+}
 
+void PointFeatureList2D::serialize_columns(QXmlStreamWriter& xmlWriter) const
+{
+    writeColumn(xmlWriter, "positions", (const char*)m_points.constData(), qint64(m_points.size())*sizeof(PointType));
+}
+
+bool PointFeatureList2D::deserialize_column(const QString& id, QXmlStreamReader& xmlReader)
+{
+    if(id == "positions")
+    {
+        return BinaryContainer::readBlock(xmlReader, (char*)m_points.data(), qint64(m_points.size())*sizeof(PointType));
     }
+    
+    qWarning() << "Skipping unknown feature column" << id;
+    xmlReader.skipCurrentElement();
     return true;
 }
 
+void PointFeatureList2D::resizeColumns(unsigned int count)
+{
+    m_points.resize(count);
+}
+
+void PointFeatureList2D::writeColumn(QXmlStreamWriter& xmlWriter, const QString& id, const char* data, qint64 size)
+{
+    xmlWriter.writeStartElement("Column");
+    xmlWriter.writeAttribute("ID", id);
+    xmlWriter.writeAttribute("Encoding", BinaryContainer::encoding(xmlWriter));
+        BinaryContainer::writeBlock(xmlWriter, data, size);
+    xmlWriter.writeEndElement();
+}
+
 
 
 
@@ -255,6 +324,11 @@ float WeightedPointFeatureList2D::weight(unsigned int index) const
 	return m_weights[index];		
 }
 
+const float* WeightedPointFeatureList2D::weights() const
+{
+	return m_weights.constData();
+}
+
 void WeightedPointFeatureList2D::setWeight(unsigned int index, float new_w)
 {
     if(locked())
@@ -291,6 +365,12 @@ void WeightedPointFeatureList2D::removeFeature(unsigned int index)
     }
 }
 
+void WeightedPointFeatureList2D::reserve(unsigned int count)
+{
+    m_weights.reserve(count);
+    PointFeatureList2D::reserve(count);
+}
+
 QString WeightedPointFeatureList2D::csvHeader() const
 {
 	return PointFeatureList2D::csvHeader() + ", weight";
@@ -354,6 +434,27 @@ bool WeightedPointFeatureList2D::deserialize_item(QXmlStreamReader& xmlReader)
     }
 }
 
+void WeightedPointFeatureList2D::serialize_columns(QXmlStreamWriter& xmlWriter) const
+{
+    PointFeatureList2D::serialize_columns(xmlWriter);
+    writeColumn(xmlWriter, "weights", (const char*)m_weights.constData(), qint64(m_weights.size())*sizeof(float));
+}
+
+bool WeightedPointFeatureList2D::deserialize_column(const QString& id, QXmlStreamReader& xmlReader)
+{
+    if(id == "weights")
+    {
+        return BinaryContainer::readBlock(xmlReader, (char*)m_weights.data(), qint64(m_weights.size())*sizeof(float));
+    }
+    return PointFeatureList2D::deserialize_column(id, xmlReader);
+}
+
+void WeightedPointFeatureList2D::resizeColumns(unsigned int count)
+{
+    m_weights.resize(count);
+    PointFeatureList2D::resizeColumns(count);
+}
+
 
 
 
@@ -388,6 +489,11 @@ float EdgelFeatureList2D::orientation(unsigned int index) const
 	return m_orientations[index];		
 }
 
+const float* EdgelFeatureList2D::orientations() const
+{
+	return m_orientations.constData();
+}
+
 void EdgelFeatureList2D::setOrientation(unsigned int index, float new_o)
 {
     if(locked())
@@ -428,6 +534,12 @@ void EdgelFeatureList2D::removeFeature(unsigned int index)
     }
 }
 
+void EdgelFeatureList2D::reserve(unsigned int count)
+{
+    m_orientations.reserve(count);
+    WeightedPointFeatureList2D::reserve(count);
+}
+
 QString EdgelFeatureList2D::csvHeader() const
 {
 	return WeightedPointFeatureList2D::csvHeader() + ", orientation";
@@ -490,6 +602,27 @@ bool EdgelFeatureList2D::deserialize_item(QXmlStreamReader& xmlReader)
     }
 }
 
+void EdgelFeatureList2D::serialize_columns(QXmlStreamWriter& xmlWriter) const
+{
+    WeightedPointFeatureList2D::serialize_columns(xmlWriter);
+    writeColumn(xmlWriter, "orientations", (const char*)m_orientations.constData(), qint64(m_orientations.size())*sizeof(float));
+}
+
+bool EdgelFeatureList2D::deserialize_column(const QString& id, QXmlStreamReader& xmlReader)
+{
+    if(id == "orientations")
+    {
+        return BinaryContainer::readBlock(xmlReader, (char*)m_orientations.data(), qint64(m_orientations.size())*sizeof(float));
+    }
+    return WeightedPointFeatureList2D::deserialize_column(id, xmlReader);
+}
+
+void EdgelFeatureList2D::resizeColumns(unsigned int count)
+{
+    m_orientations.resize(count);
+    WeightedPointFeatureList2D::resizeColumns(count);
+}
+
 
 
 
@@ -500,7 +633,9 @@ bool EdgelFeatureList2D::deserialize_item(QXmlStreamReader& xmlReader)
 
 
 SIFTFeatureList2D::SIFTFeatureList2D(Workspace* wsp)
-: EdgelFeatureList2D(wsp)
+:   EdgelFeatureList2D(wsp),
+    m_descriptor_size(0),
+    m_descriptor_stride(0)
 {
 }
 
@@ -510,7 +645,9 @@ void SIFTFeatureList2D::clear()
         return;
     
 	m_scales.clear();
+    m_descriptor_sizes.clear();
     m_descriptors.clear();
+    m_descriptor_size = m_descriptor_stride = 0;
     
 	EdgelFeatureList2D::clear();
 }
@@ -520,6 +657,11 @@ float SIFTFeatureList2D::scale(unsigned int index) const
 	return m_scales[index];
 }
 
+const float* SIFTFeatureList2D::scales() const
+{
+	return m_scales.constData();
+}
+
 void SIFTFeatureList2D::setScale(unsigned int index, float new_s)
 {
     if(locked())
@@ -529,49 +671,84 @@ void SIFTFeatureList2D::setScale(unsigned int index, float new_s)
 	updateModel();
 }
 
-const QVector<float>& SIFTFeatureList2D::descriptor(unsigned int index) const
+DescriptorSpan SIFTFeatureList2D::descriptor(unsigned int index) const
 {
-	return m_descriptors[index];
+	return DescriptorSpan(m_descriptors.data() + size_t(index)*m_descriptor_stride, std::min(m_descriptor_sizes[index], m_descriptor_size));
+}
+
+const float* SIFTFeatureList2D::descriptors() const
+{
+	return m_descriptors.data();
+}
+
+unsigned int SIFTFeatureList2D::descriptorSize() const
+{
+	return m_descriptor_size;
+}
+
+unsigned int SIFTFeatureList2D::descriptorStride() const
+{
+	return m_descriptor_stride;
 }
 
 void SIFTFeatureList2D::setDescriptor(unsigned int index, const QVector<float> & new_d)
+{
+    setDescriptor(index, new_d.constData(), new_d.size());
+}
+
+void SIFTFeatureList2D::setDescriptor(unsigned int index, const float* descr, unsigned int size)
 {
     if(locked())
         return;
     
-	m_descriptors[index] = new_d;
+    if(size > m_descriptor_size)
+    {
+        resizeDescriptorRows(size);
+    }
+    
+    float* row = m_descriptors.data() + size_t(index)*m_descriptor_stride;
+    
+    std::copy(descr, descr + size, row);
+    std::fill(row + size, row + m_descriptor_stride, 0.0f);
+    m_descriptor_sizes[index] = size;
+    
 	updateModel();
 }
 
 void SIFTFeatureList2D::addFeature(const PointType& p)
 {
-    addFeature(p, 0, 0, 0, QVector<float>());
+    addFeature(p, 0, 0, 0, NULL, 0);
 }
 
 void SIFTFeatureList2D::addFeature(const PointType& p, float weight)
 {
-    addFeature(p, weight, 0, 0, QVector<float>());
+    addFeature(p, weight, 0, 0, NULL, 0);
     
 }
 
 void SIFTFeatureList2D::addFeature(const PointType& p, float weight, float orientation)
 {
-    addFeature(p, weight, orientation, 0, QVector<float>());
+    addFeature(p, weight, orientation, 0, NULL, 0);
 }
 
 void SIFTFeatureList2D::addFeature(const PointType& p, float weight, float orientation, float scale)
 {
-    addFeature(p, weight, orientation, scale, QVector<float>());
+    addFeature(p, weight, orientation, scale, NULL, 0);
     
 }
 
 void SIFTFeatureList2D::addFeature(const PointType& p, float weight, float orientation, float scale, const QVector<float> & desc)
+{
+    addFeature(p, weight, orientation, scale, desc.constData(), desc.size());
+}
+
+void SIFTFeatureList2D::addFeature(const PointType& p, float weight, float orientation, float scale, const float* descr, unsigned int size)
 {
     if(locked())
         return;
     
 	m_scales.push_back(scale);
-    m_descriptors.push_back(desc);
+    appendDescriptor(descr, size);
     
     EdgelFeatureList2D::addFeature(p, weight, orientation);
 }
@@ -584,11 +761,21 @@ void SIFTFeatureList2D::removeFeature(unsigned int index)
 	if (index <(unsigned int) m_scales.size() )
     {
         m_scales.erase(m_scales.begin()+index);
-        m_descriptors.erase(m_descriptors.begin()+index);
+        m_descriptor_sizes.erase(m_descriptor_sizes.begin()+index);
+        m_descriptors.erase(m_descriptors.begin() + size_t(index)*m_descriptor_stride,
+                            m_descriptors.begin() + size_t(index+1)*m_descriptor_stride);
         EdgelFeatureList2D::removeFeature(index);
     }
 }
 
+void SIFTFeatureList2D::reserve(unsigned int count)
+{
+    m_scales.reserve(count);
+    m_descriptor_sizes.reserve(count);
+    m_descriptors.reserve(size_t(count)*m_descriptor_stride);
+    EdgelFeatureList2D::reserve(count);
+}
+
 QString SIFTFeatureList2D::csvHeader() const
 {
 	return EdgelFeatureList2D::csvHeader() + ", scale, descr_0, ..., descr_N";
@@ -598,9 +785,9 @@ QString SIFTFeatureList2D::itemToCSV(unsigned int index) const
 {
 	QString result = QString("%1, %2").arg(EdgelFeatureList2D::itemToCSV(index)).arg(m_scales[index]);
     
-    for(unsigned int i=0; i< (unsigned int)m_descriptors[index].size(); ++i)
+    for(float d : descriptor(index))
     {
-		result += ", " + QString::number((m_descriptors[index])[i], 'g', 10);
+		result += ", " + QString::number(d, 'g', 10);
 	}
 	return result;
 
@@ -631,7 +818,7 @@ bool SIFTFeatureList2D::itemFromCSV(const QString & serial)
                 }
             }
             
-            m_descriptors.push_back(desc);
+            appendDescriptor(desc.constData(), desc.size());
             
             EdgelFeatureList2D::itemFromCSV(serial);
 			
@@ -651,16 +838,19 @@ void SIFTFeatureList2D::serialize_item(unsigned int index, QXmlStreamWriter& xml
     
     xmlWriter.writeTextElement("scale", QString::number(m_scales[index], 'g', 10));
     
+    DescriptorSpan descr = descriptor(index);
+    
     xmlWriter.writeStartElement("descriptor");
-    xmlWriter.writeAttribute("size", QString::number(m_descriptors[index].size()));
+    xmlWriter.writeAttribute("size", QString::number(descr.size()));
     
-    for(unsigned int i=0; i< (unsigned int)m_descriptors[index].size(); ++i)
+    for(unsigned int i=0; i<descr.size(); ++i)
     {
 		xmlWriter.writeStartElement("value");
         xmlWriter.writeAttribute("ID", QString::number(i));
-            xmlWriter.writeCharacters(QString::number((m_descriptors[index])[i], 'g', 10));
+            xmlWriter.writeCharacters(QString::number(descr[i], 'g', 10));
         xmlWriter.writeEndElement();
 	}
+    xmlWriter.writeEndElement();
 }
 
 bool SIFTFeatureList2D::deserialize_item(QXmlStreamReader& xmlReader)
@@ -701,7 +891,7 @@ bool SIFTFeatureList2D::deserialize_item(QXmlStreamReader& xmlReader)
                         return false;
                     }
                 }
-                m_descriptors.push_back(desc);
+                appendDescriptor(desc.constData(), desc.size());
             }
             else
             {
@@ -718,4 +908,121 @@ bool SIFTFeatureList2D::deserialize_item(QXmlStreamReader& xmlReader)
     return true;
 }
 
+void SIFTFeatureList2D::serialize_columns(QXmlStreamWriter& xmlWriter) const
+{
+    EdgelFeatureList2D::serialize_columns(xmlWriter);
+    writeColumn(xmlWriter, "scales", (const char*)m_scales.constData(), qint64(m_scales.size())*sizeof(float));
+    writeColumn(xmlWriter, "descriptor_sizes", (const char*)m_descriptor_sizes.constData(), qint64(m_descriptor_sizes.size())*sizeof(unsigned int));
+    
+    xmlWriter.writeStartElement("Column");
+    xmlWriter.writeAttribute("ID", "descriptors");
+    xmlWriter.writeAttribute("Encoding", BinaryContainer::encoding(xmlWriter));
+    xmlWriter.writeAttribute("Size", QString::number(m_descriptor_size));
+        BinaryContainer::writeBlock(xmlWriter, (const char*)m_descriptors.data(), qint64(m_descriptors.size())*sizeof(float));
+    xmlWriter.writeEndElement();
+}
+
+bool SIFTFeatureList2D::deserialize_column(const QString& id, QXmlStreamReader& xmlReader)
+{
+    if(id == "scales")
+    {
+        return BinaryContainer::readBlock(xmlReader, (char*)m_scales.data(), qint64(m_scales.size())*sizeof(float));
+    }
+    if(id == "descriptor_sizes")
+    {
+        return BinaryContainer::readBlock(xmlReader, (char*)m_descriptor_sizes.data(), qint64(m_descriptor_sizes.size())*sizeof(unsigned int));
+    }
+    if(id == "descriptors")
+    {
+        bool ok = false;
+        unsigned int size = xmlReader.attributes().value("Size").toUInt(&ok);
+        
+        //Check the block's length before allocating the rows
+        quint64 stride = (quint64(size) + 7)/8*8;
+        quint64 bytes  = quint64(m_descriptor_sizes.size())*stride*sizeof(float);
+        
+        if(!ok || (stride != 0 && bytes/stride/sizeof(float) != quint64(m_descriptor_sizes.size())))
+        {
+            qWarning() << "SIFTFeatureList2D: Invalid descriptor size" << xmlReader.attributes().value("Size");
+            return false;
+        }
+        
+        if(xmlReader.attributes().hasAttribute("Chunk"))
+        {
+            BinaryContainer* container = qobject_cast<BinaryContainer*>(xmlReader.device());
+            
+            if(container == NULL || container->chunkSize(xmlReader.attributes().value("Chunk").toInt()) != qint64(bytes))
+            {
+                qWarning() << "SIFTFeatureList2D: Descriptor block does not match Count and Size";
+                return false;
+            }
+        }
+        
+        resizeDescriptorRows(size);
+        
+        return BinaryContainer::readBlock(xmlReader, (char*)m_descriptors.data(), qint64(m_descriptors.size())*sizeof(float));
+    }
+    return EdgelFeatureList2D::deserialize_column(id, xmlReader);
+}
+
+bool SIFTFeatureList2D::deserialize_content(QXmlStreamReader& xmlReader)
+{
+    if(!EdgelFeatureList2D::deserialize_content(xmlReader))
+    {
+        return false;
+    }
+    
+    //Each descriptor has to fit into the rows of the descriptor block
+    for(unsigned int i=0; i<(unsigned int)m_descriptor_sizes.size(); ++i)
+    {
+        if(m_descriptor_sizes[i] > m_descriptor_size)
+        {
+            qWarning() << "SIFTFeatureList2D: Descriptor" << i << "is longer than the descriptor size" << m_descriptor_size;
+            clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SIFTFeatureList2D::resizeColumns(unsigned int count)
+{
+    m_scales.resize(count);
+    m_descriptor_sizes.resize(count);
+    m_descriptors.resize(size_t(count)*m_descriptor_stride, 0.0f);
+    EdgelFeatureList2D::resizeColumns(count);
+}
+
+void SIFTFeatureList2D::appendDescriptor(const float* descr, unsigned int size)
+{
+    if(size > m_descriptor_size)
+    {
+        resizeDescriptorRows(size);
+    }
+    
+    m_descriptor_sizes.push_back(size);
+    m_descriptors.insert(m_descriptors.end(), descr, descr + size);
+    m_descriptors.resize(m_descriptors.size() + m_descriptor_stride - size, 0.0f);
+}
+
+void SIFTFeatureList2D::resizeDescriptorRows(unsigned int size)
+{
+    unsigned int stride = (size + 7)/8*8;
+    
+    if(stride != m_descriptor_stride)
+    {
+        std::vector<float, AlignedAllocator<float> > descriptors(size_t(m_descriptor_sizes.size())*stride, 0.0f);
+        
+        for(unsigned int i=0; i<(unsigned int)m_descriptor_sizes.size(); ++i)
+        {
+            const float* row = m_descriptors.data() + size_t(i)*m_descriptor_stride;
+            std::copy(row, row + std::min(std::min(m_descriptor_sizes[i], m_descriptor_size), size), descriptors.begin() + size_t(i)*stride);
+        }
+        m_descriptors.swap(descriptors);
+    }
+    
+    m_descriptor_size = size;
+    m_descriptor_stride = stride;
+}
+
 } //End of namespace graipe
@@ -42,6 +42,10 @@
 #include "features2d/config.hxx"
 
 #include <QVector>
+#include <QtGlobal>
+
+#include <new>
+#include <vector>
 
 namespace graipe {
 
@@ -52,6 +56,160 @@ namespace graipe {
  * @file
  * @brief Header file for 2d feature lists
  */
+
+/**
+ * A minimal allocator for std::vector, which aligns the storage, e.g.
+ * for the use of SIMD instructions on the stored data.
+ */
+template <class T, unsigned int Alignment = 32>
+class AlignedAllocator
+{
+    public:
+        typedef T value_type;
+        
+        template <class U>
+        struct rebind
+        {
+            typedef AlignedAllocator<U, Alignment> other;
+        };
+        
+        AlignedAllocator()
+        {
+        }
+        
+        template <class U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+        {
+        }
+        
+        /**
+         * Allocates aligned storage for n elements.
+         *
+         * \param n The number of elements.
+         * \return Pointer to the aligned storage.
+         */
+        T* allocate(std::size_t n)
+        {
+            void* p = qMallocAligned(n*sizeof(T), Alignment);
+            
+            if(p == NULL && n != 0)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(p);
+        }
+        
+        /**
+         * Frees storage, which has been allocated by allocate().
+         *
+         * \param p Pointer to the storage.
+         */
+        void deallocate(T* p, std::size_t)
+        {
+            qFreeAligned(p);
+        }
+        
+        template <class U>
+        bool operator==(const AlignedAllocator<U, Alignment>&) const
+        {
+            return true;
+        }
+        
+        template <class U>
+        bool operator!=(const AlignedAllocator<U, Alignment>&) const
+        {
+            return false;
+        }
+};
+
+/**
+ * A read-only view on a feature descriptor, which is stored inside the
+ * contiguous descriptor block of a SIFTFeatureList2D. The view is valid
+ * until the feature list is changed.
+ */
+class DescriptorSpan
+{
+    public:
+        /**
+         * Creates a view on a descriptor.
+         *
+         * \param data Pointer to the first value.
+         * \param size The number of values.
+         */
+        DescriptorSpan(const float* data=NULL, unsigned int size=0)
+        :   m_data(data),
+            m_size(size)
+        {
+        }
+        
+        /**
+         * Pointer to the first value of the descriptor.
+         *
+         * \return The descriptor's data.
+         */
+        const float* data() const
+        {
+            return m_data;
+        }
+        
+        /**
+         * The length of the descriptor.
+         *
+         * \return The number of values of the descriptor.
+         */
+        unsigned int size() const
+        {
+            return m_size;
+        }
+        
+        /**
+         * Is the descriptor empty?
+         *
+         * \return True, if the descriptor has no values.
+         */
+        bool empty() const
+        {
+            return m_size == 0;
+        }
+        
+        /**
+         * Access to a value of the descriptor.
+         *
+         * \param i The index of the value.
+         * \return The value at that index.
+         */
+        float operator[](unsigned int i) const
+        {
+            return m_data[i];
+        }
+        
+        /**
+         * Iterator to the first value.
+         *
+         * \return Pointer to the first value.
+         */
+        const float* begin() const
+        {
+            return m_data;
+        }
+        
+        /**
+         * Iterator behind the last value.
+         *
+         * \return Pointer behind the last value.
+         */
+        const float* end() const
+        {
+            return m_data + m_size;
+        }
+        
+    private:
+        /** The descriptor's values **/
+        const float* m_data;
+        
+        /** The descriptor's length **/
+        unsigned int m_size;
+};
  
 /**
  * Base class for collections for the different feature types.
@@ -101,6 +259,13 @@ class GRAIPE_FEATURES2D_EXPORT PointFeatureList2D
          */
 		virtual const PointType& position(unsigned int index) const;
     
+        /**
+         * Zero-copy access to the positions of all features.
+         *
+         * \return Pointer to the contiguous array of size() positions.
+         */
+        const PointType* positions() const;
+    
         /**
          * Setter for the position of a feature at a certain index. 
          * Replaces a features position at an index.
@@ -127,6 +292,14 @@ class GRAIPE_FEATURES2D_EXPORT PointFeatureList2D
          * \param index The index of the feature inside the list.
          */
 		virtual void removeFeature(unsigned int index);
+    
+        /**
+         * Reserves the memory for a given number of features, e.g. before
+         * adding many features.
+         *
+         * \param count The number of features.
+         */
+        virtual void reserve(unsigned int count);
 		
         /**
          * The content's item header for the feature list serialization.
@@ -174,14 +347,25 @@ class GRAIPE_FEATURES2D_EXPORT PointFeatureList2D
     
         /**
          * Serialize the complete content of the featurelist to an xml file.
+         * All features are written at once as binary columns (one for each
+         * property), which become chunks inside binary containers or Base64
+         * encoded text elsewhere:
+         * \verbatim
+           <Features Count="N">
+               <Column ID="positions" Encoding="Binary|Base64">...</Column>
+               ...
+           </Features>
+           \endverbatim
+         *
          * \param xmlWriter An xmlWriter, which will be used for the serialization.
          */
 		void serialize_content(QXmlStreamWriter& xmlWriter) const;
     
         /**
          * Deserialization of a  feature list from an xml file.
-         * The first line is the header as given in csvHeader, which is ignored however.
-         * Each following line has to be one valide feature serialization.
+         * Reads the binary columns written by serialize_content. Feature lists
+         * of former versions, with one Feature element per feature, are
+         * read using deserialize_item.
          * Does nothing if the model is locked.
          *
          * \param xmlReader The QXmlStreamReader, where we will read from.
@@ -189,6 +373,42 @@ class GRAIPE_FEATURES2D_EXPORT PointFeatureList2D
 		bool deserialize_content(QXmlStreamReader& xmlReader);
 	
 	protected:
+        /**
+         * Writes the binary columns of all features' properties.
+         *
+         * \param xmlWriter The QXmlStreamWriter, where we will write to.
+         */
+        virtual void serialize_columns(QXmlStreamWriter& xmlWriter) const;
+    
+        /**
+         * Reads one binary column. The columns have already been resized to
+         * the number of features by resizeColumns().
+         *
+         * \param id        The ID of the column.
+         * \param xmlReader The QXmlStreamReader, which points to the column element.
+         * \return True, if the column is known and could be read.
+         */
+        virtual bool deserialize_column(const QString& id, QXmlStreamReader& xmlReader);
+    
+        /**
+         * Resizes the storage of all properties to a number of features.
+         * New features get default (zero) properties.
+         *
+         * \param count The new number of features.
+         */
+        virtual void resizeColumns(unsigned int count);
+    
+        /**
+         * Writes one binary column element.
+         *
+         * \param xmlWriter The QXmlStreamWriter, where we will write to.
+         * \param id        The ID of the column.
+         * \param data      Pointer to the column's data, which needs to stay valid
+         *                  until the writer's device has been closed.
+         * \param size      The size of the data in bytes.
+         */
+        static void writeColumn(QXmlStreamWriter& xmlWriter, const QString& id, const char* data, qint64 size);
+    
 		/** The point list **/
 		QVector<PointType> m_points;
 };
@@ -234,6 +454,13 @@ class GRAIPE_FEATURES2D_EXPORT WeightedPointFeatureList2D
          */
 		float weight(unsigned int index) const;
     
+        /**
+         * Zero-copy access to the weights of all features.
+         *
+         * \return Pointer to the contiguous array of size() weights.
+         */
+        const float* weights() const;
+    
         /**
          * Setter for the weight of a feature at a certain index.
          * Replaces a feature's weight at an index.
@@ -271,6 +498,14 @@ class GRAIPE_FEATURES2D_EXPORT WeightedPointFeatureList2D
          */
 		void removeFeature(unsigned int index);
     
+        /**
+         * Reserves the memory for a given number of features, e.g. before
+         * adding many features.
+         *
+         * \param count The number of features.
+         */
+        void reserve(unsigned int count);
+    
         /**
          * The content's item header for the weighted feature list serialization.
          * 
@@ -317,6 +552,29 @@ class GRAIPE_FEATURES2D_EXPORT WeightedPointFeatureList2D
     
 		
 	protected:
+        /**
+         * Writes the binary columns of all features' properties.
+         *
+         * \param xmlWriter The QXmlStreamWriter, where we will write to.
+         */
+        void serialize_columns(QXmlStreamWriter& xmlWriter) const;
+    
+        /**
+         * Reads one binary column.
+         *
+         * \param id        The ID of the column.
+         * \param xmlReader The QXmlStreamReader, which points to the column element.
+         * \return True, if the column is known and could be read.
+         */
+        bool deserialize_column(const QString& id, QXmlStreamReader& xmlReader);
+    
+        /**
+         * Resizes the storage of all properties to a number of features.
+         *
+         * \param count The new number of features.
+         */
+        void resizeColumns(unsigned int count);
+    
         /** Additional weights for each feature **/
         QVector<float> m_weights;
 };
@@ -374,6 +632,13 @@ class GRAIPE_FEATURES2D_EXPORT EdgelFeatureList2D
          */
 		float orientation(unsigned int index) const;
     
+        /**
+         * Zero-copy access to the orientations of all features.
+         *
+         * \return Pointer to the contiguous array of size() orientations.
+         */
+        const float* orientations() const;
+    
         /**
          * Setter for the orientation of a feature at a certain index.
          * Replaces a feature's orientation at an index.
@@ -424,6 +689,14 @@ class GRAIPE_FEATURES2D_EXPORT EdgelFeatureList2D
          * \param index The index of the feature inside the list.
          */
         void removeFeature(unsigned int index);
+    
+        /**
+         * Reserves the memory for a given number of features, e.g. before
+         * adding many features.
+         *
+         * \param count The number of features.
+         */
+        void reserve(unsigned int count);
         
         /**
          * The content's item header for the edgel feature list serialization.
@@ -470,6 +743,29 @@ class GRAIPE_FEATURES2D_EXPORT EdgelFeatureList2D
 		bool deserialize_item(QXmlStreamReader& xmlReader);
 		
 	protected:
+        /**
+         * Writes the binary columns of all features' properties.
+         *
+         * \param xmlWriter The QXmlStreamWriter, where we will write to.
+         */
+        void serialize_columns(QXmlStreamWriter& xmlWriter) const;
+    
+        /**
+         * Reads one binary column.
+         *
+         * \param id        The ID of the column.
+         * \param xmlReader The QXmlStreamReader, which points to the column element.
+         * \return True, if the column is known and could be read.
+         */
+        bool deserialize_column(const QString& id, QXmlStreamReader& xmlReader);
+    
+        /**
+         * Resizes the storage of all properties to a number of features.
+         *
+         * \param count The new number of features.
+         */
+        void resizeColumns(unsigned int count);
+    
         /** Aditional orientation for each feature **/
 		QVector<float> m_orientations;
 };
@@ -514,6 +810,13 @@ class GRAIPE_FEATURES2D_EXPORT SIFTFeatureList2D
          */
 		float scale(unsigned int index) const;
     
+        /**
+         * Zero-copy access to the scales of all features.
+         *
+         * \return Pointer to the contiguous array of size() scales.
+         */
+        const float* scales() const;
+    
         /**
          * Setter for the scale of a feature at a certain index.
          * Replaces a feature's scale at an index.
@@ -528,9 +831,35 @@ class GRAIPE_FEATURES2D_EXPORT SIFTFeatureList2D
          * Getter for the descriptor of a feature at a certain index.
          *
          * \param index The index of the feature inside the list.
-         * \return The descriptor of the requested feature.
+         * \return A (zero-copy) view on the descriptor of the requested feature.
+         */
+		DescriptorSpan descriptor(unsigned int index) const;
+    
+        /**
+         * All descriptors are stored in one block with 32-byte alignment. Each
+         * feature has one row of descriptorSize() values, which is padded
+         * with zeros to descriptorStride() values. Shorter descriptors are padded
+         * with zeros, too.
+         *
+         * \return Pointer to the descriptor block of size()*descriptorStride() values.
+         */
+        const float* descriptors() const;
+    
+        /**
+         * The length of the descriptor rows. This is the length of the longest
+         * descriptor, which has been added to this list.
+         *
+         * \return The descriptor row length.
+         */
+        unsigned int descriptorSize() const;
+    
+        /**
+         * The distance of two descriptor rows in the descriptor block, which is
+         * descriptorSize() rounded up to a multiple of eight.
+         *
+         * \return The descriptor row stride.
          */
-		const QVector<float>& descriptor(unsigned int index) const;
+        unsigned int descriptorStride() const;
     
         /**
          * Setter for the descriptor of a feature at a certain index.
@@ -541,6 +870,17 @@ class GRAIPE_FEATURES2D_EXPORT SIFTFeatureList2D
          * \param new_d The new descriptor of that feature.
          */
 		void setDescriptor(unsigned int index, const QVector<float> & new_d);
+    
+        /**
+         * Setter for the descriptor of a feature at a certain index.
+         * Replaces a feature's descriptor at an index.
+         * Does nothing if the model is locked.
+         *
+         * \param index The index of the feature inside the list.
+         * \param descr Pointer to the new descriptor of that feature.
+         * \param size  The length of the new descriptor.
+         */
+		void setDescriptor(unsigned int index, const float* descr, unsigned int size);
 		
         /**
          * Addition of a point feature to the list. This will append the given feature
@@ -598,6 +938,21 @@ class GRAIPE_FEATURES2D_EXPORT SIFTFeatureList2D
          * \param descr The SIFT descriptor of the feature
          */
         virtual void addFeature(const PointType& p, float weight, float orientation, float scale, const QVector<float> & descr);
+    
+        /**
+         * Addition of a SIFT feature to the list. This will append the given edgel feature
+         * at the end of the list of features and copy the descriptor into the
+         * descriptor block.
+         * Does nothing if the model is locked.
+         *
+         * \param p The new feature.
+         * \param weight The weight of the new feature.
+         * \param orientation The orientation of the new feature (0 = 3h, pi/2 = 6h, pi=9h, 3pi/2=12h).
+         * \param scale The scale (in scale-space sigma) of the SIFT feature.
+         * \param descr Pointer to the SIFT descriptor of the feature.
+         * \param size The length of the SIFT descriptor.
+         */
+        void addFeature(const PointType& p, float weight, float orientation, float scale, const float* descr, unsigned int size);
         
         /**
          * Specialized removal of a feature at a certain index.
@@ -607,6 +962,14 @@ class GRAIPE_FEATURES2D_EXPORT SIFTFeatureList2D
          */
 		void removeFeature(unsigned int index);
     
+        /**
+         * Reserves the memory for a given number of features, e.g. before
+         * adding many features.
+         *
+         * \param count The number of features.
+         */
+        void reserve(unsigned int count);
+    
         /**
          * The content's item header for the SIFT feature list serialization.
          * 
@@ -648,13 +1011,68 @@ class GRAIPE_FEATURES2D_EXPORT SIFTFeatureList2D
          * \return True, if the item could be deserialized and the model is not locked.
          */
 		bool deserialize_item(QXmlStreamReader& xmlReader);
+    
+        /**
+         * Deserialization of a SIFT feature list from an xml file.
+         * In addition to the base class, this checks that no descriptor is
+         * longer than the descriptor block's rows.
+         *
+         * \param xmlReader The QXmlStreamReader, where we will read from.
+         * \return True, if the feature list could be read and is consistent.
+         */
+		bool deserialize_content(QXmlStreamReader& xmlReader);
 		
 	protected:
+        /**
+         * Writes the binary columns of all features' properties.
+         *
+         * \param xmlWriter The QXmlStreamWriter, where we will write to.
+         */
+        void serialize_columns(QXmlStreamWriter& xmlWriter) const;
+    
+        /**
+         * Reads one binary column.
+         *
+         * \param id        The ID of the column.
+         * \param xmlReader The QXmlStreamReader, which points to the column element.
+         * \return True, if the column is known and could be read.
+         */
+        bool deserialize_column(const QString& id, QXmlStreamReader& xmlReader);
+    
+        /**
+         * Resizes the storage of all properties to a number of features.
+         *
+         * \param count The new number of features.
+         */
+        void resizeColumns(unsigned int count);
+    
+        /**
+         * Appends a descriptor (row) to the descriptor block and its length
+         * to the descriptor lengths.
+         *
+         * \param descr Pointer to the descriptor.
+         * \param size  The length of the descriptor.
+         */
+        void appendDescriptor(const float* descr, unsigned int size);
+    
+        /**
+         * Changes the length of the descriptor rows and moves all descriptors.
+         *
+         * \param size The new row length.
+         */
+        void resizeDescriptorRows(unsigned int size);
+    
         /** Storage for each feature's scale **/
         QVector<float> m_scales;
 		
-        /** Storage for each feature's descriptor **/
-        QVector<QVector<float> > m_descriptors;
+        /** The length of the descriptor rows and their (padded) distance **/
+        unsigned int m_descriptor_size, m_descriptor_stride;
+    
+        /** Storage for each feature's descriptor length **/
+        QVector<unsigned int> m_descriptor_sizes;
+    
+        /** All descriptors as one aligned block, one (zero-padded) row per feature **/
+        std::vector<float, AlignedAllocator<float> > m_descriptors;
 };
   
 /**
@@ -34,6 +34,7 @@
 /************************************************************************/
 
 #include "images/image.hxx"
+#include "images/imagebandexecutor.hxx"
 #include "core/core.h"
 
 #include <vigra/specklefilters.hxx>
@@ -173,18 +174,20 @@ class FrostFilter
                     
                     new_image->setName(QString("Frost Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
-                    
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        frostFilter(current_image->band(m_phase),
-                                    new_image->band(m_phase),
-                                    vigra::Diff2D(param_windowSize->value(),param_windowSize->value()),
-                                    param_damping_k->value(),
-                                    vigra::BorderTreatmentMode(param_btmode->value()));
-                                    
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    m_phase = 0;
+                    m_phase_count = 1;
+                    
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, param_windowSize->value()/2,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          frostFilter(src,
+                                                      dest,
+                                                      vigra::Diff2D(param_windowSize->value(),param_windowSize->value()),
+                                                      param_damping_k->value(),
+                                                      vigra::BorderTreatmentMode(param_btmode->value()));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -290,18 +293,20 @@ class EnhancedFrostFilter
                                 
                     new_image->setName(QString("Enh. Frost Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
-                    
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        enhancedFrostFilter(current_image->band(m_phase),
-                                            new_image->band(m_phase),
-                                            vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
-                                            param_damping_k->value(), param_enl->value(),
-                                            vigra::BorderTreatmentMode(param_btmode->value()));
-                        
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    m_phase = 0;
+                    m_phase_count = 1;
+                    
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, param_windowSize->value()/2,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          enhancedFrostFilter(src,
+                                                              dest,
+                                                              vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
+                                                              param_damping_k->value(), param_enl->value(),
+                                                              vigra::BorderTreatmentMode(param_btmode->value()));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -407,18 +412,20 @@ class GammaMAPFilter
                     
                     new_image->setName(QString("Gamma Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
-                    
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        gammaMAPFilter(current_image->band(m_phase),
-                                       new_image->band(m_phase),
-                                       vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
-                                       param_enl->value(),
-                                       vigra::BorderTreatmentMode(param_btmode->value()));
-                                       
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    m_phase = 0;
+                    m_phase_count = 1;
+                    
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, param_windowSize->value()/2,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          gammaMAPFilter(src,
+                                                         dest,
+                                                         vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
+                                                         param_enl->value(),
+                                                         vigra::BorderTreatmentMode(param_btmode->value()));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -522,18 +529,20 @@ class KuanFilter
                     
                     new_image->setName(QString("Kuan Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
-                    
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        kuanFilter(current_image->band(m_phase),
-                                   new_image->band(m_phase),
-                                   vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
-                                   param_enl->value(),
-                                   vigra::BorderTreatmentMode(param_btmode->value()));
-                        
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    m_phase = 0;
+                    m_phase_count = 1;
+                    
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, param_windowSize->value()/2,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          kuanFilter(src,
+                                                     dest,
+                                                     vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
+                                                     param_enl->value(),
+                                                     vigra::BorderTreatmentMode(param_btmode->value()));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -637,18 +646,20 @@ class LeeFilter
                     
                     new_image->setName(QString("Lee Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
-                    
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        leeFilter(current_image->band(m_phase),
-                                  new_image->band(m_phase),
-                                  vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
-                                  param_enl->value(),
-                                  vigra::BorderTreatmentMode(param_btmode->value()));
-                        
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    m_phase = 0;
+                    m_phase_count = 1;
+                    
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, param_windowSize->value()/2,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          leeFilter(src,
+                                                    dest,
+                                                    vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
+                                                    param_enl->value(),
+                                                    vigra::BorderTreatmentMode(param_btmode->value()));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -757,18 +768,20 @@ class EnhancedLeeFilter
                     
                     new_image->setName(QString("Enh. Lee Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
-                    
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        enhancedLeeFilter(current_image->band(m_phase),
-                                          new_image->band(m_phase),
-                                          vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
-                                          param_damping_k->value(), param_enl->value(),
-                                          vigra::BorderTreatmentMode(param_btmode->value()));
-                        
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    m_phase = 0;
+                    m_phase_count = 1;
+                    
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, param_windowSize->value()/2,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          enhancedLeeFilter(src,
+                                                            dest,
+                                                            vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
+                                                            param_damping_k->value(), param_enl->value(),
+                                                            vigra::BorderTreatmentMode(param_btmode->value()));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -870,17 +883,19 @@ class MedianFilter
                     
                     new_image->setName(QString("Median Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
+                    m_phase = 0;
+                    m_phase_count = 1;
                     
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        medianFilter(current_image->band(m_phase),
-                                     new_image->band(m_phase),
-                                     vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
-                                     vigra::BorderTreatmentMode(param_btmode->value()));
-                                             
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, param_windowSize->value()/2,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          medianFilter(src,
+                                                       dest,
+                                                       vigra::Diff2D(param_windowSize->value(), param_windowSize->value()),
+                                                       vigra::BorderTreatmentMode(param_btmode->value()));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -986,17 +1001,28 @@ class ShockFilter
                     
                     new_image->setName(QString("Shock Filtered ") + current_image->name());
                     
-                    m_phase_count = current_image->numBands();
-                    
-                    for( m_phase=0; m_phase < m_phase_count; m_phase++)
-                    {	
-                        shockFilter(current_image->band(m_phase),
-                                    new_image->band(m_phase),
-                                    param_iSigma->value(), param_oSigma->value(),
-                                    param_upwind->value(), param_iterations->value());
-                        
-                        emit statusMessage(m_phase*99.0/m_phase_count, QString("filtering"));
-                    }
+                    m_phase = 0;
+                    m_phase_count = 1;
+                    
+                    //Filter all bands (and large bands tile-wise) in parallel
+                    processImageBands(*current_image, *new_image, -1,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          //One iteration at a time to allow cancellation in between
+                                          vigra::MultiArray<2,float> current(src);
+                                          
+                                          for(int it=0; it<param_iterations->value(); ++it)
+                                          {
+                                              CancellationToken::checkCurrent();
+                                              
+                                              shockFilter(current,
+                                                          dest,
+                                                          param_iSigma->value(), param_oSigma->value(),
+                                                          param_upwind->value(), 1);
+                                              current = dest;
+                                          }
+                                      },
+                                      [this](float p){ status_update(p); });
 
                     QString descr("The following parameters were used for filtering:\n");
                     descr += m_parameters->valueText("ModelParameter");
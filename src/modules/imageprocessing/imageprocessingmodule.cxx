@@ -351,11 +351,15 @@ class RecursiveSmoothingFilter : public Algorithm
                     
                     float scale = param_scale->value();
                     
-                    for( unsigned int c=0; c < current_image->numBands(); c++)
-                    {
-                        vigra::recursiveSmoothX(current_image->band(c), new_image->band(c), scale);// vigra::BorderTreatmentMode(param_btmode->value()));
-                        vigra::recursiveSmoothY(new_image->band(c), new_image->band(c), scale);//, vigra::BorderTreatmentMode(param_btmode->value())));
-                    }
+                    //The recursive filter has an infinite support: Only process the bands in parallel
+                    processImageBands(*current_image, *new_image, -1,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          vigra::recursiveSmoothX(src, dest, scale);// vigra::BorderTreatmentMode(param_btmode->value()));
+                                          vigra::recursiveSmoothY(dest, dest, scale);//, vigra::BorderTreatmentMode(param_btmode->value())));
+                                      },
+                                      [this](float p){ status_update(p); });
+                    
                     QString descr("The following parameters were used for recursive smoothing:\n");
                     descr += m_parameters->valueText("ModelParameter");
                     new_image->setDescription(descr);
@@ -459,11 +463,16 @@ class GaussianSmoothingFilter : public Algorithm
                     vigra::Kernel1D<double> gauss;
                     gauss.initGaussian(scale);
                     
-                    for( unsigned int c=0; c < current_image->numBands(); c++)
-                    {
-                        vigra::separableConvolveX(current_image->band(c), new_image->band(c), gauss);//, vigra::BorderTreatmentMode(param_btmode->value())) );
-                        vigra::separableConvolveY(new_image->band(c), new_image->band(c), gauss);//, vigra::BorderTreatmentMode(param_btmode->value())));
-                    }
+                    //Process all bands (and large bands tile-wise) in parallel.
+                    //The halo in y-direction is given by the radius of the kernel.
+                    processImageBands(*current_image, *new_image, gauss.right(),
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          vigra::separableConvolveX(src, dest, gauss);//, vigra::BorderTreatmentMode(param_btmode->value())) );
+                                          vigra::separableConvolveY(dest, dest, gauss);//, vigra::BorderTreatmentMode(param_btmode->value())));
+                                      },
+                                      [this](float p){ status_update(p); });
+                    
                     QString descr("The following parameters were used for gaussian smoothing:\n");
                     descr += m_parameters->valueText("ModelParameter");
                     new_image->setDescription(descr);
@@ -579,12 +588,13 @@ class NormalizedGaussianSmoothingFilter : public Algorithm
                     vigra::Kernel2D<double> gauss2d;
                     gauss2d.initSeparable(gauss,gauss);
                     
-                    for( unsigned int c=0; c < current_image->numBands(); c++)
-                    {
-                        vigra::normalizedConvolveImage(current_image->band(c),
-                                                       mask,
-                                                       new_image->band(c), gauss2d);
-                    }
+                    //The mask covers the whole band: Only process the bands in parallel
+                    processImageBands(*current_image, *new_image, -1,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          vigra::normalizedConvolveImage(src, mask, dest, gauss2d);
+                                      },
+                                      [this](float p){ status_update(p); });
                     QString descr("The following parameters were used for normalized gaussian smoothing:\n");
                     descr += m_parameters->valueText("ModelParameter");
                     new_image->setDescription(descr);
@@ -690,15 +700,15 @@ class ApplyMaskToImage
                     
                     new_image->setName(QString("masked ") + image->name());
                     
-                    for( unsigned int c=0; c < image->numBands(); c++)
-                    {
-                        using namespace vigra::functor;
-                        
-                        vigra::combineTwoImages(image->band(c),
-                                                mask,
-                                                new_image->band(c),
-                                                Arg1()*Arg2());
-                    }
+                    //The mask covers the whole band: Only process the bands in parallel
+                    processImageBands(*image, *new_image, -1,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          using namespace vigra::functor;
+                                          
+                                          vigra::combineTwoImages(src, mask, dest, Arg1()*Arg2());
+                                      },
+                                      [this](float p){ status_update(p); });
                     QString descr("The following parameters were used for masking:\n");
                     descr += m_parameters->valueText("ModelParameter");
                     new_image->setDescription(descr);
@@ -1355,10 +1365,13 @@ class ImageCropper
                     
                     new_image->setName(QString("cropped ") + current_image->name());
                     
-                    for( unsigned int c=0; c < current_image->numBands(); c++)
-                    {
-                        new_image->setBand(c, current_image->band(c));
-                    }
+                    //Copy the cropped region of all bands in parallel
+                    processImageBands(*current_image, *new_image, -1,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          dest = src.subarray(vigra::Shape2(ul_x, ul_y), vigra::Shape2(lr_x, lr_y));
+                                      },
+                                      [this](float p){ status_update(p); });
                     
                     QString descr("The following parameters were used for cropping:\n");
                     descr += m_parameters->valueText("ModelParameter");
@@ -1479,41 +1492,47 @@ class ImageResizer : public Algorithm
                     
                     new_image->setName(QString("resized ") + current_image->name());
                     
-                    for( unsigned int c=0; c < current_image->numBands(); c++)
-                    {
-                        switch (param_spline_degree->value())
-                        {
-                            case 5:
-                                vigra::resizeImageSplineInterpolation(current_image->band(c),
-                                                                      new_image->band(c),
-                                                                      vigra::BSpline<5, float>());
-                                break;
-                            case 4:
-                                vigra::resizeImageSplineInterpolation(current_image->band(c),
-                                                                      new_image->band(c),
-                                                                      vigra::BSpline<4, float>());
-                                break;
-                            case 3:
-                                vigra::resizeImageSplineInterpolation(current_image->band(c),
-                                                                      new_image->band(c),
-                                                                      vigra::BSpline<3, float>());
-                                break;
-                            case 2:
-                                vigra::resizeImageSplineInterpolation(current_image->band(c),
-                                                                      new_image->band(c),
-                                                                      vigra::BSpline<2, float>());
-                                break;
-                            case 1:
-                                vigra::resizeImageLinearInterpolation(current_image->band(c),
-                                                                      new_image->band(c));
-                                break;
-                            default:
-                            case 0:
-                                vigra::resizeImageNoInterpolation(current_image->band(c),
-                                                                  new_image->band(c));
-                                break;
-                        }
-                    }
+                    int degree = param_spline_degree->value();
+                    
+                    //The spline interpolation needs the whole band: Only process the bands in parallel
+                    processImageBands(*current_image, *new_image, -1,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          switch (degree)
+                                          {
+                                              case 5:
+                                                  vigra::resizeImageSplineInterpolation(src,
+                                                                                        dest,
+                                                                                        vigra::BSpline<5, float>());
+                                                  break;
+                                              case 4:
+                                                  vigra::resizeImageSplineInterpolation(src,
+                                                                                        dest,
+                                                                                        vigra::BSpline<4, float>());
+                                                  break;
+                                              case 3:
+                                                  vigra::resizeImageSplineInterpolation(src,
+                                                                                        dest,
+                                                                                        vigra::BSpline<3, float>());
+                                                  break;
+                                              case 2:
+                                                  vigra::resizeImageSplineInterpolation(src,
+                                                                                        dest,
+                                                                                        vigra::BSpline<2, float>());
+                                                  break;
+                                              case 1:
+                                                  vigra::resizeImageLinearInterpolation(src,
+                                                                                        dest);
+                                                  break;
+                                              default:
+                                              case 0:
+                                                  vigra::resizeImageNoInterpolation(src,
+                                                                                    dest);
+                                                  break;
+                                          }
+                                      },
+                                      [this](float p){ status_update(p); });
+                    
                     QString descr("The following parameters were used for resizing:\n");
                     descr += m_parameters->valueText("ModelParameter");
                     new_image->setDescription(descr);
@@ -1616,26 +1635,30 @@ class ImageInverter
                     
                     new_image->setName(QString("inverted ") + current_image->name());
                     
-                    for( unsigned int c=0; c < current_image->numBands(); c++)
-                    {
-                        float offset = param_offset->value();
-                        
-                        if (param_use_maximum->value())
-                        {
-                            vigra::FindMinMax<vigra::FImage::PixelType> minmax;   // init functor
-                            
-                            vigra::inspectImage(current_image->band(c), minmax);
-                            
-                            offset =  minmax.max;
-                        }
-                        
-                        using namespace vigra::functor;
-                        
-                        vigra::transformImage(current_image->band(c),
-                                              new_image->band(c),
-                                              Param(offset)-Arg1());
-                        
-                    }
+                    bool use_maximum = param_use_maximum->value();
+                    float fixed_offset = param_offset->value();
+                    
+                    //The maximum is computed per band: Only process the bands in parallel
+                    processImageBands(*current_image, *new_image, -1,
+                                      [&](const vigra::MultiArrayView<2,float>& src, vigra::MultiArrayView<2,float> dest)
+                                      {
+                                          float offset = fixed_offset;
+                                          
+                                          if (use_maximum)
+                                          {
+                                              vigra::FindMinMax<vigra::FImage::PixelType> minmax;   // init functor
+                                              
+                                              vigra::inspectImage(src, minmax);
+                                              
+                                              offset =  minmax.max;
+                                          }
+                                          
+                                          using namespace vigra::functor;
+                                          
+                                          vigra::transformImage(src, dest, Param(offset)-Arg1());
+                                      },
+                                      [this](float p){ status_update(p); });
+                    
                     QString descr("The following parameters were used for inverting:\n");
                     descr += m_parameters->valueText("ModelParameter");
                     new_image->setDescription(descr);
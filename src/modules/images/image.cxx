@@ -53,12 +53,17 @@ Image<T>::Image(Workspace* wsp)
     m_timestamp(new DateTimeParameter("Timestamp:", QDateTime::currentDateTime())),
     m_scale(new DoubleParameter("Scale (1 px = X m):", 0, 1000000000, 1)),
     m_comment(new LongStringParameter("Comment:", "")),
-    m_units(new StringParameter("Units:", "m"))
+    m_units(new StringParameter("Units:", "m")),
+    m_mappedfile(NULL),
+    m_pyramid_generation(0)
 {
     m_name->setValue(QString("New ") + typeName());
     m_description->setValue(QString("This new ") + typeName() + " has been created on " + QDateTime::currentDateTime().toString());
     
     appendParameters();
+    
+    //Cached pyramids become invalid on every change
+    QObject::connect(this, &Model::modelChanged, [this](){ clearPyramids(); });
 }
 
 template<class T>
@@ -68,9 +73,14 @@ Image<T>::Image(const Image<T> & img)
     m_timestamp(new DateTimeParameter("Timestamp:", img.timestamp())),
     m_scale(new DoubleParameter("Scale (1 px = X m):", 0, 1000000000, img.scale())),
     m_comment(new LongStringParameter("Comment:", img.comment())),
-    m_units(new StringParameter("Units:", "m"))
+    m_units(new StringParameter("Units:", "m")),
+    m_mappedfile(NULL),
+    m_pyramid_generation(0)
 {
     appendParameters();
+    
+    //Cached pyramids become invalid on every change
+    QObject::connect(this, &Model::modelChanged, [this](){ clearPyramids(); });
 
     //Get tags from other image
 	img.copyMetadata(*this);
@@ -81,6 +91,7 @@ Image<T>::Image(const Image<T> & img)
         //Copy bands from other image
         m_imagebands[i] = img.band(i);
     }
+    updateBandViews();
 }
 
 template<class T>
@@ -93,9 +104,14 @@ Image<T>::Image(Size_Type size,
     m_timestamp(new DateTimeParameter("Timestamp:", QDateTime::currentDateTime())),
     m_scale(new DoubleParameter("Scale (1 px = X m):", 0, 1000000000, 1)),
     m_comment(new LongStringParameter("Comment:", "")),
-    m_units(new StringParameter("Units:", "m"))
+    m_units(new StringParameter("Units:", "m")),
+    m_mappedfile(NULL),
+    m_pyramid_generation(0)
 {
     appendParameters();
+    
+    //Cached pyramids become invalid on every change
+    QObject::connect(this, &Model::modelChanged, [this](){ clearPyramids(); });
     setWidth((unsigned int)size[0]);
     setHeight((unsigned int)size[1]);
     setNumBands(numBands);
@@ -106,7 +122,8 @@ Image<T>::~Image()
 {
     //The command "delete m_parameters;" inside the base class
     //will also delete all other (newly introduced) parameters
-    //No need to do anything here!
+    //We only need to remove the mappings (if any)
+    unmapBands();
 }
 
 template<>
@@ -142,7 +159,7 @@ typename Image<T>::Size_Type Image<T>::size() const
 template<class T>
 const vigra::MultiArrayView<2,T> & Image<T>::band(unsigned int band_id) const
 {
-    return m_imagebands[band_id];
+    return m_bandviews[band_id];
 }
 
 template<class T>
@@ -151,7 +168,85 @@ void Image<T>::setBand(unsigned int band_id, const vigra::MultiArrayView<2,T>& b
     if(locked())
         return;
     
-    m_imagebands[band_id] = band;
+    if(m_bandviews[band_id].shape() == band.shape())
+    {
+        //Copy into the existing storage (in memory or mapped)
+        m_bandviews[band_id] = band;
+        clearPyramids();
+    }
+    else
+    {
+        m_imagebands[band_id] = band;
+        m_mappedbands[band_id] = NULL;
+        updateBandViews();
+    }
+}
+
+template<class T>
+std::shared_ptr<const ImagePyramid<T> > Image<T>::pyramid(unsigned int band_id, unsigned int levels) const
+{
+    std::shared_ptr<const ImagePyramid<T> > cached;
+    unsigned int generation;
+    
+    {
+        QMutexLocker locker(&m_pyramid_mutex);
+        
+        if(band_id >= m_bandviews.size())
+        {
+            return std::shared_ptr<const ImagePyramid<T> >();
+        }
+        if(band_id < m_pyramids.size())
+        {
+            cached = m_pyramids[band_id];
+        }
+        generation = m_pyramid_generation;
+    }
+    
+    if(cached != NULL)
+    {
+        const vigra::MultiArray<2,T> & top = cached->level(cached->levels());
+        
+        //The cached pyramid may already be as high as possible
+        if(cached->levels() >= levels || top.width() <= 1 || top.height() <= 1)
+        {
+            return cached;
+        }
+    }
+    
+    //Build (or extend) the pyramid without holding the lock, so that the
+    //pyramids of different bands can be built in parallel
+    std::shared_ptr<const ImagePyramid<T> > result;
+    
+    if(cached == NULL)
+    {
+        result.reset(new ImagePyramid<T>(band(band_id), levels));
+    }
+    else
+    {
+        result.reset(new ImagePyramid<T>(*cached, levels));
+    }
+    
+    QMutexLocker locker(&m_pyramid_mutex);
+    
+    //Do not cache the pyramid, if the image has been changed meanwhile
+    if(generation == m_pyramid_generation)
+    {
+        m_pyramids.resize(std::max(m_pyramids.size(), m_bandviews.size()));
+        
+        if(m_pyramids[band_id] == NULL || m_pyramids[band_id]->levels() < result->levels())
+        {
+            m_pyramids[band_id] = result;
+        }
+    }
+    return result;
+}
+
+template<class T>
+void Image<T>::clearPyramids()
+{
+    QMutexLocker locker(&m_pyramid_mutex);
+    m_pyramids.clear();
+    m_pyramid_generation++;
 }
 
 template <class T>
@@ -279,17 +374,15 @@ void Image<T>::serialize_content(QXmlStreamWriter& xmlWriter) const
         xmlWriter.writeTextElement("Height",   QString::number(this->height()));
         xmlWriter.writeTextElement("Channels", QString::number(this->numBands()));
         xmlWriter.writeTextElement("Order",   "Row-major");
-        xmlWriter.writeTextElement("Encoding", "Base64");
+        xmlWriter.writeTextElement("Encoding", BinaryContainer::encoding(xmlWriter));
         
         qint64 channel_size = this->width()*this->height()*sizeof(T);
 
-        for(unsigned int c=0; c<m_imagebands.size(); ++c)
+        for(unsigned int c=0; c<m_bandviews.size(); ++c)
         {
-            QByteArray block((const char*)m_imagebands[c].data(),channel_size);
-            
             xmlWriter.writeStartElement("Channel");
             xmlWriter.writeAttribute("ID", QString::number(c));
-                xmlWriter.writeCharacters(block.toBase64());
+                BinaryContainer::writeBlock(xmlWriter, (const char*)m_bandviews[c].data(), channel_size);
             xmlWriter.writeEndElement();
         }
     }
@@ -311,14 +404,13 @@ bool Image<T>::deserialize_content(QXmlStreamReader& xmlReader)
     
     qint64 channel_size = this->width()*this->height()*sizeof(T);
     
+    //Bands will be allocated (or mapped) when they are read
+    unmapBands();
     m_imagebands.clear();
     m_imagebands.resize(numBands());
-        
-    //Prepare all bands:
-    for(unsigned int c=0; c<m_imagebands.size(); ++c)
-    {
-        m_imagebands[c] = vigra::MultiArray<2,T>(width(),height());
-    }
+    m_mappedbands.assign(numBands(), NULL);
+    
+    bool result = true;
     
     try
     {
@@ -359,9 +451,14 @@ bool Image<T>::deserialize_content(QXmlStreamReader& xmlReader)
             }
             
             
-            if (xmlReader.name() == "Encoding" && xmlReader.readElementText() != "Base64")
+            if (xmlReader.name() == "Encoding")
             {
-                throw std::runtime_error("Encoding of data has to be 'Base64'.");
+                QString encoding = xmlReader.readElementText();
+                
+                if(encoding != "Base64" && encoding != "Binary")
+                {
+                    throw std::runtime_error("Encoding of data has to be 'Base64' or 'Binary'.");
+                }
             }
             
             if(xmlReader.name() == "Channel" && xmlReader.attributes().hasAttribute("ID"))
@@ -373,17 +470,21 @@ bool Image<T>::deserialize_content(QXmlStreamReader& xmlReader)
                     throw std::runtime_error("Channel id not found in image");
                 }
                 
-                QByteArray block;
-                block.append(xmlReader.readElementText());
-                block = QByteArray::fromBase64(block);
+                uchar* mapped = BinaryContainer::mapBlock(xmlReader, channel_size, m_mappedfile);
                 
-                if(block.size() == channel_size)
+                if(mapped != NULL)
                 {
-                    memcpy((char*)m_imagebands[id].data(), block.data(), channel_size);
+                    m_mappedbands[id] = (T*)mapped;
                 }
                 else
                 {
-                    throw std::runtime_error("Channel serialization was of wrong size in XML after Base64 decoding.");
+                    m_mappedbands[id] = NULL;
+                    m_imagebands[id] = vigra::MultiArray<2,T>(width(),height());
+                    
+                    if(!BinaryContainer::readBlock(xmlReader, (char*)m_imagebands[id].data(), channel_size))
+                    {
+                        throw std::runtime_error("Channel serialization was of wrong size after decoding.");
+                    }
                 }
             }
         }
@@ -391,9 +492,20 @@ bool Image<T>::deserialize_content(QXmlStreamReader& xmlReader)
     catch(std::runtime_error & e)
     {
         qCritical() << "Image<T>::deserialize_content failed! Error: " << e.what();
-        return false;
+        result = false;
+    }
+    
+    //Allocate all bands, which have neither been read nor mapped
+    for(unsigned int c=0; c<m_imagebands.size(); ++c)
+    {
+        if(m_mappedbands[c] == NULL && m_imagebands[c].size() == 0)
+        {
+            m_imagebands[c] = vigra::MultiArray<2,T>(width(),height());
+        }
     }
-    return true;
+    updateBandViews();
+    
+    return result;
 }
 
 template <class T>
@@ -410,6 +522,20 @@ void Image<T>::updateModel()
         {
             m_imagebands.pop_back();
         }
+        
+        //Mapped bands cannot be resized: Move all bands into memory
+        if(     m_mappedfile != NULL
+            &&  (m_imagebands.empty() || m_bandviews[0].shape() != size()))
+        {
+            unmapBands();
+            
+            for(vigra::MultiArray<2,T> & band: m_imagebands)
+            {
+                band.reshape(vigra::Shape2(width(),height()));
+                band.init(vigra::NumericTraits<T>::zero());
+            }
+        }
+        updateBandViews();
     }
     else if(width()!=0 && height()!=0)
     {
@@ -427,16 +553,21 @@ void Image<T>::updateModel()
             }
         }
         //Dimensions have changed
-        else if(   m_imagebands.size()!=0
-                && ((unsigned int)m_imagebands[0].width()!= width() || (unsigned int)m_imagebands[0].height()!= height()))
+        else if(   m_bandviews.size()!=0
+                && ((unsigned int)m_bandviews[0].width()!= width() || (unsigned int)m_bandviews[0].height()!= height()))
         {
-            //qDebug() << QString("Dimensions have changed from (%1x%2) to (%3x%4)").arg(m_imagebands[0].width()).arg(m_imagebands[0].height()).arg(width()).arg(height());
+            //qDebug() << QString("Dimensions have changed from (%1x%2) to (%3x%4)").arg(m_bandviews[0].width()).arg(m_bandviews[0].height()).arg(width()).arg(height());
+            
+            //Mapped bands cannot be resized: Move them into memory
+            unmapBands();
+            
             for(vigra::MultiArray<2,T> & band: m_imagebands)
             {
                 band.reshape(vigra::Shape2(width(),height()));
                 band.init(vigra::NumericTraits<T>::zero());
             }
         }
+        updateBandViews();
         
         RasteredModel::updateModel();
     }
@@ -452,6 +583,48 @@ void Image<T>::appendParameters()
     m_parameters->addParameter("units", m_units);
 }
 
+template <class T>
+void Image<T>::updateBandViews()
+{
+    clearPyramids();
+    
+    m_mappedbands.resize(m_imagebands.size(), NULL);
+    m_bandviews.clear();
+    
+    bool mapped = false;
+    
+    for(unsigned int c=0; c<m_imagebands.size(); ++c)
+    {
+        if(m_mappedbands[c] != NULL)
+        {
+            m_bandviews.push_back(vigra::MultiArrayView<2,T>(size(), m_mappedbands[c]));
+            mapped = true;
+        }
+        else
+        {
+            m_bandviews.push_back(m_imagebands[c]);
+        }
+    }
+    
+    //Release the mapping, if no band needs it anymore
+    if(!mapped && m_mappedfile != NULL)
+    {
+        delete m_mappedfile;
+        m_mappedfile = NULL;
+    }
+}
+
+template <class T>
+void Image<T>::unmapBands()
+{
+    m_bandviews.clear();
+    m_mappedbands.assign(m_mappedbands.size(), NULL);
+    
+    //Deleting the file removes all of its mappings
+    delete m_mappedfile;
+    m_mappedfile = NULL;
+}
+
 //Promote the following three temple instances for further use:
 template class Image<float>;
 template class Image<int>;
@@ -39,9 +39,15 @@
 #include "core/core.h"
 #include "images/config.hxx"
 
+#include "images/imagepyramid.hxx"
+
 #include "vigra/multi_array.hxx"
 
 #include <QDateTime>
+#include <QFile>
+#include <QMutex>
+
+#include <memory>
 
 namespace graipe {
 
@@ -60,6 +66,12 @@ namespace graipe {
  *
  * This class extends the RasteredModel class, the template argument is
  * defining the pixel type.
+ *
+ * The bands are either stored in memory or, if the image has been loaded
+ * from an uncompressed BinaryContainer, mapped copy-on-write from that file.
+ * Mapped bands are only read from disk when their pixels are touched and
+ * may be paged out by the OS. Changes to mapped bands are never written back
+ * to the file. Resizing the image moves all bands into memory.
  */
 template<class T>
 class GRAIPE_IMAGES_EXPORT Image
@@ -154,6 +166,24 @@ class GRAIPE_IMAGES_EXPORT Image
          */
 		void setBand(unsigned int band_id, const vigra::MultiArrayView<2,T>& band);
             
+        /**
+         * Returns the Gaussian pyramid of a band. The pyramid is built on the first
+         * request and cached until the image changes (see modelChanged), thus repeated
+         * runs on the same image reuse its levels. If a higher pyramid is requested
+         * later, the cached levels are reused for it. Thread-safe.
+         *
+         * \param band_id The id of the band.
+         * \param levels The number of levels above the band itself.
+         * \return The pyramid of the band, or an empty pointer for an invalid band_id.
+         */
+        std::shared_ptr<const ImagePyramid<T> > pyramid(unsigned int band_id, unsigned int levels) const;
+    
+        /**
+         * Removes all cached pyramids. This is called whenever the image changes.
+         * Pyramids, which are still in use, stay valid until they are released.
+         */
+        void clearPyramids();
+    
         /**
          * Getter for the number of bands of an Image.
          *
@@ -268,9 +298,37 @@ class GRAIPE_IMAGES_EXPORT Image
          */
         void appendParameters();
     
-        /** Storage of the image bands **/
+        /**
+         * Rebuilds the views on all bands after the storage has been changed.
+         */
+        void updateBandViews();
+    
+        /**
+         * Removes all mappings. The mapped bands will be empty afterwards.
+         */
+        void unmapBands();
+    
+        /** Storage of the image bands (empty for mapped bands) **/
 		std::vector<vigra::MultiArray<2,T> > m_imagebands;
     
+        /** Views on all image bands, either in memory or mapped **/
+        std::vector<vigra::MultiArrayView<2,T> > m_bandviews;
+    
+        /** The data of each mapped band, NULL for bands in memory **/
+        std::vector<T*> m_mappedbands;
+    
+        /** The file, which holds the mappings, NULL if no band is mapped **/
+        QFile* m_mappedfile;
+    
+        /** The cached pyramids of each band, empty if not (yet) requested **/
+        mutable std::vector<std::shared_ptr<const ImagePyramid<T> > > m_pyramids;
+    
+        /** Mutex for the cached pyramids **/
+        mutable QMutex m_pyramid_mutex;
+    
+        /** Counts the invalidations of the cached pyramids **/
+        unsigned int m_pyramid_generation;
+    
         /**
          * @{
          * Additional parameters
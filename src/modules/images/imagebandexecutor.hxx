@@ -0,0 +1,132 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_IMAGES_IMAGEBANDEXECUTOR_HXX
+#define GRAIPE_IMAGES_IMAGEBANDEXECUTOR_HXX
+
+#include "core/parallel.hxx"
+#include "core/scheduler.hxx"
+#include "images/image.hxx"
+
+#include "vigra/multi_array.hxx"
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_images
+ * @{
+ *
+ * @file
+ * @brief Header file for the parallel execution of per-band image operations
+ */
+
+/**
+ * Applies a per-band operation to all bands of an image in parallel and writes
+ * the results into the corresponding bands of another image of the same size.
+ *
+ * The bands are processed concurrently on the shared Scheduler. If there are
+ * less bands than worker threads, each band is further split into horizontal
+ * stripes, which overlap by the given halo. The functor is then called for each
+ * stripe (including its halo) and only the inner part of the stripe is copied
+ * into the destination band. Thus, for a correct halo, the result is identical
+ * to the serial processing of the whole bands.
+ *
+ * If the bands must not be split (halo of -1), the functor is called once for
+ * each whole band. In this case, the destination image may have a different
+ * size than the source image, e.g. for resizing or cropping.
+ *
+ * The functor needs to have the signature:
+ * \verbatim
+   void f(const vigra::MultiArrayView<2,T>& src, vigra::MultiArrayView<2,R> dest);
+   \endverbatim
+ *
+ * \param src      The source image.
+ * \param dest     The destination image. Needs to have the same number of bands and,
+ *                 unless the halo is -1, the same size.
+ * \param halo     The number of neighbouring pixels needed to compute one pixel, e.g.
+ *                 half of the filter window size. Use -1 if the bands must not be split.
+ * \param f        The per-band (or per-tile) operation.
+ * \param progress Optional callback for the overall progress (0...100%).
+ */
+template<class T, class R, class BandFunctor>
+void processImageBands(const Image<T>& src, Image<R>& dest,
+                       int halo, BandFunctor f,
+                       const std::function<void(float)>& progress = std::function<void(float)>())
+{
+    vigra_precondition(src.numBands() == dest.numBands(),
+                       "processImageBands(): Images need to have the same number of bands.");
+    vigra_precondition(halo < 0 || src.size() == dest.size(),
+                       "processImageBands(): Images need to have the same size for splitting bands.");
+    
+    std::vector<BandTile> tiles = splitIntoTiles(src.numBands(), src.width(), src.height(),
+                                                 halo, Scheduler::instance()->threadCount());
+    
+    parallelFor(tiles.size(),
+                [&](unsigned int i)
+                {
+                    const BandTile& tile = tiles[i];
+                    
+                    vigra::MultiArrayView<2,T> src_band  = src.band(tile.band);
+                    vigra::MultiArrayView<2,R> dest_band = dest.band(tile.band);
+                    
+                    if(tile.outer.height() == (int)src.height())
+                    {
+                        //Whole band: no need for temporary storage
+                        f(src_band, dest_band);
+                    }
+                    else
+                    {
+                        vigra::Shape2 outer_ul(tile.outer.left(), tile.outer.top()),
+                                      outer_lr(tile.outer.right()+1, tile.outer.bottom()+1),
+                                      inner_ul(tile.inner.left(), tile.inner.top()),
+                                      inner_lr(tile.inner.right()+1, tile.inner.bottom()+1);
+                        
+                        vigra::MultiArray<2,R> dest_tile(outer_lr - outer_ul);
+                        
+                        f(src_band.subarray(outer_ul, outer_lr), dest_tile);
+                        
+                        dest_band.subarray(inner_ul, inner_lr) = dest_tile.subarray(inner_ul - outer_ul, inner_lr - outer_ul);
+                    }
+                },
+                progress);
+}
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_IMAGES_IMAGEBANDEXECUTOR_HXX
@@ -118,6 +118,9 @@ ImageBandParameter<T>::ImageBandParameter(QString name, Parameter* parent, bool
     m_image(NULL),
     m_bandId(0)
 {
+    //Recursive: Creating the temporary image locks the models again
+    QMutexLocker locker(&wsp->models_mutex);
+    
     if(wsp->models.size())
     {
         m_allowed_images.clear();
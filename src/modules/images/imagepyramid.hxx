@@ -0,0 +1,182 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_IMAGES_IMAGEPYRAMID_HXX
+#define GRAIPE_IMAGES_IMAGEPYRAMID_HXX
+
+#include "vigra/multi_array.hxx"
+#include "vigra/separableconvolution.hxx"
+#include "vigra/resizeimage.hxx"
+
+#include <vector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_images
+ * @{
+ *
+ * @file
+ * @brief Header file for Gaussian image pyramids
+ */
+
+/**
+ * Reduces an image to the next level of a Gaussian pyramid: The image is smoothed
+ * by a 5x5 binomial-like filter (Burt & Adelson) and then subsampled by two.
+ *
+ * \param[in] in The input image
+ * \param[out] out The reduced image.
+ */
+template <class T>
+void reduceToNextLevel(const vigra::MultiArrayView<2,T> & in, vigra::MultiArray<2,T> & out)
+{    
+    // image size at current level
+    unsigned int width  = (unsigned int)in.width(),
+                 height = (unsigned int)in.height();
+    
+    // image size at next smaller level
+    unsigned int newwidth  = (width + 1) / 2,
+                 newheight = (height + 1) / 2;
+    
+    // resize result image to appropriate size
+    out.reshape(vigra::Shape2(newwidth, newheight));
+    
+    // define a Gaussian kernel (size 5x1)
+    vigra::Kernel1D<double> filter;
+    filter.initExplicitly(-2, 2) = 0.05, 0.25, 0.4, 0.25, 0.05;
+    
+    vigra::MultiArray<2,T> temp(in.shape()), temp2(in.shape());
+    
+    // smooth (band limit) input image
+    vigra::separableConvolveX(in,   temp, filter);
+    vigra::separableConvolveY(temp, temp2, filter);
+                       
+    // downsample smoothed image: take every second pixel, such that the sampling grid
+    // does not depend on the image size (unlike for vigra::resizeImageNoInterpolation)
+    for(unsigned int y=0; y<newheight; ++y)
+    {
+        for(unsigned int x=0; x<newwidth; ++x)
+        {
+            out(x,y) = temp2(2*x, 2*y);
+        }
+    }
+}
+
+/**
+ * A Gaussian pyramid of one image band. Level 0 is a copy of the band itself,
+ * each further level is the result of reduceToNextLevel() on the previous one.
+ *
+ * Pyramids are immutable after their creation. They are usually not created
+ * directly, but requested from Image::pyramid(), which caches them until the
+ * image changes.
+ */
+template <class T>
+class ImagePyramid
+{
+    public:
+        /**
+         * Builds a pyramid of a band.
+         *
+         * \param band   The band (level 0).
+         * \param levels The number of levels above level 0.
+         */
+        ImagePyramid(const vigra::MultiArrayView<2,T> & band, unsigned int levels)
+        :   m_levels(1, vigra::MultiArray<2,T>(band))
+        {
+            extend(levels);
+        }
+    
+        /**
+         * Builds a higher pyramid from an existing one, reusing all of its levels.
+         *
+         * \param other  The existing pyramid.
+         * \param levels The number of levels above level 0.
+         */
+        ImagePyramid(const ImagePyramid<T> & other, unsigned int levels)
+        :   m_levels(other.m_levels)
+        {
+            extend(levels);
+        }
+    
+        /**
+         * Returns the number of levels above level 0.
+         *
+         * \return The number of levels above level 0.
+         */
+        unsigned int levels() const
+        {
+            return m_levels.size()-1;
+        }
+    
+        /**
+         * Constant access to a level of the pyramid.
+         *
+         * \param level The level, 0 is the original band.
+         * \return The image of that level.
+         */
+        const vigra::MultiArray<2,T> & level(unsigned int level) const
+        {
+            return m_levels[level];
+        }
+    
+    private:
+        /**
+         * Adds levels until the given count is reached. Stops early, if the
+         * images become smaller than 2x2.
+         *
+         * \param levels The number of levels above level 0.
+         */
+        void extend(unsigned int levels)
+        {
+            while(    m_levels.size() <= levels
+                   && m_levels.back().width() > 1 && m_levels.back().height() > 1)
+            {
+                vigra::MultiArray<2,T> next;
+                reduceToNextLevel(vigra::MultiArrayView<2,T>(m_levels.back()), next);
+                m_levels.push_back(next);
+            }
+        }
+    
+        /** All levels of the pyramid **/
+        std::vector<vigra::MultiArray<2,T> > m_levels;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_IMAGES_IMAGEPYRAMID_HXX
@@ -47,8 +47,10 @@
  */
 
 #include "images/image.hxx"
+#include "images/imagebandexecutor.hxx"
 #include "images/imagebandparameter.hxx"
 #include "images/imageimpex.hxx"
+#include "images/imagepyramid.hxx"
 #include "images/imagestatistics.hxx"
 #include "images/imageviewcontroller.hxx"
 
@@ -52,7 +52,9 @@
 
 #include "opticalflow_global.hxx"
 #include "opticalflow_hybrid.hxx"
+#include "opticalflow_iterative.hxx"
 #include "opticalflow_local.hxx"
+#include "opticalflow_multigrid.hxx"
 #include "opticalflowalgorithms.hxx"
 #include "opticalflowframework.hxx"
 #include "opticalflowgradients.hxx"
@@ -126,6 +126,18 @@ class OpticalFlowGETFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the gradient energy tensor and its smoothing. Used to derive the
+         * halo of tiles for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return gaussianKernelRadius(m_sigma, 2) + gaussianKernelRadius(m_outer_sigma);
+        }
  
         /**
          * Returns the full name of the functor.
@@ -296,6 +308,18 @@ class OpticalFlowHGFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the tensor and its smoothing. Used to derive the halo of tiles
+         * for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return gaussianKernelRadius(m_sigma, 2) + gaussianKernelRadius(m_outer_sigma);
+        }
  
         /**
          * Returns the full name of the functor.
@@ -39,6 +39,9 @@
 //debug output
 #include <QtDebug>
 
+//cooperative cancellation
+#include "core/cancellation.hxx"
+
 //linear solving and eigenvector analysis
 #include <vigra/multi_math.hxx>
 #include <vigra/convolution.hxx>
@@ -49,6 +52,12 @@
 //OFCE Spatiotemporal Gradients
 #include "opticalflowgradients.hxx"
 
+//SoA iteration engine and statistics
+#include "opticalflow_iterative.hxx"
+
+//Multigrid solvers
+#include "opticalflow_multigrid.hxx"
+
 
 
 
@@ -93,16 +102,40 @@ class OpticalFlowHSOriginalFunctor
          * Constructor for the classical Horn&Schunck approach.
          *
          * \param alpha The alpha weight between gradient and smoothness.
-         * \param iterations The count of iterations.
+         * \param iterations The maximal count of iterations.
          * \param sigma The sigma is currently ignored.
+         * \param epsilon The iterations stop, if the flow converged w.r.t. this threshold.
+         *                Use 0 to always run all iterations. Defaults to 0.001.
          */
-		OpticalFlowHSOriginalFunctor(double alpha=50, int iterations=1, double sigma=1.0)
+		OpticalFlowHSOriginalFunctor(double alpha=50, int iterations=1, double sigma=1.0, double epsilon=0.001)
 		:	m_alpha(alpha),
 			m_iterations(iterations),
-			m_level(0.0)
+            m_epsilon(epsilon),
+			m_level(0.0),
+			m_solver(OpticalFlowFixedPointSolver)
 		{
         }
     
+        /**
+         * Returns the iteration statistics of all runs of this functor (and its copies).
+         *
+         * \return The iteration log.
+         */
+        const OpticalFlowIterationLog& log() const
+        {
+            return m_log;
+        }
+    
+        /**
+         * Selects the solver for the linear system of this functor.
+         *
+         * \param solver The solver, see OpticalFlowSolver.
+         */
+        void setSolver(OpticalFlowSolver solver)
+        {
+            m_solver = solver;
+        }
+    
         /**
          * When applied on a pyramidal processing model, this function is called on 
          * every layer/octave change.
@@ -113,6 +146,23 @@ class OpticalFlowHSOriginalFunctor
 		{
 			m_level=level;
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the finite differences and the 3x3 stencil of each fixed point
+         * iteration. The multigrid solvers couple the whole image. Used to derive the halo
+         * of tiles for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            if(m_solver != OpticalFlowFixedPointSolver)
+            {
+                return std::numeric_limits<unsigned int>::max();
+            }
+            return 1 + m_iterations;
+        }
 		
         /**
          * Returns the full name of the functor.
@@ -147,62 +197,9 @@ class OpticalFlowHSOriginalFunctor
                         const vigra::MultiArrayView<2,T2> & src2,
                         vigra::MultiArrayView<2, FlowValueType> flow)
 		{
-            vigra_precondition(src1.shape() == src2.shape(), "image sizes differ!");
-            vigra_precondition(src1.shape() == flow.shape(), "flow array sizes differ from image sizes!");
+            vigra::MultiArray<2,float> mask(src1.shape(), 1.0f);
             
-			vigra::MultiArray<2, FlowValueType> last_flow;
-			
-			double iter_change=0, mean_change=0, max_change=0;
-			
-			for (int iteration=1;iteration<=m_iterations; ++iteration)
-			{
-				mean_change=0;
-				max_change=0;
-				
-				last_flow = flow;
-				
-				for (int j=1; j<src1.height()-1; ++j)
-				{
-					for (int i=1; i<src1.width()-1; ++i)
-					{
-					
-						double	E_x = 0.25*(		src1(i+1,j  ) - src1(i,  j  )
-												+	src1(i+1,j+1) - src1(i,  j+1)
-												+	src2(i+1,j  ) - src2(i,  j  )
-												+	src2(i+1,j+1) - src2(i,  j+1)),
-								
-								E_y = 0.25*(		src1(i,  j+1) - src1(i,  j  )
-												+	src1(i+1,j+1) - src1(i+1,j  )
-												+	src2(i,  j+1) - src2(i,  j  )
-												+	src2(i+1,j+1) - src2(i+1,j  )),
-								
-								E_t = 0.25*(		src2(i,  j  ) - src1(i,  j  )
-												+	src2(i+1,j  ) - src1(i+1,j  )
-												+	src2(i,  j+1) - src1(i,  j+1)
-												+	src2(i+1,j+1) - src1(i+1,j+1)),
-											
-								u_mean =	(last_flow(i-1,j)[0]   + last_flow(i,j+1)[0]   +  last_flow(i+1,j)[0]   +  last_flow(i,j-1)[0]) /6.0
-										 +	(last_flow(i-1,j-1)[0] + last_flow(i-1,j+1)[0] +  last_flow(i+1,j+1)[0] +  last_flow(i-1,j-1)[0])/12.0,
-											
-								v_mean =	(last_flow(i-1,j)[1]   + last_flow(i,j+1)[1]   +  last_flow(i+1,j)[1]   +  last_flow(i,j-1)[1]) /6.0
-										 +	(last_flow(i-1,j-1)[1] + last_flow(i-1,j+1)[1] +  last_flow(i+1,j+1)[1] +  last_flow(i-1,j-1)[1])/12.0,
-
-								fix_part = (E_x*u_mean + E_y*v_mean + E_t)	/	(m_alpha*m_alpha + E_x*E_x + E_y*E_y);
-						
-						
-						flow(i,j)[0] = u_mean - fix_part*E_x;
-						flow(i,j)[1] = v_mean - fix_part*E_y;
-						
-						iter_change = vigra::norm(last_flow(i,j) - flow(i,j));
-						mean_change += iter_change;
-						max_change = std::max(max_change, iter_change);
-					}
-				}
-				mean_change= mean_change / (src1.size());
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
-			}
+            (*this)(src1, src2, mask, flow);
 		}
     
         /**
@@ -224,70 +221,177 @@ class OpticalFlowHSOriginalFunctor
             vigra_precondition(src1.shape() == mask.shape(), "image and mask sizes differ!");
             vigra_precondition(src1.shape() == flow.shape(), "flow array sizes differ from image sizes!");
             
-            vigra::MultiArray<2, FlowValueType> last_flow;
-			
-			double iter_change=0, mean_change=0, max_change=0;
-			
-			for (int iteration=1;iteration<=m_iterations; ++iteration)
+            const int w = src1.width(), h = src1.height();
+            
+            //The gradients do not change during the iterations, thus compute them once
+            vigra::MultiArray<2,float>  E_x(src1.shape()), E_y(src1.shape()), E_t(src1.shape()),
+                                        inv_den(src1.shape()), valid(src1.shape());
+            
+            for (int j=1; j<h-1; ++j)
+            {
+                for (int i=1; i<w-1; ++i)
+                {
+                    if(	  mask(i,  j  ) !=0  && mask(i,  j+1) !=0
+                       && mask(i+1,j  ) !=0  && mask(i+1,j+1) !=0)
+                    {
+                        E_x(i,j) = 0.25*(		src1(i+1,j  ) - src1(i,  j  )
+                                            +	src1(i+1,j+1) - src1(i,  j+1)
+                                            +	src2(i+1,j  ) - src2(i,  j  )
+                                            +	src2(i+1,j+1) - src2(i,  j+1));
+                        
+                        E_y(i,j) = 0.25*(		src1(i,  j+1) - src1(i,  j  )
+                                            +	src1(i+1,j+1) - src1(i+1,j  )
+                                            +	src2(i,  j+1) - src2(i,  j  )
+                                            +	src2(i+1,j+1) - src2(i+1,j  ));
+                        
+                        E_t(i,j) = 0.25*(		src2(i,  j  ) - src1(i,  j  )
+                                            +	src2(i+1,j  ) - src1(i+1,j  )
+                                            +	src2(i,  j+1) - src1(i,  j+1)
+                                            +	src2(i+1,j+1) - src1(i+1,j+1));
+                        
+                        double den = m_alpha*m_alpha + E_x(i,j)*E_x(i,j) + E_y(i,j)*E_y(i,j);
+                        
+                        inv_den(i,j) = (den > 0) ? 1.0/den : 0.0;
+                        valid(i,j)   = 1;
+                    }
+                }
+            }
+            
+            //The discretised Euler-Lagrange equations: alpha^2*(u - u_mean) + E_x*(E_x*u + E_y*v + E_t) = 0
+            OpticalFlowLinearSystem system(src1.shape(), m_alpha*m_alpha, 1.0f/6.0f, 1.0f/12.0f);
+            
+            for (int j=0; j<h; ++j)
+            {
+                for (int i=0; i<w; ++i)
+                {
+                    system.a11(i,j) = E_x(i,j)*E_x(i,j);
+                    system.a12(i,j) = system.a21(i,j) = E_x(i,j)*E_y(i,j);
+                    system.a22(i,j) = E_y(i,j)*E_y(i,j);
+                    system.f1(i,j)  = -E_x(i,j)*E_t(i,j);
+                    system.f2(i,j)  = -E_y(i,j)*E_t(i,j);
+                }
+            }
+            system.weight = valid;
+            
+            //SoA planes of the flow
+            vigra::MultiArray<2,float>  u(flow.bindElementChannel(0)), v(flow.bindElementChannel(1));
+            
+            if(m_solver == OpticalFlowFixedPointSolver)
+            {
+                m_log.add(iterate(E_x, E_y, E_t, inv_den, system, u, v));
+            }
+            else
+            {
+                m_log.add(solveOpticalFlowMultigrid(m_solver,
+                                                    [&](const vigra::MultiArray<2,float> &, const vigra::MultiArray<2,float> &){ return system; },
+                                                    false, m_iterations, m_epsilon, m_level, u, v));
+            }
+            
+            flow.bindElementChannel(0) = u;
+            flow.bindElementChannel(1) = v;
+		}
+
+    private:
+        /**
+         * The Jacobi iterations of Horn & Schunck. Each iteration is processed row-parallel.
+         *
+         * \param[in]     E_x     The spatial derivative in x-direction.
+         * \param[in]     E_y     The spatial derivative in y-direction.
+         * \param[in]     E_t     The temporal derivative.
+         * \param[in]     inv_den The inverse denominators 1/(alpha^2 + E_x^2 + E_y^2).
+         * \param[in]     system  The linear system (for the residuals and the valid pixels).
+         * \param[in,out] u       The first flow component.
+         * \param[in,out] v       The second flow component.
+         * \return The statistics of the iterations.
+         */
+        OpticalFlowIterationStatistics iterate(const vigra::MultiArray<2,float> & E_x,
+                                               const vigra::MultiArray<2,float> & E_y,
+                                               const vigra::MultiArray<2,float> & E_t,
+                                               const vigra::MultiArray<2,float> & inv_den,
+                                               const OpticalFlowLinearSystem & system,
+                                               vigra::MultiArray<2,float> & u,
+                                               vigra::MultiArray<2,float> & v) const
+        {
+            const int w = u.width(), h = u.height();
+            
+            //Next iterate (Jacobi scheme)
+            vigra::MultiArray<2,float> next_u(u), next_v(v);
+            
+            OpticalFlowIterationStatistics statistics = {m_level, 0, 0.0, 0.0, false};
+            
+            OpticalFlowResidualCurve curve(statistics, m_iterations/64);
+            curve.start(system.residual(u, v));
+            
+			for (int iteration=1; iteration<=m_iterations; ++iteration)
 			{
-				mean_change=0;
-				max_change=0;
-				
-                last_flow = flow;
-				
-				for (int j=1; j<src1.height()-1; ++j)
-				{
-					for (int i=1; i<src1.width()-1; ++i)
-					{
-					
-						if(	  mask(i,  j  ) !=0  && mask(i,  j+1) !=0
-						   && mask(i+1,j  ) !=0  && mask(i+1,j+1) !=0)
+				CancellationToken::checkCurrent();
+                
+                OpticalFlowChange change = parallelRows(1, h-1,
+                    [&](int j)
+                    {
+                        const float *u_p = &u(0,j-1), *u_c = &u(0,j), *u_n = &u(0,j+1),
+                                    *v_p = &v(0,j-1), *v_c = &v(0,j), *v_n = &v(0,j+1),
+                                    *ex = &E_x(0,j), *ey = &E_y(0,j), *et = &E_t(0,j),
+                                    *id = &inv_den(0,j), *va = &system.weight(0,j);
+                        float *nu = &next_u(0,j), *nv = &next_v(0,j);
+                        
+                        float sum_change = 0, max_change = 0;
+                        
+                        for (int i=1; i<w-1; ++i)
                         {
-                            double	E_x = 0.25*(		src1(i+1,j  ) - src1(i,  j  )
-                                                    +	src1(i+1,j+1) - src1(i,  j+1)
-                                                    +	src2(i+1,j  ) - src2(i,  j  )
-                                                    +	src2(i+1,j+1) - src2(i,  j+1)),
-                                    
-                                    E_y = 0.25*(		src1(i,  j+1) - src1(i,  j  )
-                                                    +	src1(i+1,j+1) - src1(i+1,j  )
-                                                    +	src2(i,  j+1) - src2(i,  j  )
-                                                    +	src2(i+1,j+1) - src2(i+1,j  )),
-                                    
-                                    E_t = 0.25*(		src2(i,  j  ) - src1(i,  j  )
-                                                    +	src2(i+1,j  ) - src1(i+1,j  )
-                                                    +	src2(i,  j+1) - src1(i,  j+1)
-                                                    +	src2(i+1,j+1) - src1(i+1,j+1)),
-                                                
-                                    u_mean =	(last_flow(i-1,j)[0]   + last_flow(i,j+1)[0]   +  last_flow(i+1,j)[0]   +  last_flow(i,j-1)[0]) /6.0
-                                             +	(last_flow(i-1,j-1)[0] + last_flow(i-1,j+1)[0] +  last_flow(i+1,j+1)[0] +  last_flow(i-1,j-1)[0])/12.0,
-                                                
-                                    v_mean =	(last_flow(i-1,j)[1]   + last_flow(i,j+1)[1]   +  last_flow(i+1,j)[1]   +  last_flow(i,j-1)[1]) /6.0
-                                             +	(last_flow(i-1,j-1)[1] + last_flow(i-1,j+1)[1] +  last_flow(i+1,j+1)[1] +  last_flow(i-1,j-1)[1])/12.0,
-
-                                    fix_part = (E_x*u_mean + E_y*v_mean + E_t)	/	(m_alpha*m_alpha + E_x*E_x + E_y*E_y);
-                            
+                            float u_mean =	(u_c[i-1] + u_n[i]   + u_c[i+1] + u_p[i])  /6.0f
+                                         +	(u_p[i-1] + u_n[i-1] + u_n[i+1] + u_p[i+1])/12.0f,
+                                  
+                                  v_mean =	(v_c[i-1] + v_n[i]   + v_c[i+1] + v_p[i])  /6.0f
+                                         +	(v_p[i-1] + v_n[i-1] + v_n[i+1] + v_p[i+1])/12.0f,
+                                  
+                                  fix_part = (ex[i]*u_mean + ey[i]*v_mean + et[i]) * id[i],
+                                  
+                                  du = va[i]*(u_mean - fix_part*ex[i] - u_c[i]),
+                                  dv = va[i]*(v_mean - fix_part*ey[i] - v_c[i]),
+                                  
+                                  iter_change = std::sqrt(du*du + dv*dv);
                             
-                            flow(i,j)[0] = u_mean - fix_part*E_x;
-                            flow(i,j)[1] = v_mean - fix_part*E_y;
+                            nu[i] = u_c[i] + du;
+                            nv[i] = v_c[i] + dv;
                             
-                            iter_change = vigra::norm(last_flow(i,j) - flow(i,j));
-                            mean_change += iter_change;
+                            sum_change += iter_change;
                             max_change = std::max(max_change, iter_change);
                         }
-                    }
+                        
+                        OpticalFlowChange row_change;
+                        row_change.sum = sum_change;
+                        row_change.max = max_change;
+                        return row_change;
+                    });
+                
+                u.swap(next_u);
+                v.swap(next_v);
+                
+                statistics.iterations  = iteration;
+                statistics.mean_change = change.sum / u.size();
+                statistics.max_change  = change.max;
+                statistics.converged   = opticalFlowConverged(statistics.mean_change, statistics.max_change, m_epsilon);
+                
+                curve.record(iteration, [&](){ return system.residual(u, v); },
+                             statistics.converged || iteration == m_iterations);
+                
+                if(statistics.converged)
+                {
+                    break;
                 }
-				mean_change= mean_change / (src1.size());
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
 			}
-		}
-
-    private:
+            
+            return statistics;
+        }
+    
 		double	m_alpha;
 		int		m_iterations;
     //  double  m_sigma;
+        double  m_epsilon;
 		int		m_level;
+        OpticalFlowIterationLog m_log;
+        OpticalFlowSolver m_solver;
 };
 
 
@@ -310,18 +414,45 @@ class OpticalFlowHSFunctor
          * Constructor for the Gaussian Horn&Schunck approach.
          *
          * \param alpha The alpha weight between gradient and smoothness.
-         * \param iterations The count of iterations.
+         * \param iterations The maximal count of iterations.
          * \param sigma The sigma of the Gaussian used to estimate the partial derivatives
          *              in space and time.
+         * \param epsilon The iterations stop, if the flow converged w.r.t. this threshold.
+         *                Use 0 to always run all iterations. Defaults to 0.001.
          */
-		OpticalFlowHSFunctor(double alpha=50, int iterations=1, double sigma=1.0)
+		OpticalFlowHSFunctor(double alpha=50, int iterations=1, double sigma=1.0, double epsilon=0.001)
 		:	m_alpha(alpha),
 			m_iterations(iterations),
 			m_sigma(sigma),
+            m_epsilon(epsilon),
 			m_level(0.0)
 		{
         }
     
+        /**
+         * Returns the iteration statistics of all runs of this functor (and its copies).
+         *
+         * \return The iteration log.
+         */
+        const OpticalFlowIterationLog& log() const
+        {
+            return m_log;
+        }
+    
+        /**
+         * This functor has no linear system and thus always uses its own fixed
+         * point iterations. Other solvers are rejected with a warning.
+         *
+         * \param solver The solver, see OpticalFlowSolver.
+         */
+        void setSolver(OpticalFlowSolver solver)
+        {
+            if(solver != OpticalFlowFixedPointSolver)
+            {
+                qWarning() << QString::fromStdString(name()) << "does not support" << opticalFlowSolverName(solver) << "- using fixed point iterations instead.";
+            }
+        }
+    
         /**
          * When applied on a pyramidal processing model, this function is called on 
          * every layer/octave change.
@@ -334,6 +465,18 @@ class OpticalFlowHSFunctor
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
 
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the Gaussian gradients and the smoothing of the flow, which grows
+         * with each iteration. Used to derive the halo of tiles for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return gaussianKernelRadius(m_sigma, 1) + m_iterations*std::max(gaussianKernelRadius(m_sigma), 1u);
+        }
+
         /**
          * Returns the full name of the functor.
          *
@@ -370,47 +513,12 @@ class OpticalFlowHSFunctor
             vigra_precondition(src1.shape() == src2.shape(), "image sizes differ!");
             vigra_precondition(src1.shape() == flow.shape(), "flow array sizes differ from image sizes!");
             
-            using namespace ::vigra;
-            
 			vigra::MultiArray<2,ValueType> gradX(src1.shape()), gradY(src1.shape()), gradT(src1.shape());
             
-            vigra::MultiArray<2, FlowValueType>  mean_flow(src1.shape());
-						
 			//spatiotemporal Gradients of first order: I_x, I_y and I_t
 			spatioTemporalGradient(src1, src2, gradX, gradY, gradT, m_sigma);
 			
-			double iter_change=0, mean_change=0, max_change=0;
-			
-			for (int iteration=1;iteration<=m_iterations; ++iteration)
-			{
-				mean_change=0;
-				max_change=0;
-				
-				vigra::gaussianSmoothing(flow, mean_flow,	m_sigma);
-				
-				for (int j=0; j<src1.height(); ++j)
-				{
-					for (int i=0; i<src1.width(); ++i)
-					{
-						double	fix_part	= (gradX(i,j)*mean_flow(i,j)[0]+ gradY(i,j)*mean_flow(i,j)[1]+ gradT(i,j))	/	(m_alpha*m_alpha + gradX(i,j)*gradX(i,j) + gradY(i,j)*gradY(i,j)),
-								new_u		= mean_flow(i,j)[0] - fix_part*gradX(i,j),
-								new_v		= mean_flow(i,j)[1] - fix_part*gradY(i,j);
-						
-						iter_change = sqrt(		pow(flow(i,j)[0] - new_u,2)
-										   +	pow(flow(i,j)[1] - new_v,2));
-						
-						mean_change	+= iter_change;
-						max_change = max(max_change, iter_change);
-                        
-						flow(i,j)[0] = new_u;
-                        flow(i,j)[1] = new_v;
-					}
-				}
-				mean_change = mean_change / src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
-			}
+            iterate(gradX, gradY, gradT, vigra::MultiArray<2,float>(src1.shape(), 1.0f), flow);
 		}
 		
 		/**
@@ -432,57 +540,133 @@ class OpticalFlowHSFunctor
             vigra_precondition(src1.shape() == mask.shape(), "image and mask sizes differ!");
             vigra_precondition(src1.shape() == flow.shape(), "flow array sizes differ from image sizes!");
             
-            using namespace ::vigra;
-            
 			vigra::MultiArray<2,ValueType> gradX(src1.shape()), gradY(src1.shape()), gradT(src1.shape());
-            
-            vigra::MultiArray<2, FlowValueType>  mean_flow(src1.shape());
 						
 			//spatiotemporal Gradients of first order: I_x, I_y and I_t
 			spatioTemporalGradientWithMask(src1, src2, mask, gradX, gradY, gradT, m_sigma);
 			
-			double iter_change=0, mean_change=0, max_change=0;
-			
+            iterate(gradX, gradY, gradT, maskWeight(mask), flow);
+		}
+    
+	private:
+        /**
+         * The iterations on precomputed gradients. Each iteration smoothes the u and v planes
+         * by means of a normalized Gaussian convolution with the weights and updates all
+         * pixels of non-zero weight according to Horn & Schunck (Jacobi scheme).
+         *
+         * \param[in] gradX The spatiotemporal gradient in x-direction.
+         * \param[in] gradY The spatiotemporal gradient in y-direction.
+         * \param[in] gradT The spatiotemporal gradient in t-direction.
+         * \param[in] weight The weight of each pixel (0 for masked pixels, 1 otherwise).
+         * \param[in,out] flow The Optical Flow field.
+         */
+        void iterate(const vigra::MultiArray<2,ValueType> & gradX,
+                     const vigra::MultiArray<2,ValueType> & gradY,
+                     const vigra::MultiArray<2,ValueType> & gradT,
+                     const vigra::MultiArray<2,float> & weight,
+                     vigra::MultiArrayView<2, FlowValueType> flow)
+        {
+            const int w = gradX.width(), h = gradX.height();
+            
+            vigra::MultiArray<2,float> inv_den(gradX.shape());
+            
+            for (int j=0; j<h; ++j)
+            {
+                for (int i=0; i<w; ++i)
+                {
+                    double den = m_alpha*m_alpha + gradX(i,j)*gradX(i,j) + gradY(i,j)*gradY(i,j);
+                    
+                    inv_den(i,j) = (den > 0) ? 1.0/den : 0.0;
+                }
+            }
+            
+            //SoA planes of the flow: current and next iterate (Jacobi scheme) and the horizontally smoothed planes
+            vigra::MultiArray<2,float>  u(flow.bindElementChannel(0)), v(flow.bindElementChannel(1)),
+                                        next_u(u), next_v(v),
+                                        smooth_u(gradX.shape()), smooth_v(gradX.shape());
+            
+            OpticalFlowSmoother smoother(weight, m_sigma);
+            const vigra::MultiArray<2,float> & norm = smoother.normalization();
+            
+            OpticalFlowIterationStatistics statistics = {m_level, 0, 0.0, 0.0, false};
+            
 			for (int iteration=1;iteration<=m_iterations; ++iteration)
 			{
-				mean_change=0;
-				max_change=0;
-				
-				gaussianSmoothingWithMask(flow, mask, mean_flow,	m_sigma);
-				
-				for (int j=0; j<src1.height(); ++j)
-				{
-					for (int i=0; i<src1.width(); ++i)
-					{
-						if(mask(i,j) !=0)
+				CancellationToken::checkCurrent();
+                
+                smoother.horizontalPass(u, smooth_u);
+                smoother.horizontalPass(v, smooth_v);
+                
+                //Vertical smoothing pass fused with the update step
+                OpticalFlowChange change = parallelRows(0, h,
+                    [&](int j)
+                    {
+                        std::vector<float> mean_u(w), mean_v(w);
+                        
+                        smoother.verticalRow(smooth_u, j, mean_u.data());
+                        smoother.verticalRow(smooth_v, j, mean_v.data());
+                        
+                        const float *gx = &gradX(0,j), *gy = &gradY(0,j), *gt = &gradT(0,j),
+                                    *id = &inv_den(0,j), *wt = &weight(0,j), *nm = &norm(0,j),
+                                    *u_c = &u(0,j), *v_c = &v(0,j);
+                        float *nu = &next_u(0,j), *nv = &next_v(0,j);
+                        
+                        float sum_change = 0, max_change = 0;
+                        
+                        for (int i=0; i<w; ++i)
                         {
-                            double	fix_part	= (gradX(i,j)*mean_flow(i,j)[0]+ gradY(i,j)*mean_flow(i,j)[1]+ gradT(i,j))	/	(m_alpha*m_alpha + gradX(i,j)*gradX(i,j) + gradY(i,j)*gradY(i,j)),
-                                    new_u		= mean_flow(i,j)[0] -fix_part*gradX(i,j),
-                                    new_v		= mean_flow(i,j)[1] -fix_part*gradY(i,j);
-						
-                            iter_change = sqrt(		pow(flow(i,j)[0] - new_u,2)
-										   +	pow(flow(i,j)[1] - new_v,2));
-						
-                            mean_change	+= iter_change;
-                            max_change = max(max_change, iter_change);
-						
-                            flow(i,j)[0] = new_u;
-                            flow(i,j)[1] = new_v;
-						}
-					}
-				}
-				mean_change = mean_change / src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
+                            float valid  = (wt[i] != 0 && nm[i] > 0) ? 1.0f : 0.0f,
+                                  inv_nm = valid / std::max(nm[i], std::numeric_limits<float>::min()),
+                                  
+                                  u_mean = mean_u[i]*inv_nm,
+                                  v_mean = mean_v[i]*inv_nm,
+                                  
+                                  fix_part = (gx[i]*u_mean + gy[i]*v_mean + gt[i]) * id[i],
+                                  
+                                  du = valid*(u_mean - fix_part*gx[i] - u_c[i]),
+                                  dv = valid*(v_mean - fix_part*gy[i] - v_c[i]),
+                                  
+                                  iter_change = std::sqrt(du*du + dv*dv);
+                            
+                            nu[i] = u_c[i] + du;
+                            nv[i] = v_c[i] + dv;
+                            
+                            sum_change += iter_change;
+                            max_change = std::max(max_change, iter_change);
+                        }
+                        
+                        OpticalFlowChange row_change;
+                        row_change.sum = sum_change;
+                        row_change.max = max_change;
+                        return row_change;
+                    });
+                
+                u.swap(next_u);
+                v.swap(next_v);
+                
+                statistics.iterations  = iteration;
+                statistics.mean_change = change.sum / gradX.size();
+                statistics.max_change  = change.max;
+                
+                if(opticalFlowConverged(statistics.mean_change, statistics.max_change, m_epsilon))
+                {
+                    statistics.converged = true;
+                    break;
+                }
 			}
-		}
+            
+            flow.bindElementChannel(0) = u;
+            flow.bindElementChannel(1) = v;
+            
+            m_log.add(statistics);
+        }
     
-	private:
 		double	m_alpha;
 		int		m_iterations;
 		double  m_sigma;
+        double  m_epsilon;
 		int		m_level;
+        OpticalFlowIterationLog m_log;
 };
 
 
@@ -508,17 +692,44 @@ class OpticalFlowNEFunctor
          * Constructor for the Nagel & Enkelmann approach.
          *
          * \param alpha The alpha weight between gradient and smoothness.
-         * \param iterations The count of iterations.
+         * \param iterations The maximal count of iterations.
          * \param sigma The sigma of the Gaussian used to estimate the partial derivatives
          *              in space and time.
+         * \param epsilon The iterations stop, if the flow converged w.r.t. this threshold.
+         *                Use 0 to always run all iterations. Defaults to 0.001.
          */
-		OpticalFlowNEFunctor(double alpha=50, int iterations=1, double sigma=1.0)
+		OpticalFlowNEFunctor(double alpha=50, int iterations=1, double sigma=1.0, double epsilon=0.001)
 		:	m_alpha(alpha),
 			m_iterations(iterations),
 			m_sigma(sigma),
+            m_epsilon(epsilon),
 			m_level(0.0)
 		{
         }
+    
+        /**
+         * Returns the iteration statistics of all runs of this functor (and its copies).
+         *
+         * \return The iteration log.
+         */
+        const OpticalFlowIterationLog& log() const
+        {
+            return m_log;
+        }
+    
+        /**
+         * This functor has no linear system and thus always uses its own fixed
+         * point iterations. Other solvers are rejected with a warning.
+         *
+         * \param solver The solver, see OpticalFlowSolver.
+         */
+        void setSolver(OpticalFlowSolver solver)
+        {
+            if(solver != OpticalFlowFixedPointSolver)
+            {
+                qWarning() << QString::fromStdString(name()) << "does not support" << opticalFlowSolverName(solver) << "- using fixed point iterations instead.";
+            }
+        }
 		
         /**
          * When applied on a pyramidal processing model, this function is called on 
@@ -531,6 +742,18 @@ class OpticalFlowNEFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the Gaussian gradients and the smoothing of the flow, which grows
+         * with each iteration. Used to derive the halo of tiles for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return gaussianKernelRadius(m_sigma, 1) + m_iterations*std::max(gaussianKernelRadius(m_sigma), 1u);
+        }
 		
         /**
          * Returns the full name of the functor.
@@ -630,6 +853,8 @@ class OpticalFlowNEFunctor
 			}
 			
 			double iter_change=0, mean_change=0,max_change=0;
+            
+            OpticalFlowIterationStatistics statistics = {m_level, 0, 0.0, 0.0, false};
 			
 			double	Xi_u, Xi_v, fix_part, new_u, new_v;
 			
@@ -640,6 +865,8 @@ class OpticalFlowNEFunctor
 			//do iterations
 			for (int iteration=1; iteration<=m_iterations; ++iteration)
 			{
+				CancellationToken::checkCurrent();
+
 				mean_change=0;
 				max_change=0;
 				
@@ -696,10 +923,19 @@ class OpticalFlowNEFunctor
 				}
 				
 				mean_change = mean_change / src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
+				
+                statistics.iterations  = iteration;
+                statistics.mean_change = mean_change;
+                statistics.max_change  = max_change;
+                
+                if(opticalFlowConverged(mean_change, max_change, m_epsilon))
+                {
+                    statistics.converged = true;
+                    break;
+                }
 			}
+            
+            m_log.add(statistics);
 		}
 	
 		/**
@@ -785,6 +1021,8 @@ class OpticalFlowNEFunctor
 			}
 			
 			double iter_change=0, mean_change=0,max_change=0;
+            
+            OpticalFlowIterationStatistics statistics = {m_level, 0, 0.0, 0.0, false};
 			
 			double	Xi_u, Xi_v, fix_part, new_u, new_v;
 			
@@ -795,6 +1033,8 @@ class OpticalFlowNEFunctor
 			//do iterations
 			for (int iteration=1; iteration<=m_iterations; ++iteration)
 			{
+				CancellationToken::checkCurrent();
+
 				mean_change=0;
 				max_change=0;
 				
@@ -852,10 +1092,19 @@ class OpticalFlowNEFunctor
 				}
 				
 				mean_change = mean_change /src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
+				
+                statistics.iterations  = iteration;
+                statistics.mean_change = mean_change;
+                statistics.max_change  = max_change;
+                
+                if(opticalFlowConverged(mean_change, max_change, m_epsilon))
+                {
+                    statistics.converged = true;
+                    break;
+                }
 			}
+            
+            m_log.add(statistics);
 			
 		}
 
@@ -863,7 +1112,9 @@ class OpticalFlowNEFunctor
 		double	m_alpha;
 		int		m_iterations;
 		double  m_sigma;
+        double  m_epsilon;
 		int		m_level;
+        OpticalFlowIterationLog m_log;
 };
 
 /**
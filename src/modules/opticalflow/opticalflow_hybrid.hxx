@@ -39,9 +39,18 @@
 //debug output
 #include <QtDebug>
 
+//cooperative cancellation
+#include "core/cancellation.hxx"
+
 //OFCE Spatiotemporal Gradients
 #include "opticalflowgradients.hxx"
 
+//SoA iteration engine and statistics
+#include "opticalflow_iterative.hxx"
+
+//Multigrid solvers
+#include "opticalflow_multigrid.hxx"
+
 
 namespace graipe {
 
@@ -71,17 +80,41 @@ class OpticalFlowCLGFunctor
          * \param sigma The sigma of the Gaussian used to compute the spatio-temporal gradients.
          * \param outer_sigma The sigma of the Gaussian used to apply the smoothing step for the Structure Tensor.
          * \param omega Linear penalizer weight. Defaults to 1.0.
-         * \param iterations The count of iterations.
+         * \param iterations The maximal count of iterations.
+         * \param epsilon The iterations stop, if the flow converged w.r.t. this threshold.
+         *                Use 0 to always run all iterations. Defaults to 0.001.
          */
-		OpticalFlowCLGFunctor(double alpha=1.0, double sigma=1.0, double outer_sigma=3.0, double omega=1.0, int iterations=100)
+		OpticalFlowCLGFunctor(double alpha=1.0, double sigma=1.0, double outer_sigma=3.0, double omega=1.0, int iterations=100, double epsilon=0.001)
 		:	m_outer_sigma(outer_sigma),
 			m_sigma(sigma),
 			m_alpha(alpha),
 			m_omega(omega),
 			m_iterations(iterations),
-			m_level(0.0)
+            m_epsilon(epsilon),
+			m_level(0.0),
+			m_solver(OpticalFlowFixedPointSolver)
 		{
         }
+    
+        /**
+         * Returns the iteration statistics of all runs of this functor (and its copies).
+         *
+         * \return The iteration log.
+         */
+        const OpticalFlowIterationLog& log() const
+        {
+            return m_log;
+        }
+    
+        /**
+         * Selects the solver for the linear system of this functor.
+         *
+         * \param solver The solver, see OpticalFlowSolver.
+         */
+        void setSolver(OpticalFlowSolver solver)
+        {
+            m_solver = solver;
+        }
 		
         /**
          * When applied on a pyramidal processing model, this function is called on 
@@ -94,6 +127,23 @@ class OpticalFlowCLGFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the structure tensor and the red-black sweeps, which reach two
+         * pixels per iteration. The multigrid solvers couple the whole image. Used to
+         * derive the halo of tiles for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            if(m_solver != OpticalFlowFixedPointSolver)
+            {
+                return std::numeric_limits<unsigned int>::max();
+            }
+            return gaussianKernelRadius(m_sigma, 1) + gaussianKernelRadius(m_outer_sigma) + 2*m_iterations;
+        }
 		
         /**
          * Returns the full name of the functor.
@@ -136,8 +186,6 @@ class OpticalFlowCLGFunctor
 			vigra::MultiArray<2, ValueType> stxx(src1.shape()), stxy(src1.shape()), styy(src1.shape()),
                                             gradX(src1.shape()), gradY(src1.shape()), gradT(src1.shape()), temp(src1.shape());
             
-            vigra::MultiArray<2, FlowValueType> last_flow(src1.shape());
-			
             temp = (src1+src2)/2;
             
 			// calculate Structure Tensor at inner scale = sigma and outer scale = sigma2
@@ -157,48 +205,7 @@ class OpticalFlowCLGFunctor
 			vigra::gaussianSmoothing(gradY, gradY,	m_outer_sigma);
 			
 			
-			int max_iter = m_iterations;
-			double	omega = m_omega,
-					iter_change=0,
-					mean_change=0,
-					max_change=0;
-			
-			for(int iteration=1; iteration<=max_iter; iteration++)
-			{
-				//save last results
-				last_flow = flow;
-				
-				mean_change=0;
-				max_change=0;
-				
-				for (int j=1;j<src1.height()-1; ++j)
-				{
-					for (int i=1;i<src1.width()-1; ++i)
-					{
-						 //With SOR (successive over-relaxation)
-						 flow(i,j)[0] = (1.0-omega)*last_flow(i,j)[0]
-										+	omega*(		(flow(i-1,j)[0] + flow(i,j-1)[0])
-													+	(last_flow(i+1,j)[0]+last_flow(i,j+1)[0])
-													-	(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[1] + gradX(i,j)))
-										/	(4.0 + (1.0/m_alpha)*stxx(i,j));
-						
-						 flow(i,j)[1] = (1.0-omega)*last_flow(i,j)[1]
-									   +	omega*(		(flow(i-1,j)[1] + flow(i,j-1)[1])
-													+	(last_flow(i+1,j)[1]+last_flow(i,j+1)[1])
-													-	(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[0] + gradY(i,j)))
-									   /	(4.0 + (1.0/m_alpha)*styy(i,j));
-						
-						iter_change =  vigra::norm(last_flow(i,j) - flow(i,j));
-						mean_change += iter_change;
-										
-                        max_change = std::max(max_change, iter_change);
-					}
-				}
-				mean_change = mean_change / src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
-			}
+            iterate(stxx, stxy, styy, gradX, gradY, vigra::MultiArray<2,float>(src1.shape(), 1.0f), flow);
 		}
 	
 		/**
@@ -226,8 +233,6 @@ class OpticalFlowCLGFunctor
 			vigra::MultiArray<2, ValueType> stxx(src1.shape()), stxy(src1.shape()), styy(src1.shape()),
                                             gradX(src1.shape()), gradY(src1.shape()), gradT(src1.shape()), temp(src1.shape());
            
-            vigra::MultiArray<2,FlowValueType> last_flow(src1.shape());
-            
             temp = (src1+src2)/2;
             
 			// calculate Structure Tensor at inner scale = sigma and outer scale = sigma2
@@ -247,60 +252,190 @@ class OpticalFlowCLGFunctor
 			gaussianSmoothingWithMask(gradY, mask, gradY,	m_outer_sigma);
 			
 			
-			int max_iter = m_iterations;
-			double	omega = m_omega,
-			iter_change=0,
-			mean_change=0,
-			max_change=0;
-			
-			for(int iteration=1; iteration<=max_iter; iteration++)
-			{
-				//save last results
-				last_flow = flow;
-				
-				mean_change=0;
-				max_change=0;
-				
-				for (int j=1;j<src1.height()-1; ++j)
+            iterate(stxx, stxy, styy, gradX, gradY, maskWeight(mask), flow);
+		}
+    
+    private:
+        /**
+         * Assembles the linear system of the CLG approach for the multigrid solvers:
+         * alpha*sum_n (u - u_n) + J_11*u + J_12*v = -J_13 and likewise for v.
+         * The borders are fixed as in the SOR scheme.
+         *
+         * \param stxx The xx-part of the Structure Tensor.
+         * \param stxy The xy-part of the Structure Tensor.
+         * \param styy The yy-part of the Structure Tensor.
+         * \param bx The smoothed product of I_x and I_t.
+         * \param by The smoothed product of I_y and I_t.
+         * \param weight The weight of each pixel (0 for masked pixels, 1 otherwise).
+         * \return The linear system.
+         */
+        OpticalFlowLinearSystem linearSystem(const vigra::MultiArray<2,ValueType> & stxx,
+                                             const vigra::MultiArray<2,ValueType> & stxy,
+                                             const vigra::MultiArray<2,ValueType> & styy,
+                                             const vigra::MultiArray<2,ValueType> & bx,
+                                             const vigra::MultiArray<2,ValueType> & by,
+                                             const vigra::MultiArray<2,float> & weight) const
+        {
+            const int w = stxx.width(), h = stxx.height();
+            
+            OpticalFlowLinearSystem system(stxx.shape(), m_alpha);
+            
+            for (int j=0; j<h; ++j)
+            {
+                for (int i=0; i<w; ++i)
+                {
+                    system.a11(i,j) = stxx(i,j);
+                    system.a12(i,j) = system.a21(i,j) = stxy(i,j);
+                    system.a22(i,j) = styy(i,j);
+                    system.f1(i,j)  = -bx(i,j);
+                    system.f2(i,j)  = -by(i,j);
+                    system.weight(i,j) = (i>0 && j>0 && i<w-1 && j<h-1) ? weight(i,j) : 0.0f;
+                }
+            }
+            return system;
+        }
+    
+        /**
+         * The iterations on the precomputed structure tensor. Each iteration consists of
+         * two half sweeps of a red-black SOR scheme: First all pixels with even i+j are
+         * updated, then all pixels with odd i+j. Since each half sweep only depends on the
+         * pixels of the other color, the rows are processed in parallel.
+         * If a multigrid solver has been selected, it is used instead.
+         *
+         * \param[in] stxx The xx-part of the Structure Tensor.
+         * \param[in] stxy The xy-part of the Structure Tensor.
+         * \param[in] styy The yy-part of the Structure Tensor.
+         * \param[in] bx The smoothed product of I_x and I_t.
+         * \param[in] by The smoothed product of I_y and I_t.
+         * \param[in] weight The weight of each pixel (0 for masked pixels, 1 otherwise).
+         * \param[in,out] flow The Optical Flow field.
+         */
+        void iterate(const vigra::MultiArray<2,ValueType> & stxx,
+                     const vigra::MultiArray<2,ValueType> & stxy,
+                     const vigra::MultiArray<2,ValueType> & styy,
+                     const vigra::MultiArray<2,ValueType> & bx,
+                     const vigra::MultiArray<2,ValueType> & by,
+                     const vigra::MultiArray<2,float> & weight,
+                     vigra::MultiArrayView<2, FlowValueType> flow)
+        {
+            const int w = stxx.width(), h = stxx.height();
+            const float omega = m_omega,
+                        inv_alpha = 1.0/m_alpha;
+            
+            //The denominators do not change during the iterations
+            vigra::MultiArray<2,float> inv_den_u(stxx.shape()), inv_den_v(stxx.shape());
+            
+            for (int j=0; j<h; ++j)
+            {
+                for (int i=0; i<w; ++i)
+                {
+                    inv_den_u(i,j) = 1.0/(4.0 + inv_alpha*stxx(i,j));
+                    inv_den_v(i,j) = 1.0/(4.0 + inv_alpha*styy(i,j));
+                }
+            }
+            
+            //SoA planes of the flow
+            vigra::MultiArray<2,float> u(flow.bindElementChannel(0)), v(flow.bindElementChannel(1));
+            
+            //The same system for the multigrid solvers and the residuals (fixed borders as in the SOR scheme)
+            const OpticalFlowLinearSystem system = linearSystem(stxx, stxy, styy, bx, by, weight);
+            
+            OpticalFlowIterationStatistics statistics = {m_level, 0, 0.0, 0.0, false};
+            
+            if(m_solver != OpticalFlowFixedPointSolver)
+            {
+                statistics = solveOpticalFlowMultigrid(m_solver,
+                                                       [&](const vigra::MultiArray<2,float> &, const vigra::MultiArray<2,float> &){ return system; },
+                                                       false, m_iterations, m_epsilon, m_level, u, v);
+            }
+            else
+            {
+                std::function<double()> residual = [&](){ return system.residual(u, v); };
+                
+                OpticalFlowResidualCurve curve(statistics, m_iterations/64);
+                curve.start(residual());
+                
+				for(int iteration=1; iteration<=m_iterations; iteration++)
 				{
-					for (int i=1;i<src1.width()-1; ++i)
-					{
-						if(	mask(i,j) !=0 )
-						{
-						 //With SOR (successive over-relaxation)
-						 flow(i,j)[0] = (1.0-omega)*last_flow(i,j)[0]
-										+	omega*(		(flow(i-1,j)[0] + flow(i,j-1)[0])
-													+	(last_flow(i+1,j)[0]+last_flow(i,j+1)[0])
-													-	(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[1] + gradX(i,j)))
-										/	(4.0 + (1.0/m_alpha)*stxx(i,j));
-						
-						 flow(i,j)[1] = (1.0-omega)*last_flow(i,j)[1]
-									   +	omega*(		(flow(i-1,j)[1] + flow(i,j-1)[1])
-													+	(last_flow(i+1,j)[1]+last_flow(i,j+1)[1])
-													-	(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[0] + gradY(i,j)))
-									   /	(4.0 + (1.0/m_alpha)*styy(i,j));
-						
-						iter_change =  vigra::norm(last_flow(i,j) - flow(i,j));
-						mean_change += iter_change;
-										
-                        max_change = std::max(max_change, iter_change);
-                        }
+					CancellationToken::checkCurrent();
+                
+                    OpticalFlowChange change;
+                
+                    for(int color=0; color!=2; ++color)
+                    {
+                        change.add(parallelRows(1, h-1,
+                            [&](int j)
+                            {
+                                float *u_p = &u(0,j-1), *u_c = &u(0,j), *u_n = &u(0,j+1),
+                                      *v_p = &v(0,j-1), *v_c = &v(0,j), *v_n = &v(0,j+1);
+                                const float *sxy = &stxy(0,j), *gx = &bx(0,j), *gy = &by(0,j),
+                                            *idu = &inv_den_u(0,j), *idv = &inv_den_v(0,j), *wt = &weight(0,j);
+                            
+                                float sum_change = 0, max_change = 0;
+                            
+                                for (int i = 1 + (1+j+color)%2; i<w-1; i+=2)
+                                {
+                                    float u_old = u_c[i], v_old = v_c[i];
+                                
+                                    //With SOR (successive over-relaxation)
+                                    float new_u = (1.0f-omega)*u_old
+                                                +	omega*(		(u_c[i-1] + u_p[i]) + (u_c[i+1] + u_n[i])
+                                                            -	inv_alpha*(sxy[i]*v_old + gx[i]))
+                                                     * idu[i],
+                                
+                                          new_v = (1.0f-omega)*v_old
+                                                +	omega*(		(v_c[i-1] + v_p[i]) + (v_c[i+1] + v_n[i])
+                                                            -	inv_alpha*(sxy[i]*u_old + gy[i]))
+                                                     * idv[i],
+                                
+                                          du = wt[i]*(new_u - u_old),
+                                          dv = wt[i]*(new_v - v_old),
+                                      
+                                          iter_change = std::sqrt(du*du + dv*dv);
+                                
+                                    u_c[i] = u_old + du;
+                                    v_c[i] = v_old + dv;
+                                
+                                    sum_change += iter_change;
+                                    max_change = std::max(max_change, iter_change);
+                                }
+                            
+                                OpticalFlowChange row_change;
+                                row_change.sum = sum_change;
+                                row_change.max = max_change;
+                                return row_change;
+                            }));
+                    }
+                
+                    statistics.iterations  = iteration;
+                    statistics.mean_change = change.sum / stxx.size();
+                    statistics.max_change  = change.max;
+                    statistics.converged   = opticalFlowConverged(statistics.mean_change, statistics.max_change, m_epsilon);
+                
+                    curve.record(iteration, residual, statistics.converged || iteration == m_iterations);
+                
+                    if(statistics.converged)
+                    {
+                        break;
                     }
 				}
-				mean_change = mean_change / src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
-			}
-		}
+            }
+            
+            flow.bindElementChannel(0) = u;
+            flow.bindElementChannel(1) = v;
+            
+            m_log.add(statistics);
+        }
     
-    private:
 		double	m_outer_sigma;
 		double	m_sigma;
 		double	m_alpha;
 		double  m_omega;
 		int		m_iterations;
+        double  m_epsilon;
 		int		m_level;
+        OpticalFlowIterationLog m_log;
+        OpticalFlowSolver m_solver;
 };
 
 
@@ -323,18 +458,42 @@ class OpticalFlowCLGNonlinearFunctor
          * \param sigma The sigma of the Gaussian used to compute the spatio-temporal gradients.
          * \param outer_sigma The sigma of the Gaussian used to apply the smoothing step for the Structure Tensor.
          * \param omega Linear penalizer weight. Defaults to 1.0.
-         * \param iterations The count of iterations.
+         * \param iterations The maximal count of iterations.
+         * \param epsilon The iterations stop, if the flow converged w.r.t. this threshold.
+         *                Use 0 to always run all iterations. Defaults to 0.001.
          */
-		OpticalFlowCLGNonlinearFunctor(double alpha=1.0, double sigma=1.0, double outer_sigma=3.0, double omega=1.0, int iterations=100)
+		OpticalFlowCLGNonlinearFunctor(double alpha=1.0, double sigma=1.0, double outer_sigma=3.0, double omega=1.0, int iterations=100, double epsilon=0.001)
 			:	m_outer_sigma(outer_sigma),
 				m_sigma(sigma),
 				m_alpha(alpha),
 				m_omega(omega),
 				m_iterations(iterations),
-				m_level(0.0)
+                m_epsilon(epsilon),
+				m_level(0.0),
+				m_solver(OpticalFlowFixedPointSolver)
 		{
         }
     
+        /**
+         * Returns the iteration statistics of all runs of this functor (and its copies).
+         *
+         * \return The iteration log.
+         */
+        const OpticalFlowIterationLog& log() const
+        {
+            return m_log;
+        }
+    
+        /**
+         * Selects the solver for the linear system of this functor.
+         *
+         * \param solver The solver, see OpticalFlowSolver.
+         */
+        void setSolver(OpticalFlowSolver solver)
+        {
+            m_solver = solver;
+        }
+    
         /**
          * When applied on a pyramidal processing model, this function is called on 
          * every layer/octave change.
@@ -346,6 +505,24 @@ class OpticalFlowCLGNonlinearFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the structure tensor and the red-black sweeps, which reach two
+         * pixels per iteration plus one for the diffusivities. The multigrid solvers
+         * couple the whole image. Used to derive the halo of tiles for the tiled
+         * processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            if(m_solver != OpticalFlowFixedPointSolver)
+            {
+                return std::numeric_limits<unsigned int>::max();
+            }
+            return gaussianKernelRadius(m_sigma, 1) + gaussianKernelRadius(m_outer_sigma) + 3*m_iterations;
+        }
 	
         /**
          * Returns the full name of the functor.
@@ -388,8 +565,6 @@ class OpticalFlowCLGNonlinearFunctor
 			vigra::MultiArray<2, ValueType> stxx(src1.shape()), stxy(src1.shape()), styy(src1.shape()),
                                     gradX(src1.shape()), gradY(src1.shape()), gradT(src1.shape()), temp(src1.shape());
             
-            vigra::MultiArray<2,FlowValueType> last_flow(src1.shape());
-			
             temp = (src1+src2)/2;
             
 			// calculate Structure Tensor at inner scale = sigma and outer scale = sigma2
@@ -408,84 +583,7 @@ class OpticalFlowCLGNonlinearFunctor
 			vigra::gaussianSmoothing(gradY, gradX,	m_outer_sigma);
 			vigra::gaussianSmoothing(gradY, gradY,	m_outer_sigma);
 			
-			int max_iter = m_iterations;
-			double	omega = m_omega,
-					iter_change=0,
-					mean_change=0,
-					max_change=0;
-			
-			for(int iteration=0; iteration<max_iter; iteration++)
-			{
-				//save last results
-				last_flow = flow;
-				
-				mean_change=0;
-				max_change=0;
-				
-				for (int j=1;j<src1.height()-1; ++j)
-				{
-					for (int i=1;i<src1.width()-1; ++i)
-					{
-						//Some abbrev. for convenience
-						double	p2i_minus_u = (pen(2,     flow(i-1,j)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-								p2j_minus_u = (pen(2,     flow(i,j-1)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-								p2i_plus_u  = (pen(2,last_flow(i+1,j)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-								p2j_plus_u  = (pen(2,last_flow(i,j+1)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-								p1_u = pen(1,last_flow(i,j)[0]),
-							
-								p2i_minus_v = (pen(2,     flow(i-1,j)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-								p2j_minus_v = (pen(2,     flow(i,j-1)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-								p2i_plus_v  = (pen(2,last_flow(i+1,j)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-								p2j_plus_v  = (pen(2,last_flow(i,j+1)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-								p1_v = pen(1,last_flow(i,j)[1]);
-						
-						//With SOR (successive over-relaxation)
-						flow(i,j)[0] = (1.0-omega)*last_flow(i,j)[0]
-									  +	omega*(	/*** SUM over N- an penalize ***/
-													(p2i_minus_u * flow(i-1,j)[0])
-											   + 	(p2j_minus_u * flow(i,j-1)[0])
-											   /*** SUM over N+ an penalize ***/
-											   +
-													(p2i_plus_u * last_flow(i+1,j)[0])
-											   +	(p2j_plus_u * last_flow(i,j+1)[0])
-			
-											   /*** Structure tensor term ***/
-											   -	p1_u*(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[1] + gradX(i,j)))
-									  /	
-									  /*** SUM over all penalizer values for normalisation **/
-									  (		p2i_minus_u + p2j_minus_u 
-									   +	p2i_plus_u  + p2j_plus_u
-									   +	(	p1_u
-											 *	(1.0/m_alpha)*stxx(i,j)));
-						
-						flow(i,j)[1] = (1.0-omega)*last_flow(i,j)[1]
-									  +	omega*(	/*** SUM over N- an penalize ***/
-													(p2i_minus_v * flow(i-1,j)[1])
-											   + 	(p2j_minus_v * flow(i,j-1)[1])
-											   /*** SUM over N+ an penalize ***/
-											   +
-													(p2i_plus_v * last_flow(i+1,j)[1])
-											   +	(p2j_plus_v * last_flow(i,j+1)[1])
-			
-											   /*** Structure tensor term ***/
-											   -	p1_v*(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[0] + gradY(i,j)))
-									  /	
-									  /*** SUM over all penalizer values for normalisation **/
-									  (		p2i_minus_v + p2j_minus_v 
-									   +	p2i_plus_v + p2j_plus_v
-									   +	(	p1_v
-											 *	(1.0/m_alpha)*styy(i,j)));
-						
-						iter_change = vigra::norm(last_flow(i,j) - flow(i,j));
-						mean_change+= iter_change;
-						max_change  = max(max_change, iter_change);
-					}
-				}
-				mean_change = mean_change /src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
-			}
+            iterate(stxx, stxy, styy, gradX, gradY, vigra::MultiArray<2,float>(src1.shape(), 1.0f), flow);
 		}
 	
 		/**
@@ -512,8 +610,6 @@ class OpticalFlowCLGNonlinearFunctor
 			vigra::MultiArray<2, ValueType> stxx(src1.shape()), stxy(src1.shape()), styy(src1.shape()),
                                     gradX(src1.shape()), gradY(src1.shape()), gradT(src1.shape()), temp(src1.shape());
             
-			vigra::MultiArray<2, FlowValueType> last_flow(src1.shape());
-            
             temp = (src1+src2)/2;
             
 			// calculate Structure Tensor at inner scale = sigma and outer scale = sigma2
@@ -532,87 +628,7 @@ class OpticalFlowCLGNonlinearFunctor
 			gaussianSmoothingWithMask(gradY, mask, gradX,	m_outer_sigma);
 			gaussianSmoothingWithMask(gradY, mask, gradY,	m_outer_sigma);
 			
-			int max_iter = m_iterations;
-			double	omega = m_omega,
-					iter_change=0,
-					mean_change=0,
-					max_change=0;
-			
-			for(int iteration=0; iteration<max_iter; iteration++)
-			{
-				//save last results
-				last_flow = flow;
-				
-				mean_change=0;
-				max_change=0;
-				
-				for (int j=1;j<src1.height()-1; ++j)
-				{
-					for (int i=1;i<src1.width()-1; ++i)
-					{
-                        if(mask(i,j) != 0)
-                        {
-                            //Some abbrev. for convenience
-                            double	p2i_minus_u = (pen(2,     flow(i-1,j)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-                                    p2j_minus_u = (pen(2,     flow(i,j-1)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-                                    p2i_plus_u  = (pen(2,last_flow(i+1,j)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-                                    p2j_plus_u  = (pen(2,last_flow(i,j+1)[0]) + pen(2,last_flow(i,j)[0]))/2.0,
-                                    p1_u = pen(1,last_flow(i,j)[0]),
-                                
-                                    p2i_minus_v = (pen(2,     flow(i-1,j)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-                                    p2j_minus_v = (pen(2,     flow(i,j-1)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-                                    p2i_plus_v  = (pen(2,last_flow(i+1,j)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-                                    p2j_plus_v  = (pen(2,last_flow(i,j+1)[1]) + pen(2,last_flow(i,j)[1]))/2.0,
-                                    p1_v = pen(1,last_flow(i,j)[1]);
-                            
-                            //With SOR (successive over-relaxation)
-                            flow(i,j)[0] = (1.0-omega)*last_flow(i,j)[0]
-                                          +	omega*(	/*** SUM over N- an penalize ***/
-                                                        (p2i_minus_u * flow(i-1,j)[0])
-                                                   + 	(p2j_minus_u * flow(i,j-1)[0])
-                                                   /*** SUM over N+ an penalize ***/
-                                                   +
-                                                        (p2i_plus_u * last_flow(i+1,j)[0])
-                                                   +	(p2j_plus_u * last_flow(i,j+1)[0])
-                
-                                                   /*** Structure tensor term ***/
-                                                   -	p1_u*(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[1] + gradX(i,j)))
-                                          /	
-                                          /*** SUM over all penalizer values for normalisation **/
-                                          (		p2i_minus_u + p2j_minus_u 
-                                           +	p2i_plus_u  + p2j_plus_u
-                                           +	(	p1_u
-                                                 *	(1.0/m_alpha)*stxx(i,j)));
-                            
-                            flow(i,j)[1] = (1.0-omega)*last_flow(i,j)[1]
-                                          +	omega*(	/*** SUM over N- an penalize ***/
-                                                        (p2i_minus_v * flow(i-1,j)[1])
-                                                   + 	(p2j_minus_v * flow(i,j-1)[1])
-                                                   /*** SUM over N+ an penalize ***/
-                                                   +
-                                                        (p2i_plus_v * last_flow(i+1,j)[1])
-                                                   +	(p2j_plus_v * last_flow(i,j+1)[1])
-                
-                                                   /*** Structure tensor term ***/
-                                                   -	p1_v*(1.0/m_alpha)*(stxy(i,j)*last_flow(i,j)[0] + gradY(i,j)))
-                                          /	
-                                          /*** SUM over all penalizer values for normalisation **/
-                                          (		p2i_minus_v + p2j_minus_v 
-                                           +	p2i_plus_v + p2j_plus_v
-                                           +	(	p1_v
-                                                 *	(1.0/m_alpha)*styy(i,j)));
-                            
-                            iter_change = vigra::norm(last_flow(i,j) - flow(i,j));
-                            mean_change+= iter_change;
-                            max_change  = max(max_change, iter_change);
-                        }
-                    }
-				}
-				mean_change = mean_change /src1.size();
-				//qDebug() << iteration << ":\t mean change this iteration: " << mean_change << "\n";
-				//qDebug() << iteration << ":\t max change this iteration: " << max_change << "\n\n";
-				//if(mean_change < 0.001/(m_alpha*m_alpha*m_alpha) || max_change < 0.001/(m_alpha*m_alpha)) break;
-			}
+            iterate(stxx, stxy, styy, gradX, gradY, maskWeight(mask), flow);
 		}
 
 	protected:
@@ -631,12 +647,216 @@ class OpticalFlowCLGNonlinearFunctor
 		
 
 	private:
+        /**
+         * Assembles the system of the nonlinear CLG approach, linearised at a given flow:
+         * alpha*sum_n (p(u)+p(u_n))/2*(u - u_n) + p(u)*(J_11*u + J_12*v) = -p(u)*J_13
+         * and likewise for v. The borders are fixed as in the SOR scheme.
+         *
+         * \param stxx The xx-part of the Structure Tensor.
+         * \param stxy The xy-part of the Structure Tensor.
+         * \param styy The yy-part of the Structure Tensor.
+         * \param bx The smoothed product of I_x and I_t.
+         * \param by The smoothed product of I_y and I_t.
+         * \param weight The weight of each pixel (0 for masked pixels, 1 otherwise).
+         * \param u The first flow component.
+         * \param v The second flow component.
+         * \return The linearised system.
+         */
+        OpticalFlowLinearSystem linearSystem(const vigra::MultiArray<2,ValueType> & stxx,
+                                             const vigra::MultiArray<2,ValueType> & stxy,
+                                             const vigra::MultiArray<2,ValueType> & styy,
+                                             const vigra::MultiArray<2,ValueType> & bx,
+                                             const vigra::MultiArray<2,ValueType> & by,
+                                             const vigra::MultiArray<2,float> & weight,
+                                             const vigra::MultiArray<2,float> & u,
+                                             const vigra::MultiArray<2,float> & v) const
+        {
+            const int w = stxx.width(), h = stxx.height();
+            
+            OpticalFlowLinearSystem system(stxx.shape(), m_alpha);
+            
+            for (int j=0; j<h; ++j)
+            {
+                for (int i=0; i<w; ++i)
+                {
+                    const float p_u = pen(2, u(i,j)),
+                                p_v = pen(2, v(i,j));
+                    
+                    system.d1(i,j)  = p_u;
+                    system.d2(i,j)  = p_v;
+                    system.a11(i,j) = p_u*stxx(i,j);
+                    system.a12(i,j) = p_u*stxy(i,j);
+                    system.a21(i,j) = p_v*stxy(i,j);
+                    system.a22(i,j) = p_v*styy(i,j);
+                    system.f1(i,j)  = -p_u*bx(i,j);
+                    system.f2(i,j)  = -p_v*by(i,j);
+                    system.weight(i,j) = (i>0 && j>0 && i<w-1 && j<h-1) ? weight(i,j) : 0.0f;
+                }
+            }
+            return system;
+        }
+    
+        /**
+         * The iterations on the precomputed structure tensor. Each iteration consists of
+         * two half sweeps of a red-black SOR scheme: First all pixels with even i+j are
+         * updated, then all pixels with odd i+j. Since each half sweep only depends on the
+         * pixels of the other color, the rows are processed in parallel.
+         * If a multigrid solver has been selected, it is used instead.
+         *
+         * \param[in] stxx The xx-part of the Structure Tensor.
+         * \param[in] stxy The xy-part of the Structure Tensor.
+         * \param[in] styy The yy-part of the Structure Tensor.
+         * \param[in] bx The smoothed product of I_x and I_t.
+         * \param[in] by The smoothed product of I_y and I_t.
+         * \param[in] weight The weight of each pixel (0 for masked pixels, 1 otherwise).
+         * \param[in,out] flow The Optical Flow field.
+         */
+        void iterate(const vigra::MultiArray<2,ValueType> & stxx,
+                     const vigra::MultiArray<2,ValueType> & stxy,
+                     const vigra::MultiArray<2,ValueType> & styy,
+                     const vigra::MultiArray<2,ValueType> & bx,
+                     const vigra::MultiArray<2,ValueType> & by,
+                     const vigra::MultiArray<2,float> & weight,
+                     vigra::MultiArrayView<2, FlowValueType> flow)
+        {
+            const int w = stxx.width(), h = stxx.height();
+            const float omega = m_omega,
+                        inv_alpha = 1.0/m_alpha;
+            
+            //SoA planes of the flow and their penalized values
+            vigra::MultiArray<2,float>  u(flow.bindElementChannel(0)), v(flow.bindElementChannel(1)),
+                                        pen_u(stxx.shape()), pen_v(stxx.shape());
+            
+            OpticalFlowIterationStatistics statistics = {m_level, 0, 0.0, 0.0, false};
+            
+            if(m_solver != OpticalFlowFixedPointSolver)
+            {
+                //Lagged nonlinearity: The system is re-assembled before each cycle
+                statistics = solveOpticalFlowMultigrid(m_solver,
+                                                       [&](const vigra::MultiArray<2,float> & cur_u, const vigra::MultiArray<2,float> & cur_v)
+                                                       {
+                                                           return linearSystem(stxx, stxy, styy, bx, by, weight, cur_u, cur_v);
+                                                       },
+                                                       true, m_iterations, m_epsilon, m_level, u, v);
+            }
+            else
+            {
+                //The residual of the system, which has been linearised at the current flow
+                std::function<double()> residual = [&](){ return linearSystem(stxx, stxy, styy, bx, by, weight, u, v).residual(u, v); };
+                
+                OpticalFlowResidualCurve curve(statistics, m_iterations/64);
+                curve.start(residual());
+                
+				for(int iteration=1; iteration<=m_iterations; iteration++)
+				{
+					CancellationToken::checkCurrent();
+                
+                    OpticalFlowChange change;
+                
+                    for(int color=0; color!=2; ++color)
+                    {
+                        //Penalize the current flow once for all neighbors
+                        parallelRows(0, h,
+                            [&](int j)
+                            {
+                                for (int i=0; i<w; ++i)
+                                {
+                                    pen_u(i,j) = pen(2, u(i,j));
+                                    pen_v(i,j) = pen(2, v(i,j));
+                                }
+                                return OpticalFlowChange();
+                            });
+                    
+                        change.add(parallelRows(1, h-1,
+                            [&](int j)
+                            {
+                                float *u_p = &u(0,j-1), *u_c = &u(0,j), *u_n = &u(0,j+1),
+                                      *v_p = &v(0,j-1), *v_c = &v(0,j), *v_n = &v(0,j+1);
+                                const float *pu_p = &pen_u(0,j-1), *pu_c = &pen_u(0,j), *pu_n = &pen_u(0,j+1),
+                                            *pv_p = &pen_v(0,j-1), *pv_c = &pen_v(0,j), *pv_n = &pen_v(0,j+1),
+                                            *sxx = &stxx(0,j), *sxy = &stxy(0,j), *syy = &styy(0,j),
+                                            *gx = &bx(0,j), *gy = &by(0,j), *wt = &weight(0,j);
+                            
+                                float sum_change = 0, max_change = 0;
+                            
+                                for (int i = 1 + (1+j+color)%2; i<w-1; i+=2)
+                                {
+                                    float u_old = u_c[i], v_old = v_c[i],
+                                
+                                          //Some abbrev. for convenience
+                                          p2i_minus_u = (pu_c[i-1] + pu_c[i])/2.0f,
+                                          p2j_minus_u = (pu_p[i]   + pu_c[i])/2.0f,
+                                          p2i_plus_u  = (pu_c[i+1] + pu_c[i])/2.0f,
+                                          p2j_plus_u  = (pu_n[i]   + pu_c[i])/2.0f,
+                                          p1_u = pu_c[i],
+                                
+                                          p2i_minus_v = (pv_c[i-1] + pv_c[i])/2.0f,
+                                          p2j_minus_v = (pv_p[i]   + pv_c[i])/2.0f,
+                                          p2i_plus_v  = (pv_c[i+1] + pv_c[i])/2.0f,
+                                          p2j_plus_v  = (pv_n[i]   + pv_c[i])/2.0f,
+                                          p1_v = pv_c[i],
+                                
+                                          //With SOR (successive over-relaxation)
+                                          new_u = (1.0f-omega)*u_old
+                                                +	omega*(		p2i_minus_u*u_c[i-1] + p2j_minus_u*u_p[i]
+                                                            +	p2i_plus_u *u_c[i+1] + p2j_plus_u *u_n[i]
+                                                            -	p1_u*inv_alpha*(sxy[i]*v_old + gx[i]))
+                                                /	(p2i_minus_u + p2j_minus_u + p2i_plus_u + p2j_plus_u + p1_u*inv_alpha*sxx[i]),
+                                
+                                          new_v = (1.0f-omega)*v_old
+                                                +	omega*(		p2i_minus_v*v_c[i-1] + p2j_minus_v*v_p[i]
+                                                            +	p2i_plus_v *v_c[i+1] + p2j_plus_v *v_n[i]
+                                                            -	p1_v*inv_alpha*(sxy[i]*u_old + gy[i]))
+                                                /	(p2i_minus_v + p2j_minus_v + p2i_plus_v + p2j_plus_v + p1_v*inv_alpha*syy[i]),
+                                
+                                          du = wt[i]*(new_u - u_old),
+                                          dv = wt[i]*(new_v - v_old),
+                                      
+                                          iter_change = std::sqrt(du*du + dv*dv);
+                                
+                                    u_c[i] = u_old + du;
+                                    v_c[i] = v_old + dv;
+                                
+                                    sum_change += iter_change;
+                                    max_change = std::max(max_change, iter_change);
+                                }
+                            
+                                OpticalFlowChange row_change;
+                                row_change.sum = sum_change;
+                                row_change.max = max_change;
+                                return row_change;
+                            }));
+                    }
+                
+                    statistics.iterations  = iteration;
+                    statistics.mean_change = change.sum / stxx.size();
+                    statistics.max_change  = change.max;
+                    statistics.converged   = opticalFlowConverged(statistics.mean_change, statistics.max_change, m_epsilon);
+                
+                    curve.record(iteration, residual, statistics.converged || iteration == m_iterations);
+                
+                    if(statistics.converged)
+                    {
+                        break;
+                    }
+				}
+            }
+            
+            flow.bindElementChannel(0) = u;
+            flow.bindElementChannel(1) = v;
+            
+            m_log.add(statistics);
+        }
+    
 		double	m_outer_sigma;
 		double	m_sigma;
 		double	m_alpha;
 		double  m_omega;
 		int		m_iterations;
+        double  m_epsilon;
 		int		m_level;
+        OpticalFlowIterationLog m_log;
+        OpticalFlowSolver m_solver;
 };
 
 /**
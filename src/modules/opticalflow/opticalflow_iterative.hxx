@@ -0,0 +1,475 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef GRAIPE_OPTICALFLOW_OPTICALFLOW_ITERATIVE_HXX
+#define GRAIPE_OPTICALFLOW_OPTICALFLOW_ITERATIVE_HXX
+
+//row-parallel execution and cooperative cancellation
+#include "core/parallel.hxx"
+#include "core/cancellation.hxx"
+
+#include <QMutex>
+#include <QString>
+
+#include <vigra/multi_array.hxx>
+#include <vigra/separableconvolution.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_opticalflow
+ * @{
+ *
+ * @file
+ * @brief Header file for the common iteration engine of the global and hybrid Optical Flow algorithms.
+ *
+ * The iterative functors keep the flow as separate u and v planes (instead of an
+ * array of vectors) during the iterations. Each sweep is processed row-parallel on
+ * the shared Scheduler, and the row loops work on contiguous float arrays, which
+ * allows the compiler to vectorise them.
+ */
+
+/**
+ * The solvers for the linear(ised) systems of the variational Optical Flow functors.
+ */
+enum OpticalFlowSolver
+{
+    /** The functor's own fixed point iterations (Jacobi or SOR) **/
+    OpticalFlowFixedPointSolver = 0,
+    /** Multigrid V-cycles, starting with the current flow **/
+    OpticalFlowVCycleSolver = 1,
+    /** Full multigrid (coarse-to-fine) cycle, followed by V-cycles **/
+    OpticalFlowFullMultigridSolver = 2
+};
+
+/**
+ * Returns a human-readable name of a solver.
+ *
+ * \param solver The solver.
+ * \return The name of the solver.
+ */
+inline QString opticalFlowSolverName(OpticalFlowSolver solver)
+{
+    switch(solver)
+    {
+        case OpticalFlowVCycleSolver:
+            return "multigrid V-cycles";
+        case OpticalFlowFullMultigridSolver:
+            return "full multigrid";
+        default:
+            return "fixed point iterations";
+    }
+}
+
+/**
+ * One point of the residual-vs-time curve of a solver.
+ */
+struct OpticalFlowResidual
+{
+    /** The time spent in the solver so far (in ms) **/
+    double time;
+    /** The root mean square residual of the linear(ised) system **/
+    double residual;
+};
+
+/**
+ * The statistics of one run of an iterative Optical Flow functor, which is
+ * equivalent to one level of the pyramid in hierarchical processing.
+ */
+struct OpticalFlowIterationStatistics
+{
+    /** The pyramid level **/
+    int level;
+    /** The number of iterations, which have been run **/
+    int iterations;
+    /** The mean change of the flow during the last iteration **/
+    double mean_change;
+    /** The maximal change of the flow during the last iteration **/
+    double max_change;
+    /** True, if the iterations stopped, because the flow converged **/
+    bool converged;
+    /** The solver, which has been used **/
+    OpticalFlowSolver solver;
+    /** The residual-vs-time curve (empty, if the functor has no linear system) **/
+    std::vector<OpticalFlowResidual> residuals;
+};
+
+/**
+ * The log of all runs of an iterative Optical Flow functor. Since the functors
+ * are passed by value through the hierarchical framework, all copies of a log
+ * share the same statistics. Adding to the log is thread-safe, since copies may
+ * be used by parallel tiles (see OpticalFlowAlgorithm).
+ */
+class OpticalFlowIterationLog
+{
+    public:
+        /**
+         * Creates a new and empty log.
+         */
+        OpticalFlowIterationLog()
+        :   m_statistics(new std::vector<OpticalFlowIterationStatistics>),
+            m_mutex(new QMutex)
+        {
+        }
+    
+        /**
+         * Adds the statistics of one run to the log.
+         *
+         * \param statistics The statistics of the run.
+         */
+        void add(const OpticalFlowIterationStatistics& statistics)
+        {
+            QMutexLocker locker(m_mutex.get());
+            m_statistics->push_back(statistics);
+        }
+    
+        /**
+         * Returns the statistics of all runs in order of their execution.
+         *
+         * \return The statistics of all runs.
+         */
+        const std::vector<OpticalFlowIterationStatistics>& statistics() const
+        {
+            return *m_statistics;
+        }
+    
+        /**
+         * Returns a human-readable summary of the log, e.g. for a Model's description.
+         *
+         * \return The iterations used by each run as a QString.
+         */
+        QString toText() const
+        {
+            QMutexLocker locker(m_mutex.get());
+            
+            QString text("Iterations used per pyramid level:\n");
+            
+            for(const OpticalFlowIterationStatistics& s : *m_statistics)
+            {
+                text += QString("Level %1: %2 iterations (%3), mean change: %4, max. change: %5\n")
+                            .arg(s.level)
+                            .arg(s.iterations)
+                            .arg(s.converged ? "converged" : "max. iterations reached")
+                            .arg(s.mean_change, 0, 'g', 4)
+                            .arg(s.max_change, 0, 'g', 4);
+                
+                if(s.solver != OpticalFlowFixedPointSolver || !s.residuals.empty())
+                {
+                    text += QString("    Solver: %1").arg(opticalFlowSolverName(s.solver));
+                    
+                    if(!s.residuals.empty())
+                    {
+                        text += ", residual (time in ms: residual):";
+                        
+                        for(const OpticalFlowResidual& r : s.residuals)
+                        {
+                            text += QString(" %1: %2").arg(r.time, 0, 'f', 1).arg(r.residual, 0, 'g', 4);
+                        }
+                    }
+                    text += "\n";
+                }
+            }
+            return text;
+        }
+    
+    private:
+        /** The shared statistics **/
+        std::shared_ptr<std::vector<OpticalFlowIterationStatistics> > m_statistics;
+        /** The shared mutex for the statistics **/
+        std::shared_ptr<QMutex> m_mutex;
+};
+
+/**
+ * The change of the flow during one sweep or a part of it.
+ */
+struct OpticalFlowChange
+{
+    /**
+     * Creates an empty change.
+     */
+    OpticalFlowChange()
+    :   sum(0),
+        max(0)
+    {
+    }
+    
+    /**
+     * Merges another (partial) change into this one.
+     *
+     * \param other The other change.
+     */
+    void add(const OpticalFlowChange& other)
+    {
+        sum += other.sum;
+        max = std::max(max, other.max);
+    }
+    
+    /** The sum of all changes **/
+    double sum;
+    /** The maximal change **/
+    double max;
+};
+
+/**
+ * The stopping criterion of the iterative functors: The flow has converged,
+ * if the mean change per pixel is below epsilon and no single vector changed
+ * by more than ten times epsilon.
+ *
+ * \param mean_change The mean change of the last iteration.
+ * \param max_change  The maximal change of the last iteration.
+ * \param epsilon     The threshold. Use 0 to disable the criterion.
+ * \return True, if the iterations may stop.
+ */
+inline bool opticalFlowConverged(double mean_change, double max_change, double epsilon)
+{
+    return epsilon > 0 && mean_change < epsilon && max_change < 10.0*epsilon;
+}
+
+/**
+ * Converts a mask into the weights of the iterative functors.
+ *
+ * \param mask The mask.
+ * \return 1 for all pixels, where the mask is not zero, else 0.
+ */
+template <class T>
+vigra::MultiArray<2,float> maskWeight(const vigra::MultiArrayView<2,T> & mask)
+{
+    vigra::MultiArray<2,float> weight(mask.shape());
+    
+    for(int j=0; j<mask.height(); ++j)
+    {
+        for(int i=0; i<mask.width(); ++i)
+        {
+            weight(i,j) = (mask(i,j) != 0);
+        }
+    }
+    return weight;
+}
+
+/**
+ * Runs a row kernel for all rows in [begin, end) in parallel. The rows are
+ * grouped into blocks, which are the tasks of the Scheduler. Each call of the
+ * kernel returns the change of the flow in its row.
+ *
+ * \param begin  The first row.
+ * \param end    The row after the last row.
+ * \param kernel The kernel, called as kernel(row), returning an OpticalFlowChange.
+ * \return The accumulated change of all rows.
+ */
+template <class RowKernel>
+OpticalFlowChange parallelRows(int begin, int end, const RowKernel & kernel)
+{
+    const int block_rows = 32;
+    
+    OpticalFlowChange change;
+    
+    if(end <= begin)
+    {
+        return change;
+    }
+    
+    const unsigned int blocks = (end - begin + block_rows - 1)/block_rows;
+    std::vector<OpticalFlowChange> block_changes(blocks);
+    
+    parallelFor(blocks,
+                [&](unsigned int b)
+                {
+                    const int row_end = std::min(end, begin + int(b+1)*block_rows);
+                    
+                    for(int j = begin + int(b)*block_rows; j < row_end; ++j)
+                    {
+                        block_changes[b].add(kernel(j));
+                    }
+                });
+    
+    for(const OpticalFlowChange& block_change : block_changes)
+    {
+        change.add(block_change);
+    }
+    return change;
+}
+
+/**
+ * Weighted (normalized) separable Gaussian smoothing of single flow planes. This
+ * is the counterpart of gaussianSmoothingWithMask() for the iterative functors:
+ * The kernel and the normalization are computed only once, and each smoothing
+ * consists of a row-parallel horizontal pass and a vertical pass, which is
+ * evaluated row by row and may thus be fused with the update step.
+ *
+ * Pixels outside the image or with zero weight are ignored, which is equivalent
+ * to vigra::BORDER_TREATMENT_CLIP.
+ */
+class OpticalFlowSmoother
+{
+    public:
+        /**
+         * Creates a new smoother.
+         *
+         * \param weight The weight of each pixel, e.g. 0 or 1 for masking.
+         * \param sigma  The standard deviation of the Gaussian. Use 0 for no smoothing.
+         */
+        OpticalFlowSmoother(const vigra::MultiArrayView<2,float> & weight, double sigma)
+        :   m_weight(weight),
+            m_norm(weight.shape()),
+            m_temp(weight.shape()),
+            m_radius(0)
+        {
+            if(sigma > 0)
+            {
+                vigra::Kernel1D<double> kernel;
+                kernel.initGaussian(sigma);
+                
+                m_radius = kernel.right();
+                
+                for(int t=-m_radius; t<=m_radius; ++t)
+                {
+                    m_kernel.push_back(kernel[t]);
+                }
+            }
+            else
+            {
+                m_kernel.push_back(1.0f);
+            }
+            
+            //The normalization is the smoothed weight itself
+            vigra::MultiArray<2,float> ones(weight.shape(), 1.0f);
+            horizontalPass(ones, m_temp);
+            
+            parallelRows(0, m_norm.height(),
+                         [&](int j)
+                         {
+                             verticalRow(m_temp, j, &m_norm(0,j));
+                             return OpticalFlowChange();
+                         });
+        }
+    
+        /**
+         * Returns the normalization of each pixel, i.e. the sum of all kernel
+         * weights, which were taken into account.
+         *
+         * \return The normalization.
+         */
+        const vigra::MultiArray<2,float>& normalization() const
+        {
+            return m_norm;
+        }
+    
+        /**
+         * The horizontal pass of the smoothing. Processes all rows in parallel.
+         *
+         * \param[in]  src  The plane to be smoothed.
+         * \param[out] dest The weighted and horizontally smoothed plane.
+         */
+        void horizontalPass(const vigra::MultiArray<2,float> & src, vigra::MultiArray<2,float> & dest) const
+        {
+            const int w = src.width();
+            
+            parallelRows(0, src.height(),
+                         [&](int j)
+                         {
+                             const float* s  = &src(0,j);
+                             const float* wt = &m_weight(0,j);
+                             float* d = &dest(0,j);
+                             
+                             std::fill(d, d+w, 0.0f);
+                             
+                             for(int t=-m_radius; t<=m_radius; ++t)
+                             {
+                                 const float k = m_kernel[t+m_radius];
+                                 const int x_begin = std::max(0, -t),
+                                           x_end   = std::min(w, w-t);
+                                 
+                                 for(int x=x_begin; x<x_end; ++x)
+                                 {
+                                     d[x] += k*wt[x+t]*s[x+t];
+                                 }
+                             }
+                             return OpticalFlowChange();
+                         });
+        }
+    
+        /**
+         * The vertical pass of the smoothing for one row. The result is not normalized.
+         *
+         * \param[in]  src The result of the horizontal pass.
+         * \param[in]  j   The row.
+         * \param[out] out The smoothed row (of the plane's width).
+         */
+        void verticalRow(const vigra::MultiArray<2,float> & src, int j, float* out) const
+        {
+            const int w = src.width(), h = src.height();
+            
+            std::fill(out, out+w, 0.0f);
+            
+            for(int t=-m_radius; t<=m_radius; ++t)
+            {
+                if(j+t < 0 || j+t >= h)
+                    continue;
+                
+                const float k = m_kernel[t+m_radius];
+                const float* s = &src(0,j+t);
+                
+                for(int x=0; x<w; ++x)
+                {
+                    out[x] += k*s[x];
+                }
+            }
+        }
+    
+    private:
+        /** The weight of each pixel **/
+        vigra::MultiArray<2,float> m_weight;
+        /** The normalization of each pixel **/
+        vigra::MultiArray<2,float> m_norm;
+        /** Temporary plane **/
+        vigra::MultiArray<2,float> m_temp;
+        /** The kernel **/
+        std::vector<float> m_kernel;
+        /** The radius of the kernel **/
+        int m_radius;
+};
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_OPTICALFLOW_OPTICALFLOW_ITERATIVE_HXX
@@ -39,12 +39,20 @@
 //debug output
 #include <QtDebug>
 
+//cooperative cancellation
+#include "core/cancellation.hxx"
+
 //OFCE Spatiotemporal Gradients
 #include "opticalflowgradients.hxx"
 
 //Image interpolation using splines
 #include <vigra/splineimageview.hxx>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 
 namespace graipe {
 
@@ -75,9 +83,96 @@ namespace graipe {
  *    an iterative scheme.
  */
 
+/**
+ * Computes the sum of all values inside the (2*radius+1)x(2*radius+1) box around
+ * each pixel by means of separable running sums. Independent of the box size, this
+ * needs only four additions per pixel. The vertical pass runs over complete rows
+ * at once, which allows the compiler to vectorise it.
+ *
+ * Only the inner part of the result (radius pixels away from the border) is
+ * computed, the border is set to zero.
+ *
+ * \param[in]  src    The values to be summed.
+ * \param[out] dest   The box sums, same shape as src.
+ * \param[in]  radius The radius of the box.
+ */
+template <class T>
+void boxSum(const vigra::MultiArrayView<2,T> & src,
+            vigra::MultiArrayView<2,T> dest,
+            unsigned int radius)
+{
+    vigra_precondition(src.shape() == dest.shape(), "boxSum: array sizes differ!");
+    
+    const int w = src.width(), h = src.height(),
+              r = radius, size = 2*radius+1;
+    
+    dest.init(0);
+    
+    if(w < size || h < size)
+    {
+        return;
+    }
+    
+    //Horizontal pass: running sums along each row
+    vigra::MultiArray<2,double> rows(src.shape());
+    
+    for(int y=0; y<h; ++y)
+    {
+        double sum = 0;
+        
+        for(int x=0; x<size; ++x)
+        {
+            sum += src(x,y);
+        }
+        rows(r,y) = sum;
+        
+        for(int x=r+1; x<w-r; ++x)
+        {
+            sum += src(x+r,y) - src(x-r-1,y);
+            rows(x,y) = sum;
+        }
+    }
+    
+    //Vertical pass: running sums of complete rows
+    std::vector<double> acc(w, 0.0);
+    
+    for(int y=0; y<size; ++y)
+    {
+        const double* row = &rows(0,y);
+        
+        for(int x=r; x<w-r; ++x)
+        {
+            acc[x] += row[x];
+        }
+    }
+    
+    for(int x=r; x<w-r; ++x)
+    {
+        dest(x,r) = acc[x];
+    }
+    
+    for(int y=r+1; y<h-r; ++y)
+    {
+        const double* add = &rows(0,y+r);
+        const double* sub = &rows(0,y-r-1);
+        
+        for(int x=r; x<w-r; ++x)
+        {
+            acc[x] += add[x] - sub[x];
+            dest(x,y) = acc[x];
+        }
+    }
+}
+
 /**
  * The classical (unweighted) Lucas & Kanade algorithm as described by them in 1982,
  * pimped by better gradient computations using vigra's gaussian convolution kernels
+ *
+ * Instead of summing up the whole neighborhood for each pixel, the terms of the
+ * structure tensor (Ix^2, IxIy, Iy^2, IxIt, IyIt) are computed once per iteration
+ * for the whole image (with the second image warped by the current flow) and
+ * summed up by means of separable box sums. The resulting 2x2 systems are solved
+ * in closed form. This makes the runtime independent of the mask size.
  */
 class OpticalFlowLKFunctor
 {
@@ -116,6 +211,19 @@ class OpticalFlowLKFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the Gaussian gradients and the window sums of the warped
+         * gradients, which grow by half of the mask size with each iteration. Used to
+         * derive the halo of tiles for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return gaussianKernelRadius(m_sigma, 1) + m_iterations*(m_mask_size/2 + 1);
+        }
  
         /**
          * Returns the full name of the functor.
@@ -166,82 +274,9 @@ class OpticalFlowLKFunctor
 			vigra::gaussianSmoothing(src1, gradT1, m_sigma);
 			vigra::gaussianSmoothing(src2, gradT2, m_sigma);
 			
-			vigra::SplineImageView<1,ValueType> gradX2_s(gradX2), gradY2_s(gradY2), gradT2_s(gradT2);
-			
-			//Matrix A, vecor b and eigenvectors resp. eigenvalues
-			vigra::Matrix<double> A(2,2), b(2,1), res(2,1), ev(2,2), ew(2,1);
-			double last_u, last_v, gx, gy, gt, sum_w;
-			
-			for(unsigned int it=1; it<=m_iterations; ++it)
-			{
-				for(unsigned int j=m_mask_size/2; j<src1.height()-m_mask_size/2; ++j)
-				{
-					for(unsigned int i=m_mask_size/2; i<src1.width()-m_mask_size/2; ++i)
-					{
-						last_u = flow(i,j)[0];
-						last_v = flow(i,j)[1];
-						
-						if(		i+last_u+m_mask_size/2 >= src1.width()
-						   ||	i+last_u-m_mask_size/2 < 0
-						   ||	j+last_v+m_mask_size/2 >= src1.height()
-						   ||	j+last_v-m_mask_size/2 < 0 ) 
-							continue;
-						
-						//reset Matrix and result vector 	
-						A(0,0)=0; A(0,1) = 0;
-						A(1,0)=0; A(1,1) = 0;
-						
-						b(0,0) = 0; 
-						b(1,0) = 0;
-						
-						/** Create Sums of gradients to calculate optical flow:
-						 *
-						 *  SUM [ nabla(I_x)^2           nabla(I_x)*nabla(I_y)  ] * [ u ]   = SUM [nabla(I_x)] * nabla(I_t)
-						 *      [ nabla(I_x)*nabla(I_y)  nabla(I_y)^2           ]   [ v ]         [nabla(I_y)] 
-						 */
-						for(unsigned int mj = j-m_mask_size/2; mj<j+m_mask_size/2;	++mj)
-						{
-							for(unsigned int mi = i-m_mask_size/2; mi<i+m_mask_size/2;	++mi)
-							{
-								gx = (gradX1(mi,mj) + gradX2_s(mi+last_u,mj+last_v))/2.0;
-								gy = (gradY1(mi,mj) + gradY2_s(mi+last_u,mj+last_v))/2.0;
-								gt = (gradT2_s(mi+last_u,mj+last_v)-gradT1(mi,mj));
-								
-								A(0,0) += gx*gx; // (nabla I_x)^2
-								A(0,1) += gx*gy; // (nabla I_x)*(nabla I_y)
-								A(1,1) += gy*gy;  // (nabla I_y)^2
-								
-								b(0,0) += gx*gt;
-								b(1,0) += gy*gt;
-							}
-						}
-						
-						sum_w = (m_mask_size*m_mask_size);
-						
-						//Normalize acc. t sum_w
-						A(0,0)/= sum_w;		A(0,1)/= sum_w;
-						A(0,1)/= sum_w;		A(1,1)/= sum_w;
-						b(0,0)/= sum_w;
-						b(1,0)/= sum_w;
-						
-						A(1,0) = A(0,1);
-						b	   = -b;
-						
-						//solve the linear system of equations
-						if(vigra::linearSolve( 	A, b, res))
-						{
-							//threshold vectors using the smallest of both eigenvalue scaled to one pixel 
-							vigra::symmetricEigensystem(A,ew,ev);
-							if(ew(1,0)>= m_threshold)
-							{
-								flow(i,j)[0] = last_u+res(0,0);
-								flow(i,j)[1] = last_v+res(1,0);
-								flow(i,j)[2] = ew(1,0);
-							}
-						}
-					}
-				}
-			}
+            vigra::MultiArray<2, unsigned char> mask(src1.shape(), 1);
+            
+            iterate(gradX1, gradY1, gradT1, gradX2, gradY2, gradT2, vigra::MultiArrayView<2, unsigned char>(mask), flow);
 		}
 				        
         /**
@@ -275,88 +310,126 @@ class OpticalFlowLKFunctor
 			gaussianSmoothingWithMask(src1, mask, gradT1, m_sigma);
 			gaussianSmoothingWithMask(src2, mask, gradT2, m_sigma);
 			
+            iterate(gradX1, gradY1, gradT1, gradX2, gradY2, gradT2, mask, flow);
+		}
+	
+	private:
+        /**
+         * The iterative Lucas & Kanade scheme on precomputed gradients. In each iteration,
+         * the gradients of the second image are warped by the current flow, the terms
+         * of the structure tensor are summed up over the neighborhood using box sums,
+         * and the 2x2 system of each (masked) pixel is solved in closed form.
+         *
+         * \param[in] gradX1 The x-gradient of the first image.
+         * \param[in] gradY1 The y-gradient of the first image.
+         * \param[in] gradT1 The smoothed first image.
+         * \param[in] gradX2 The x-gradient of the second image.
+         * \param[in] gradY2 The y-gradient of the second image.
+         * \param[in] gradT2 The smoothed second image.
+         * \param[in] mask The flow is only computed, where the mask is not zero.
+         * \param[in,out] flow The Optical Flow field.
+         */
+        template <class T>
+        void iterate(const vigra::MultiArrayView<2, ValueType> & gradX1,
+                     const vigra::MultiArrayView<2, ValueType> & gradY1,
+                     const vigra::MultiArrayView<2, ValueType> & gradT1,
+                     const vigra::MultiArrayView<2, ValueType> & gradX2,
+                     const vigra::MultiArrayView<2, ValueType> & gradY2,
+                     const vigra::MultiArrayView<2, ValueType> & gradT2,
+                     const vigra::MultiArrayView<2, T> & mask,
+                     vigra::MultiArrayView<2, FlowValueType> flow)
+        {
+            const int w = gradX1.width(), h = gradX1.height(),
+                      r = m_mask_size/2;
+            
+            //Normalization of the sums
+            const double sum_w = (2*r+1)*(2*r+1);
+            
 			vigra::SplineImageView<1,ValueType> gradX2_s(gradX2), gradY2_s(gradY2), gradT2_s(gradT2);
-			
-			//Matrix A, vecor b and eigenvectors resp. eigenvalues
-			vigra::Matrix<double> A(2,2), b(2,1), res(2,1), ev(2,2), ew(2,1);
-			double last_u, last_v, gx, gy, gt, sum_we;
-			
+            
+            //The (pointwise) terms of the structure tensor and their box sums
+            vigra::MultiArray<2, ValueType> xx(gradX1.shape()), xy(gradX1.shape()), yy(gradX1.shape()),
+                                            xt(gradX1.shape()), yt(gradX1.shape()),
+                                            sum_xx(gradX1.shape()), sum_xy(gradX1.shape()), sum_yy(gradX1.shape()),
+                                            sum_xt(gradX1.shape()), sum_yt(gradX1.shape());
+            
 			for(unsigned int it=1; it<=m_iterations; ++it)
 			{
-				for(unsigned int j=m_mask_size/2; j<src1.height()-m_mask_size/2; ++j)
+				CancellationToken::checkCurrent();
+                
+                //Warp the second image's gradients by the current flow
+                for(int j=0; j<h; ++j)
+                {
+                    for(int i=0; i<w; ++i)
+                    {
+                        double x = std::min(std::max(i + flow(i,j)[0], 0.0f), float(w-1)),
+                               y = std::min(std::max(j + flow(i,j)[1], 0.0f), float(h-1));
+                        
+                        double gx = (gradX1(i,j) + gradX2_s(x,y))/2.0,
+                               gy = (gradY1(i,j) + gradY2_s(x,y))/2.0,
+                               gt = (gradT2_s(x,y) - gradT1(i,j));
+                        
+                        xx(i,j) = gx*gx; // (nabla I_x)^2
+                        xy(i,j) = gx*gy; // (nabla I_x)*(nabla I_y)
+                        yy(i,j) = gy*gy; // (nabla I_y)^2
+                        xt(i,j) = gx*gt;
+                        yt(i,j) = gy*gt;
+                    }
+                }
+                
+                /** Create Sums of gradients to calculate optical flow:
+                 *
+                 *  SUM [ nabla(I_x)^2           nabla(I_x)*nabla(I_y)  ] * [ u ]   = SUM [nabla(I_x)] * nabla(I_t)
+                 *      [ nabla(I_x)*nabla(I_y)  nabla(I_y)^2           ]   [ v ]         [nabla(I_y)] 
+                 */
+                boxSum(xx, sum_xx, r);
+                boxSum(xy, sum_xy, r);
+                boxSum(yy, sum_yy, r);
+                boxSum(xt, sum_xt, r);
+                boxSum(yt, sum_yt, r);
+                
+                //Solve the 2x2 systems in closed form
+				for(int j=r; j<h-r; ++j)
 				{
-					for(unsigned int i=m_mask_size/2; i<src1.width()-m_mask_size/2; ++i)
+					for(int i=r; i<w-r; ++i)
 					{
-						if(mask(i,j) != 0)
+						if(mask(i,j) == 0)
+                            continue;
+                        
+						double last_u = flow(i,j)[0],
+                               last_v = flow(i,j)[1];
+						
+						if(		i+last_u+r >= w
+						   ||	i+last_u-r < 0
+						   ||	j+last_v+r >= h
+						   ||	j+last_v-r < 0 ) 
+							continue;
+						
+                        double a  = sum_xx(i,j)/sum_w,
+                               b  = sum_xy(i,j)/sum_w,
+                               c  = sum_yy(i,j)/sum_w,
+                               bx = -sum_xt(i,j)/sum_w,
+                               by = -sum_yt(i,j)/sum_w;
+                        
+                        double det = a*c - b*b;
+                        
+                        if(det <= std::numeric_limits<double>::epsilon()*(a*c+b*b))
+                            continue;
+                        
+                        //threshold vectors using the smallest of both eigenvalue scaled to one pixel 
+                        double ew_min = (a+c)/2.0 - std::sqrt((a-c)*(a-c)/4.0 + b*b);
+                        
+                        if(ew_min >= m_threshold)
                         {
-                            last_u = flow(i,j)[0];
-                            last_v = flow(i,j)[1];
-                            
-                            if(		i+last_u+m_mask_size/2 >= src1.width()
-                               ||	i+last_u-m_mask_size/2 < 0
-                               ||	j+last_v+m_mask_size/2 >= src1.height()
-                               ||	j+last_v-m_mask_size/2 < 0 ) 
-                                continue;
-                            
-                            //reset Matrix and result vector 	
-                            A(0,0)=0; A(0,1) = 0;
-                            A(1,0)=0; A(1,1) = 0;
-                            
-                            b(0,0) = 0; 
-                            b(1,0) = 0;
-                            
-                            /** Create Sums of gradients to calculate optical flow:
-                             *
-                             *  SUM [ nabla(I_x)^2           nabla(I_x)*nabla(I_y)  ] * [ u ]   = SUM [nabla(I_x)] * nabla(I_t)
-                             *      [ nabla(I_x)*nabla(I_y)  nabla(I_y)^2           ]   [ v ]         [nabla(I_y)] 
-                             */
-                            for(unsigned int mj = j-m_mask_size/2; mj<j+m_mask_size/2;	++mj)
-                            {
-                                for(unsigned int mi = i-m_mask_size/2; mi<i+m_mask_size/2;	++mi)
-                                {
-                                    gx = (gradX1(mi,mj) + gradX2_s(mi+last_u,mj+last_v))/2.0;
-                                    gy = (gradY1(mi,mj) + gradY2_s(mi+last_u,mj+last_v))/2.0;
-                                    gt = (gradT2_s(mi+last_u,mj+last_v)-gradT1(mi,mj));
-                                    
-                                    A(0,0) += gx*gx; // (nabla I_x)^2
-                                    A(0,1) += gx*gy; // (nabla I_x)*(nabla I_y)
-                                    A(1,1) += gy*gy;  // (nabla I_y)^2
-                                    
-                                    b(0,0) += gx*gt;
-                                    b(1,0) += gy*gt;
-                                }
-                            }
-                            
-                            sum_we = (m_mask_size*m_mask_size);
-                            
-                            //Normalize acc. t sum_w
-                            A(0,0)/= sum_we;		A(0,1)/= sum_we;
-                            A(0,1)/= sum_we;		A(1,1)/= sum_we;
-                            b(0,0)/= sum_we;
-                            b(1,0)/= sum_we;
-                            
-                            A(1,0) = A(0,1);
-                            b	   = -b;
-                            
-                            //solve the linear system of equations
-                            if(vigra::linearSolve( 	A, b, res))
-                            {
-                                //threshold vectors using the smallest of both eigenvalue scaled to one pixel 
-                                vigra::symmetricEigensystem(A,ew,ev);
-                                if(ew(1,0)>= m_threshold)
-                                {
-                                    flow(i,j)[0] = last_u+res(0,0);
-                                    flow(i,j)[1] = last_v+res(1,0);
-                                    flow(i,j)[2] = ew(1,0);
-                                }
-                            }
+                            flow(i,j)[0] = last_u + (c*bx - b*by)/det;
+                            flow(i,j)[1] = last_v + (a*by - b*bx)/det;
+                            flow(i,j)[2] = ew_min;
                         }
-                    }
+					}
 				}
 			}
-		}
-	
-	private:
+        }
+    
 		double			m_sigma;
 		unsigned int	m_mask_size;
 		double			m_threshold;
@@ -411,6 +484,19 @@ class OpticalFlowSTFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the Gaussian gradients and the mask around each pixel. The
+         * iterations only depend on the pixel's own flow. Used to derive the halo of tiles
+         * for the tiled processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return gaussianKernelRadius(m_sigma, 1) + m_mask_size/2 + 1;
+        }
  
         /**
          * Returns the full name of the functor.
@@ -469,6 +555,7 @@ class OpticalFlowSTFunctor
 			
 			for(unsigned int it=1; it<=m_iterations; ++it)
 			{
+				CancellationToken::checkCurrent();
 				
 				for(unsigned int j=m_mask_size/2; j<src1.height()-m_mask_size/2; ++j)
 				{
@@ -583,6 +670,7 @@ class OpticalFlowSTFunctor
 			
 			for(unsigned int it=1; it<=m_iterations; ++it)
 			{
+				CancellationToken::checkCurrent();
 				
 				for(unsigned int j=m_mask_size/2; j<src1.height()-m_mask_size/2; ++j)
 				{
@@ -713,6 +801,19 @@ class OpticalFlowCCFunctor
 			m_level=level;
 			//we assume the same m_sigma for all levels, thus nothing is done here!
 		}
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the Gaussian derivatives up to second order. The iterations only
+         * depend on the pixel's own flow. Used to derive the halo of tiles for the tiled
+         * processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return gaussianKernelRadius(m_sigma, 2) + 1;
+        }
  
         /**
          * Returns the full name of the functor.
@@ -777,6 +878,8 @@ class OpticalFlowCCFunctor
 			
 			for(unsigned int it=1; it<=m_iterations; ++it)
 			{
+				CancellationToken::checkCurrent();
+
 				for(unsigned int j=0;j<src1.height(); ++j)
 				{
 					for(unsigned int i=0;i<src1.width(); ++i)
@@ -858,6 +961,8 @@ class OpticalFlowCCFunctor
 			
 			for(unsigned int it=1; it<=m_iterations; ++it)
 			{
+				CancellationToken::checkCurrent();
+
 				for(unsigned int j=0;j<src1.height(); ++j)
 				{
 					for(unsigned int i=0;i<src1.width(); ++i)
@@ -945,6 +1050,19 @@ class OpticalFlowFBFunctor
             m_level=level;
             //we assume the same m_sigma for all levels, thus nothing is done here!
         }
+
+        /**
+         * Returns the radius of the neighbourhood, which influences a flow vector on the
+         * current level: the polynomial expansion and the smoothing of the flow matrix,
+         * which grows with each iteration. Used to derive the halo of tiles for the tiled
+         * processing.
+         *
+         * \return The radius in pixels.
+         */
+        unsigned int halo() const
+        {
+            return m_mask_size/2 + m_iterations*(gaussianKernelRadius(m_sigma) + 1);
+        }
  
         /**
          * Returns the full name of the functor.
@@ -993,6 +1111,8 @@ class OpticalFlowFBFunctor
             
             for(unsigned int i=1; i<=m_iterations; ++i)
             {
+                CancellationToken::checkCurrent();
+
                 //A: Compute the current flow matrix M - according to both poly exps and the current flow
                 for(unsigned int y = 0; y < src1.height(); y++ )
                 {
@@ -1090,6 +1210,8 @@ class OpticalFlowFBFunctor
             
             for(unsigned int i=1; i<=m_iterations; ++i)
             {
+                CancellationToken::checkCurrent();
+
                 //A: Compute the current flow matrix M - according to both poly exps and the current flow
                 for(unsigned int y = 0; y < src1.height(); y++ )
                 {
@@ -0,0 +1,675 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_OPTICALFLOW_OPTICALFLOW_MULTIGRID_HXX
+#define GRAIPE_OPTICALFLOW_OPTICALFLOW_MULTIGRID_HXX
+
+//SoA iteration engine and statistics
+#include "opticalflow_iterative.hxx"
+
+#include <QElapsedTimer>
+
+#include <vigra/multi_array.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_opticalflow
+ * @{
+ *
+ * @file
+ * @brief Header file for the multigrid solvers of the variational Optical Flow algorithms.
+ *
+ * The multigrid schemes follow Bruhn et al.: A coupled (u,v) point Gauss-Seidel
+ * smoother, cell-centred averaging restriction, bilinear prolongation and a
+ * re-discretisation of the system on the coarser grids. Nonlinear models are
+ * solved by lagging the nonlinearity: Their system is re-assembled from the
+ * current flow before each cycle.
+ */
+
+/**
+ * Averages a plane over 2x2 cells. The coarse plane needs to have
+ * the size ((w+1)/2, (h+1)/2).
+ *
+ * \param[in]  fine   The fine plane.
+ * \param[out] coarse The coarse plane.
+ */
+inline void restrictPlane(const vigra::MultiArray<2,float> & fine, vigra::MultiArray<2,float> & coarse)
+{
+    const int w = fine.width(), h = fine.height();
+    
+    for(int J=0; J<coarse.height(); ++J)
+    {
+        for(int I=0; I<coarse.width(); ++I)
+        {
+            float sum = 0;
+            int count = 0;
+            
+            for(int j=2*J; j<std::min(2*J+2, h); ++j)
+            {
+                for(int i=2*I; i<std::min(2*I+2, w); ++i)
+                {
+                    sum += fine(i,j);
+                    ++count;
+                }
+            }
+            coarse(I,J) = sum/count;
+        }
+    }
+}
+
+/**
+ * Bilinear interpolation of a coarse plane at the (cell-centred) positions of the
+ * finer plane's pixels.
+ *
+ * \param[in]  coarse The coarse plane.
+ * \param[out] fine   The fine plane.
+ */
+inline void prolongatePlane(const vigra::MultiArray<2,float> & coarse, vigra::MultiArray<2,float> & fine)
+{
+    const int cw = coarse.width(), ch = coarse.height();
+    
+    for(int j=0; j<fine.height(); ++j)
+    {
+        const float y  = std::min(std::max((j+0.5f)/2.0f - 0.5f, 0.0f), float(ch-1));
+        const int   j0 = int(y), j1 = std::min(j0+1, ch-1);
+        const float fy = y - j0;
+        
+        for(int i=0; i<fine.width(); ++i)
+        {
+            const float x  = std::min(std::max((i+0.5f)/2.0f - 0.5f, 0.0f), float(cw-1));
+            const int   i0 = int(x), i1 = std::min(i0+1, cw-1);
+            const float fx = x - i0;
+            
+            fine(i,j) =   (1-fy)*((1-fx)*coarse(i0,j0) + fx*coarse(i1,j0))
+                        +    fy *((1-fx)*coarse(i0,j1) + fx*coarse(i1,j1));
+        }
+    }
+}
+
+/**
+ * The discretised Euler-Lagrange equations of a linear (or linearised) variational
+ * Optical Flow model on one grid. For each pixel x with neighbours n:
+ *
+ *     alpha * sum_n c_n*(d1(x)+d1(n))/2*(u(x)-u(n)) + a11(x)*u(x) + a12(x)*v(x) = f1(x)
+ *     alpha * sum_n c_n*(d2(x)+d2(n))/2*(v(x)-v(n)) + a21(x)*u(x) + a22(x)*v(x) = f2(x)
+ *
+ * where c_n is "axial" for the four direct and "diagonal" for the four diagonal
+ * neighbours. Neighbours outside the image are ignored (Neumann boundaries) and
+ * pixels with a weight of zero are fixed at their current value.
+ */
+class OpticalFlowLinearSystem
+{
+    public:
+        /**
+         * Creates a new system with zero data term and unit diffusivities.
+         *
+         * \param shape    The size of the grid.
+         * \param alpha    The weight of the smoothness term.
+         * \param axial    The stencil weight of the direct neighbours.
+         * \param diagonal The stencil weight of the diagonal neighbours.
+         */
+        OpticalFlowLinearSystem(const vigra::Shape2 & shape, float alpha, float axial=1.0f, float diagonal=0.0f)
+        :   alpha(alpha),
+            axial(axial),
+            diagonal(diagonal),
+            a11(shape), a12(shape), a21(shape), a22(shape),
+            f1(shape), f2(shape),
+            d1(shape, 1.0f), d2(shape, 1.0f),
+            weight(shape, 1.0f)
+        {
+        }
+    
+        /**
+         * Creates the re-discretised system on the next coarser grid.
+         *
+         * \return The system of half the size.
+         */
+        OpticalFlowLinearSystem coarsen() const
+        {
+            const int w = weight.width(), h = weight.height();
+            
+            //Grid spacing doubles, thus the smoothness term has to be quartered
+            OpticalFlowLinearSystem coarse(vigra::Shape2((w+1)/2, (h+1)/2), alpha/4.0f, axial, diagonal);
+            
+            restrictPlane(a11, coarse.a11);
+            restrictPlane(a12, coarse.a12);
+            restrictPlane(a21, coarse.a21);
+            restrictPlane(a22, coarse.a22);
+            restrictPlane(f1, coarse.f1);
+            restrictPlane(f2, coarse.f2);
+            restrictPlane(d1, coarse.d1);
+            restrictPlane(d2, coarse.d2);
+            
+            //A coarse pixel is free, if any of its fine pixels is free
+            for(int J=0; J<coarse.weight.height(); ++J)
+            {
+                for(int I=0; I<coarse.weight.width(); ++I)
+                {
+                    float active = 0;
+                    
+                    for(int j=2*J; j<std::min(2*J+2, h); ++j)
+                    {
+                        for(int i=2*I; i<std::min(2*I+2, w); ++i)
+                        {
+                            active = std::max(active, float(weight(i,j) != 0));
+                        }
+                    }
+                    coarse.weight(I,J) = active;
+                }
+            }
+            
+            return coarse;
+        }
+    
+        /**
+         * Runs coupled point Gauss-Seidel sweeps on the system with a given right hand
+         * side. The pixels are visited in four colours (by the parities of i and j),
+         * such that all pixels of one colour are independent of each other and each
+         * colour can be processed row-parallel.
+         *
+         * \param[in]     rhs1   The right hand side of the first equation.
+         * \param[in]     rhs2   The right hand side of the second equation.
+         * \param[in,out] u      The first flow component.
+         * \param[in,out] v      The second flow component.
+         * \param[in]     sweeps The number of sweeps.
+         */
+        void smooth(const vigra::MultiArray<2,float> & rhs1, const vigra::MultiArray<2,float> & rhs2,
+                    vigra::MultiArray<2,float> & u, vigra::MultiArray<2,float> & v,
+                    int sweeps) const
+        {
+            const int w = u.width(), h = u.height();
+            
+            for(int sweep=0; sweep<sweeps; ++sweep)
+            {
+                for(int color=0; color!=4; ++color)
+                {
+                    parallelRows(0, h,
+                        [&](int j)
+                        {
+                            if(j%2 == color/2)
+                            {
+                                for(int i=color%2; i<w; i+=2)
+                                {
+                                    if(weight(i,j) == 0)
+                                        continue;
+                                    
+                                    float s1 = 0, n1 = 0, s2 = 0, n2 = 0;
+                                    stencil(d1, u, i, j, s1, n1);
+                                    stencil(d2, v, i, j, s2, n2);
+                                    
+                                    //Solve the 2x2 system of this pixel
+                                    const float m11 = alpha*s1 + a11(i,j), m12 = a12(i,j),
+                                                m21 = a21(i,j),            m22 = alpha*s2 + a22(i,j),
+                                                r1  = rhs1(i,j) + alpha*n1,
+                                                r2  = rhs2(i,j) + alpha*n2,
+                                                det = m11*m22 - m12*m21;
+                                    
+                                    if(det > std::numeric_limits<float>::epsilon())
+                                    {
+                                        u(i,j) = (m22*r1 - m12*r2)/det;
+                                        v(i,j) = (m11*r2 - m21*r1)/det;
+                                    }
+                                }
+                            }
+                            return OpticalFlowChange();
+                        });
+                }
+            }
+        }
+    
+        /**
+         * Computes the residual of the system with a given right hand side.
+         *
+         * \param[in]  rhs1 The right hand side of the first equation.
+         * \param[in]  rhs2 The right hand side of the second equation.
+         * \param[in]  u    The first flow component.
+         * \param[in]  v    The second flow component.
+         * \param[out] res1 The residual of the first equation.
+         * \param[out] res2 The residual of the second equation.
+         * \return The root mean square residual.
+         */
+        double residual(const vigra::MultiArray<2,float> & rhs1, const vigra::MultiArray<2,float> & rhs2,
+                        const vigra::MultiArray<2,float> & u, const vigra::MultiArray<2,float> & v,
+                        vigra::MultiArray<2,float> & res1, vigra::MultiArray<2,float> & res2) const
+        {
+            const int w = u.width(), h = u.height();
+            
+            OpticalFlowChange squares = parallelRows(0, h,
+                [&](int j)
+                {
+                    OpticalFlowChange row_squares;
+                    
+                    for(int i=0; i<w; ++i)
+                    {
+                        float s1 = 0, n1 = 0, s2 = 0, n2 = 0;
+                        stencil(d1, u, i, j, s1, n1);
+                        stencil(d2, v, i, j, s2, n2);
+                        
+                        const float wt = (weight(i,j) != 0),
+                                    r1 = wt*(rhs1(i,j) - alpha*(s1*u(i,j) - n1) - a11(i,j)*u(i,j) - a12(i,j)*v(i,j)),
+                                    r2 = wt*(rhs2(i,j) - alpha*(s2*v(i,j) - n2) - a21(i,j)*u(i,j) - a22(i,j)*v(i,j));
+                        
+                        res1(i,j) = r1;
+                        res2(i,j) = r2;
+                        
+                        row_squares.sum += r1*r1 + r2*r2;
+                    }
+                    return row_squares;
+                });
+            
+            return std::sqrt(squares.sum/(2.0*u.size()));
+        }
+    
+        /**
+         * Computes the root mean square residual of the system for a given flow.
+         *
+         * \param u The first flow component.
+         * \param v The second flow component.
+         * \return The root mean square residual.
+         */
+        double residual(const vigra::MultiArray<2,float> & u, const vigra::MultiArray<2,float> & v) const
+        {
+            vigra::MultiArray<2,float> res1(u.shape()), res2(u.shape());
+            return residual(f1, f2, u, v, res1, res2);
+        }
+    
+        /** The weight of the smoothness term **/
+        float alpha;
+        /** The stencil weights of the direct and diagonal neighbours **/
+        float axial, diagonal;
+        /** The (pixelwise) data term coefficients **/
+        vigra::MultiArray<2,float> a11, a12, a21, a22;
+        /** The right hand sides **/
+        vigra::MultiArray<2,float> f1, f2;
+        /** The (pixelwise) diffusivities of both components **/
+        vigra::MultiArray<2,float> d1, d2;
+        /** The free (non-zero) and fixed (zero) pixels **/
+        vigra::MultiArray<2,float> weight;
+    
+    private:
+        /**
+         * Accumulates the smoothness stencil of one pixel and component.
+         *
+         * \param[in]  d     The diffusivity of the component.
+         * \param[in]  x     The component.
+         * \param[in]  i     The x-coordinate of the pixel.
+         * \param[in]  j     The y-coordinate of the pixel.
+         * \param[out] sum   The sum of the stencil weights (added).
+         * \param[out] neigh The weighted sum of the neighbours (added).
+         */
+        void stencil(const vigra::MultiArray<2,float> & d, const vigra::MultiArray<2,float> & x,
+                     int i, int j, float & sum, float & neigh) const
+        {
+            const int w = x.width(), h = x.height();
+            const float d_c = d(i,j);
+            
+            for(int dj=-1; dj<=1; ++dj)
+            {
+                for(int di=-1; di<=1; ++di)
+                {
+                    const float c = (di == 0 || dj == 0) ? axial : diagonal;
+                    const int n_i = i+di, n_j = j+dj;
+                    
+                    if(    (di == 0 && dj == 0) || c == 0
+                        || n_i < 0 || n_j < 0 || n_i >= w || n_j >= h)
+                        continue;
+                    
+                    const float e = c*(d_c + d(n_i,n_j))/2.0f;
+                    
+                    sum   += e;
+                    neigh += e*x(n_i,n_j);
+                }
+            }
+        }
+};
+
+/**
+ * The multigrid hierarchy of an OpticalFlowLinearSystem and the V-cycle and
+ * full multigrid schemes on it.
+ */
+class OpticalFlowMultigrid
+{
+    public:
+        /**
+         * Builds the grid hierarchy of a system.
+         *
+         * \param system          The system on the finest grid.
+         * \param pre_sweeps      The smoothing sweeps before each coarse grid correction.
+         * \param post_sweeps     The smoothing sweeps after each coarse grid correction.
+         * \param coarsest_sweeps The smoothing sweeps, which solve the coarsest grid.
+         */
+        OpticalFlowMultigrid(const OpticalFlowLinearSystem & system, int pre_sweeps=2, int post_sweeps=2, int coarsest_sweeps=20)
+        :   m_pre_sweeps(pre_sweeps),
+            m_post_sweeps(post_sweeps),
+            m_coarsest_sweeps(coarsest_sweeps)
+        {
+            m_levels.push_back(system);
+            
+            while(    std::min(m_levels.back().weight.width(), m_levels.back().weight.height()) > 8
+                   && m_levels.size() < 16)
+            {
+                m_levels.push_back(m_levels.back().coarsen());
+            }
+        }
+    
+        /**
+         * Computes the root mean square residual on the finest grid.
+         *
+         * \param u The first flow component.
+         * \param v The second flow component.
+         * \return The root mean square residual.
+         */
+        double residual(const vigra::MultiArray<2,float> & u, const vigra::MultiArray<2,float> & v) const
+        {
+            return m_levels.front().residual(u, v);
+        }
+    
+        /**
+         * Runs one V-cycle, starting with the given flow.
+         *
+         * \param[in,out] u The first flow component.
+         * \param[in,out] v The second flow component.
+         */
+        void vCycle(vigra::MultiArray<2,float> & u, vigra::MultiArray<2,float> & v) const
+        {
+            vCycle(0, m_levels.front().f1, m_levels.front().f2, u, v);
+        }
+    
+        /**
+         * Runs one full multigrid cycle: The correction of the given flow is solved
+         * on the coarsest grid first and then refined by one V-cycle on each finer grid.
+         *
+         * \param[in,out] u The first flow component.
+         * \param[in,out] v The second flow component.
+         */
+        void fullMultigrid(vigra::MultiArray<2,float> & u, vigra::MultiArray<2,float> & v) const
+        {
+            const int levels = m_levels.size();
+            
+            std::vector<vigra::MultiArray<2,float> > rhs1(levels), rhs2(levels);
+            rhs1[0].reshape(u.shape());
+            rhs2[0].reshape(u.shape());
+            m_levels[0].residual(m_levels[0].f1, m_levels[0].f2, u, v, rhs1[0], rhs2[0]);
+            
+            for(int l=1; l<levels; ++l)
+            {
+                rhs1[l].reshape(m_levels[l].weight.shape());
+                rhs2[l].reshape(m_levels[l].weight.shape());
+                restrictPlane(rhs1[l-1], rhs1[l]);
+                restrictPlane(rhs2[l-1], rhs2[l]);
+            }
+            
+            vigra::MultiArray<2,float> e1(m_levels.back().weight.shape()), e2(m_levels.back().weight.shape());
+            m_levels.back().smooth(rhs1.back(), rhs2.back(), e1, e2, m_coarsest_sweeps);
+            
+            for(int l=levels-2; l>=0; --l)
+            {
+                vigra::MultiArray<2,float> p1(m_levels[l].weight.shape()), p2(m_levels[l].weight.shape());
+                prolongatePlane(e1, p1);
+                prolongatePlane(e2, p2);
+                p1 *= m_levels[l].weight;
+                p2 *= m_levels[l].weight;
+                e1.swap(p1);
+                e2.swap(p2);
+                
+                vCycle(l, rhs1[l], rhs2[l], e1, e2);
+            }
+            
+            u += e1;
+            v += e2;
+        }
+    
+    private:
+        /**
+         * Runs one V-cycle on a level of the hierarchy.
+         *
+         * \param[in]     l    The level.
+         * \param[in]     rhs1 The right hand side of the first equation.
+         * \param[in]     rhs2 The right hand side of the second equation.
+         * \param[in,out] u    The first flow component (or its correction).
+         * \param[in,out] v    The second flow component (or its correction).
+         */
+        void vCycle(int l,
+                    const vigra::MultiArray<2,float> & rhs1, const vigra::MultiArray<2,float> & rhs2,
+                    vigra::MultiArray<2,float> & u, vigra::MultiArray<2,float> & v) const
+        {
+            const OpticalFlowLinearSystem & system = m_levels[l];
+            
+            if(l+1 == (int)m_levels.size())
+            {
+                system.smooth(rhs1, rhs2, u, v, m_coarsest_sweeps);
+                return;
+            }
+            
+            CancellationToken::checkCurrent();
+            
+            system.smooth(rhs1, rhs2, u, v, m_pre_sweeps);
+            
+            //Restrict the residual to the coarser grid
+            vigra::MultiArray<2,float> res1(u.shape()), res2(u.shape());
+            system.residual(rhs1, rhs2, u, v, res1, res2);
+            
+            const vigra::Shape2 coarse_shape = m_levels[l+1].weight.shape();
+            vigra::MultiArray<2,float> c_rhs1(coarse_shape), c_rhs2(coarse_shape),
+                                       e1(coarse_shape), e2(coarse_shape);
+            restrictPlane(res1, c_rhs1);
+            restrictPlane(res2, c_rhs2);
+            
+            //Solve for the correction and add it to the free pixels
+            vCycle(l+1, c_rhs1, c_rhs2, e1, e2);
+            
+            prolongatePlane(e1, res1);
+            prolongatePlane(e2, res2);
+            res1 *= system.weight;
+            res2 *= system.weight;
+            u += res1;
+            v += res2;
+            
+            system.smooth(rhs1, rhs2, u, v, m_post_sweeps);
+        }
+    
+        std::vector<OpticalFlowLinearSystem> m_levels;
+        int m_pre_sweeps;
+        int m_post_sweeps;
+        int m_coarsest_sweeps;
+};
+
+/**
+ * Records the residual-vs-time curve of a solver into its statistics. Only the time
+ * spent between the records is counted, so the computation of the residuals
+ * themselves does not distort the curve.
+ */
+class OpticalFlowResidualCurve
+{
+    public:
+        /**
+         * Creates a new curve.
+         *
+         * \param statistics The statistics, which will hold the curve.
+         * \param stride     Only every stride-th iteration will be recorded.
+         */
+        OpticalFlowResidualCurve(OpticalFlowIterationStatistics & statistics, int stride=1)
+        :   m_statistics(statistics),
+            m_stride(std::max(1, stride)),
+            m_time(0)
+        {
+        }
+    
+        /**
+         * Records the initial residual and starts the clock.
+         *
+         * \param residual The residual before the first iteration.
+         */
+        void start(double residual)
+        {
+            OpticalFlowResidual r = {0.0, residual};
+            m_statistics.residuals.push_back(r);
+            
+            m_timer.start();
+        }
+    
+        /**
+         * Records the residual after an iteration, if it is due.
+         *
+         * \param iteration The iteration.
+         * \param residual  A function returning the current residual.
+         * \param last      If true, the residual is recorded in any case.
+         */
+        void record(int iteration, const std::function<double()> & residual, bool last=false)
+        {
+            m_time += m_timer.nsecsElapsed()/1.0e6;
+            
+            if(iteration % m_stride == 0 || last)
+            {
+                OpticalFlowResidual r = {m_time, residual()};
+                m_statistics.residuals.push_back(r);
+            }
+            
+            m_timer.restart();
+        }
+    
+    private:
+        OpticalFlowIterationStatistics & m_statistics;
+        int m_stride;
+        double m_time;
+        QElapsedTimer m_timer;
+};
+
+/**
+ * Assembles the linear(ised) system of a functor for the current flow.
+ */
+typedef std::function<OpticalFlowLinearSystem(const vigra::MultiArray<2,float> &, const vigra::MultiArray<2,float> &)> OpticalFlowAssembler;
+
+/**
+ * Solves a variational Optical Flow model with one of the multigrid schemes.
+ * The same convergence criterion as for the fixed point iterations is applied
+ * after each cycle.
+ *
+ * \param[in]     solver    The multigrid scheme. The full multigrid cycle is only used
+ *                          as the first cycle and followed by V-cycles.
+ * \param[in]     assemble  Assembles the system for the current flow.
+ * \param[in]     nonlinear If true, the system is re-assembled before each cycle.
+ * \param[in]     cycles    The maximal count of cycles.
+ * \param[in]     epsilon   The convergence threshold, see opticalFlowConverged().
+ * \param[in]     level     The current pyramid level (for the statistics).
+ * \param[in,out] u         The first flow component.
+ * \param[in,out] v         The second flow component.
+ * \return The statistics including the residual-vs-time curve.
+ */
+inline OpticalFlowIterationStatistics solveOpticalFlowMultigrid(OpticalFlowSolver solver,
+                                                                const OpticalFlowAssembler & assemble,
+                                                                bool nonlinear,
+                                                                int cycles,
+                                                                double epsilon,
+                                                                int level,
+                                                                vigra::MultiArray<2,float> & u,
+                                                                vigra::MultiArray<2,float> & v)
+{
+    OpticalFlowIterationStatistics statistics = {level, 0, 0.0, 0.0, false};
+    statistics.solver = solver;
+    
+    OpticalFlowResidualCurve curve(statistics);
+    
+    std::unique_ptr<OpticalFlowMultigrid> multigrid(new OpticalFlowMultigrid(assemble(u, v)));
+    curve.start(multigrid->residual(u, v));
+    
+    for(int cycle=1; cycle<=cycles; ++cycle)
+    {
+        CancellationToken::checkCurrent();
+        
+        if(nonlinear && cycle > 1)
+        {
+            multigrid.reset(new OpticalFlowMultigrid(assemble(u, v)));
+        }
+        
+        vigra::MultiArray<2,float> last_u(u), last_v(v);
+        
+        if(solver == OpticalFlowFullMultigridSolver && cycle == 1)
+        {
+            multigrid->fullMultigrid(u, v);
+        }
+        else
+        {
+            multigrid->vCycle(u, v);
+        }
+        
+        OpticalFlowChange change = parallelRows(0, u.height(),
+            [&](int j)
+            {
+                OpticalFlowChange row_change;
+                
+                for(int i=0; i<u.width(); ++i)
+                {
+                    const float du = u(i,j) - last_u(i,j),
+                                dv = v(i,j) - last_v(i,j),
+                                iter_change = std::sqrt(du*du + dv*dv);
+                    
+                    row_change.sum += iter_change;
+                    row_change.max = std::max(row_change.max, double(iter_change));
+                }
+                return row_change;
+            });
+        
+        statistics.iterations  = cycle;
+        statistics.mean_change = change.sum / u.size();
+        statistics.max_change  = change.max;
+        statistics.converged   = opticalFlowConverged(statistics.mean_change, statistics.max_change, epsilon);
+        
+        curve.record(cycle, [&](){ return multigrid->residual(u, v); });
+        
+        if(statistics.converged)
+        {
+            break;
+        }
+    }
+    
+    return statistics;
+}
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_OPTICALFLOW_OPTICALFLOW_MULTIGRID_HXX
@@ -95,10 +95,28 @@ QStringList propagation_modes()
 	propagation_modes.append("Warp according to previous result using subsampling of 40x40");
     propagation_modes.append("Warp according to previous result using subsampling of 45x45");
     propagation_modes.append("Warp according to previous result using subsampling of 50x50");
+    propagation_modes.append("Warp densely according to previous result (bilinear)");
+    propagation_modes.append("Warp densely according to previous result (bicubic)");
 
 	return propagation_modes;
 }
 
+/**
+ * The solvers for the linear systems of the variational Optical Flow algorithms.
+ * For the multigrid solvers, the number of iterations is the maximal number of cycles.
+ *
+ * \return A QStringList containing the available solvers (see OpticalFlowSolver).
+ */
+QStringList solver_modes()
+{
+	QStringList solver_modes;
+	solver_modes.append("Fixed point iterations (Jacobi/SOR)");
+	solver_modes.append("Multigrid V-cycles");
+	solver_modes.append("Full multigrid");
+
+	return solver_modes;
+}
+
 /**
  * This class defines the most general common part of all Optical Flow estimation 
  * algorithms by means of a specialization of graipe::Algorithm
@@ -126,6 +144,57 @@ class OpticalFlowAlgorithm
         {
             return "OpticalFlowAlgorithm";
         }
+    
+        /**
+         * Checks the validity of the parameters. In contrast to the default implementation,
+         * parameters, which are disabled by their (BoolParameter) parent, are not required
+         * to be valid. Thus, both images are not needed if a sequence is processed and the
+         * mask is not needed if masking is switched off. Tiled processing is rejected for
+         * the thin plate spline propagation strategies.
+         *
+         * 
+eturn True, if all enabled parameters are valid.
+         */
+        bool parametersValid() const
+        {
+            for(auto item : *m_parameters)
+            {
+                Parameter* param = item.second;
+                
+                if (param == NULL)
+                {
+                    return false;
+                }
+                
+                if (param->parent() != NULL && param->parent()->typeName() == "BoolParameter")
+                {
+                    BoolParameter* parent_param = static_cast<BoolParameter*>(param->parent());
+                    
+                    //Disabled by parent: no need to be valid
+                    if (parent_param->value() == param->invertParent())
+                    {
+                        continue;
+                    }
+                }
+                
+                if (!param->isValid())
+                {
+                    qDebug() << "ERR for Alg: parameter " << item.first << " Name: " << param->name() << " is not valid!\n";
+                    return false;
+                }
+            }
+            
+            //The TPS propagation strategies (1-10) warp each level globally, which cannot be
+            //restricted to a tile and its halo.
+            if (    m_param_useTiles->value()
+                &&  m_param_useHierarchy->value()
+                &&  m_param_pmode->value() >= 1 && m_param_pmode->value() <= 10)
+            {
+                qDebug() << "ERR for Alg: Thin plate spline propagation is not available in tiled mode!\n";
+                return false;
+            }
+            return true;
+        }
         
     protected:
         /**
@@ -133,8 +202,10 @@ class OpticalFlowAlgorithm
          */
         virtual void addImageAndMaskParameters()
         {
-            m_param_imageBand1		= new ImageBandParameter<float>("Reference Image", NULL, false, m_workspace);
-            m_param_imageBand2		= new ImageBandParameter<float>("Second Image",	NULL, false, m_workspace);
+            m_param_useSequence     = new BoolParameter("process an image sequence instead of both images");
+            
+            m_param_imageBand1		= new ImageBandParameter<float>("Reference Image", m_param_useSequence, true, m_workspace);
+            m_param_imageBand2		= new ImageBandParameter<float>("Second Image",	m_param_useSequence, true, m_workspace);
             
             m_param_useMask			= new BoolParameter("use image band for masking flow");
             m_param_mask			= new ImageBandParameter<float>("Mask Image", m_param_useMask, false, m_workspace);
@@ -145,6 +216,13 @@ class OpticalFlowAlgorithm
             
             m_parameters->addParameter("use_mask?", m_param_useMask );
             m_parameters->addParameter("mask", m_param_mask );
+            
+            m_param_sequence        = new MultiModelParameter("Image sequence (ordered, or a single multi-band image)", "Image", m_param_useSequence, false, m_workspace);
+            m_param_sequenceBand    = new IntParameter("band of the sequence's images", 0, 200, 0, m_param_useSequence);
+            
+            m_parameters->addParameter("use_sequence?", m_param_useSequence );
+            m_parameters->addParameter("sequence", m_param_sequence );
+            m_parameters->addParameter("sequence_band", m_param_sequenceBand );
         }
         
         /**
@@ -165,6 +243,9 @@ class OpticalFlowAlgorithm
             m_param_saveIntermediateImages	= new BoolParameter("save intermediate (warped) images", false, m_param_useHierarchy);
             m_param_saveIntermediateFlow	= new BoolParameter("save intermediate flow fields", false, m_param_useHierarchy);
             
+            m_param_useTiles    = new BoolParameter("process in tiles (for images larger than memory)");
+            m_param_tileSize    = new IntParameter("tile size (without halo)", 64, 65536, 1024, m_param_useTiles);
+            
             m_parameters->addParameter("use_gme?", m_param_useGME);
             m_parameters->addParameter("use_hierarchy?", m_param_useHierarchy );
             m_parameters->addParameter("lowL", m_param_lowestLevel );
@@ -174,6 +255,8 @@ class OpticalFlowAlgorithm
             m_parameters->addParameter("warp_sigma", m_param_warp_sigma );
             m_parameters->addParameter("save-intermI", m_param_saveIntermediateImages );
             m_parameters->addParameter("save-intermVF", m_param_saveIntermediateFlow );
+            m_parameters->addParameter("use_tiles?", m_param_useTiles );
+            m_parameters->addParameter("tile_size", m_param_tileSize );
         }	
         
         /**
@@ -190,6 +273,11 @@ class OpticalFlowAlgorithm
             
             vigra_assert(FlowValueType().size() > 1, "flow functor needs to return a vectorfield of at least (u,v) components");
             
+            if (m_param_useSequence->value())
+            {
+                computeSequenceFlow(func);
+                return;
+            }
             
             vigra::MultiArrayView<2,float> imageband1 = m_param_imageBand1->value();
             vigra::MultiArrayView<2,float> imageband2 = m_param_imageBand2->value();
@@ -205,6 +293,125 @@ class OpticalFlowAlgorithm
             std::vector<double> rotation_correlation_list;
             std::vector<double> translation_correlation_list;
             
+            if (m_param_useTiles->value())
+            {
+                computeFlowTiled(func, imageband1, imageband2, mask,
+                                 flow_list, mat_list, rotation_correlation_list, translation_correlation_list);
+            }
+            else
+            {
+                //Reuse the cached Gaussian pyramids of the images (and of the mask)
+                std::shared_ptr<const ImagePyramid<float> > pyramid1, pyramid2, mask_pyramid;
+                if (m_param_useHierarchy->value())
+                {
+                    unsigned int levels = m_param_highestLevel->value();
+                
+                    pyramid1 = m_param_imageBand1->image()->pyramid(m_param_imageBand1->bandId(), levels);
+                    pyramid2 = m_param_imageBand2->image()->pyramid(m_param_imageBand2->bandId(), levels);
+                
+                    if (m_param_useMask->value())
+                    {
+                        mask_pyramid = m_param_mask->image()->pyramid(m_param_mask->bandId(), levels);
+                    }
+                }
+                
+                computeFlowOnImages(func, imageband1, imageband2, mask,
+                                    pyramid1.get(), pyramid2.get(), mask_pyramid.get(),
+                                    m_param_useGME->value(),
+                                    img_list, flow_list, mat_list, rotation_correlation_list, translation_correlation_list);
+            }
+            
+            for (unsigned int i=0; i< flow_list.size(); ++i)
+            {
+                //Save pyramid of vectorfields on demand
+                if(i==0 || m_param_saveIntermediateFlow->value())
+                {
+                    DenseVectorfield2D* new_vectorfield = newFlowVectorfield(flow_list[i], mat_list[i]);
+                    
+                    QString functor_name = QString::fromStdString(OpticalFlowFunctor::name());
+                    QString functor_sname = QString::fromStdString(OpticalFlowFunctor::shortName());
+                    
+                    if( i != 0)
+                    {
+                        new_vectorfield->setName(QString("%1 (L%2) of %3 and %4").arg(functor_sname).arg(i).arg(m_param_imageBand1->toString()).arg(m_param_imageBand2->toString()));
+                    }
+                    else
+                    {
+                        new_vectorfield->setName(QString("%1 of %2 and %3").arg(functor_sname).arg(m_param_imageBand1->toString()).arg(m_param_imageBand2->toString()));
+                    }
+                    
+                    //Get time diff
+                    unsigned int seconds = (unsigned int)m_param_imageBand1->image()->timestamp().secsTo(m_param_imageBand2->image()->timestamp());
+                    
+                    if(seconds != 0)
+                    {
+                        new_vectorfield->setScale(m_param_imageBand1->image()->scale()*100.0/seconds * (m_param_imageBand1->image()->width()/flow_list[0].width()));
+                    }
+                    
+                    QString descr = QString("The following parameters were used to calculate the %1\n").arg(functor_name);
+                    
+                    if( i != 0)
+                    {
+                        descr += QString("Level %1 of %2\n").arg(i).arg(flow_list.size());
+                    }
+                    descr += m_parameters->valueText("ImageBandParameter<float>");
+                    new_vectorfield->setDescription(descr);
+                    m_results.push_back(new_vectorfield);
+                }
+                //Also save warped images on demand
+                if(m_param_pmode->value() !=0 && i!=0 && m_param_saveIntermediateImages->value()) 
+                {
+                    Image<float>* new_image = new Image<float>(img_list[i].shape(), 1, m_workspace);
+                    new_image->setBand(0,img_list[i]);
+                    
+                    m_param_imageBand1->image()->copyMetadata(*new_image);
+                    
+                    new_image->setName(QString("Warped Image (L%1) of %2").arg(i).arg(m_param_imageBand1->toString()));
+                    new_image->setDescription(QString("The following parameters were used to calculate the warping:\n")
+                                              + (m_param_pmode->value() > 10
+                                                    ? QString("Dense warping\n%1 interpolation").arg(m_param_pmode->value() == 11 ? "Bilinear" : "Bicubic")
+                                                    : QString("TPS Functor\nSubsampled each %1 pixel").arg(5*m_param_pmode->value())));
+                    m_results.push_back(new_image);
+                }
+            }
+        }
+
+        /**
+         * Computes the flow of two images (or parts of them) according to the chosen
+         * parameters and appends the result of each level to the given lists.
+         *
+         * \param func The Optical Flow Functor, which will carry out each step's 
+         *             flow estimation.
+         * \param imageband1 The first image.
+         * \param imageband2 The second image.
+         * \param mask The mask, only used if the mask parameter is set.
+         * \param pyramid1 The cached pyramid of the first image. May be NULL.
+         * \param pyramid2 The cached pyramid of the second image. May be NULL.
+         * \param mask_pyramid The cached pyramid of the mask. May be NULL.
+         * \param use_gme If true, the global motion estimation will be used.
+         * \param[out] img_list The (warped) images of each level.
+         * \param[out] flow_list The flow fields of each level.
+         * \param[out] mat_list The global motion matrices of each level.
+         * \param[out] rotation_correlation_list The rotation correlations of each level.
+         * \param[out] translation_correlation_list The translation correlations of each level.
+         */
+        template<class OpticalFlowFunctor>
+        void computeFlowOnImages(OpticalFlowFunctor func,
+                                 const vigra::MultiArrayView<2,float> & imageband1,
+                                 const vigra::MultiArrayView<2,float> & imageband2,
+                                 const vigra::MultiArrayView<2,float> & mask,
+                                 const ImagePyramid<float> * pyramid1,
+                                 const ImagePyramid<float> * pyramid2,
+                                 const ImagePyramid<float> * mask_pyramid,
+                                 bool use_gme,
+                                 std::vector<vigra::MultiArray<2,float> > & img_list,
+                                 std::vector<vigra::MultiArray<2,typename OpticalFlowFunctor::FlowValueType> > & flow_list,
+                                 std::vector<vigra::Matrix<double> > & mat_list,
+                                 std::vector<double> & rotation_correlation_list,
+                                 std::vector<double> & translation_correlation_list)
+        {
+            typedef typename OpticalFlowFunctor::FlowValueType FlowValueType;
+            
             flow_list.push_back(vigra::MultiArray<2,FlowValueType>(imageband1.shape()));
             mat_list.push_back(vigra::Matrix<double>(3,3));
             rotation_correlation_list.push_back(0);
@@ -219,7 +426,7 @@ class OpticalFlowAlgorithm
                                   mask,
                                   flow_list[0],
                                   func,
-                                  m_param_useGME->value(),
+                                  use_gme,
                                   mat_list[0],
                                   rotation_correlation_list[0],
                                   translation_correlation_list[0]);
@@ -230,7 +437,7 @@ class OpticalFlowAlgorithm
                                   imageband2,
                                   flow_list[0],
                                   func,
-                                  m_param_useGME->value(),
+                                  use_gme,
                                   mat_list[0],
                                   rotation_correlation_list[0],
                                   translation_correlation_list[0]);
@@ -247,12 +454,13 @@ class OpticalFlowAlgorithm
                                                            mask,
                                                            flow_list,
                                                            func,
-                                                           m_param_useGME->value(),
+                                                           use_gme,
                                                            mat_list,
                                                            rotation_correlation_list,
                                                            translation_correlation_list,
                                                            m_param_highestLevel->value(), m_param_lowestLevel->value(),
-                                                           m_param_hmode->value());
+                                                           m_param_hmode->value(),
+                                                           pyramid1, pyramid2, mask_pyramid);
                 }
                 else
                 {
@@ -260,18 +468,24 @@ class OpticalFlowAlgorithm
                                                            imageband2,
                                                            flow_list,
                                                            func,
-                                                           m_param_useGME->value(),
+                                                           use_gme,
                                                            mat_list,
                                                            rotation_correlation_list,
                                                            translation_correlation_list,
                                                            m_param_highestLevel->value(), m_param_lowestLevel->value(),
-                                                           m_param_hmode->value());
+                                                           m_param_hmode->value(),
+                                                           pyramid1, pyramid2);
                     
                 }
                 
             }
             else
             {
+                //Modes 1-10: TPS warping with subsampled flow, 11/12: dense bilinear/bicubic warping
+                const unsigned int pmode = m_param_pmode->value(),
+                                   dense_warp_order = (pmode > 10) ? ((pmode == 11) ? 1 : 3) : 0,
+                                   warp_subsampling = (pmode > 10) ? 0 : 5*pmode;
+                
                 WarpTPSFunctor warp_func;
                 if (m_param_useMask->value()) 
                 {
@@ -281,12 +495,13 @@ class OpticalFlowAlgorithm
                                                        img_list,
                                                        flow_list,
                                                        func,
-                                                       m_param_useGME->value(),
+                                                       use_gme,
                                                        mat_list,
                                                        rotation_correlation_list,
                                                        translation_correlation_list,
                                                        m_param_highestLevel->value(), m_param_lowestLevel->value(), m_param_hmode->value(),
-                                                       warp_func, 5*m_param_pmode->value(), m_param_warp_sigma->value());
+                                                       warp_func, warp_subsampling, m_param_warp_sigma->value(), dense_warp_order,
+                                                       pyramid1, pyramid2, mask_pyramid);
                 }
                 else 
                 {
@@ -295,84 +510,339 @@ class OpticalFlowAlgorithm
                                                        img_list,
                                                        flow_list,
                                                        func,
-                                                       m_param_useGME->value(),
+                                                       use_gme,
                                                        mat_list,
                                                        rotation_correlation_list,
                                                        translation_correlation_list,
                                                        m_param_highestLevel->value(), m_param_lowestLevel->value(), m_param_hmode->value(),
-                                                       warp_func, 5*m_param_pmode->value(), m_param_warp_sigma->value());
+                                                       warp_func, warp_subsampling, m_param_warp_sigma->value(), dense_warp_order,
+                                                       pyramid1, pyramid2);
                 }
                 
             }	
+        }
+        
+        /**
+         * Computes the flow in overlapping tiles to bound the memory consumption for
+         * large (e.g. mapped) images. Each tile is extended by a halo, which is derived
+         * from the functor, the pyramid depth and the propagation strategy (see
+         * calculateOFCEHalo). Only the inner region of each tile is copied into the
+         * result. Thus, the result matches the untiled computation, as long as the halo
+         * is not limited to the tile size. This happens for global methods like
+         * multigrid solvers or TPS warping, where the results near the tile borders may
+         * differ slightly. The tiles are processed in parallel, but at most one tile per
+         * thread at a time. Global motion estimation and intermediate results are not
+         * available in tiled mode.
+         *
+         * \param func The Optical Flow Functor, which will carry out each step's 
+         *             flow estimation.
+         * \param imageband1 The first image.
+         * \param imageband2 The second image.
+         * \param mask The mask, only used if the mask parameter is set.
+         * \param[out] flow_list Will contain the flow field.
+         * \param[out] mat_list Will contain the identity matrix.
+         * \param[out] rotation_correlation_list Will contain a zero correlation.
+         * \param[out] translation_correlation_list Will contain a zero correlation.
+         */
+        template<class OpticalFlowFunctor>
+        void computeFlowTiled(OpticalFlowFunctor func,
+                              const vigra::MultiArrayView<2,float> & imageband1,
+                              const vigra::MultiArrayView<2,float> & imageband2,
+                              const vigra::MultiArrayView<2,float> & mask,
+                              std::vector<vigra::MultiArray<2,typename OpticalFlowFunctor::FlowValueType> > & flow_list,
+                              std::vector<vigra::Matrix<double> > & mat_list,
+                              std::vector<double> & rotation_correlation_list,
+                              std::vector<double> & translation_correlation_list)
+        {
+            typedef typename OpticalFlowFunctor::FlowValueType FlowValueType;
             
-            for (unsigned int i=0; i< flow_list.size(); ++i)
+            if (m_param_useGME->value())
             {
-                //Save pyramid of vectorfields on demand
-                if(i==0 || m_param_saveIntermediateFlow->value())
+                qWarning() << "OpticalFlowAlgorithm: Global motion estimation is not available in tiled mode and will be ignored.";
+            }
+            if (m_param_useHierarchy->value() && (m_param_saveIntermediateFlow->value() || m_param_saveIntermediateImages->value()))
+            {
+                qWarning() << "OpticalFlowAlgorithm: Intermediate results are not saved in tiled mode.";
+            }
+            
+            //Use the same pyramid depth as for the whole image and align the tiles to its sampling grid
+            unsigned int steps = 0;
+            
+            if (m_param_useHierarchy->value())
+            {
+                steps = (unsigned int)std::max(0.0, std::min((double)m_param_highestLevel->value(),
+                                                             log((double)std::min(imageband1.width(), imageband1.height()))/log(2.0)-3));
+            }
+            
+            const unsigned int alignment = 1 << steps,
+                               min_size  = 8 << steps,
+                               tile_size = std::max((unsigned int)m_param_tileSize->value(), min_size);
+            
+            //Propagation: 0: initialisation, 11/12: dense bilinear/bicubic warping
+            //(TPS warping, 1-10, is global and thus rejected by parametersValid in tiled mode)
+            const unsigned int pmode = m_param_pmode->value();
+            double warp_radius = 1;
+            
+            if (pmode == 12)
+            {
+                warp_radius = 2;
+            }
+            
+            double halo = calculateOFCEHalo(func, m_param_useHierarchy->value(),
+                                            steps, m_param_lowestLevel->value(), m_param_hmode->value(),
+                                            (pmode != 0) ? m_param_warp_sigma->value() : 0.0f, warp_radius);
+            
+            if (halo > tile_size)
+            {
+                qWarning() << "OpticalFlowAlgorithm: The halo of" << halo << "pixels, which is needed for exact tiled results, is limited to"
+                           << tile_size << "pixels. The results near the tile borders may differ from the untiled computation.";
+                halo = tile_size;
+            }
+            
+            const int width = imageband1.width(), height = imageband1.height();
+            
+            std::vector<BandTile> tiles = splitIntoBlocks(width, height, tile_size, (unsigned int)halo, alignment);
+            
+            //Tiles at the right and lower borders need to be large enough for the pyramid
+            for (BandTile& tile : tiles)
+            {
+                if (tile.outer.width() < (int)min_size)
                 {
-                    DenseVectorfield2D* new_vectorfield = NULL;
-                    
-                    if(FlowValueType().size() == 2)
-                    {
-                       new_vectorfield =  new DenseVectorfield2D(flow_list[i].bindElementChannel(0),flow_list[i].bindElementChannel(1), m_workspace);
-                    }
-                    //Has to be larger
-                    else
-                    {
-                        new_vectorfield =  new DenseWeightedVectorfield2D(flow_list[i].bindElementChannel(0),flow_list[i].bindElementChannel(1),flow_list[i].bindElementChannel(2), m_workspace);
-                    }
-                    
-                    QString functor_name = QString::fromStdString(OpticalFlowFunctor::name());
-                    QString functor_sname = QString::fromStdString(OpticalFlowFunctor::shortName());
-                    
-                    if( i != 0)
-                    {
-                        new_vectorfield->setName(QString("%1 (L%2) of %3 and %4").arg(functor_sname).arg(i).arg(m_param_imageBand1->toString()).arg(m_param_imageBand2->toString()));
-                    }
-                    else
-                    {
-                        new_vectorfield->setName(QString("%1 of %2 and %3").arg(functor_sname).arg(m_param_imageBand1->toString()).arg(m_param_imageBand2->toString()));
-                    }
-                    new_vectorfield->setGlobalMotion(QTransform(mat_list[i](0,0), mat_list[i](1,0), mat_list[i](2,0),
-                                                                mat_list[i](0,1), mat_list[i](1,1), mat_list[i](2,1),
-                                                                mat_list[i](0,2), mat_list[i](1,2), mat_list[i](2,2)));
-                                                                
-                    qDebug() << "Assigning GME for VF:" << new_vectorfield->globalMotion();
-                    qDebug() << "Inverted GME for VF:" << new_vectorfield->globalMotion().inverted();
-                    
-                    //Get time diff
-                    unsigned int seconds = (unsigned int)m_param_imageBand1->image()->timestamp().secsTo(m_param_imageBand2->image()->timestamp());
-                    
-                    if(seconds != 0)
-                    {
-                        new_vectorfield->setScale(m_param_imageBand1->image()->scale()*100.0/seconds * (m_param_imageBand1->image()->width()/flow_list[0].width()));
-                    }
-                    
-                    QString descr = QString("The following parameters were used to calculate the %1\n").arg(functor_name);
-                    
-                    if( i != 0)
+                    tile.outer.setLeft(std::max(0, std::min(tile.outer.left(), tile.outer.right()+1 - (int)min_size)/(int)alignment*(int)alignment));
+                }
+                if (tile.outer.height() < (int)min_size)
+                {
+                    tile.outer.setTop(std::max(0, std::min(tile.outer.top(), tile.outer.bottom()+1 - (int)min_size)/(int)alignment*(int)alignment));
+                }
+            }
+            
+            flow_list.push_back(vigra::MultiArray<2,FlowValueType>(imageband1.shape()));
+            mat_list.push_back(vigra::identityMatrix<double>(3));
+            rotation_correlation_list.push_back(0);
+            translation_correlation_list.push_back(0);
+            
+            vigra::MultiArrayView<2,FlowValueType> flow = flow_list[0];
+            
+            //Bound the peak memory: At most one tile per thread is processed at a time
+            const unsigned int batch_size = std::max(Scheduler::instance()->threadCount(), 1u);
+            
+            for (unsigned int first=0; first < tiles.size(); first += batch_size)
+            {
+                const unsigned int count = std::min(batch_size, (unsigned int)tiles.size() - first);
+                
+                parallelFor(count,
+                            [&](unsigned int i)
+                            {
+                                const BandTile& tile = tiles[first+i];
+                                
+                                vigra::Shape2 outer_ul(tile.outer.left(), tile.outer.top()),
+                                              outer_lr(tile.outer.right()+1, tile.outer.bottom()+1),
+                                              inner_ul(tile.inner.left(), tile.inner.top()),
+                                              inner_lr(tile.inner.right()+1, tile.inner.bottom()+1);
+                                
+                                std::vector<vigra::MultiArray<2,float> > tile_img_list;
+                                std::vector<vigra::MultiArray<2,FlowValueType> > tile_flow_list;
+                                std::vector<vigra::Matrix<double> > tile_mat_list;
+                                std::vector<double> tile_rotation_correlation_list;
+                                std::vector<double> tile_translation_correlation_list;
+                                
+                                computeFlowOnImages(func,
+                                                    imageband1.subarray(outer_ul, outer_lr),
+                                                    imageband2.subarray(outer_ul, outer_lr),
+                                                    m_param_useMask->value() ? mask.subarray(outer_ul, outer_lr) : mask,
+                                                    NULL, NULL, NULL,
+                                                    false,
+                                                    tile_img_list, tile_flow_list, tile_mat_list,
+                                                    tile_rotation_correlation_list, tile_translation_correlation_list);
+                                
+                                flow.subarray(inner_ul, inner_lr) = tile_flow_list[0].subarray(inner_ul - outer_ul, inner_lr - outer_ul);
+                            },
+                            [&](float p)
+                            {
+                                status_update((first + p/100.0*count)*100.0/tiles.size());
+                            });
+            }
+        }
+        
+        /**
+         * Computes the flow for each pair of consecutive frames of an image sequence.
+         * The frames are either all bands of a single image or the same band of all
+         * given images. The pyramid of each frame is built only once (see Image::pyramid)
+         * and shared by both pairs, which contain the frame. The pairs are processed in
+         * parallel (or one after the other, if each pair is tiled) and the results are
+         * appended to the results in the order of the sequence.
+         *
+         * \param func The Optical Flow Functor, which will carry out each step's 
+         *             flow estimation.
+         */
+        template<class OpticalFlowFunctor>
+        void computeSequenceFlow(OpticalFlowFunctor func)
+        {
+            typedef typename OpticalFlowFunctor::FlowValueType FlowValueType;
+            
+            //Collect the frames of the sequence
+            std::vector<Model*> models = m_param_sequence->value();
+            std::vector<Image<float>*> frame_images;
+            std::vector<unsigned int> frame_bands;
+            
+            for (Model* model : models)
+            {
+                Image<float>* image = static_cast<Image<float>*>(model);
+                
+                if (models.size() == 1)
+                {
+                    for (unsigned int b=0; b < image->numBands(); ++b)
                     {
-                        descr += QString("Level %1 of %2\n").arg(i).arg(flow_list.size());
+                        frame_images.push_back(image);
+                        frame_bands.push_back(b);
                     }
-                    descr += m_parameters->valueText("ImageBandParameter<float>");
-                    new_vectorfield->setDescription(descr);
-                    m_results.push_back(new_vectorfield);
                 }
-                //Also save warped images on demand
-                if(m_param_pmode->value() !=0 && i!=0 && m_param_saveIntermediateImages->value()) 
+                else if ((unsigned int)m_param_sequenceBand->value() < image->numBands())
                 {
-                    Image<float>* new_image = new Image<float>(img_list[i].shape(), 1, m_workspace);
-                    new_image->setBand(0,img_list[i]);
-                    
-                    m_param_imageBand1->image()->copyMetadata(*new_image);
-                    
-                    new_image->setName(QString("Warped Image (L%1) of %2").arg(i).arg(m_param_imageBand1->toString()));
-                    new_image->setDescription(QString(  "The following parameters were used to calculate the warping:\n"
-                                                        "TPS Functor\n"
-                                                        "Subsampled each %1 pixel").arg(5*m_param_pmode->value()));
-                    m_results.push_back(new_image);
+                    frame_images.push_back(image);
+                    frame_bands.push_back(m_param_sequenceBand->value());
+                }
+                else
+                {
+                    qWarning() << "OpticalFlowAlgorithm: Skipping" << image->name() << "of the sequence, since it has no band" << m_param_sequenceBand->value();
+                }
+            }
+            
+            vigra_precondition(frame_images.size() >= 2, "OpticalFlowAlgorithm: The image sequence needs at least two frames.");
+            
+            const unsigned int frames = frame_images.size(),
+                               pairs  = frames - 1;
+            
+            vigra::MultiArrayView<2,float> mask = m_param_mask->value();
+            
+            //Build the pyramid of each frame once
+            std::vector<std::shared_ptr<const ImagePyramid<float> > > pyramids(frames);
+            std::shared_ptr<const ImagePyramid<float> > mask_pyramid;
+            
+            if (m_param_useHierarchy->value() && !m_param_useTiles->value())
+            {
+                unsigned int levels = m_param_highestLevel->value();
+                
+                parallelFor(frames,
+                            [&](unsigned int f)
+                            {
+                                pyramids[f] = frame_images[f]->pyramid(frame_bands[f], levels);
+                            });
+                
+                if (m_param_useMask->value())
+                {
+                    mask_pyramid = m_param_mask->image()->pyramid(m_param_mask->bandId(), levels);
+                }
+            }
+            
+            std::vector<vigra::MultiArray<2,FlowValueType> > flows(pairs);
+            std::vector<vigra::Matrix<double> > mats(pairs);
+            
+            auto computePair = [&](unsigned int p)
+            {
+                const vigra::MultiArrayView<2,float> & band1 = frame_images[p]->band(frame_bands[p]),
+                                                     & band2 = frame_images[p+1]->band(frame_bands[p+1]);
+                
+                vigra_precondition(band1.shape() == band2.shape(), "OpticalFlowAlgorithm: The frames of the sequence differ in size.");
+                
+                if (m_param_useMask->value())
+                {
+                    vigra_precondition(band1.shape() == mask.shape(), "OpticalFlowAlgorithm: The mask and the frames of the sequence differ in size.");
+                }
+                
+                std::vector<vigra::MultiArray<2,float> > img_list;
+                std::vector<vigra::MultiArray<2,FlowValueType> > flow_list;
+                std::vector<vigra::Matrix<double> > mat_list;
+                std::vector<double> rotation_correlation_list;
+                std::vector<double> translation_correlation_list;
+                
+                if (m_param_useTiles->value())
+                {
+                    computeFlowTiled(func, band1, band2, mask,
+                                     flow_list, mat_list, rotation_correlation_list, translation_correlation_list);
+                }
+                else
+                {
+                    computeFlowOnImages(func, band1, band2, mask,
+                                        pyramids[p].get(), pyramids[p+1].get(), mask_pyramid.get(),
+                                        m_param_useGME->value(),
+                                        img_list, flow_list, mat_list, rotation_correlation_list, translation_correlation_list);
+                }
+                
+                flows[p].swap(flow_list[0]);
+                mats[p] = mat_list[0];
+            };
+            
+            if (m_param_useTiles->value())
+            {
+                //The tiles of each pair are already processed in parallel
+                for (unsigned int p=0; p < pairs; ++p)
+                {
+                    computePair(p);
                 }
             }
+            else
+            {
+                parallelFor(pairs, computePair, [&](float p){ status_update(p); });
+            }
+            
+            QString functor_name = QString::fromStdString(OpticalFlowFunctor::name());
+            QString functor_sname = QString::fromStdString(OpticalFlowFunctor::shortName());
+            
+            for (unsigned int p=0; p < pairs; ++p)
+            {
+                DenseVectorfield2D* new_vectorfield = newFlowVectorfield(flows[p], mats[p]);
+                
+                new_vectorfield->setName(QString("%1 of %2 (band %3) and %4 (band %5)")
+                                            .arg(functor_sname)
+                                            .arg(frame_images[p]->name()).arg(frame_bands[p])
+                                            .arg(frame_images[p+1]->name()).arg(frame_bands[p+1]));
+                
+                //Get time diff
+                qint64 seconds = frame_images[p]->timestamp().secsTo(frame_images[p+1]->timestamp());
+                
+                //Frames out of temporal order (or with equal timestamps) carry no usable interval
+                if (seconds > 0)
+                {
+                    new_vectorfield->setScale(frame_images[p]->scale()*100.0/seconds);
+                }
+                
+                QString descr = QString("The following parameters were used to calculate the %1\n").arg(functor_name);
+                descr += QString("Frames %1 and %2 of %3 of the image sequence\n").arg(p+1).arg(p+2).arg(frames);
+                descr += m_parameters->valueText("ImageBandParameter<float>");
+                new_vectorfield->setDescription(descr);
+                m_results.push_back(new_vectorfield);
+            }
+        }
+        
+        /**
+         * Creates a new vectorfield from a flow field and assigns the global motion.
+         *
+         * \param flow The flow field.
+         * \param mat The global motion matrix of the flow field.
+         * \return A new DenseVectorfield2D for (u,v) flows, a new DenseWeightedVectorfield2D
+         *         for weighted flows.
+         */
+        template<class FlowValueType>
+        DenseVectorfield2D* newFlowVectorfield(const vigra::MultiArray<2,FlowValueType> & flow, const vigra::Matrix<double> & mat)
+        {
+            DenseVectorfield2D* new_vectorfield = NULL;
+            
+            if(FlowValueType().size() == 2)
+            {
+               new_vectorfield =  new DenseVectorfield2D(flow.bindElementChannel(0),flow.bindElementChannel(1), m_workspace);
+            }
+            //Has to be larger
+            else
+            {
+                new_vectorfield =  new DenseWeightedVectorfield2D(flow.bindElementChannel(0),flow.bindElementChannel(1),flow.bindElementChannel(2), m_workspace);
+            }
+            
+            new_vectorfield->setGlobalMotion(QTransform(mat(0,0), mat(1,0), mat(2,0),
+                                                        mat(0,1), mat(1,1), mat(2,1),
+                                                        mat(0,2), mat(1,2), mat(2,2)));
+            
+            return new_vectorfield;
         }
             
     protected:
@@ -387,6 +857,10 @@ class OpticalFlowAlgorithm
         BoolParameter *  m_param_useMask;
         ImageBandParameter<float> * m_param_mask;
         
+        BoolParameter *  m_param_useSequence;
+        MultiModelParameter * m_param_sequence;
+        IntParameter *   m_param_sequenceBand;
+        
         BoolParameter	*  m_param_useGME;
         BoolParameter	*  m_param_useHierarchy;
         
@@ -400,6 +874,9 @@ class OpticalFlowAlgorithm
         
         BoolParameter	* m_param_saveIntermediateImages;
         BoolParameter	* m_param_saveIntermediateFlow;
+        
+        BoolParameter	* m_param_useTiles;
+        IntParameter    * m_param_tileSize;
         /**
          * @}
          */
@@ -429,10 +906,12 @@ class OpticalFlowHSEstimator
 			m_param_sigma = new FloatParameter("sigma of gauss. gradient", 0, 30, 1);
 			m_param_alpha = new FloatParameter("Weight alpha", 0, 99999, 1);
 			m_param_iterations = new IntParameter("No. of iterations", 1, 1000, 100);
+			m_param_solver = new EnumParameter("Solver (multigrid only for the original HS)", solver_modes(), 0);
 			
 			m_parameters->addParameter("sigma", m_param_sigma );
 			m_parameters->addParameter("alpha", m_param_alpha );
 			m_parameters->addParameter("iterations", m_param_iterations );
+			m_parameters->addParameter("solver", m_param_solver );
 		
 			addFrameworkProcessingParameters();
 		}
@@ -468,11 +947,21 @@ class OpticalFlowHSEstimator
                     OPTICALFLOW_FUNCTOR func(m_param_alpha->value(),
                                              m_param_iterations->value(),
                                              m_param_sigma->value());
+                    func.setSolver(OpticalFlowSolver(m_param_solver->value()));
                     
                     emit statusMessage(1.0, QString("started computation"));
                     
                     computeFlow(func);
                     
+                    //Report the iterations, which have been needed for each level
+                    QString statistics = func.log().toText();
+                    qDebug() << typeName() << statistics;
+                    
+                    for(Model* model : m_results)
+                    {
+                        model->setDescription(model->description() + "\n" + statistics);
+                    }
+                    
                     emit statusMessage(100.0, QString("finished computation"));
                     emit finished();
                 }
@@ -497,6 +986,7 @@ class OpticalFlowHSEstimator
         FloatParameter * m_param_sigma;
         FloatParameter * m_param_alpha;
         IntParameter* m_param_iterations;
+        EnumParameter* m_param_solver;
         /**
          * @}
          */
@@ -560,6 +1050,7 @@ class OpticalFlowBruhnEstimator
             m_param_alpha = new FloatParameter("Weight alpha", 0, 100, 1);
             m_param_omega = new FloatParameter("Weight omega", 0, 100, 1);
             m_param_iterations = new IntParameter("No. of iterations", 1, 1000, 100);
+            m_param_solver = new EnumParameter("Solver", solver_modes(), 0);
             
             
             m_parameters->addParameter("sigma1", m_param_inner_sigma );
@@ -567,6 +1058,7 @@ class OpticalFlowBruhnEstimator
             m_parameters->addParameter("alpha", m_param_alpha );
             m_parameters->addParameter("omega", m_param_omega );
             m_parameters->addParameter("iterations", m_param_iterations );
+            m_parameters->addParameter("solver", m_param_solver );
             
             addFrameworkProcessingParameters();
         }
@@ -603,11 +1095,21 @@ class OpticalFlowBruhnEstimator
                                              m_param_outer_sigma->value(),
                                              m_param_omega->value(),
                                              m_param_iterations->value());
+                    func.setSolver(OpticalFlowSolver(m_param_solver->value()));
                     
                     emit statusMessage(1.0, QString("started computation"));
                     
                     computeFlow(func);
                     
+                    //Report the iterations, which have been needed for each level
+                    QString statistics = func.log().toText();
+                    qDebug() << typeName() << statistics;
+                    
+                    for(Model* model : m_results)
+                    {
+                        model->setDescription(model->description() + "\n" + statistics);
+                    }
+                    
                     emit statusMessage(100.0, QString("finished computation"));
                     emit finished();
                 }
@@ -634,6 +1136,7 @@ class OpticalFlowBruhnEstimator
         FloatParameter * m_param_alpha;
         FloatParameter * m_param_omega;	
         IntParameter* m_param_iterations;
+        EnumParameter* m_param_solver;
         /**
          * @}
          */
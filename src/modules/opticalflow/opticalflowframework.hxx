@@ -42,14 +42,24 @@
 //for hierarchical processing and global motion estimation
 #include "registration/registration.h"
 
-//image representation
+//image representation and (cached) Gaussian pyramids
 #include <vigra/stdimage.hxx>
+#include "images/imagepyramid.hxx"
 
 //separable filters
 #include <vigra/convolution.hxx>
 #include <vigra/stdconvolution.hxx>
 #include <vigra/affine_registration_fft.hxx>
 
+//row-parallel dense warping
+#include "core/parallel.hxx"
+
+//kernel radii for the halos of tiles
+#include "opticalflowgradients.hxx"
+
+#include <algorithm>
+#include <cmath>
+
 namespace graipe {
 
 /**
@@ -220,37 +230,173 @@ void calculateOFCE(const vigra::MultiArrayView<2,T1> & src1,
  */ 
 
 /**
- * Helper-function to get (via Gaussian reduction) from one image to next pyramid level's image
- * Next means smaller image.
- * \param[in] in The input image
- * \param[out] out The reduced image.
+ * Computes one level of a Gaussian pyramid. If a cached pyramid (see Image::pyramid)
+ * is given and contains that level, it is copied from there. Otherwise, it is reduced
+ * from the previous level by means of reduceToNextLevel.
+ *
+ * \param[in,out] list The pyramid levels. All levels below the given level need to be set.
+ * \param[in] level The level to be computed.
+ * \param[in] cache The cached pyramid of the same image. May be NULL.
+ */
+template <class T>
+void buildPyramidLevel(std::vector<vigra::MultiArray<2,T> > & list, unsigned int level, const ImagePyramid<T> * cache)
+{
+    if(cache != NULL && cache->levels() >= level)
+    {
+        list[level] = cache->level(level);
+    }
+    else
+    {
+        reduceToNextLevel(vigra::MultiArrayView<2,T>(list[level-1]), list[level]);
+    }
+}
+
+/**
+ * Bilinear interpolation of an image at a subpixel position. Positions outside
+ * the image are clamped to the border.
+ *
+ * \param img The image.
+ * \param x The x-coordinate of the position.
+ * \param y The y-coordinate of the position.
+ * \return The interpolated value.
+ */
+template <class T>
+double interpolateBilinear(const vigra::MultiArrayView<2,T> & img, double x, double y)
+{
+    x = std::min(std::max(x, 0.0), img.width()-1.0);
+    y = std::min(std::max(y, 0.0), img.height()-1.0);
+    
+    const int x0 = (int)x, x1 = std::min(x0+1, (int)img.width()-1),
+              y0 = (int)y, y1 = std::min(y0+1, (int)img.height()-1);
+    const double fx = x - x0, fy = y - y0;
+    
+    return    (1-fy)*((1-fx)*img(x0,y0) + fx*img(x1,y0))
+            +    fy *((1-fx)*img(x0,y1) + fx*img(x1,y1));
+}
+
+/**
+ * Resamples a (flow) field from one pyramid level to another one. In contrast to
+ * vigra::resizeImageLinearInterpolation, which maps the first and last pixels onto
+ * each other, pixel x at the destination level samples the source level at
+ * x*2^(dest_level-src_level). This is the sampling grid of reduceToNextLevel and it
+ * does not depend on the image size. Thus, tiles, which start at multiples of
+ * 2^levels, share it with the whole image. Positions outside the source are clamped
+ * to its border. The vector lengths are not rescaled.
+ *
+ * \param[in] src The field at the source level.
+ * \param[out] dest The field at the destination level. Needs to have the level's size.
+ * \param[in] src_level The pyramid level of the source.
+ * \param[in] dest_level The pyramid level of the destination.
  */
 template <class T>
-void reduceToNextLevel(const vigra::MultiArrayView<2,T> & in, vigra::MultiArray<2,T> & out)
-{    
-    // image size at current level
-    unsigned int width  = (unsigned int)in.width(),
-                 height = (unsigned int)in.height();
+void resampleToLevel(const vigra::MultiArrayView<2,T> & src, vigra::MultiArray<2,T> & dest,
+                     unsigned int src_level, unsigned int dest_level)
+{
+    const double scale = std::pow(2.0, double(dest_level) - double(src_level));
+    const int w = src.width(), h = src.height();
     
-    // image size at next smaller level
-    unsigned int newwidth  = (width + 1) / 2,
-                 newheight = (height + 1) / 2;
+    for(int y=0; y<dest.height(); ++y)
+    {
+        const double sy = std::min(y*scale, h-1.0);
+        const int y0 = (int)sy, y1 = std::min(y0+1, h-1);
+        const double fy = sy - y0;
+        
+        for(int x=0; x<dest.width(); ++x)
+        {
+            const double sx = std::min(x*scale, w-1.0);
+            const int x0 = (int)sx, x1 = std::min(x0+1, w-1);
+            const double fx = sx - x0;
+            
+            dest(x,y) =   src(x0,y0)*((1-fx)*(1-fy)) + src(x1,y0)*(fx*(1-fy))
+                        + src(x0,y1)*((1-fx)*fy)     + src(x1,y1)*(fx*fy);
+        }
+    }
+}
+
+/**
+ * Bicubic (Catmull-Rom) interpolation of an image at a subpixel position. Positions
+ * outside the image are clamped to the border.
+ *
+ * \param img The image.
+ * \param x The x-coordinate of the position.
+ * \param y The y-coordinate of the position.
+ * \return The interpolated value.
+ */
+template <class T>
+double interpolateBicubic(const vigra::MultiArrayView<2,T> & img, double x, double y)
+{
+    const int w = img.width(), h = img.height();
     
-    // resize result image to appropriate size
-    out.reshape(vigra::Shape2(newwidth, newheight));
+    x = std::min(std::max(x, 0.0), w-1.0);
+    y = std::min(std::max(y, 0.0), h-1.0);
     
-    // define a Gaussian kernel (size 5x1)
-    vigra::Kernel1D<double> filter;
-    filter.initExplicitly(-2, 2) = 0.05, 0.25, 0.4, 0.25, 0.05;
+    const int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+    const double fx = x - x0, fy = y - y0;
     
-    vigra::MultiArray<2,T> temp(in.shape()), temp2(in.shape());
+    //Keys' cubic convolution kernel with a = -0.5 at the offsets -1, 0, 1, 2
+    double kx[4], ky[4];
+    kx[0] = ((-0.5*fx + 1.0)*fx - 0.5)*fx;
+    kx[1] = (1.5*fx - 2.5)*fx*fx + 1.0;
+    kx[2] = ((-1.5*fx + 2.0)*fx + 0.5)*fx;
+    kx[3] = (0.5*fx - 0.5)*fx*fx;
+    ky[0] = ((-0.5*fy + 1.0)*fy - 0.5)*fy;
+    ky[1] = (1.5*fy - 2.5)*fy*fy + 1.0;
+    ky[2] = ((-1.5*fy + 2.0)*fy + 0.5)*fy;
+    ky[3] = (0.5*fy - 0.5)*fy*fy;
     
-    // smooth (band limit) input image
-    vigra::separableConvolveX(in,   temp, filter);
-    vigra::separableConvolveY(temp, temp2, filter);
-                       
-    // downsample smoothed image
-    vigra::resizeImageNoInterpolation(temp2, out);
+    double result = 0;
+    
+    for(int j=0; j<4; ++j)
+    {
+        const int yy = std::min(std::max(y0+j-1, 0), h-1);
+        double row = 0;
+        
+        for(int i=0; i<4; ++i)
+        {
+            row += kx[i]*img(std::min(std::max(x0+i-1, 0), w-1), yy);
+        }
+        result += ky[j]*row;
+    }
+    return result;
+}
+
+/**
+ * Dense warping of an image along a flow field, which is the fast alternative
+ * to the warping functors with subsampled point correspondences. Each pixel x is
+ * resampled at x - flow(x), which is the first-order inverse of moving each
+ * pixel x to x + flow(x). The rows are processed in parallel.
+ *
+ * \param[in,out] img The image, which will be warped in place.
+ * \param[in] flow The flow field (of the image's size).
+ * \param[in] order The interpolation order: 1 = bilinear, 3 = bicubic.
+ */
+template <class T, class FlowValueType>
+void warpImageWithFlow(vigra::MultiArray<2,T> & img,
+                       const vigra::MultiArrayView<2,FlowValueType> & flow,
+                       unsigned int order)
+{
+    vigra_precondition(img.shape() == flow.shape(), "image and flow sizes differ!");
+    
+    const vigra::MultiArray<2,T> src(img);
+    const int w = img.width(), h = img.height(), block_rows = 32;
+    
+    parallelFor((h + block_rows - 1)/block_rows,
+                [&](unsigned int b)
+                {
+                    const int y_end = std::min(h, int(b+1)*block_rows);
+                    
+                    for(int y=b*block_rows; y<y_end; ++y)
+                    {
+                        for(int x=0; x<w; ++x)
+                        {
+                            const double src_x = x - flow(x,y)[0],
+                                         src_y = y - flow(x,y)[1];
+                            
+                            img(x,y) = (order == 1) ? interpolateBilinear(src, src_x, src_y)
+                                                    : interpolateBicubic(src, src_x, src_y);
+                        }
+                    }
+                });
 }
 
 /**
@@ -308,6 +454,49 @@ std::list<unsigned int> buildStepList(unsigned int steps, unsigned int break_lev
 	return step_list;
 }
 
+/**
+ * Computes the halo, which is needed around each tile for a tiled Optical Flow
+ * computation, such that the flow of the tile's inner region does not depend on
+ * the tile's borders. The functor's halo is needed on each visited level of the
+ * scale space, which enlarges it by that level's scale factor. Additionally, the
+ * Gaussian reduction of the pyramid and the propagation (interpolation and
+ * smoothing) of the flow from one level to the next are taken into account.
+ * Displacements, which point beyond the halo, are not.
+ *
+ * \param flow_func The used functor to compute the Optical Flow.
+ * \param hierarchical If true, the hierarchical framework is used.
+ * \param steps Step count.
+ * \param break_level On wich level shall we finish/break the traversal.
+ * \param hmode The hierarchical traversal mode: (0: V, 1: Single W, 2: Full W)
+ * \param warp_sigma The sigma of the smoothing before each warping (0.0 = none).
+ * \param warp_radius The radius of the flow's propagation from one level to the next,
+ *                    e.g. 1 for bilinear and 2 for bicubic interpolation.
+ * \return The halo in pixels of level 0. Global methods may need more than the image size.
+ */
+template <class OpticalFlowFunctor>
+double calculateOFCEHalo(const OpticalFlowFunctor & flow_func, bool hierarchical,
+                         unsigned int steps, unsigned int break_level, unsigned int hmode,
+                         float warp_sigma, double warp_radius)
+{
+    double level_halo = flow_func.halo();
+    
+    if(!hierarchical)
+    {
+        return level_halo;
+    }
+    
+    level_halo += warp_radius + gaussianKernelRadius(warp_sigma);
+    
+    //The Gaussian reduction (radius 2) of each level
+    double halo = 2.0*(std::pow(2.0, (double)steps) - 1.0);
+    
+    for(unsigned int level : buildStepList(steps, break_level, hmode))
+    {
+        halo += level_halo*std::pow(2.0, (double)level);
+    }
+    return halo;
+}
+
 
 /**
  * The first hierarchical Optical Flow estimation approach:
@@ -327,6 +516,8 @@ std::list<unsigned int> buildStepList(unsigned int steps, unsigned int break_lev
  * \param[in] steps Step count.
  * \param[in] break_level On wich level shall we finish/break the traversal.
  * \param[in] hmode The hierarchical traversal mode: (0: V, 1: Single W, 2: Full W)
+ * \param[in] pyramid1 The cached pyramid of the first image, see Image::pyramid(). May be NULL.
+ * \param[in] pyramid2 The cached pyramid of the second image, see Image::pyramid(). May be NULL.
  */
 template <	class T1, class T2, class MatrixType, class OpticalFlowFunctor>
 void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> & src1, 
@@ -339,7 +530,9 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
                                             std::vector<double>& translation_correlation_list,
                                             unsigned int steps,  
                                             unsigned int break_level, 
-                                            unsigned int hmode)
+                                            unsigned int hmode,
+                                            const ImagePyramid<T1> * pyramid1=NULL,
+                                            const ImagePyramid<T2> * pyramid2=NULL)
 {
     vigra_precondition(src1.shape() == src2.shape() ,"image sizes differ!");
     
@@ -357,8 +550,8 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
 		
 	for (unsigned int level=1; level<=steps; ++level)
 	{
-		reduceToNextLevel(img_list[level-1], img_list[level]);
-		reduceToNextLevel(img2_list[level-1], img2_list[level]);
+		buildPyramidLevel(img_list, level, pyramid1);
+		buildPyramidLevel(img2_list, level, pyramid2);
 		
 		flow_list.push_back(vigra::MultiArray<2,typename OpticalFlowFunctor::FlowValueType>(img_list[level].shape()));
 		mat_list.push_back(MatrixType(3,3));
@@ -387,7 +580,7 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
 		if(next_iter != step_list.end() )
 		{
 			//progate u's and v's for the next lower step
-			vigra::resizeImageLinearInterpolation(flow_list[s], flow_list[next_s]);
+			resampleToLevel(flow_list[s], flow_list[next_s], s, next_s);
 			
             //rescale vector length only!
             double rescale_factor = pow(2.0, double(s-next_s));
@@ -398,7 +591,7 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
 	}	
 	if(break_level!=0)
 	{
-		vigra::resizeImageLinearInterpolation(flow_list[break_level], flow_list[0]);
+		resampleToLevel(flow_list[break_level], flow_list[0], break_level, 0);
 		
 		//rescale vector length only!
 		double rescale_factor = pow(2.0, double(break_level));
@@ -427,6 +620,9 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
  * \param steps Step count.
  * \param[in] break_level On wich level shall we finish/break the traversal.
  * \param[in] hmode The hierarchical traversal mode: (0: V, 1: Single W, 2: Full W)
+ * \param[in] pyramid1 The cached pyramid of the first image, see Image::pyramid(). May be NULL.
+ * \param[in] pyramid2 The cached pyramid of the second image, see Image::pyramid(). May be NULL.
+ * \param[in] mask_pyramid The cached pyramid of the mask, see Image::pyramid(). May be NULL.
  */
 template <	class T1, class T2, class T3, class MatrixType, class OpticalFlowFunctor>
 void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> & src1,
@@ -440,7 +636,10 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
                                             std::vector<double>& translation_correlation_list,
 											unsigned int steps,
 											unsigned int break_level,
-											unsigned int hmode)
+											unsigned int hmode,
+											const ImagePyramid<T1> * pyramid1=NULL,
+											const ImagePyramid<T2> * pyramid2=NULL,
+											const ImagePyramid<T3> * mask_pyramid=NULL)
 {
     vigra_precondition(src1.shape() == src2.shape() ,"image sizes differ!");
     vigra_precondition(src1.shape() == mask.shape() ,"image and mask sizes differ!");
@@ -461,9 +660,9 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
 	
 	for (unsigned int level=1; level<=steps; ++level)
 	{
-		reduceToNextLevel(img_list[level-1], img_list[level]);
-		reduceToNextLevel(img2_list[level-1], img2_list[level]);
-		reduceToNextLevel(mask_list[level-1], mask_list[level]);
+		buildPyramidLevel(img_list, level, pyramid1);
+		buildPyramidLevel(img2_list, level, pyramid2);
+		buildPyramidLevel(mask_list, level, mask_pyramid);
 		
 		flow_list.push_back(vigra::MultiArray<2,typename OpticalFlowFunctor::FlowValueType>(img_list[level].shape()));
 		mat_list.push_back(MatrixType(3,3));
@@ -494,7 +693,7 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
 		if(next_iter != step_list.end() )
 		{
 			//progate u's and v's for the next lower step
-            vigra::resizeImageLinearInterpolation(flow_list[s], flow_list[next_s]);
+            resampleToLevel(flow_list[s], flow_list[next_s], s, next_s);
 			
             //rescale vector length only!
             double rescale_factor = pow(2.0, double(s-next_s));
@@ -505,7 +704,7 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
 	}	
 	if(break_level!=0)
 	{
-		vigra::resizeImageLinearInterpolation(flow_list[break_level], flow_list[0]);
+		resampleToLevel(flow_list[break_level], flow_list[0], break_level, 0);
 		
 		//rescale vector length only!
 		double rescale_factor = pow(2.0, double(break_level));
@@ -544,6 +743,11 @@ void calculateOFCEHierarchicallyInitialiser(const vigra::MultiArrayView<2,T1> &
  * \param[in] warp The functor, which is used for warping
  * \param[in] warp_subsampling The subsampling, wich is used for warping
  * \param[in] warp_sigma The sigma, which is used for smoothing the result before subsampling.
+ * \param[in] dense_warp_order If not 0, the images are warped densely by means of
+ *                             warpImageWithFlow() with this interpolation order (1 or 3)
+ *                             instead of using the warping functor.
+ * \param[in] pyramid1 The cached pyramid of the first image, see Image::pyramid(). May be NULL.
+ * \param[in] pyramid2 The cached pyramid of the second image, see Image::pyramid(). May be NULL.
  */
 template <class T1, class T2, class MatrixType, class OpticalFlowFunctor, class WarpingFunctor>
 void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1, 
@@ -560,7 +764,10 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
 										unsigned int hmode,
 										WarpingFunctor warp,
 										unsigned int warp_subsampling,
-										float warp_sigma)
+										float warp_sigma,
+										unsigned int dense_warp_order=0,
+										const ImagePyramid<T1> * pyramid1=NULL,
+										const ImagePyramid<T2> * pyramid2=NULL)
 {
     vigra_precondition(src1.shape() == src2.shape() ,"image sizes differ!");
     
@@ -582,8 +789,8 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
 	
 	for (unsigned int level=1; level<=steps; ++level)
 	{
-		reduceToNextLevel(img_list[level-1], img_list[level]);
-		reduceToNextLevel(img2_list[level-1], img2_list[level]);
+		buildPyramidLevel(img_list, level, pyramid1);
+		buildPyramidLevel(img2_list, level, pyramid2);
 		
 		flow_list.push_back(vigra::MultiArray<2,typename OpticalFlowFunctor::FlowValueType>(img_list[level].shape()));
 		mat_list.push_back(MatrixType(3,3));
@@ -615,14 +822,14 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
             double rescale_factor = pow(2.0, double(s));
             
 			//store computed u and v to the result
-			vigra::resizeImageLinearInterpolation(flow_list[s], temp_res);
+			resampleToLevel(flow_list[s], temp_res, s, 0);
             
             //rescale values:
             flow_res += temp_res*rescale_factor;
             
             //use u and v (in a subsampled way) to call the warping
 			//progate u's and v's for the next lower step
-			vigra::resizeImageLinearInterpolation(flow_list[s], flow_list[next_s]);
+			resampleToLevel(flow_list[s], flow_list[next_s], s, next_s);
 			
 			//rescale vector length
             rescale_factor = pow(2.0, double(s-next_s));
@@ -635,18 +842,26 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
 				vigra::gaussianSmoothing(flow_list[next_s], flow_list[next_s], warp_sigma);
 			}
 			
-			//Prepare point list for warping
-			std::vector<Vectorfield2D::PointType> src_points, dest_points;
-			for(unsigned int y=0; y<(unsigned int)(flow_list[next_s].height()); y+=warp_subsampling)
+			if(dense_warp_order != 0)
+			{
+				//Resample the image directly along the dense flow
+				warpImageWithFlow(img_list[next_s], flow_list[next_s], dense_warp_order);
+			}
+			else
 			{
-				for(unsigned int x=0; x<(unsigned int)(flow_list[next_s].width()); x+=warp_subsampling)
+				//Prepare point list for warping
+				std::vector<Vectorfield2D::PointType> src_points, dest_points;
+				for(unsigned int y=0; y<(unsigned int)(flow_list[next_s].height()); y+=warp_subsampling)
 				{
-					src_points.push_back(Vectorfield2D::PointType(x,y));
-					dest_points.push_back(Vectorfield2D::PointType(x+flow_list[next_s](x,y)[0], y+flow_list[next_s](x,y)[1]));
-				} 
+					for(unsigned int x=0; x<(unsigned int)(flow_list[next_s].width()); x+=warp_subsampling)
+					{
+						src_points.push_back(Vectorfield2D::PointType(x,y));
+						dest_points.push_back(Vectorfield2D::PointType(x+flow_list[next_s](x,y)[0], y+flow_list[next_s](x,y)[1]));
+					} 
+				}
+				//Call the warping functor
+				warp(img_list[next_s], img_list[next_s], src_points.begin(), src_points.end(), dest_points.begin());
 			}
-			//Call the warping functor
-			warp(img_list[next_s], img_list[next_s], src_points.begin(), src_points.end(), dest_points.begin());
 			
 			//Delete (already corrected) motion estimate
 			flow_list[next_s] = typename OpticalFlowFunctor::FlowValueType();
@@ -654,13 +869,13 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
 	}	
 	if(break_level!=0)
 	{
-        vigra::resizeImageLinearInterpolation(flow_list[break_level], flow_list[0]);
+        resampleToLevel(flow_list[break_level], flow_list[0], break_level, 0);
 		
 		//rescale vector length
 		double rescale_factor = pow(2.0, double(break_level));
 		
 		//store computed u and v to the result
-		vigra::resizeImageLinearInterpolation(flow_list[break_level], temp_res);
+		resampleToLevel(flow_list[break_level], temp_res, break_level, 0);
         flow_res += temp_res*rescale_factor;
 	}
 	flow_list[0] = flow_res;
@@ -693,6 +908,12 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
  * \param[in] warp The functor, which is used for warping
  * \param[in] warp_subsampling The subsampling, wich is used for warping
  * \param[in] warp_sigma The sigma, which is used for smoothing the result before subsampling.
+ * \param[in] dense_warp_order If not 0, the images are warped densely by means of
+ *                             warpImageWithFlow() with this interpolation order (1 or 3)
+ *                             instead of using the warping functor.
+ * \param[in] pyramid1 The cached pyramid of the first image, see Image::pyramid(). May be NULL.
+ * \param[in] pyramid2 The cached pyramid of the second image, see Image::pyramid(). May be NULL.
+ * \param[in] mask_pyramid The cached pyramid of the mask, see Image::pyramid(). May be NULL.
  */
 template <class T1, class T2, class T3, class MatrixType, class OpticalFlowFunctor, class WarpingFunctor>
 void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1,
@@ -710,7 +931,11 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
                                         unsigned int hmode,
                                         WarpingFunctor warp,
                                         unsigned int warp_subsampling,
-                                        float warp_sigma)
+                                        float warp_sigma,
+                                        unsigned int dense_warp_order=0,
+                                        const ImagePyramid<T1> * pyramid1=NULL,
+                                        const ImagePyramid<T2> * pyramid2=NULL,
+                                        const ImagePyramid<T3> * mask_pyramid=NULL)
 {
     vigra_precondition(src1.shape() == src2.shape() ,"image sizes differ!");
     vigra_precondition(src1.shape() == mask.shape() ,"image and mask sizes differ!");
@@ -735,9 +960,9 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
 	
 	for (unsigned int level=1; level<=steps; ++level)
 	{
-		reduceToNextLevel(img_list[level-1], img_list[level]);
-		reduceToNextLevel(img2_list[level-1], img2_list[level]);
-		reduceToNextLevel(mask_list[level-1], mask_list[level]);
+		buildPyramidLevel(img_list, level, pyramid1);
+		buildPyramidLevel(img2_list, level, pyramid2);
+		buildPyramidLevel(mask_list, level, mask_pyramid);
 		
 		flow_list.push_back(vigra::MultiArray<2,typename OpticalFlowFunctor::FlowValueType>(img_list[level].shape()));
 		mat_list.push_back(MatrixType(3,3));
@@ -771,14 +996,14 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
             double rescale_factor = pow(2.0, double(s));
             
 			//store computed u and v to the result
-			vigra::resizeImageLinearInterpolation(flow_list[s], temp_res);
+			resampleToLevel(flow_list[s], temp_res, s, 0);
             
             //rescale values:
             flow_res += temp_res*rescale_factor;
             
             //use u and v (in a subsampled way) to call the warping
 			//progate u's and v's for the next lower step
-			vigra::resizeImageLinearInterpolation(flow_list[s], flow_list[next_s]);
+			resampleToLevel(flow_list[s], flow_list[next_s], s, next_s);
 			
 			//rescale vector length
             rescale_factor = pow(2.0, double(s-next_s));
@@ -793,18 +1018,26 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
 				vigra::gaussianSmoothing(flow_list[next_s], flow_list[next_s], warp_sigma);
 			}
 			
-			//Prepare point list for warping
-			std::vector<Vectorfield2D::PointType> src_points, dest_points;
-			for(unsigned int y=0; y<(unsigned int)(flow_list[next_s].height()); y+=warp_subsampling)
+			if(dense_warp_order != 0)
+			{
+				//Resample the image directly along the dense flow
+				warpImageWithFlow(img_list[next_s], flow_list[next_s], dense_warp_order);
+			}
+			else
 			{
-				for(unsigned int x=0; x<(unsigned int)(flow_list[next_s].width()); x+=warp_subsampling)
+				//Prepare point list for warping
+				std::vector<Vectorfield2D::PointType> src_points, dest_points;
+				for(unsigned int y=0; y<(unsigned int)(flow_list[next_s].height()); y+=warp_subsampling)
 				{
-					src_points.push_back(Vectorfield2D::PointType(x,y));
-					dest_points.push_back(Vectorfield2D::PointType(x+flow_list[next_s](x,y)[0], y+flow_list[next_s](x,y)[1]));
-				} 
+					for(unsigned int x=0; x<(unsigned int)(flow_list[next_s].width()); x+=warp_subsampling)
+					{
+						src_points.push_back(Vectorfield2D::PointType(x,y));
+						dest_points.push_back(Vectorfield2D::PointType(x+flow_list[next_s](x,y)[0], y+flow_list[next_s](x,y)[1]));
+					} 
+				}
+				//Call the warping functor
+				warp(img_list[next_s], img_list[next_s], src_points.begin(), src_points.end(), dest_points.begin());
 			}
-			//Call the warping functor
-			warp(img_list[next_s], img_list[next_s], src_points.begin(), src_points.end(), dest_points.begin());
 			
 			//Delete (already corrected) motion estimate
 			flow_list[next_s] = typename OpticalFlowFunctor::FlowValueType();
@@ -812,13 +1045,13 @@ void calculateOFCEHierarchicallyWarping(const vigra::MultiArrayView<2,T1> & src1
 	}	
 	if(break_level!=0)
 	{
-        vigra::resizeImageLinearInterpolation(flow_list[break_level], flow_list[0]);
+        resampleToLevel(flow_list[break_level], flow_list[0], break_level, 0);
 		
 		//rescale vector length
 		double rescale_factor = pow(2.0, double(break_level));
 		
 		//store computed u and v to the result
-		vigra::resizeImageLinearInterpolation(flow_list[break_level], temp_res);
+		resampleToLevel(flow_list[break_level], temp_res, break_level, 0);
         flow_res += temp_res*rescale_factor;
 	}
 	flow_list[0] = flow_res;
@@ -53,6 +53,20 @@ namespace graipe {
  * @brief Header file for the generic image series' gradients for Optical Flow approaches.
  */
  
+/**
+ * Returns the radius of the Gaussian kernels (or their derivatives), which
+ * are used by vigra's convolution functions for a given sigma (window ratio 3).
+ * Needed to derive the halo of tiles for a tiled processing.
+ *
+ * \param sigma The scale of the Gaussian.
+ * \param order The order of the derivative. Defaults to 0.
+ * \return The radius of the kernel in pixels.
+ */
+inline unsigned int gaussianKernelRadius(double sigma, unsigned int order=0)
+{
+    return (unsigned int)(3.0*sigma + 0.5*order + 0.5);
+}
+
 /**
  * The generic version of a spatio-temporal Gradient estimator based on two images.
  * To avoid noise-addictiveness, one can give a gaussian sigma value to smooth
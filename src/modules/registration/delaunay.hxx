@@ -64,7 +64,9 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <limits>
 #include <math.h>
+#include <cmath>
 
 #include "vigra/tinyvector.hxx"
 
@@ -357,361 +359,558 @@ typedef std::multiset<Triangle<double>>::const_iterator CTIterator;
 
 
 /**
- * Very basic implementation of an Edge class, which just keeps two vertices.
+ * Delaunay triangulation of a set of vertices by means of the sweep-hull
+ * approach (S-hull, as used in the Delaunator library):
+ * The vertices are sorted by their distance to the circumcenter of a
+ * small seed triangle and then added one after the other to the convex hull.
+ * Each new vertex is connected to the visible hull edges and the new
+ * triangles are legalized by edge flips.
+ *
+ * All data is kept in flat index arrays. For each triangle t, the indices of
+ * its vertices are stored at triangles()[3*t], triangles()[3*t+1] and
+ * triangles()[3*t+2]. The halfedge e of the triangle e/3 goes from vertex
+ * triangles()[e] to the next vertex of the same triangle. halfedges()[e]
+ * holds the opposite halfedge of the adjacent triangle, or -1 at the
+ * convex hull.
+ *
+ * The runtime is in O(n log n) for n vertices. Duplicate vertices are
+ * ignored. If all vertices are collinear, no triangles are created.
  */
-class Edge
+class DelaunayTriangulation
 {
     public:
         /**
-         * Copy constructor.
+         * Computes the Delaunay triangulation of a vector of vertices.
          *
-         * \param e The other edge, from which the data will be copied.
+         * \param vertices The vertices, which shall be triangulated.
          */
-        Edge(const Edge& e)
-        : m_pV0(e.v0()),
-          m_pV1(e.v1())
+        DelaunayTriangulation(const VertexVector & vertices)
+        :   m_vertices(vertices),
+            m_hull_start(0),
+            m_hash_size(0)
         {
+            triangulate();
         }
     
         /**
-         * Single argument constructor. Constructs an edge given two vertices.
+         * The number of triangles of the triangulation.
          *
-         * \param pV0 The first vertex.
-         * \param pV1 The second vertex.
+         * \return The number of triangles.
          */
-        Edge(const Vertex * pV0, const Vertex * pV1)
-        : m_pV0(pV0),
-          m_pV1(pV1)
+        unsigned int size() const
         {
+            return (unsigned int)(m_triangles.size()/3);
         }
     
         /**
-         * Smaller than comparison operator for edges.
+         * Const access to the vertex indices of all triangles (three per triangle).
          *
-         * \return True if the pointers/addresses are smaller.
+         * \return The vertex indices of the triangles.
          */
-        bool operator<(const Edge& e) const
+        const std::vector<int> & triangles() const
         {
-            if (m_pV0 == e.m_pV0)
-            {
-                return * m_pV1 < * e.m_pV1;
-            }
-            return * m_pV0 < * e.m_pV0;
+            return m_triangles;
         }
     
         /**
-         * Reading/Const access to the first vertex of the edge.
+         * Const access to the adjacency of the triangles. For each halfedge,
+         * the opposite halfedge or -1 at the convex hull is stored.
          *
-         * \return Const pointer to the first vertex.
+         * \return The opposite halfedges.
          */
-        const Vertex* v0() const
+        const std::vector<int> & halfedges() const
         {
-            return m_pV0;
+            return m_halfedges;
         }
     
+    private:
         /**
-         * Reading/Const access to the second vertex of the edge.
-         *
-         * \return Const pointer to the second vertex.
+         * The main triangulation procedure.
          */
-        const Vertex* v1() const
+        void triangulate()
         {
-            return m_pV1;
+            const int n = (int)m_vertices.size();
+            
+            if(n < 3)
+            {
+                return;
+            }
+            
+            //Determine the bounding box and its center
+            double  x_min = m_vertices[0][0], y_min = m_vertices[0][1],
+                    x_max = x_min,            y_max = y_min;
+            
+            for(const Vertex & v : m_vertices)
+            {
+                x_min = std::min(x_min, v[0]); y_min = std::min(y_min, v[1]);
+                x_max = std::max(x_max, v[0]); y_max = std::max(y_max, v[1]);
+            }
+            const Vertex center((x_min + x_max)/2, (y_min + y_max)/2);
+            
+            //Find the seed triangle: The vertex next to the center,
+            //its nearest neighbor and the vertex forming the smallest circumcircle with them
+            int i0 = -1, i1 = -1, i2 = -1;
+            double min_dist = std::numeric_limits<double>::max();
+            
+            for(int i=0; i<n; ++i)
+            {
+                double d = vigra::squaredNorm(m_vertices[i] - center);
+                if(d < min_dist)
+                {
+                    i0 = i;
+                    min_dist = d;
+                }
+            }
+            
+            min_dist = std::numeric_limits<double>::max();
+            
+            for(int i=0; i<n; ++i)
+            {
+                double d = vigra::squaredNorm(m_vertices[i] - m_vertices[i0]);
+                if(i != i0 && d < min_dist && d > 0)
+                {
+                    i1 = i;
+                    min_dist = d;
+                }
+            }
+            
+            double min_radius = std::numeric_limits<double>::max();
+            
+            for(int i=0; i<n && i1 != -1; ++i)
+            {
+                if(i == i0 || i == i1)
+                {
+                    continue;
+                }
+                
+                double r = circumradius(m_vertices[i0], m_vertices[i1], m_vertices[i]);
+                if(r < min_radius)
+                {
+                    i2 = i;
+                    min_radius = r;
+                }
+            }
+            
+            //All vertices are collinear (or equal): There is no triangle at all
+            if(i2 == -1 || min_radius == std::numeric_limits<double>::max())
+            {
+                return;
+            }
+            
+            if(orient(m_vertices[i0], m_vertices[i1], m_vertices[i2]))
+            {
+                std::swap(i1, i2);
+            }
+            
+            m_center = circumcenter(m_vertices[i0], m_vertices[i1], m_vertices[i2]);
+            
+            //Sort the vertices by their distance to the seed circumcenter
+            std::vector<int> ids(n);
+            std::vector<double> dists(n);
+            
+            for(int i=0; i<n; ++i)
+            {
+                ids[i] = i;
+                dists[i] = vigra::squaredNorm(m_vertices[i] - m_center);
+            }
+            std::sort(ids.begin(), ids.end(),
+                      [&dists](int a, int b)
+                      {
+                          return dists[a] < dists[b] || (dists[a] == dists[b] && a < b);
+                      });
+            
+            //Initialize the hull (a doubly linked list) by the seed triangle
+            m_hash_size = (int)std::ceil(std::sqrt((double)n));
+            m_hull_prev.assign(n, -1);
+            m_hull_next.assign(n, -1);
+            m_hull_tri.assign(n, -1);
+            m_hull_hash.assign(m_hash_size, -1);
+            
+            m_hull_start = i0;
+            
+            m_hull_next[i0] = m_hull_prev[i2] = i1;
+            m_hull_next[i1] = m_hull_prev[i0] = i2;
+            m_hull_next[i2] = m_hull_prev[i1] = i0;
+            
+            m_hull_tri[i0] = 0;
+            m_hull_tri[i1] = 1;
+            m_hull_tri[i2] = 2;
+            
+            m_hull_hash[hashKey(m_vertices[i0])] = i0;
+            m_hull_hash[hashKey(m_vertices[i1])] = i1;
+            m_hull_hash[hashKey(m_vertices[i2])] = i2;
+            
+            const unsigned int max_triangles = 2*n - 5;
+            m_triangles.reserve(3*max_triangles);
+            m_halfedges.reserve(3*max_triangles);
+            
+            addTriangle(i0, i1, i2, -1, -1, -1);
+            
+            const double eps = std::numeric_limits<double>::epsilon();
+            Vertex last;
+            
+            for(int k=0; k<n; ++k)
+            {
+                const int i = ids[k];
+                const Vertex & v = m_vertices[i];
+                
+                //Skip (near-)duplicate vertices
+                if(k > 0 && std::abs(v[0] - last[0]) <= eps && std::abs(v[1] - last[1]) <= eps)
+                {
+                    continue;
+                }
+                last = v;
+                
+                //Skip the seed triangle vertices
+                if(i == i0 || i == i1 || i == i2)
+                {
+                    continue;
+                }
+                
+                //Find a visible edge on the convex hull using the edge hash
+                int start = 0;
+                const int key = hashKey(v);
+                
+                for(int j=0; j<m_hash_size; ++j)
+                {
+                    start = m_hull_hash[(key + j) % m_hash_size];
+                    if(start != -1 && start != m_hull_next[start])
+                    {
+                        break;
+                    }
+                }
+                
+                start = m_hull_prev[start];
+                int e = start, q;
+                
+                while(q = m_hull_next[e], !orient(v, m_vertices[e], m_vertices[q]))
+                {
+                    e = q;
+                    if(e == start)
+                    {
+                        e = -1;
+                        break;
+                    }
+                }
+                
+                //Likely a near-duplicate vertex, skip it
+                if(e == -1)
+                {
+                    continue;
+                }
+                
+                //Add the first triangle from the vertex
+                int t = addTriangle(e, i, m_hull_next[e], -1, -1, m_hull_tri[e]);
+                
+                //Recursively flip triangles from the vertex until they satisfy the Delaunay condition
+                m_hull_tri[i] = legalize(t + 2);
+                m_hull_tri[e] = t;
+                
+                //Walk forward through the hull, adding more triangles and flipping recursively
+                int next = m_hull_next[e];
+                while(q = m_hull_next[next], orient(v, m_vertices[next], m_vertices[q]))
+                {
+                    t = addTriangle(next, i, q, m_hull_tri[i], -1, m_hull_tri[next]);
+                    m_hull_tri[i] = legalize(t + 2);
+                    m_hull_next[next] = next; //Mark as removed
+                    next = q;
+                }
+                
+                //Walk backward from the other side, adding more triangles and flipping
+                if(e == start)
+                {
+                    while(q = m_hull_prev[e], orient(v, m_vertices[q], m_vertices[e]))
+                    {
+                        t = addTriangle(q, i, e, -1, m_hull_tri[e], m_hull_tri[q]);
+                        legalize(t + 2);
+                        m_hull_tri[q] = t;
+                        m_hull_next[e] = e; //Mark as removed
+                        e = q;
+                    }
+                }
+                
+                //Update the hull indices
+                m_hull_start = m_hull_prev[i] = e;
+                m_hull_next[e] = m_hull_prev[next] = i;
+                m_hull_next[i] = next;
+                
+                //Save the two new edges in the hash table
+                m_hull_hash[hashKey(v)] = i;
+                m_hull_hash[hashKey(m_vertices[e])] = e;
+            }
+            
+            //Release the helpers of the construction
+            m_hull_prev.clear();
+            m_hull_next.clear();
+            m_hull_tri.clear();
+            m_hull_hash.clear();
+            m_edge_stack.clear();
         }
     
-    private:
-        /** first vertex **/
-        const Vertex * m_pV0;
-        /** second vertex **/
-        const Vertex * m_pV1;
-};
-
-/** The used edge set type **/
-typedef std::set<Edge> EdgeSet;
-
-/** Iterator over the used edge type **/
-typedef std::set<Edge>::iterator EdgeIterator;
-
-/** Const iterator over the used edge type **/
-typedef std::set<Edge>::const_iterator CEdgeIterator;
-
-/**
- * Function object to check whether a triangle has one of the vertices in SuperTriangle.
- * operator() returns true if it does.
- */
-class TriangleHasVertex
-{
-    public:
         /**
-         * Creates a function object to check whether a triangle has one of the vertices in SuperTriangle.
-         * 
-         * \param superTriangle The 'super triangle'.
+         * Restores the Delaunay condition by flipping the halfedge a
+         * (and all the edges, which become illegal by flipping) if necessary.
+         *
+         * \param a The halfedge to start with.
+         * \return The halfedge, which now points to the new vertex.
          */
-        TriangleHasVertex(const Vertex superTriangle[3])
-        : m_pSuperTriangle(superTriangle)
+        int legalize(int a)
         {
+            unsigned int i = 0;
+            int ar = 0;
+            
+            m_edge_stack.clear();
+            
+            while(true)
+            {
+                const int b  = m_halfedges[a];
+                const int a0 = a - a%3;
+                ar = a0 + (a + 2)%3;
+                
+                //Convex hull edge
+                if(b == -1)
+                {
+                    if(i == 0)
+                    {
+                        break;
+                    }
+                    a = m_edge_stack[--i];
+                    continue;
+                }
+                
+                const int b0 = b - b%3,
+                          al = a0 + (a + 1)%3,
+                          bl = b0 + (b + 2)%3;
+                
+                const int p0 = m_triangles[ar],
+                          pr = m_triangles[a],
+                          pl = m_triangles[al],
+                          p1 = m_triangles[bl];
+                
+                if(inCircle(m_vertices[p0], m_vertices[pr], m_vertices[pl], m_vertices[p1]))
+                {
+                    m_triangles[a] = p1;
+                    m_triangles[b] = p0;
+                    
+                    const int hbl = m_halfedges[bl];
+                    
+                    //Edge swapped on the other side of the hull (rare): Fix the halfedge reference
+                    if(hbl == -1)
+                    {
+                        int e = m_hull_start;
+                        do
+                        {
+                            if(m_hull_tri[e] == bl)
+                            {
+                                m_hull_tri[e] = a;
+                                break;
+                            }
+                            e = m_hull_prev[e];
+                        }
+                        while(e != m_hull_start);
+                    }
+                    
+                    link(a, hbl);
+                    link(b, m_halfedges[ar]);
+                    link(ar, bl);
+                    
+                    const int br = b0 + (b + 1)%3;
+                    
+                    if(i < m_edge_stack.size())
+                    {
+                        m_edge_stack[i] = br;
+                    }
+                    else
+                    {
+                        m_edge_stack.push_back(br);
+                    }
+                    ++i;
+                }
+                else
+                {
+                    if(i == 0)
+                    {
+                        break;
+                    }
+                    a = m_edge_stack[--i];
+                }
+            }
+            return ar;
         }
     
         /**
-         * Application of the function object on a triangle
+         * Links two opposite halfedges.
          *
-         * \param tri The triangle.
-         * \return true, if the triangle has one of the vertices in SuperTriangle.
+         * \param a The first halfedge.
+         * \param b The second halfedge, may be -1.
          */
-        bool operator()(const Triangle<double>& tri) const
+        void link(int a, int b)
         {
-            for (int i = 0; i < 3; i++)
+            m_halfedges[a] = b;
+            if(b != -1)
             {
-                const Vertex * p = tri.vertex(i);
-                if (p >= m_pSuperTriangle && p < (m_pSuperTriangle + 3))
-                {
-                    return true;
-                }
+                m_halfedges[b] = a;
             }
-            return false;
         }
     
-    private:
-        const Vertex * m_pSuperTriangle;
-};
-
-/**
- * Function object to check whether a triangle is 'completed', i.e. doesn't need to be checked
- * again in the algorithm, i.e. it won't be changed anymore.
- * Therefore it can be removed from the workset.
- * A triangle is completed if the circumcircle is completely to the left of the current vertex.
- * If a triangle is completed, it will be inserted in the output set, unless one or more of it's vertices
- * belong to the 'super triangle'.
- */
-class TriangleIsCompleted
-{
-    public:
         /**
-         * Create a function object to check whether a triangle is 'completed'.
+         * Adds a new triangle and links its halfedges.
          *
-         * \param itVertex      Vertex iterator
-         * \param output        The Triangle set
-         * \param superTriangle The 'super triangle'
+         * \param i0 The index of the first vertex.
+         * \param i1 The index of the second vertex.
+         * \param i2 The index of the third vertex.
+         * \param a The opposite halfedge of the first edge (or -1).
+         * \param b The opposite halfedge of the second edge (or -1).
+         * \param c The opposite halfedge of the third edge (or -1).
+         * \return The first halfedge of the new triangle.
          */
-        TriangleIsCompleted(CVIterator itVertex, TriangleSet& output, const Vertex superTriangle[3])
-        : m_itVertex(itVertex),
-          m_output(output),
-          m_pSuperTriangle(superTriangle)
+        int addTriangle(int i0, int i1, int i2, int a, int b, int c)
         {
+            const int t = (int)m_triangles.size();
+            
+            m_triangles.push_back(i0);
+            m_triangles.push_back(i1);
+            m_triangles.push_back(i2);
+            m_halfedges.resize(t + 3);
+            
+            link(t,     a);
+            link(t + 1, b);
+            link(t + 2, c);
+            
+            return t;
         }
     
         /**
-         * Application of the function object on a triangle
+         * Hashes a vertex by its (pseudo) angle around the seed circumcenter.
          *
-         * \param tri The triangle.
-         * \return true, if the triangle is completed.
+         * \param v The vertex.
+         * \return The hash key.
          */
-        bool operator()(const Triangle<double>& tri) const
+        int hashKey(const Vertex & v) const
         {
-            bool b = tri.isLeftOf(*m_itVertex);
-
-            if (b)
-            {
-                TriangleHasVertex thv(m_pSuperTriangle);
-                if (! thv(tri))
-                {
-                    m_output.insert(tri);
-                }
-            }
-            return b;
+            const double dx = v[0] - m_center[0],
+                         dy = v[1] - m_center[1];
+            
+            //Monotonically increases with the real angle, but does not need expensive trigonometry
+            const double p = dx / (std::abs(dx) + std::abs(dy)),
+                         a = (dy > 0 ? 3 - p : 1 + p) / 4;
+            
+            return (int)std::floor(a * m_hash_size) % m_hash_size;
         }
-
-    private:
-        /** The iterator of a vertex **/
-        CVIterator m_itVertex;
-        /** The triangle set **/
-        TriangleSet& m_output;
-        /** The super triangle **/
-        const Vertex * m_pSuperTriangle;
-};
-
-/**
- * Function object to check whether vertex is in circumcircle of triangle.
- * operator() returns true if it does.
- * The edges of a 'hot' triangle are stored in the EdgeSet edges.
- */
-class VertexIsInCircumCircle
-{
-    public:
+    
         /**
-         * Create a function object to check whether vertex is in circumcircle of triangle.
+         * Orientation test of three vertices.
          *
-         * \param itVertex Vertex iterator
-         * \param edges    A Set of edges
+         * \return True, if the vertices p, q, r are in clockwise order (y-axis up).
          */
-        VertexIsInCircumCircle(CVIterator itVertex, EdgeSet& edges) 
-        : m_itVertex(itVertex),
-          m_edges(edges)
-        {}
-        
+        static bool orient(const Vertex & p, const Vertex & q, const Vertex & r)
+        {
+            return (q[1] - p[1]) * (r[0] - q[0]) - (q[0] - p[0]) * (r[1] - q[1]) < 0;
+        }
+    
         /**
-         * Application of the function object on a triangle
+         * Test if the vertex p is inside the circumcircle of the vertices a, b, c.
          *
-         * \param tri The triangle.
-         * \return true, if the  vertex is in circumcircle of triangle.
+         * \return True, if p is inside the circumcircle.
          */
-        bool operator()(const Triangle<double>& tri) const
+        static bool inCircle(const Vertex & a, const Vertex & b, const Vertex & c, const Vertex & p)
         {
-            bool b = tri.cCEncompasses(*m_itVertex);
-
-            if (b)
-            {
-                handleEdge(tri.vertex(0), tri.vertex(1));
-                handleEdge(tri.vertex(1), tri.vertex(2));
-                handleEdge(tri.vertex(2), tri.vertex(0));
-            }
-            return b;
+            const double dx = a[0] - p[0], dy = a[1] - p[1],
+                         ex = b[0] - p[0], ey = b[1] - p[1],
+                         fx = c[0] - p[0], fy = c[1] - p[1];
+            
+            const double ap = dx*dx + dy*dy,
+                         bp = ex*ex + ey*ey,
+                         cp = fx*fx + fy*fy;
+            
+            return dx*(ey*cp - bp*fy) - dy*(ex*cp - bp*fx) + ap*(ex*fy - ey*fx) < 0;
         }
-    protected:
+    
         /**
-         * Endge handling: Creates new edges if neccessary.
+         * The squared circumradius of the triangle a, b, c.
          *
-         * \param p0 Pointer to a vertex.
-         * \param p1 Pointer to another vertex.
+         * \return The squared radius or the largest double for collinear vertices.
          */
-        void handleEdge(const Vertex * p0, const Vertex * p1) const
+        static double circumradius(const Vertex & a, const Vertex & b, const Vertex & c)
         {
-            const Vertex * pVertex0(NULL);
-            const Vertex * pVertex1(NULL);
-
-            // Create a normalized edge, in which the smallest vertex comes first.
-            if (* p0 < * p1)
-            {
-                pVertex0 = p0;
-                pVertex1 = p1;
-            }
-            else
-            {
-                pVertex0 = p1;
-                pVertex1 = p0;
-            }
-
-            Edge e(pVertex0, pVertex1);
-
-            // Check if this edge is already in the buffer
-            EdgeIterator found = m_edges.find(e);
-
-            if (found == m_edges.end())
-            {
-                m_edges.insert(e);		// no, it isn't, so insert
-            }
-            else
+            const double dx = b[0] - a[0], dy = b[1] - a[1],
+                         ex = c[0] - a[0], ey = c[1] - a[1];
+            
+            const double bl = dx*dx + dy*dy,
+                         cl = ex*ex + ey*ey,
+                         det = dx*ey - dy*ex;
+            
+            if(det == 0)
             {
-                m_edges.erase(found);							// yes, it is, so erase it to eliminate double edges
+                return std::numeric_limits<double>::max();
             }
+            
+            const double d = 0.5 / det,
+                         x = (ey*bl - dy*cl) * d,
+                         y = (dx*cl - ex*bl) * d;
+            
+            return x*x + y*y;
         }
-
-    private:
-        /** The iterator of a vertex **/
-        CVIterator m_itVertex;
-        /** The edge set **/
-        EdgeSet& m_edges;
+    
+        /**
+         * The circumcenter of the triangle a, b, c.
+         *
+         * \return The center of the circumcircle.
+         */
+        static Vertex circumcenter(const Vertex & a, const Vertex & b, const Vertex & c)
+        {
+            const double dx = b[0] - a[0], dy = b[1] - a[1],
+                         ex = c[0] - a[0], ey = c[1] - a[1];
+            
+            const double bl = dx*dx + dy*dy,
+                         cl = ex*ex + ey*ey,
+                         d  = 0.5 / (dx*ey - dy*ex);
+            
+            return Vertex(a[0] + (ey*bl - dy*cl) * d,
+                          a[1] + (dx*cl - ex*bl) * d);
+        }
+    
+        /** The triangulated vertices **/
+        const VertexVector & m_vertices;
+        /** The vertex indices of the triangles **/
+        std::vector<int> m_triangles;
+        /** The opposite halfedges **/
+        std::vector<int> m_halfedges;
+        
+        /** The circumcenter of the seed triangle **/
+        Vertex m_center;
+        /** The start of the convex hull during the construction **/
+        int m_hull_start;
+        /** The previous and next vertex on the hull and the hull triangles of each vertex **/
+        std::vector<int> m_hull_prev, m_hull_next, m_hull_tri;
+        /** The angular hash of the hull vertices and its size **/
+        std::vector<int> m_hull_hash;
+        int m_hash_size;
+        /** Stack of edges, which need to be legalized **/
+        std::vector<int> m_edge_stack;
 };
 
 /**
- * All class definitions above may now be compined to formulate
- * the well known Delaunay triangluation procedure.
+ * Delaunay triangulation of a vector of vertices. This is a thin wrapper
+ * around the DelaunayTriangulation class, which keeps the TriangleSet output.
+ * Use the DelaunayTriangulation class directly, if you need the vertex
+ * indices or the adjacency of the triangles.
  *
  * \param vertices Unconnected vector of vertices/point, which shall be
  *                 Delauny triangulated.
  * \param output The (final) set of triangles which hold pointers to the input
  *                vertices.
  */
-void delaunay_triangulation(const VertexVector& vertices, TriangleSet& output)
+inline void delaunay_triangulation(const VertexVector& vertices, TriangleSet& output)
 {
-	if (vertices.size() < 3)
-    {
-        return;	// nothing to handle
-    }
-	
-    // Determine the bounding box.
-	CVIterator itVertex = vertices.begin();
-
-	float xMin = (*itVertex)[0];
-	float yMin = (*itVertex)[1];
-	float xMax = xMin;
-	float yMax = yMin;
-
-	++itVertex;		// If we're here, we know that vertices is not empty.
-	for (; itVertex != vertices.end(); itVertex++)
-	{
-		xMax = (*itVertex)[0];	// Vertices are sorted along the x-axis, so the last one stored will be the biggest.
-		float y = (*itVertex)[1];
-		if (y < yMin)
-        {
-            yMin = y;
-        }
-		if (y > yMax)
-        {
-            yMax = y;
-        }
-	}
-
-	float dx = xMax - xMin;
-	float dy = yMax - yMin;
-
-	// Make the bounding box slightly bigger, just to feel safe.
-	float ddx = dx * 0.01F;
-	float ddy = dy * 0.01F;
-
-	xMin -= ddx;
-	xMax += ddx;
-	dx += 2 * ddx;
-
-	yMin -= ddy;
-	yMax += ddy;
-	dy += 2 * ddy;
-
-	// Create a 'super triangle', encompassing all the vertices. We choose an equilateral triangle with horizontal base.
-	// We could have made the 'super triangle' simply very big. However, the algorithm is quite sensitive to
-	// rounding errors, so it's better to make the 'super triangle' just big enough, like we do here.
-	Vertex vSuper[3];
+    DelaunayTriangulation triangulation(vertices);
     
-    float dMax = (dx > dy) ? dx : dy; 
-    float xMid = (xMax + xMin) / 2.0;
-    float yMid = (yMax + yMin) / 2.0; 
+    const std::vector<int> & triangles = triangulation.triangles();
     
-    vSuper[0] = Vertex(xMid - 20 * dMax, yMid - dMax); 
-    vSuper[1] = Vertex(xMid, yMid + 20 * dMax); 
-    vSuper[2] = Vertex(xMid + 20 * dMax,yMid - dMax);
-	
-    TriangleSet workset;
-	workset.insert(Triangle<>(vSuper));
-
-	for (itVertex = vertices.begin(); itVertex != vertices.end(); itVertex++)
-	{
-		// First, remove all 'completed' triangles from the workset.
-		// A triangle is 'completed' if its circumcircle is entirely to the left of the current vertex.
-		// Vertices are sorted in x-direction (the set container does this automagically).
-		// Unless they are part of the 'super triangle', copy the 'completed' triangles to the output.
-		// The algorithm also works without this step, but it is an important optimalization for bigger numbers of vertices.
-		// It makes the algorithm about five times faster for 2000 vertices, and for 10000 vertices,
-		// it's thirty times faster. For smaller numbers, the difference is negligible.
-		TIterator itEnd = remove_if(workset.begin(), workset.end(), TriangleIsCompleted(itVertex, output, vSuper));
-
-		EdgeSet edges;
-
-		// A triangle is 'hot' if the current vertex v is inside the circumcircle.
-		// Remove all hot triangles, but keep their edges.
-		itEnd = remove_if(workset.begin(), itEnd, VertexIsInCircumCircle(itVertex, edges));
-		workset.erase(itEnd, workset.end());	// remove_if doesn't actually remove; we have to do this explicitly.
-
-		// Create new triangles from the edges and the current vertex.
-		for (EdgeIterator it = edges.begin(); it != edges.end(); it++)
-        {
-			workset.insert(Triangle<>(it->v0(), it->v1(), & (* itVertex)));
-        }
-	}
-
-	// Finally, remove all the triangles belonging to the 'super triangle' and move the remaining
-	// triangles tot the output; remove_copy_if lets us do that in one go.
-	TIterator where = output.begin();
-	remove_copy_if(workset.begin(), workset.end(), std::inserter(output, where), TriangleHasVertex(vSuper));
+    for(unsigned int t=0; t<triangles.size(); t+=3)
+    {
+        output.insert(Triangle<>(&vertices[triangles[t]], &vertices[triangles[t+1]], &vertices[triangles[t+2]]));
+    }
 }
 
 /**
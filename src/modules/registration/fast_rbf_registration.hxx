@@ -0,0 +1,1125 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2008-2017 by Benjamin Seppke                 */
+/*       Cognitive Systems Group, University of Hamburg, Germany        */
+/*                                                                      */
+/*    This file is part of the GrAphical Image Processing Enviroment.   */
+/*    The GRAIPE Website may be found at:                               */
+/*        https://github.com/bseppke/graipe                             */
+/*    Please direct questions, bug reports, and contributions to        */
+/*    the GitHub page and use the methods provided there.               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef GRAIPE_REGISTRATION_FAST_RBF_REGISTRATION_HXX
+#define GRAIPE_REGISTRATION_FAST_RBF_REGISTRATION_HXX
+
+#include <vigra/tinyvector.hxx>
+#include <vigra/matrix.hxx>
+#include <vigra/linear_solve.hxx>
+#include <vigra/multi_array.hxx>
+#include <vigra/splineimageview.hxx>
+
+#include "core/parallel.hxx"
+#include "core/scheduler.hxx"
+
+#include <QtDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace graipe {
+
+/**
+ * @addtogroup graipe_registration
+ * @{
+ *
+ * @file
+ * @brief Header file for the fast radial basis function (RBF) registration
+ *
+ * The dense RBF registration of vigra solves an (N+3)x(N+3) system and evaluates
+ * all N basis functions at every pixel, which is not feasible for dense
+ * correspondences. This file provides an accelerated engine:
+ * - A treecode evaluates the sum of all basis functions in O(log N) per point.
+ *   Far away cells of a quadtree are replaced by Chebyshev interpolation
+ *   points (proxies), which works for every smooth radial basis function.
+ * - The weights are fitted by GMRES, which is preconditioned by the local
+ *   cardinal functions of each point's nearest neighbors.
+ * - The warping evaluates the transformation on a coarse grid only and
+ *   interpolates it bilinearly in between.
+ */
+
+/**
+ * Number of point correspondences, above which the GenericRegistration uses
+ * the fast RBF engine instead of the dense one.
+ */
+static const unsigned int fast_rbf_point_threshold = 1000;
+
+/**
+ * A treecode for the fast evaluation of sums of radial basis functions:
+ * f(t) = sum_j q_j * rbf(t, p_j)
+ * The points p_j are sorted into a quadtree. If a cell of the tree is far
+ * enough from t, the charges q_j of the cell are interpolated on order x order
+ * Chebyshev points of the cell, which are then used instead of the
+ * points themselves. The charges may be of any type, which supports
+ * addition and multiplication with a double, e.g. double or vigra::TinyVector.
+ */
+template <class RadialBasisFunctor>
+class RBFTreecode
+{
+    public:
+        /** The used point type **/
+        typedef vigra::TinyVector<double,2> PointType;
+    
+        /**
+         * Builds the treecode for a set of points.
+         *
+         * \param points The points. They need to stay valid as long as the treecode is used.
+         * \param rbf The radial basis function.
+         * \param order The number of Chebyshev points per dimension and cell.
+         * \param theta The opening criterion: A cell with radius r is far from t, if r < theta*|t-center|.
+         * \param leaf_size The maximal number of points in a leaf of the tree.
+         */
+        RBFTreecode(const std::vector<PointType> & points, const RadialBasisFunctor & rbf = RadialBasisFunctor(),
+                    unsigned int order=6, double theta=0.5, unsigned int leaf_size=64)
+        :   m_points(points),
+            m_rbf(rbf),
+            m_order(std::max(order, 2u)),
+            m_theta(theta),
+            m_leaf_size(std::max(leaf_size, 1u))
+        {
+            for(unsigned int k=0; k<m_order; ++k)
+            {
+                m_chebyshev.push_back(std::cos(M_PI*k/(m_order-1)));
+                m_barycentric.push_back(((k%2) ? -1.0 : 1.0) * ((k==0 || k==m_order-1) ? 0.5 : 1.0));
+            }
+            
+            if(points.empty())
+            {
+                return;
+            }
+            
+            m_indices.resize(points.size());
+            
+            PointType ul = points.front(), lr = points.front();
+            
+            for(unsigned int i=0; i<points.size(); ++i)
+            {
+                m_indices[i] = i;
+                ul = min(ul, points[i]);
+                lr = max(lr, points[i]);
+            }
+            
+            //The root (and thus each) cell is a square
+            double half_size = std::max(std::max(lr[0]-ul[0], lr[1]-ul[1])/2.0, 1.0)*1.0001;
+            
+            build(0, (unsigned int)points.size(), (ul+lr)/2.0, half_size, 0);
+        }
+    
+        /**
+         * Computes the charges of the Chebyshev proxies of all cells.
+         *
+         * \param charges The charges of the points.
+         * \param[out] proxy_charges The charges of the proxies.
+         */
+        template <class V>
+        void computeProxyCharges(const std::vector<V> & charges, std::vector<V> & proxy_charges) const
+        {
+            proxy_charges.assign(m_proxy_points.size(), V());
+            
+            const unsigned int blocks = std::max(Scheduler::instance()->threadCount(), 1u)*4;
+            
+            parallelFor(blocks,
+                        [&](unsigned int b)
+                        {
+                            std::vector<double> lx(m_order), ly(m_order);
+                            
+                            for(unsigned int n=b; n<m_nodes.size(); n+=blocks)
+                            {
+                                const Node & node = m_nodes[n];
+                                
+                                if(node.proxy_offset < 0)
+                                {
+                                    continue;
+                                }
+                                
+                                V* proxy = &proxy_charges[node.proxy_offset];
+                                
+                                for(unsigned int j=node.begin; j<node.end; ++j)
+                                {
+                                    const PointType & p = m_points[m_indices[j]];
+                                    const V & q = charges[m_indices[j]];
+                                    
+                                    lagrange((p[0]-node.center[0])/node.half_size, lx);
+                                    lagrange((p[1]-node.center[1])/node.half_size, ly);
+                                    
+                                    for(unsigned int k=0; k<m_order; ++k)
+                                    {
+                                        for(unsigned int l=0; l<m_order; ++l)
+                                        {
+                                            proxy[k*m_order+l] += q*(lx[k]*ly[l]);
+                                        }
+                                    }
+                                }
+                            }
+                        });
+        }
+    
+        /**
+         * Evaluates the sum of the radial basis functions at one point.
+         *
+         * \param target The point, where the sum shall be evaluated.
+         * \param charges The charges of the points.
+         * \param proxy_charges The charges of the proxies, see computeProxyCharges.
+         * \return The sum of the charges weighted by the radial basis function.
+         */
+        template <class V>
+        V evaluate(const PointType & target, const std::vector<V> & charges, const std::vector<V> & proxy_charges) const
+        {
+            V result = V();
+            
+            if(m_nodes.empty())
+            {
+                return result;
+            }
+            
+            //The depth is limited, so is the stack
+            int stack[4*MaxDepth+4];
+            unsigned int stack_size = 0;
+            stack[stack_size++] = 0;
+            
+            const double theta2 = m_theta*m_theta;
+            
+            while(stack_size != 0)
+            {
+                const Node & node = m_nodes[stack[--stack_size]];
+                
+                //Radius of the cell: sqrt(2)*half_size
+                if(     node.proxy_offset >= 0
+                    &&  2.0*node.half_size*node.half_size < theta2*squaredNorm(target - node.center))
+                {
+                    const unsigned int proxy_count = m_order*m_order;
+                    
+                    for(unsigned int k=0; k<proxy_count; ++k)
+                    {
+                        result += proxy_charges[node.proxy_offset + k]*m_rbf(target, m_proxy_points[node.proxy_offset + k]);
+                    }
+                }
+                else if(node.isLeaf())
+                {
+                    for(unsigned int j=node.begin; j<node.end; ++j)
+                    {
+                        result += charges[m_indices[j]]*m_rbf(target, m_points[m_indices[j]]);
+                    }
+                }
+                else
+                {
+                    for(unsigned int c=0; c<4; ++c)
+                    {
+                        if(node.children[c] != -1)
+                        {
+                            stack[stack_size++] = node.children[c];
+                        }
+                    }
+                }
+            }
+            return result;
+        }
+    
+        /**
+         * Evaluates the sum of the radial basis functions at many points in parallel.
+         *
+         * \param targets The points, where the sum shall be evaluated.
+         * \param charges The charges of the points.
+         * \param[out] results The sums at the targets.
+         */
+        template <class V>
+        void evaluate(const std::vector<PointType> & targets, const std::vector<V> & charges, std::vector<V> & results) const
+        {
+            std::vector<V> proxy_charges;
+            computeProxyCharges(charges, proxy_charges);
+            
+            results.resize(targets.size());
+            
+            const unsigned int block_size = 1024,
+                               blocks = ((unsigned int)targets.size() + block_size - 1)/block_size;
+            
+            parallelFor(blocks,
+                        [&](unsigned int b)
+                        {
+                            const unsigned int end = std::min((b+1)*block_size, (unsigned int)targets.size());
+                            
+                            for(unsigned int i=b*block_size; i<end; ++i)
+                            {
+                                results[i] = evaluate(targets[i], charges, proxy_charges);
+                            }
+                        });
+        }
+    
+        /**
+         * Finds the k nearest points to a given point.
+         *
+         * \param point The point.
+         * \param k The number of neighbors.
+         * \param[out] neighbors The indices of the (at most) k nearest points, sorted by distance.
+         */
+        void nearestNeighbors(const PointType & point, unsigned int k, std::vector<unsigned int> & neighbors) const
+        {
+            std::priority_queue<std::pair<double, unsigned int> > heap;
+            
+            if(!m_nodes.empty() && k != 0)
+            {
+                searchNeighbors(0, point, k, heap);
+            }
+            
+            neighbors.resize(heap.size());
+            
+            for(unsigned int i=(unsigned int)heap.size(); i!=0; --i)
+            {
+                neighbors[i-1] = heap.top().second;
+                heap.pop();
+            }
+        }
+    
+    private:
+        /** The maximal depth of the tree **/
+        static const unsigned int MaxDepth = 32;
+    
+        /**
+         * A (square) cell of the quadtree.
+         */
+        struct Node
+        {
+            /** The center of the cell **/
+            PointType center;
+            /** Half of the cell's side length **/
+            double half_size;
+            /** The range of the cell's points in m_indices **/
+            unsigned int begin, end;
+            /** The child cells (or -1 for empty quadrants) **/
+            int children[4];
+            /** Offset of the cell's proxies or -1, if the cell has too few points for proxies **/
+            int proxy_offset;
+            
+            /**
+             * \return True, if the cell has no children.
+             */
+            bool isLeaf() const
+            {
+                return children[0] == -1 && children[1] == -1 && children[2] == -1 && children[3] == -1;
+            }
+        };
+    
+        /**
+         * Recursively builds the quadtree for the range [begin,end) of m_indices.
+         *
+         * \return The index of the new node.
+         */
+        int build(unsigned int begin, unsigned int end, const PointType & center, double half_size, unsigned int depth)
+        {
+            Node node;
+            node.center = center;
+            node.half_size = half_size;
+            node.begin = begin;
+            node.end = end;
+            node.children[0] = node.children[1] = node.children[2] = node.children[3] = -1;
+            node.proxy_offset = -1;
+            
+            int n = (int)m_nodes.size();
+            m_nodes.push_back(node);
+            
+            //Proxies are only useful for cells with more points than proxies
+            if(end - begin > m_order*m_order)
+            {
+                m_nodes[n].proxy_offset = (int)m_proxy_points.size();
+                
+                for(unsigned int k=0; k<m_order; ++k)
+                {
+                    for(unsigned int l=0; l<m_order; ++l)
+                    {
+                        m_proxy_points.push_back(center + half_size*PointType(m_chebyshev[k], m_chebyshev[l]));
+                    }
+                }
+            }
+            
+            if(end - begin > m_leaf_size && depth < MaxDepth)
+            {
+                std::vector<unsigned int>::iterator first = m_indices.begin() + begin,
+                                                    last  = m_indices.begin() + end;
+                
+                std::vector<unsigned int>::iterator mid_y  = std::partition(first, last,  [&](unsigned int i){ return m_points[i][1] < center[1]; }),
+                                                    mid_x0 = std::partition(first, mid_y, [&](unsigned int i){ return m_points[i][0] < center[0]; }),
+                                                    mid_x1 = std::partition(mid_y, last,  [&](unsigned int i){ return m_points[i][0] < center[0]; });
+                
+                std::vector<unsigned int>::iterator bounds[5] = {first, mid_x0, mid_y, mid_x1, last};
+                
+                for(unsigned int c=0; c<4; ++c)
+                {
+                    if(bounds[c] != bounds[c+1])
+                    {
+                        PointType offset((c%2) ? half_size/2 : -half_size/2,
+                                         (c/2) ? half_size/2 : -half_size/2);
+                        
+                        int child = build((unsigned int)(bounds[c]   - m_indices.begin()),
+                                          (unsigned int)(bounds[c+1] - m_indices.begin()),
+                                          center + offset, half_size/2, depth+1);
+                        m_nodes[n].children[c] = child;
+                    }
+                }
+            }
+            return n;
+        }
+    
+        /**
+         * Computes the Lagrange polynomials of the Chebyshev points at a position
+         * by means of the barycentric formula.
+         *
+         * \param u The position in [-1,1].
+         * \param[out] l The values of all m_order Lagrange polynomials.
+         */
+        void lagrange(double u, std::vector<double> & l) const
+        {
+            double sum = 0;
+            
+            for(unsigned int k=0; k<m_order; ++k)
+            {
+                double diff = u - m_chebyshev[k];
+                
+                if(std::abs(diff) < 1.0e-14)
+                {
+                    std::fill(l.begin(), l.end(), 0.0);
+                    l[k] = 1;
+                    return;
+                }
+                l[k] = m_barycentric[k]/diff;
+                sum += l[k];
+            }
+            
+            for(unsigned int k=0; k<m_order; ++k)
+            {
+                l[k] /= sum;
+            }
+        }
+    
+        /**
+         * Recursive nearest neighbor search.
+         */
+        void searchNeighbors(int n, const PointType & point, unsigned int k, std::priority_queue<std::pair<double, unsigned int> > & heap) const
+        {
+            const Node & node = m_nodes[n];
+            
+            double dx = std::max(std::abs(point[0] - node.center[0]) - node.half_size, 0.0),
+                   dy = std::max(std::abs(point[1] - node.center[1]) - node.half_size, 0.0);
+            
+            if(heap.size() == k && dx*dx + dy*dy >= heap.top().first)
+            {
+                return;
+            }
+            
+            if(node.isLeaf())
+            {
+                for(unsigned int j=node.begin; j<node.end; ++j)
+                {
+                    double d2 = squaredNorm(point - m_points[m_indices[j]]);
+                    
+                    if(heap.size() < k)
+                    {
+                        heap.push(std::make_pair(d2, m_indices[j]));
+                    }
+                    else if(d2 < heap.top().first)
+                    {
+                        heap.pop();
+                        heap.push(std::make_pair(d2, m_indices[j]));
+                    }
+                }
+            }
+            else
+            {
+                //Visit the nearest children first
+                std::pair<double, int> children[4];
+                unsigned int count = 0;
+                
+                for(unsigned int c=0; c<4; ++c)
+                {
+                    if(node.children[c] != -1)
+                    {
+                        children[count++] = std::make_pair(squaredNorm(point - m_nodes[node.children[c]].center), node.children[c]);
+                    }
+                }
+                std::sort(children, children+count);
+                
+                for(unsigned int c=0; c<count; ++c)
+                {
+                    searchNeighbors(children[c].second, point, k, heap);
+                }
+            }
+        }
+    
+        /** The points **/
+        const std::vector<PointType> & m_points;
+        /** The radial basis function **/
+        RadialBasisFunctor m_rbf;
+        /** The number of Chebyshev points per dimension **/
+        unsigned int m_order;
+        /** The opening criterion **/
+        double m_theta;
+        /** The maximal number of points per leaf **/
+        unsigned int m_leaf_size;
+        /** The Chebyshev points in [-1,1] and their barycentric weights **/
+        std::vector<double> m_chebyshev, m_barycentric;
+        /** The point indices sorted by the cells **/
+        std::vector<unsigned int> m_indices;
+        /** The cells of the tree, the root is the first one **/
+        std::vector<Node> m_nodes;
+        /** The proxy points of all cells **/
+        std::vector<PointType> m_proxy_points;
+};
+
+/**
+ * A radial basis function transformation, which is fitted and evaluated by
+ * means of the RBFTreecode. Like vigra's rbfMatrix2DFromCorrespondingPoints,
+ * it maps from the destination (reference) points d to the source points s:
+ * T(x) = a_0 + a_1*x + a_2*y + sum_j w_j * rbf(x, d_j)
+ * with sum_j w_j = sum_j w_j*d_j = 0.
+ *
+ * The (N+3)x(N+3) interpolation system is never built. It is solved by restarted
+ * GMRES with the treecode as matrix-vector product. As (right) preconditioner
+ * the local cardinal functions are used: For each point, the interpolation
+ * problem on its nearest neighbors with a one at the point and zeros at the
+ * neighbors is solved. These coefficients already fulfill the side conditions,
+ * and make the preconditioned system close to the identity. Since the cardinal
+ * functions span only an (N-3)-dimensional space, three points do not get one.
+ * Their unknowns are replaced by the three coefficients of the affine part,
+ * which results in a regular NxN system.
+ */
+template <class RadialBasisFunctor>
+class FastRBFTransformation
+{
+    public:
+        /** The used point type **/
+        typedef vigra::TinyVector<double,2> PointType;
+    
+        /**
+         * Fits the transformation to a set of point correspondences.
+         *
+         * \param s     The begin() iterator of the source points.
+         * \param s_end The end() iterator of the source points.
+         * \param d     The begin() iterator of the corresponding dest points.
+         * \param rbf   The radial basis function.
+         * \param tolerance The relative residual, at which the iterative fitting stops.
+         * \param max_iterations The maximal number of GMRES iterations per coordinate.
+         * \param neighbors The number of nearest neighbors of the local cardinal functions.
+         */
+        template <class SrcPointIterator, class DestPointIterator>
+        FastRBFTransformation(SrcPointIterator s, SrcPointIterator s_end, DestPointIterator d,
+                              const RadialBasisFunctor & rbf = RadialBasisFunctor(),
+                              double tolerance = 1.0e-5, unsigned int max_iterations = 500, unsigned int neighbors = 32)
+        :   m_points(d, d + (s_end - s)),
+            m_tree(m_points, rbf),
+            m_rbf(rbf),
+            m_tolerance(tolerance),
+            m_max_iterations(max_iterations)
+        {
+            const unsigned int point_count = (unsigned int)m_points.size();
+            
+            vigra_precondition(point_count >= 3, "FastRBFTransformation: At least three point correspondences are needed.");
+            
+            //Center and scale the coordinates of the affine part
+            PointType ul = m_points.front(), lr = m_points.front();
+            for(const PointType & p : m_points)
+            {
+                ul = min(ul, p);
+                lr = max(lr, p);
+            }
+            m_origin = (ul + lr)/2.0;
+            m_scale = std::max(std::max(lr[0]-ul[0], lr[1]-ul[1])/2.0, 1.0);
+            
+            findAffinePoints();
+            computePreconditioner(std::min(neighbors, point_count));
+            
+            std::vector<double> rhs(point_count, 0.0);
+            std::vector<double> coefficients[2];
+            
+            for(unsigned int dim=0; dim<2; ++dim)
+            {
+                for(unsigned int i=0; i<point_count; ++i)
+                {
+                    rhs[i] = s[i][dim];
+                }
+                
+                if(!gmres(rhs, coefficients[dim]))
+                {
+                    qWarning() << "FastRBFTransformation: GMRES did not converge for coordinate" << dim;
+                }
+            }
+            
+            //Transform the solution back
+            std::vector<double> weights_x, weights_y;
+            precondition(coefficients[0], weights_x);
+            precondition(coefficients[1], weights_y);
+            
+            m_weights.resize(point_count);
+            for(unsigned int i=0; i<point_count; ++i)
+            {
+                m_weights[i] = PointType(weights_x[i], weights_y[i]);
+            }
+            for(unsigned int k=0; k<3; ++k)
+            {
+                m_affine[k] = PointType(coefficients[0][m_affine_points[k]], coefficients[1][m_affine_points[k]]);
+            }
+            
+            m_tree.computeProxyCharges(m_weights, m_proxy_weights);
+        }
+    
+        /**
+         * Transforms a single point.
+         *
+         * \param p The point (in destination coordinates).
+         * \return The transformed point (in source coordinates).
+         */
+        PointType operator()(const PointType & p) const
+        {
+            return affine(p) + m_tree.evaluate(p, m_weights, m_proxy_weights);
+        }
+    
+        /**
+         * Transforms many points in parallel.
+         *
+         * \param points The points (in destination coordinates).
+         * \param[out] results The transformed points (in source coordinates).
+         */
+        void transform(const std::vector<PointType> & points, std::vector<PointType> & results) const
+        {
+            m_tree.evaluate(points, m_weights, results);
+            
+            for(unsigned int i=0; i<points.size(); ++i)
+            {
+                results[i] += affine(points[i]);
+            }
+        }
+    
+    private:
+        /**
+         * Evaluates the affine part of the transformation.
+         */
+        PointType affine(const PointType & p) const
+        {
+            PointType u = (p - m_origin)/m_scale;
+            return m_affine[0] + m_affine[1]*u[0] + m_affine[2]*u[1];
+        }
+    
+        /**
+         * Selects three points, which do not get a cardinal function, but carry the
+         * unknowns of the affine part: The leftmost and rightmost points and the point,
+         * which forms the largest triangle with them.
+         */
+        void findAffinePoints()
+        {
+            unsigned int i0 = 0, i1 = 0, i2 = 0;
+            
+            for(unsigned int i=0; i<m_points.size(); ++i)
+            {
+                if(m_points[i] < m_points[i0])
+                {
+                    i0 = i;
+                }
+                if(m_points[i1] < m_points[i])
+                {
+                    i1 = i;
+                }
+            }
+            
+            double max_area = -1;
+            
+            for(unsigned int i=0; i<m_points.size(); ++i)
+            {
+                PointType e1 = m_points[i1] - m_points[i0],
+                          e2 = m_points[i]  - m_points[i0];
+                double area = std::abs(e1[0]*e2[1] - e1[1]*e2[0]);
+                
+                if(i != i0 && i != i1 && area > max_area)
+                {
+                    i2 = i;
+                    max_area = area;
+                }
+            }
+            
+            vigra_precondition(max_area > 0, "FastRBFTransformation: All points are collinear.");
+            
+            m_affine_points[0] = i0;
+            m_affine_points[1] = i1;
+            m_affine_points[2] = i2;
+        }
+    
+        /**
+         * Tests if a point carries one of the unknowns of the affine part.
+         *
+         * \param i The index of the point.
+         * 
+eturn True, if the point is one of the three selected points.
+         */
+        bool isAffinePoint(unsigned int i) const
+        {
+            return i == m_affine_points[0] || i == m_affine_points[1] || i == m_affine_points[2];
+        }
+    
+        /**
+         * Computes the local cardinal functions of all points. Each local problem consists
+         * of the nearest neighbors of the point and a few well-spread coarse points, which
+         * let the cardinal functions also decay far away from the point. Without them, the
+         * number of iterations would grow with the number of points.
+         *
+         * \param neighbors The number of nearest neighbors for each point.
+         */
+        void computePreconditioner(unsigned int neighbors)
+        {
+            const unsigned int point_count = (unsigned int)m_points.size();
+            
+            //The coarse points are the points nearest to a coarse_grid x coarse_grid grid,
+            //which grows slowly with the number of points (5x5 ... 10x10)
+            const unsigned int coarse_grid = std::min(std::max((unsigned int)std::sqrt(std::sqrt((double)point_count)), 5u), 10u);
+            
+            std::vector<unsigned int> coarse, nb;
+            
+            if(point_count > neighbors)
+            {
+                const double cell_size = 2*m_scale/coarse_grid;
+                
+                for(unsigned int gy=0; gy<coarse_grid; ++gy)
+                {
+                    for(unsigned int gx=0; gx<coarse_grid; ++gx)
+                    {
+                        PointType p = m_origin + PointType((gx+0.5)*cell_size - m_scale, (gy+0.5)*cell_size - m_scale);
+                        
+                        m_tree.nearestNeighbors(p, 1, nb);
+                        
+                        if(!nb.empty() && std::find(coarse.begin(), coarse.end(), nb[0]) == coarse.end())
+                        {
+                            coarse.push_back(nb[0]);
+                        }
+                    }
+                }
+            }
+            
+            const unsigned int stencil_size = neighbors + (unsigned int)coarse.size();
+            
+            m_stencil_size = stencil_size;
+            m_precond_indices.assign(point_count*stencil_size, 0);
+            m_precond_coefficients.assign(point_count*stencil_size, 0.0);
+            
+            const unsigned int block_size = 256,
+                               blocks = (point_count + block_size - 1)/block_size;
+            
+            parallelFor(blocks,
+                        [&](unsigned int b)
+                        {
+                            std::vector<unsigned int> nb;
+                            
+                            for(unsigned int i=b*block_size; i<std::min((b+1)*block_size, point_count); ++i)
+                            {
+                                //The affine points do not get a cardinal function
+                                if(isAffinePoint(i))
+                                {
+                                    continue;
+                                }
+                                
+                                m_tree.nearestNeighbors(m_points[i], neighbors, nb);
+                                
+                                for(unsigned int c : coarse)
+                                {
+                                    if(std::find(nb.begin(), nb.end(), c) == nb.end())
+                                    {
+                                        nb.push_back(c);
+                                    }
+                                }
+                                
+                                const unsigned int m = (unsigned int)nb.size();
+                                
+                                unsigned int * indices = &m_precond_indices[i*stencil_size];
+                                double * coefficients = &m_precond_coefficients[i*stencil_size];
+                                
+                                std::copy(nb.begin(), nb.end(), indices);
+                                
+                                vigra::Matrix<double> L(m+3, m+3, 0.0), rhs(m+3, 1, 0.0), c(m+3, 1, 0.0);
+                                
+                                double local_scale = 0, kernel_scale = 0;
+                                
+                                for(unsigned int a=0; a<m; ++a)
+                                {
+                                    local_scale = std::max(local_scale, squaredNorm(m_points[nb[a]] - m_points[i]));
+                                    
+                                    for(unsigned int k=0; k<a; ++k)
+                                    {
+                                        L(a,k) = L(k,a) = m_rbf(m_points[nb[a]], m_points[nb[k]]);
+                                        kernel_scale = std::max(kernel_scale, std::abs(L(a,k)));
+                                    }
+                                    
+                                    if(nb[a] == i)
+                                    {
+                                        rhs(a,0) = 1;
+                                    }
+                                }
+                                
+                                //Scaling the side conditions does not change the cardinal function,
+                                //but balances the system for the solver
+                                local_scale = std::max(std::sqrt(local_scale), 1.0e-10);
+                                kernel_scale = std::max(kernel_scale, 1.0e-10);
+                                
+                                for(unsigned int a=0; a<m; ++a)
+                                {
+                                    PointType u = (m_points[nb[a]] - m_points[i])/local_scale;
+                                    
+                                    L(a,m)   = L(m,a)   = kernel_scale;
+                                    L(a,m+1) = L(m+1,a) = kernel_scale*u[0];
+                                    L(a,m+2) = L(m+2,a) = kernel_scale*u[1];
+                                }
+                                
+                                if(vigra::linearSolve(L, rhs, c))
+                                {
+                                    for(unsigned int a=0; a<m; ++a)
+                                    {
+                                        coefficients[a] = c(a,0);
+                                    }
+                                }
+                                else
+                                {
+                                    //Degenerated neighborhood (e.g. collinear): No preconditioning for this point
+                                    std::fill(coefficients, coefficients + stencil_size, 0.0);
+                                    indices[0] = i;
+                                    coefficients[0] = 1;
+                                }
+                            }
+                        });
+        }
+    
+        /**
+         * Applies the preconditioner to a vector. The entries of the affine points are skipped.
+         *
+         * \param z The vector (size N).
+         * \param[out] weights The resulting RBF weights (size N).
+         */
+        void precondition(const std::vector<double> & z, std::vector<double> & weights) const
+        {
+            const unsigned int point_count = (unsigned int)m_points.size();
+            
+            weights.assign(point_count, 0.0);
+            
+            for(unsigned int i=0; i<point_count; ++i)
+            {
+                if(isAffinePoint(i))
+                {
+                    continue;
+                }
+                
+                for(unsigned int a=0; a<m_stencil_size; ++a)
+                {
+                    weights[m_precond_indices[i*m_stencil_size + a]] += m_precond_coefficients[i*m_stencil_size + a]*z[i];
+                }
+            }
+        }
+    
+        /**
+         * Applies the preconditioned interpolation system to a vector.
+         *
+         * \param z The vector (size N).
+         * \param[out] result The result (size N).
+         */
+        void applySystem(const std::vector<double> & z, std::vector<double> & result) const
+        {
+            const unsigned int point_count = (unsigned int)m_points.size();
+            
+            std::vector<double> weights;
+            precondition(z, weights);
+            
+            m_tree.evaluate(m_points, weights, result);
+            
+            const double a0 = z[m_affine_points[0]],
+                         a1 = z[m_affine_points[1]],
+                         a2 = z[m_affine_points[2]];
+            
+            for(unsigned int i=0; i<point_count; ++i)
+            {
+                PointType u = (m_points[i] - m_origin)/m_scale;
+                result[i] += a0 + a1*u[0] + a2*u[1];
+            }
+        }
+    
+        /**
+         * Solves the preconditioned interpolation system by restarted GMRES.
+         *
+         * \param b The right hand side.
+         * \param[out] x The solution.
+         * \param restart The number of iterations before a restart.
+         * \return True, if the relative residual dropped below the tolerance.
+         */
+        bool gmres(const std::vector<double> & b, std::vector<double> & x, unsigned int restart=50) const
+        {
+            const unsigned int n = (unsigned int)b.size();
+            
+            x.assign(n, 0.0);
+            
+            const double b_norm = norm(b);
+            
+            if(b_norm == 0)
+            {
+                return true;
+            }
+            
+            std::vector<std::vector<double> > v(restart+1);
+            std::vector<std::vector<double> > h(restart+1, std::vector<double>(restart, 0.0));
+            std::vector<double> cs(restart), sn(restart), g(restart+1), r, w;
+            
+            unsigned int iterations = 0;
+            
+            while(true)
+            {
+                applySystem(x, r);
+                for(unsigned int i=0; i<n; ++i)
+                {
+                    r[i] = b[i] - r[i];
+                }
+                
+                double beta = norm(r);
+                
+                if(beta <= m_tolerance*b_norm)
+                {
+                    return true;
+                }
+                if(iterations >= m_max_iterations)
+                {
+                    qDebug() << "FastRBFTransformation: Relative residual after" << iterations << "iterations:" << beta/b_norm;
+                    return false;
+                }
+                
+                v[0].resize(n);
+                for(unsigned int i=0; i<n; ++i)
+                {
+                    v[0][i] = r[i]/beta;
+                }
+                std::fill(g.begin(), g.end(), 0.0);
+                g[0] = beta;
+                
+                unsigned int k = 0;
+                
+                for(unsigned int j=0; j<restart && iterations<m_max_iterations; ++j)
+                {
+                    //Arnoldi step with modified Gram-Schmidt
+                    applySystem(v[j], w);
+                    
+                    for(unsigned int i=0; i<=j; ++i)
+                    {
+                        h[i][j] = dot(w, v[i]);
+                        for(unsigned int l=0; l<n; ++l)
+                        {
+                            w[l] -= h[i][j]*v[i][l];
+                        }
+                    }
+                    h[j+1][j] = norm(w);
+                    
+                    v[j+1].resize(n);
+                    for(unsigned int l=0; l<n; ++l)
+                    {
+                        v[j+1][l] = (h[j+1][j] != 0) ? w[l]/h[j+1][j] : 0.0;
+                    }
+                    
+                    //Apply the previous and a new Givens rotation
+                    for(unsigned int i=0; i<j; ++i)
+                    {
+                        double tmp = cs[i]*h[i][j] + sn[i]*h[i+1][j];
+                        h[i+1][j]  = -sn[i]*h[i][j] + cs[i]*h[i+1][j];
+                        h[i][j]    = tmp;
+                    }
+                    
+                    double denom = std::sqrt(h[j][j]*h[j][j] + h[j+1][j]*h[j+1][j]);
+                    cs[j] = (denom != 0) ? h[j][j]/denom : 1.0;
+                    sn[j] = (denom != 0) ? h[j+1][j]/denom : 0.0;
+                    
+                    h[j][j]   = denom;
+                    h[j+1][j] = 0;
+                    g[j+1] = -sn[j]*g[j];
+                    g[j]   =  cs[j]*g[j];
+                    
+                    ++iterations;
+                    k = j+1;
+                    
+                    if(std::abs(g[j+1]) <= m_tolerance*b_norm || denom == 0)
+                    {
+                        break;
+                    }
+                }
+                
+                //Solve the upper triangular system and update the solution
+                std::vector<double> y(k, 0.0);
+                
+                for(int i=(int)k-1; i>=0; --i)
+                {
+                    y[i] = g[i];
+                    for(unsigned int l=i+1; l<k; ++l)
+                    {
+                        y[i] -= h[i][l]*y[l];
+                    }
+                    y[i] = (h[i][i] != 0) ? y[i]/h[i][i] : 0.0;
+                }
+                
+                for(unsigned int i=0; i<k; ++i)
+                {
+                    for(unsigned int l=0; l<n; ++l)
+                    {
+                        x[l] += y[i]*v[i][l];
+                    }
+                }
+            }
+        }
+    
+        /**
+         * Dot product of two vectors.
+         */
+        static double dot(const std::vector<double> & a, const std::vector<double> & b)
+        {
+            double result = 0;
+            for(unsigned int i=0; i<a.size(); ++i)
+            {
+                result += a[i]*b[i];
+            }
+            return result;
+        }
+    
+        /**
+         * Euclidean norm of a vector.
+         */
+        static double norm(const std::vector<double> & a)
+        {
+            return std::sqrt(dot(a, a));
+        }
+    
+        /** The destination points **/
+        std::vector<PointType> m_points;
+        /** The treecode on the destination points **/
+        RBFTreecode<RadialBasisFunctor> m_tree;
+        /** The radial basis function **/
+        RadialBasisFunctor m_rbf;
+        /** Stopping criteria of the fitting **/
+        double m_tolerance;
+        unsigned int m_max_iterations;
+        /** Center and scale of the affine part **/
+        PointType m_origin;
+        double m_scale;
+        /** The points, which carry the unknowns of the affine part **/
+        unsigned int m_affine_points[3];
+        /** The local cardinal functions (m_stencil_size per point) **/
+        unsigned int m_stencil_size;
+        std::vector<unsigned int> m_precond_indices;
+        std::vector<double> m_precond_coefficients;
+        /** The fitted RBF weights and their proxy weights **/
+        std::vector<PointType> m_weights, m_proxy_weights;
+        /** The fitted affine part **/
+        PointType m_affine[3];
+};
+
+/**
+ * Warps an image by means of a FastRBFTransformation. The transformation is only
+ * evaluated on a grid with the given spacing and bilinearly interpolated in between.
+ * Since RBF transformations are smooth, this is a good approximation for small spacings.
+ * The rows are processed in parallel.
+ *
+ * \param src The source image.
+ * \param dest The destination image.
+ * \param transformation The transformation from destination to source coordinates.
+ * \param grid_spacing The spacing of the evaluation grid, 1 evaluates at each pixel.
+ */
+template <int ORDER, class T1, class T2, class RadialBasisFunctor>
+void fastRbfWarpImage(const vigra::SplineImageView<ORDER, T1> & src, vigra::MultiArrayView<2, T2> dest,
+                      const FastRBFTransformation<RadialBasisFunctor> & transformation, unsigned int grid_spacing=4)
+{
+    typedef vigra::TinyVector<double,2> PointType;
+    
+    const int width = dest.width(), height = dest.height();
+    
+    if(width == 0 || height == 0)
+    {
+        return;
+    }
+    
+    const int spacing = std::max(grid_spacing, 1u);
+    
+    //The grid covers the whole image
+    const int grid_width  = (width  - 1)/spacing + 2,
+              grid_height = (height - 1)/spacing + 2;
+    
+    std::vector<PointType> grid_points(grid_width*grid_height), grid_values;
+    
+    for(int gy=0; gy<grid_height; ++gy)
+    {
+        for(int gx=0; gx<grid_width; ++gx)
+        {
+            grid_points[gy*grid_width + gx] = PointType(gx*spacing, gy*spacing);
+        }
+    }
+    
+    transformation.transform(grid_points, grid_values);
+    
+    const unsigned int blocks = std::min((unsigned int)height, std::max(Scheduler::instance()->threadCount(), 1u));
+    
+    parallelFor(blocks,
+                [&](unsigned int b)
+                {
+                    //SplineImageViews cache the last coefficients and are thus not thread-safe
+                    vigra::SplineImageView<ORDER, T1> block_src(src);
+                    
+                    for(int y=b*height/blocks; y<(int)((b+1)*height/blocks); ++y)
+                    {
+                        const int gy = y/spacing;
+                        const double fy = double(y - gy*spacing)/spacing;
+                        
+                        for(int x=0; x<width; ++x)
+                        {
+                            const int gx = x/spacing;
+                            const double fx = double(x - gx*spacing)/spacing;
+                            
+                            const PointType * row0 = &grid_values[gy*grid_width + gx],
+                                            * row1 = row0 + grid_width;
+                            
+                            PointType p = (1-fy)*((1-fx)*row0[0] + fx*row0[1])
+                                        +    fy *((1-fx)*row1[0] + fx*row1[1]);
+                            
+                            if(block_src.isInside(p[0], p[1]))
+                            {
+                                dest(x,y) = block_src(p[0], p[1]);
+                            }
+                        }
+                    }
+                });
+}
+
+/**
+ * @}
+ */
+
+} //end of namespace graipe
+
+#endif //GRAIPE_REGISTRATION_FAST_RBF_REGISTRATION_HXX
@@ -50,6 +50,14 @@
 
 #include "registration/delaunay.hxx"
 
+#include "core/parallel.hxx"
+#include "core/scheduler.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 namespace graipe {
 
 /**
@@ -66,20 +74,65 @@ typedef Vertex PointType;
 /** The used type for triangles **/
 typedef Triangle<double> TriangleType;
 
+/**
+ * A triangle of a piecewise affine transformation together with its affine
+ * transformation. The vertices are stored by value in the coordinates of the
+ * destination image, the transformation maps from the destination into the
+ * source image (as needed for warping).
+ */
+struct TriangleTransformation
+{
+    /** The vertices of the triangle (destination image coordinates) **/
+    PointType vertices[3];
+    /** The affine transformation (3x3) from destination to source coordinates **/
+    vigra::Matrix<double> transformation;
+    
+    /**
+     * Tests if a point is inside the triangle. Points on the edges are also
+     * considered to be inside.
+     *
+     * \param point The point to be checked.
+     * \return True, if the point is inside the triangle.
+     */
+    bool isInside(const PointType & point) const
+    {
+        // Compute direction vectors
+        PointType v0 = vertices[2] - vertices[0],
+                  v1 = vertices[1] - vertices[0],
+                  v2 = point       - vertices[0];
+        
+        // Compute dot products
+        double	dot00 = dot(v0, v0),
+                dot01 = dot(v0, v1),
+                dot02 = dot(v0, v2),
+                dot11 = dot(v1, v1),
+                dot12 = dot(v1, v2);
+        
+        // Compute barycentric coordinates
+        double	invDenom = 1.0 / (dot00 * dot11 - dot01 * dot01),
+                       u = (dot11 * dot02 - dot01 * dot12) * invDenom,
+                       v = (dot00 * dot12 - dot01 * dot02) * invDenom;
+        
+        // Check if point is in triangle
+        return (u >= 0) && (v >= 0) && (u + v <= 1);
+    }
+};
+
 /** The used triangle transformation type **/
-typedef std::pair<TriangleType, vigra::Matrix<double> > TriangleTransformationType;
+typedef TriangleTransformation TriangleTransformationType;
 
 
 /**
  * This function computes the piecewise affine transmations for a set of points
- * It first Delaunay triangluates the source points and uses the same triangle structure on
- * source and target points. 
- * For each of the triangles, it computes the affine matrix.
+ * It first Delaunay triangluates the source points (in O(n log n), see DelaunayTriangulation)
+ * and uses the same triangle structure on source and target points. 
+ * For each of the triangles, it computes the affine matrix. Degenerated triangles
+ * (without area in the destination) are skipped.
  *
  * \param s     The begin() iterator of the source points.
  * \param s_end The end() iterator of the source points.
  * \param d    The begin() iterator of the corresponding dest points.
- * \return A Vector containing pairs of triangles and affine transformation matrices.
+ * \return A Vector containing the (destination) triangles and their affine transformation matrices.
  */
 template <class SrcPointIterator, class DestPointIterator>
 std::vector<TriangleTransformationType> computePiecewiseAffineTransformations(SrcPointIterator s, SrcPointIterator s_end, DestPointIterator d)
@@ -87,39 +140,196 @@ std::vector<TriangleTransformationType> computePiecewiseAffineTransformations(Sr
     unsigned int point_count = (unsigned int)(s_end - s);
     
     VertexVector vertices(point_count);
-    TriangleSet triangles;
     
-    unsigned int i=0;
-    
-    for (i=0; i<point_count;++i)
+    for(unsigned int i=0; i<point_count; ++i)
     {
-        vertices[i] = Vertex((float)s[i][0], (float)s[i][1]);
+        vertices[i] = Vertex(s[i][0], s[i][1]);
     }
     
-    delaunay_triangulation(vertices, triangles);
+    //Use the flat index arrays of the triangulation instead of a TriangleSet
+    DelaunayTriangulation triangulation(vertices);
+    const std::vector<int> & triangles = triangulation.triangles();
     
     std::vector<PointType> s_points(3), d_points(3);
     
     std::vector<TriangleTransformationType> result;
+    result.reserve(triangulation.size());
     
-	for (TriangleSet::iterator iter = triangles.begin(); iter!=triangles.end(); iter++) 
+    for(unsigned int t=0; t<triangles.size(); t+=3)
     {
         for(unsigned int i=0; i<3; ++i)
         {
-            unsigned long idx = iter->vertex(i) - vertices.data();
-            s_points[i] = s[idx];
-            s_points[i] = d[idx];
+            int idx = triangles[t+i];
+            s_points[i] = PointType(s[idx][0], s[idx][1]);
+            d_points[i] = PointType(d[idx][0], d[idx][1]);
+        }
+        
+        PointType e1 = d_points[1] - d_points[0],
+                  e2 = d_points[2] - d_points[0];
+        
+        if(std::abs(e1[0]*e2[1] - e1[1]*e2[0]) <= std::numeric_limits<double>::epsilon())
+        {
+            continue;
         }
-        result.push_back(TriangleTransformationType(*iter,
-                                                    vigra::affineMatrix2DFromCorrespondingPoints(d_points.begin(), d_points.end(), s_points.begin())));
+        
+        TriangleTransformationType tri_trans;
+        std::copy(d_points.begin(), d_points.end(), tri_trans.vertices);
+        tri_trans.transformation = vigra::affineMatrix2DFromCorrespondingPoints(d_points.begin(), d_points.end(), s_points.begin());
+        
+        result.push_back(tri_trans);
     }
     
     return result;
 }
 
+/**
+ * A spatial index of the triangles of a piecewise affine transformation.
+ * The bounding box of all triangles is divided into a regular grid of cells,
+ * where each cell knows the triangles, which overlap it. Thus, finding the
+ * triangle of a point only needs to test the few triangles of one cell instead
+ * of all triangles.
+ */
+class TriangleIndex
+{
+    public:
+        /**
+         * Builds the index for triangles as returned by computePiecewiseAffineTransformations.
+         * The cells are chosen such that there is about one triangle per cell.
+         * The triangles need to stay valid as long as the index is used.
+         *
+         * \param tri_trans The triangles and their transformations.
+         */
+        TriangleIndex(const std::vector<TriangleTransformationType> & tri_trans)
+        :   m_tri_trans(tri_trans),
+            m_cols(0),
+            m_rows(0)
+        {
+            if(tri_trans.empty())
+            {
+                return;
+            }
+            
+            m_ul = m_lr = tri_trans.front().vertices[0];
+            
+            for(const TriangleTransformationType & tri : tri_trans)
+            {
+                for(unsigned int i=0; i<3; ++i)
+                {
+                    m_ul = min(m_ul, tri.vertices[i]);
+                    m_lr = max(m_lr, tri.vertices[i]);
+                }
+            }
+            
+            PointType size = m_lr - m_ul;
+            m_cell_size = std::max(std::sqrt(size[0]*size[1]/tri_trans.size()), 1.0);
+            
+            m_cols = (unsigned int)(size[0]/m_cell_size) + 1;
+            m_rows = (unsigned int)(size[1]/m_cell_size) + 1;
+            m_cells.resize(m_cols*m_rows);
+            
+            for(unsigned int t=0; t<tri_trans.size(); ++t)
+            {
+                const PointType * v = tri_trans[t].vertices;
+                
+                PointType tri_ul = min(min(v[0], v[1]), v[2]),
+                          tri_lr = max(max(v[0], v[1]), v[2]);
+                
+                for(unsigned int y=cell(tri_ul[1], m_ul[1], m_rows); y<=cell(tri_lr[1], m_ul[1], m_rows); ++y)
+                {
+                    for(unsigned int x=cell(tri_ul[0], m_ul[0], m_cols); x<=cell(tri_lr[0], m_ul[0], m_cols); ++x)
+                    {
+                        m_cells[y*m_cols + x].push_back(t);
+                    }
+                }
+            }
+        }
+    
+        /**
+         * Finds the triangle, which contains a point. If the point is inside more than one
+         * triangle (on a shared edge), the first one is returned.
+         *
+         * \param point The point.
+         * \return The index of the triangle in the vector given at construction, or -1
+         *         if the point is outside of all triangles.
+         */
+        int find(const PointType & point) const
+        {
+            if(    m_cells.empty()
+               ||  point[0] < m_ul[0] || point[1] < m_ul[1]
+               ||  point[0] > m_lr[0] || point[1] > m_lr[1])
+            {
+                return -1;
+            }
+            
+            for(unsigned int t : m_cells[cell(point[1], m_ul[1], m_rows)*m_cols + cell(point[0], m_ul[0], m_cols)])
+            {
+                if(m_tri_trans[t].isInside(point))
+                {
+                    return t;
+                }
+            }
+            return -1;
+        }
+    
+    private:
+        /**
+         * Computes the cell index of a coordinate in one dimension.
+         *
+         * \param coord The coordinate.
+         * \param origin The origin of the grid in that dimension.
+         * \param count The number of cells in that dimension.
+         * \return The index of the cell (clipped to the grid).
+         */
+        unsigned int cell(double coord, double origin, unsigned int count) const
+        {
+            return (unsigned int)std::min(std::max((coord - origin)/m_cell_size, 0.0), count - 1.0);
+        }
+    
+        /** The indexed triangles **/
+        const std::vector<TriangleTransformationType> & m_tri_trans;
+        /** The bounding box of all triangles **/
+        PointType m_ul, m_lr;
+        /** The size of each (square) cell **/
+        double m_cell_size;
+        /** The number of cells in each dimension **/
+        unsigned int m_cols, m_rows;
+        /** The triangle indices of each cell (row by row) **/
+        std::vector<std::vector<unsigned int> > m_cells;
+};
+
+/**
+ * Applies a piecewise affine transformation to a single (destination) point by
+ * means of a triangle index.
+ *
+ * \param tri_trans The triangles and their transformations as returned by computePiecewiseAffineTransformations.
+ * \param index The index of these triangles.
+ * \param point The point in destination coordinates.
+ * \param[out] result The transformed point in source coordinates.
+ * \return True, if the point is inside a triangle. Otherwise, result is not changed.
+ */
+inline bool piecewiseAffineTransformPoint(const std::vector<TriangleTransformationType> & tri_trans, const TriangleIndex & index,
+                                          const PointType & point, PointType & result)
+{
+    int t = index.find(point);
+    
+    if(t < 0)
+    {
+        return false;
+    }
+    
+    const vigra::Matrix<double> & transformation = tri_trans[t].transformation;
+    result[0] = transformation(0,0)*point[0] + transformation(0,1)*point[1] + transformation(0,2);
+    result[1] = transformation(1,0)*point[0] + transformation(1,1)*point[1] + transformation(1,2);
+    return true;
+}
+
 /**
  * Given a piecewise affine transformation structure as returned by computePiecewiseAffineTransformations
- * this function returns the transformed image.
+ * this function returns the transformed image. Instead of testing each pixel against all
+ * triangles, each triangle is rasterised by scanlines, which makes the costs linear in
+ * the number of pixels plus triangles. The rows of the destination are split into
+ * blocks, which are processed in parallel. Pixels on an edge shared by two triangles
+ * get the value of the later triangle, pixels outside of all triangles are not changed.
  * 
  * \param src The source image.
  * \param dest The destination image.
@@ -129,25 +339,102 @@ template <int ORDER, class T1, class T2>
 void piecewiseAffineWarpImage(vigra::SplineImageView<ORDER, T1> const & src, vigra::MultiArrayView<2,T2> dest,
                               const std::vector<TriangleTransformationType> & tri_trans)
 {
-
-    for(unsigned int y = 0; y<dest.height(); ++y)
+    const int width = dest.width(), height = dest.height();
+    
+    if(width == 0 || height == 0)
     {
-        for(unsigned int x=0; x<dest.width(); ++x)
+        return;
+    }
+    
+    //Split the rows into one block per thread and find the triangles of each block
+    const unsigned int blocks = std::min((unsigned int)height, std::max(Scheduler::instance()->threadCount(), 1u));
+    std::vector<std::vector<unsigned int> > block_triangles(blocks);
+    
+    for(unsigned int t=0; t<tri_trans.size(); ++t)
+    {
+        const PointType * v = tri_trans[t].vertices;
+        
+        int y_min = (int)std::ceil(std::min(std::min(v[0][1], v[1][1]), v[2][1])),
+            y_max = (int)std::floor(std::max(std::max(v[0][1], v[1][1]), v[2][1]));
+        
+        y_min = std::max(y_min, 0);
+        y_max = std::min(y_max, height-1);
+        
+        if(y_min > y_max)
         {
-            for(std::vector<TriangleTransformationType>::const_iterator iter=tri_trans.begin(); iter!=tri_trans.end(); ++iter)
-            {
-                if(iter->first.isInside(PointType(x,y)))
-                {
-                    vigra::Matrix<double> transformation = iter->second;
-                    double sx = transformation(0,0)*x + transformation(0,1)*y + transformation(0,2);
-                    double sy = transformation(1,0)*x + transformation(1,1)*y + transformation(1,2); 
-                    
-                    if(src.isInside(sx, sy))
-                        dest(x,y) =  src(sx, sy);
-                }
-            }
+            continue;
+        }
+        
+        for(unsigned int b=(unsigned int)y_min*blocks/height; b<=(unsigned int)y_max*blocks/height; ++b)
+        {
+            block_triangles[b].push_back(t);
         }
     }
+    
+    parallelFor(blocks,
+                [&](unsigned int b)
+                {
+                    //SplineImageViews cache the last coefficients and are thus not thread-safe
+                    vigra::SplineImageView<ORDER, T1> block_src(src);
+                    
+                    //Rows of this block: y*blocks/height == b
+                    const int block_begin = (b*height + blocks - 1)/blocks,
+                              block_end   = ((b+1)*height + blocks - 1)/blocks;
+                    
+                    for(unsigned int t : block_triangles[b])
+                    {
+                        const PointType * v = tri_trans[t].vertices;
+                        const vigra::Matrix<double> & transformation = tri_trans[t].transformation;
+                        
+                        int y_begin = std::max((int)std::ceil(std::min(std::min(v[0][1], v[1][1]), v[2][1])), block_begin),
+                            y_end   = std::min((int)std::floor(std::max(std::max(v[0][1], v[1][1]), v[2][1])) + 1, block_end);
+                        
+                        for(int y=y_begin; y<y_end; ++y)
+                        {
+                            //Intersect the scanline with the triangle's edges
+                            double x_min = std::numeric_limits<double>::max(),
+                                   x_max = -std::numeric_limits<double>::max();
+                            
+                            for(unsigned int e=0; e<3; ++e)
+                            {
+                                const PointType & p0 = v[e],
+                                                & p1 = v[(e+1)%3];
+                                
+                                if(std::min(p0[1], p1[1]) <= y && y <= std::max(p0[1], p1[1]))
+                                {
+                                    if(p0[1] == p1[1])
+                                    {
+                                        x_min = std::min(x_min, std::min(p0[0], p1[0]));
+                                        x_max = std::max(x_max, std::max(p0[0], p1[0]));
+                                    }
+                                    else
+                                    {
+                                        double x = p0[0] + (y - p0[1])*(p1[0] - p0[0])/(p1[1] - p0[1]);
+                                        x_min = std::min(x_min, x);
+                                        x_max = std::max(x_max, x);
+                                    }
+                                }
+                            }
+                            
+                            //Points on the edges belong to the triangle
+                            const double eps = 1.0e-9;
+                            
+                            int x_begin = std::max((int)std::ceil(x_min - eps), 0),
+                                x_end   = std::min((int)std::floor(x_max + eps) + 1, width);
+                            
+                            double sx = transformation(0,0)*x_begin + transformation(0,1)*y + transformation(0,2),
+                                   sy = transformation(1,0)*x_begin + transformation(1,1)*y + transformation(1,2);
+                            
+                            for(int x=x_begin; x<x_end; ++x, sx+=transformation(0,0), sy+=transformation(1,0))
+                            {
+                                if(block_src.isInside(sx, sy))
+                                {
+                                    dest(x,y) = block_src(sx, sy);
+                                }
+                            }
+                        }
+                    }
+                });
 }
 
 /**
@@ -35,6 +35,7 @@
 
 #include "images/images.h"
 #include "vectorfields/vectorfields.h"
+#include "features2d/features2d.h"
 #include "core/core.h"
 
 #include "registration/warpingfunctors.hxx"
@@ -43,6 +44,8 @@
 
 #include <QElapsedTimer>
 
+#include <type_traits>
+
 namespace graipe {
 
 /**
@@ -260,32 +263,42 @@ class GenericRegistration
                     
                     emit statusMessage(1.0, QString("starting computation"));
                     
-                    WARPING_FUNCTOR func_a;
-                    
                     Image<float>* new_image = new Image<float>(image2->size(), image1->numBands(), m_workspace);
                     
-                    vigra::MultiArray<2,float> res_img_band(image2->size());
                     std::vector<vigra::TinyVector<double,2> > src_points(vf->size()), dest_points(vf->size());
             
                     for(unsigned int i=0; i<vf->size(); ++i)
                     {
                         src_points[i][0] = vf->origin(i).x();
-                        src_points[i][1] = vf->origin(i).x();
+                        src_points[i][1] = vf->origin(i).y();
                 
                         dest_points[i][0] = vf->target(i).x();
                         dest_points[i][1] = vf->target(i).y();
                     }
                     
-                    for(unsigned int c=0; c<image1->numBands(); c++)
+                    //Use the fast counterpart of the warping functor (if any) for many correspondences
+                    typedef typename FastWarpingFunctor<WARPING_FUNCTOR>::type FAST_WARPING_FUNCTOR;
+                    
+                    QString functor_name;
+                    
+                    if(     vf->size() > fast_rbf_point_threshold
+                        &&  !std::is_same<FAST_WARPING_FUNCTOR, WARPING_FUNCTOR>::value)
                     {
-                        func_a(image1->band(c), new_image->band(c), src_points.begin(), src_points.end(), dest_points.begin());
-            
+                        FAST_WARPING_FUNCTOR func_a;
+                        warpBands(func_a, image1, new_image, src_points, dest_points);
+                        functor_name = func_a.name();
+                    }
+                    else
+                    {
+                        WARPING_FUNCTOR func_a;
+                        warpBands(func_a, image1, new_image, src_points, dest_points);
+                        functor_name = func_a.name();
                     }
                     
-                    new_image->setName(func_a.name() + QString(" of ") + image1->name() + QString(" to ") + image2->name());
+                    new_image->setName(functor_name + QString(" of ") + image1->name() + QString(" to ") + image2->name());
                     QString descr("The following components were used to compute the ");
                     
-                    descr += func_a.name() + QString(":\n");
+                    descr += functor_name + QString(":\n");
                     descr +=  QString("First image: ") + image1->name()  + QString("\n");
                     descr +=  QString("Reference image: ") + image2->name()  + QString("\n");
                     descr +=  QString("Correspondence vectorfield: ") + vf->name()  + QString("\n");
@@ -310,6 +323,27 @@ class GenericRegistration
                 unlockModels();
             }
         }
+    
+    protected:
+        /**
+         * Warps all bands of an image by means of a warping functor.
+         *
+         * \param func The warping functor.
+         * \param image The image to be warped.
+         * \param new_image The warped image, which needs to have as many bands as the image.
+         * \param src_points The source points of the correspondences.
+         * \param dest_points The destination points of the correspondences.
+         */
+        template <class FUNCTOR>
+        void warpBands(FUNCTOR & func, Image<float>* image, Image<float>* new_image,
+                       std::vector<vigra::TinyVector<double,2> > & src_points,
+                       std::vector<vigra::TinyVector<double,2> > & dest_points)
+        {
+            for(unsigned int c=0; c<image->numBands(); c++)
+            {
+                func(image->band(c), new_image->band(c), src_points.begin(), src_points.end(), dest_points.begin());
+            }
+        }
 };
 
 		
@@ -541,6 +575,163 @@ Algorithm* createTPSRegistration(Workspace* wsp)
 
 
 
+/**
+ * This algorithm applies the piecewise affine registration to sparse point
+ * features or vectors instead of images. The positions of the features (or
+ * the origins and targets of the vectors) are given in the coordinates of the
+ * first image of the correspondence map and are transformed into the reference
+ * image's coordinates. Each position is looked up by means of a TriangleIndex,
+ * positions outside of the triangulation are dropped.
+ */
+class PiecewiseAffinePointRegistration
+:   public Algorithm
+{
+	public:
+        /**
+         * Default constructor. Adds all neccessary parameters for this algorithm to run.
+         *
+         * \param wsp The workspace to be used.
+         */
+		PiecewiseAffinePointRegistration(Workspace* wsp)
+        : Algorithm(wsp)
+		{
+			m_parameters->addParameter("model", new ModelParameter("Features or vectors to be transformed",
+                                                                   "PointFeatureList2D, WeightedPointFeatureList2D, EdgelFeatureList2D, SIFTFeatureList2D, "
+                                                                   "SparseVectorfield2D, SparseWeightedVectorfield2D, SparseMultiVectorfield2D, SparseWeightedMultiVectorfield2D",
+                                                                   NULL, false, wsp));
+			m_parameters->addParameter("vf", new ModelParameter("Correspondence Map",  "SparseVectorfield2D", NULL, false, wsp));
+		}
+		
+        /**
+         * Returns the name of this algorithm.
+         * 
+         * \return Always: "PiecewiseAffinePointRegistration"
+         */
+        QString typeName() const
+        {
+            return "PiecewiseAffinePointRegistration";
+        }
+
+        /**
+         * Specialization of the running phase of this algorithm.
+         */
+		void run()
+		{
+            if(!parametersValid())
+            {
+                //Parameters set incorrectly
+                emit errorMessage(QString("Some parameters are not available"));
+            }
+            else
+            {
+                lockModels();
+                try
+                {
+                    emit statusMessage(0.0, QString("started"));
+                    
+                    ModelParameter	* param_model = static_cast<ModelParameter*> ((*m_parameters)["model"]),
+                                    * param_vf = static_cast<ModelParameter*> ((*m_parameters)["vf"]);
+                    
+                    Model* model = param_model->value();
+                    Vectorfield2D* vf =  static_cast<Vectorfield2D*> (param_vf->value());
+                    
+                    emit statusMessage(1.0, QString("starting computation"));
+                    
+                    std::vector<PointType> src_points(vf->size()), dest_points(vf->size());
+            
+                    for(unsigned int i=0; i<vf->size(); ++i)
+                    {
+                        src_points[i] = PointType(vf->origin(i).x(), vf->origin(i).y());
+                        dest_points[i] = PointType(vf->target(i).x(), vf->target(i).y());
+                    }
+                    
+                    //Triangulate the reference points, such that the transformations
+                    //map from the first image into the reference image
+                    std::vector<TriangleTransformationType> tri_trans = computePiecewiseAffineTransformations(dest_points.begin(), dest_points.end(), src_points.begin());
+                    TriangleIndex index(tri_trans);
+                    
+                    emit statusMessage(50.0, QString("transforming positions"));
+                    
+                    Model* new_model = NULL;
+                    PointType p, p_new, t_new;
+                    
+                    if(model->typeName().contains("FeatureList2D"))
+                    {
+                        PointFeatureList2D* features = static_cast<PointFeatureList2D*>(model);
+                        PointFeatureList2D* new_features = new PointFeatureList2D(m_workspace);
+                        
+                        for(unsigned int i=0; i<features->size(); ++i)
+                        {
+                            p = PointType(features->position(i).x(), features->position(i).y());
+                            
+                            if(piecewiseAffineTransformPoint(tri_trans, index, p, p_new))
+                            {
+                                new_features->addFeature(PointFeatureList2D::PointType(p_new[0], p_new[1]));
+                            }
+                        }
+                        new_model = new_features;
+                    }
+                    else
+                    {
+                        Vectorfield2D* vectors = static_cast<Vectorfield2D*>(model);
+                        SparseVectorfield2D* new_vectors = new SparseVectorfield2D(m_workspace);
+                        
+                        for(unsigned int i=0; i<vectors->size(); ++i)
+                        {
+                            p = PointType(vectors->origin(i).x(), vectors->origin(i).y());
+                            
+                            PointType t(vectors->target(i).x(), vectors->target(i).y());
+                            
+                            if(     piecewiseAffineTransformPoint(tri_trans, index, p, p_new)
+                                &&  piecewiseAffineTransformPoint(tri_trans, index, t, t_new))
+                            {
+                                new_vectors->addVector(Vectorfield2D::PointType(p_new[0], p_new[1]),
+                                                       Vectorfield2D::PointType(t_new[0]-p_new[0], t_new[1]-p_new[1]));
+                            }
+                        }
+                        new_model = new_vectors;
+                    }
+                    
+                    new_model->setName(QString("Piecewise affine reg. of ") + model->name());
+                    QString descr("The following components were used to compute the piecewise affine registration:\n");
+                    descr +=  QString("Transformed model: ") + model->name()  + QString("\n");
+                    descr +=  QString("Correspondence vectorfield: ") + vf->name()  + QString("\n");
+                    new_model->setDescription(descr);
+                    
+                    vf->copyGeometry(*new_model);
+                    
+                    m_results.push_back(new_model);
+                    
+                    emit statusMessage(100.0, QString("finished computation"));
+                    emit finished();
+                }
+                catch(std::exception& e)
+                {
+                    emit errorMessage(QString("Explainable error occured: ") + QString::fromStdString(e.what()));
+                }
+                catch(...)
+                {
+                    emit errorMessage(QString("Non-explainable error occured"));		
+                }
+                unlockModels();
+            }
+        }
+};
+
+/** 
+ * Creates one instance of the piecewise affine registration of sparse
+ * point features or vectors defined above.
+ *
+ * \return A new instance of the PiecewiseAffinePointRegistration.
+ */
+Algorithm* createPiecewiseAffinePointRegistration(Workspace* wsp)
+{
+	return new PiecewiseAffinePointRegistration(wsp);
+}
+
+
+
+
 /**
  * This class encapsulates all the functionality of this module in a 
  * way that it can be used within graipe. To achieve this, it extends
@@ -665,6 +856,12 @@ class RegistrationModule
 			alg_item.algorithm_fptr = &createTPSRegistration;
 			alg_factory.push_back(alg_item);	
 			
+			//11. Piecewise affine registration of features and vectors
+			alg_item.algorithm_name = "Piecewise affine registration (features/vectors)";
+            alg_item.algorithm_type = "PiecewiseAffinePointRegistration";
+			alg_item.algorithm_fptr = &createPiecewiseAffinePointRegistration;
+			alg_factory.push_back(alg_item);	
+			
 			return alg_factory;
 		}
 		
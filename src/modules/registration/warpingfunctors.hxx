@@ -43,11 +43,14 @@
 #include <vigra/affinegeometry.hxx>
 
 #include "registration/piecewiseaffine_registration.hxx"
+#include "registration/fast_rbf_registration.hxx"
 
 #include <vigra/projective_registration.hxx>
 #include <vigra/polynomial_registration.hxx>
 #include <vigra/rbf_registration.hxx>
 
+#include <memory>
+
 namespace graipe {
 
 /**
@@ -293,6 +296,111 @@ class WarpRadialBasisFunctor
         }
 };
 
+/**  General neighborhood size trait for the fast RBF fitting: **/
+template<class T> unsigned int rbfNeighbors()                                  { return 32; }
+/**  The cubic Distance Power functor needs larger neighborhoods for its cardinal functions: **/
+template<>        unsigned int rbfNeighbors<vigra::DistancePowerFunctor<3> >() { return 64; }
+
+
+
+
+/**
+ * This class is the hull for the fast Radial Basis Function (RBF) registration.
+ * In contrast to the WarpRadialBasisFunctor, it does not solve the dense system,
+ * but uses the FastRBFTransformation and evaluates it on a coarse grid only.
+ * Thus, it is suited for many (e.g. dense) correspondences. The fitted
+ * transformation is kept for further calls with the same correspondences,
+ * like for the other bands of an image.
+ */
+template <class RadialBasisFunctor>
+class WarpFastRadialBasisFunctor
+{
+    public:
+        /**
+         * Default constructor.
+         *
+         * \param grid_spacing The spacing of the grid, on which the transformation is evaluated.
+         */
+        WarpFastRadialBasisFunctor(unsigned int grid_spacing=4)
+        :   m_grid_spacing(grid_spacing)
+        {
+        }
+    
+        /**
+         * The functor call. It transforms the first image with respect to the given point correspondences
+         * and the RBF functor to match the second image as best as possible, given the RBF model.
+         *
+         * \param src   The first image.
+         * \param dest  The second (reference) image.
+         * \param s     The begin() iterator of the source points.
+         * \param s_end The end() iterator of the source points.
+         * \param d    The begin() iterator of the corresponding dest points.
+         */
+        template <class T1, class T2, class SrcPointIterator, class DestPointIterator>
+        void operator()(const vigra::MultiArrayView<2, T1> & src, vigra::MultiArrayView<2, T2> dest,
+                        SrcPointIterator s, SrcPointIterator s_end,
+                        DestPointIterator d)
+        {
+            std::vector<vigra::TinyVector<double,2> > s_points(s, s_end),
+                                                      d_points(d, d + (s_end - s));
+            
+            if(!m_transformation || s_points != m_s_points || d_points != m_d_points)
+            {
+                m_transformation.reset(new FastRBFTransformation<RadialBasisFunctor>(s_points.begin(), s_points.end(), d_points.begin(),
+                                                                                     RadialBasisFunctor(), 1.0e-5, 500,
+                                                                                     rbfNeighbors<RadialBasisFunctor>()));
+                m_s_points.swap(s_points);
+                m_d_points.swap(d_points);
+            }
+            
+            fastRbfWarpImage(vigra::SplineImageView<4, T1>(src), dest, *m_transformation, m_grid_spacing);
+        }
+    
+        /**
+         * The static name of this functor. It mainly depends on the Name traits above the 
+         * class definition.
+         *
+         * \return The name of this functor.
+         */
+        static QString name()
+        {
+            return rbfName<RadialBasisFunctor>() + " (fast)";
+        }
+    
+    private:
+        /** The spacing of the evaluation grid **/
+        unsigned int m_grid_spacing;
+        /** The correspondences of the last fitted transformation **/
+        std::vector<vigra::TinyVector<double,2> > m_s_points, m_d_points;
+        /** The last fitted transformation **/
+        std::shared_ptr<FastRBFTransformation<RadialBasisFunctor> > m_transformation;
+};
+
+
+
+
+/**
+ * Traits to find the fast counterpart of a warping functor, which is used
+ * by the GenericRegistration for many point correspondences. By default, a
+ * warping functor has no fast counterpart.
+ */
+template <class WarpingFunctor>
+struct FastWarpingFunctor
+{
+    /** The fast warping functor type **/
+    typedef WarpingFunctor type;
+};
+
+/**
+ * The fast counterpart of the Radial Basis Function (RBF) registration.
+ */
+template <class RadialBasisFunctor>
+struct FastWarpingFunctor<WarpRadialBasisFunctor<RadialBasisFunctor> >
+{
+    /** The fast warping functor type **/
+    typedef WarpFastRadialBasisFunctor<RadialBasisFunctor> type;
+};
+
 /**
  * @{
  *
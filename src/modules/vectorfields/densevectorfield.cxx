@@ -285,20 +285,16 @@ void DenseVectorfield2D::serialize_content(QXmlStreamWriter& xmlWriter) const
       
         qint64 channel_size = m_u.width()*m_u.height()*sizeof(ArrayType::value_type);
 
-        QByteArray block((const char*)m_u.data(),channel_size);
-            
         xmlWriter.writeStartElement("Channel");
         xmlWriter.writeAttribute("ID", "u");
-        xmlWriter.writeAttribute("Encoding", "Base64");
-            xmlWriter.writeCharacters(block.toBase64());
+        xmlWriter.writeAttribute("Encoding", BinaryContainer::encoding(xmlWriter));
+            BinaryContainer::writeBlock(xmlWriter, (const char*)m_u.data(), channel_size);
         xmlWriter.writeEndElement();
         
-        block = QByteArray((const char*)m_v.data(),channel_size);
-            
         xmlWriter.writeStartElement("Channel");
         xmlWriter.writeAttribute("ID", "v");
-        xmlWriter.writeAttribute("Encoding", "Base64");
-            xmlWriter.writeCharacters(block.toBase64());
+        xmlWriter.writeAttribute("Encoding", BinaryContainer::encoding(xmlWriter));
+            BinaryContainer::writeBlock(xmlWriter, (const char*)m_v.data(), channel_size);
         xmlWriter.writeEndElement();
     }
     catch(...)
@@ -331,34 +327,23 @@ bool DenseVectorfield2D::deserialize_content(QXmlStreamReader& xmlReader)
             if(xmlReader.name() == "Channel"
                 && xmlReader.attributes().hasAttribute("ID")
                 && xmlReader.attributes().hasAttribute("Encoding")
-                && xmlReader.attributes().value("Encoding") == "Base64")
+                && (   xmlReader.attributes().value("Encoding") == "Base64"
+                    || xmlReader.attributes().value("Encoding") == "Binary"))
             {
                 QString id = xmlReader.attributes().value("ID").toString();
                 
-                QByteArray block;
-                block.append(xmlReader.readElementText());
-                block = QByteArray::fromBase64(block);
-                
                 if (id  == "u")
                 {
-                    if(block.size() == channel_size)
+                    if(!BinaryContainer::readBlock(xmlReader, (char*)m_u.data(), channel_size))
                     {
-                        memcpy((char*)m_u.data(), block.data(), channel_size);
-                    }
-                    else
-                    {
-                        throw std::runtime_error("Channel serialization was of wrong size in XML after Base64 decoding for u field.");
+                        throw std::runtime_error("Channel serialization was of wrong size after decoding for u field.");
                     }
                 }
                 else if (id  == "v")
                 {
-                    if(block.size() == channel_size)
-                    {
-                        memcpy((char*)m_v.data(), block.data(), channel_size);
-                    }
-                    else
+                    if(!BinaryContainer::readBlock(xmlReader, (char*)m_v.data(), channel_size))
                     {
-                        throw std::runtime_error("Channel serialization was of wrong size in XML after Base64 decoding for v field.");
+                        throw std::runtime_error("Channel serialization was of wrong size after decoding for v field.");
                     }
                 }
             
@@ -511,12 +496,10 @@ void DenseWeightedVectorfield2D::serialize_content(QXmlStreamWriter& xmlWriter)
     {
         qint64 channel_size = m_w.width()*m_w.height()*sizeof(ArrayType::value_type);
 
-        QByteArray block((const char*)m_w.data(),channel_size);
-            
         xmlWriter.writeStartElement("Channel");
         xmlWriter.writeAttribute("ID", "w");
-        xmlWriter.writeAttribute("Encoding", "Base64");
-            xmlWriter.writeCharacters(block.toBase64());
+        xmlWriter.writeAttribute("Encoding", BinaryContainer::encoding(xmlWriter));
+            BinaryContainer::writeBlock(xmlWriter, (const char*)m_w.data(), channel_size);
         xmlWriter.writeEndElement();
     }
     catch(...)
@@ -552,19 +535,12 @@ bool DenseWeightedVectorfield2D::deserialize_content(QXmlStreamReader& xmlReader
             && xmlReader.attributes().hasAttribute("ID")
             && xmlReader.attributes().value("ID") == "w"
             && xmlReader.attributes().hasAttribute("Encoding")
-            && xmlReader.attributes().value("Encoding") == "Base64")
+            && (   xmlReader.attributes().value("Encoding") == "Base64"
+                || xmlReader.attributes().value("Encoding") == "Binary"))
         {
-            QByteArray block;
-            block.append(xmlReader.readElementText());
-            block = QByteArray::fromBase64(block);
-            
-            if(block.size() == channel_size)
-            {
-                memcpy((char*)m_w.data(), block.data(), channel_size);
-            }
-            else
+            if(!BinaryContainer::readBlock(xmlReader, (char*)m_w.data(), channel_size))
             {
-                throw std::runtime_error("Channel serialization was of wrong size in XML after Base64 decoding for w field.");
+                throw std::runtime_error("Channel serialization was of wrong size after decoding for w field.");
             }
         }
         else
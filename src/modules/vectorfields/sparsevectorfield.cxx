@@ -842,6 +842,53 @@ void SparseWeightedMultiVectorfield2D::addVector(const PointType& orig, const st
     addVector(orig, all_dirs.front(),all_weights.front(), alt_dirs, alt_weights);
 }
 
+void SparseWeightedMultiVectorfield2D::addVectors(const std::vector<PointType>& origs,
+                                                  const std::vector<std::vector<PointType> >& all_dirs,
+                                                  const std::vector<std::vector<float> >& all_weights)
+{
+	if(locked())
+        return;
+    
+    Q_ASSERT(origs.size() == all_dirs.size());
+    Q_ASSERT(origs.size() == all_weights.size());
+    
+    unsigned int alt_count = alternatives();
+    size_t new_size = m_origins.size() + origs.size();
+    
+    m_origins.reserve(new_size);
+    m_directions.reserve(new_size);
+    m_alt_directions.reserve(new_size);
+    m_weights.reserve(new_size);
+    m_alt_weights.reserve(new_size);
+    
+    for(unsigned int i=0; i<origs.size(); ++i)
+    {
+        const std::vector<PointType>& dirs = all_dirs[i];
+        const std::vector<float>& weights = all_weights[i];
+        
+        if(dirs.empty())
+            continue;
+        
+        std::vector<PointType> alt_dirs(alt_count);
+        std::vector<float> alt_weights(alt_count);
+        
+        for (unsigned int alt_index=0; alt_index<alt_count; ++alt_index)
+        {
+            if(alt_index+1 < dirs.size())
+                alt_dirs[alt_index] = dirs[alt_index+1];
+            if(alt_index+1 < weights.size())
+                alt_weights[alt_index] = weights[alt_index+1];
+        }
+        
+        m_origins.push_back(origs[i]);
+        m_directions.push_back(dirs.front());
+        m_alt_directions.push_back(alt_dirs);
+        m_weights.push_back(weights.empty() ? 0.0f : weights.front());
+        m_alt_weights.push_back(alt_weights);
+    }
+    updateModel();
+}
+
 void SparseWeightedMultiVectorfield2D::removeVector(unsigned int index)
 {
     if(locked())
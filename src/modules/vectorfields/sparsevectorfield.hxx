@@ -787,6 +787,21 @@ class GRAIPE_VECTORFIELDS_EXPORT SparseWeightedMultiVectorfield2D
          * \param all_weights The alternative direction weights of the new vector.
          */
 		virtual void addVector(const PointType& orig, const std::vector<PointType>& all_dirs, const std::vector<float>& all_weights);
+    
+        /**
+         * Add many vectors to the sparse weighted multi vectorfield at once. For each i, this
+         * behaves like addVector(origs[i], all_dirs[i], all_weights[i]), but the storage is
+         * reserved only once and the model is updated only once after the last vector.
+         * Entries with an empty list of directions are skipped. Missing weights are set to zero.
+         * Does nothing if the model is locked.
+         *
+         * \param origs The origins of the new vectors.
+         * \param all_dirs The directions (first: main, others: alternatives) of each new vector.
+         * \param all_weights The weights of these directions for each new vector.
+         */
+		void addVectors(const std::vector<PointType>& origs,
+                        const std::vector<std::vector<PointType> >& all_dirs,
+                        const std::vector<std::vector<float> >& all_weights);
 	
         /**
          * Removing a vector from the vector field at a given index